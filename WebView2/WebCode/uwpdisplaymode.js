@@ -26,6 +26,13 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
     const SUPPORT_HDR_AFFIX = ",hdr=1";
     const SUPPORT_DV_AFFIX = ",ext-profile=dvhe.05";
 
+    // This string checks for PlayReady SL3000 (hardware) support. Your app must
+    // specify the hevcPlayback capability in its appxmanifest file to use SL3000.
+    // If you only need SL2000, use "com.microsoft.playready.recommendation" instead.
+    // For more information see:
+    // https://learn.microsoft.com/en-us/playready/overview/key-system-strings
+    const PLAYREADY_KEY_SYSTEM = "com.microsoft.playready.recommendation.3000";
+
     // Strings useful for checking types of HDCP support
     public.hdcpTypes = {
         hdcp1: "video/mp4;codecs=\"hvc1,mp4a\";features=\"hdcp=1\"",
@@ -48,6 +55,13 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
         dolbyDigitalPlus: "video/mp4;codecs=\"hvc1,ec-3\";"
     };
 
+    // The native DisplayModeSelector picks a mode in one call, rather than reading every supported
+    // mode through the host object proxies, and doesn't switch if the display is already in it.
+    // Without it, the modes are filtered here instead.
+    function hasDisplayModeSelector() {
+        return WindowsProxies.DisplayModeSelector !== undefined;
+    }
+
     // Sample function which switches the display to 4K Dolby Vision mode,
     // if supported. Returns false otherwise, and prints warnings to the console.
     public.switchTVModeTo4KDVAsync = async function () {
@@ -61,6 +75,11 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
             return false;
         }
 
+        if (hasDisplayModeSelector()) {
+            return await WindowsProxies.DisplayModeSelector.requestSetBestModeAsync(
+                WindowsProxies.DisplayModeKind.dolbyVision4K);
+        }
+
         let hdmiInfo = Windows.Graphics.Display.Core.HdmiDisplayInformation.getForCurrentView();
         let modes = hdmiInfo.getSupportedDisplayModes();
 
@@ -93,6 +112,11 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
             return false;
         }
 
+        if (hasDisplayModeSelector()) {
+            return await WindowsProxies.DisplayModeSelector.requestSetBestModeAsync(
+                WindowsProxies.DisplayModeKind.hdr4K);
+        }
+
         let hdmiInfo = Windows.Graphics.Display.Core.HdmiDisplayInformation.getForCurrentView();
         let modes = hdmiInfo.getSupportedDisplayModes();
 
@@ -116,7 +140,7 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
     // if supported. Returns false otherwise, and prints warnings to the console.
     public.switchTVModeTo4KSDRAsync = async function () {
         // Validate display supports 4K SDR and HDCP
-        if (!this.isTypeSupportedAsync(this.videoTypes.sdr4k)) {
+        if (!await this.isTypeSupportedAsync(this.videoTypes.sdr4k)) {
             console.warn("Display does not support 4K Resolution");
             return false;
         }
@@ -125,6 +149,11 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
             return false;
         }
 
+        if (hasDisplayModeSelector()) {
+            return await WindowsProxies.DisplayModeSelector.requestSetBestModeAsync(
+                WindowsProxies.DisplayModeKind.sdr4K);
+        }
+
         let hdmiInfo = Windows.Graphics.Display.Core.HdmiDisplayInformation.getForCurrentView();
         let modes = hdmiInfo.getSupportedDisplayModes();
 
@@ -149,6 +178,11 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
     // If your content is authored with a 25Hz or 50Hz refresh rate, setting the
     // display to a 50Hz display mode is important to avoid visual judder.
     public.switchTVModeTo50HzAsync = async function () {
+        if (hasDisplayModeSelector()) {
+            return await WindowsProxies.DisplayModeSelector.requestSetBestModeAsync(
+                WindowsProxies.DisplayModeKind.refresh50Hz);
+        }
+
         let hdmiInfo = Windows.Graphics.Display.Core.HdmiDisplayInformation.getForCurrentView();
         let modes = hdmiInfo.getSupportedDisplayModes();
 
@@ -168,25 +202,76 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
         }
     };
 
-    // Calls Windows.Media.Protection.ProtectionCapabilities().IsTypeSupported() in a loop
-    // until it gets a non-maybe result.
+    // Answers for every type probed so far, as promises so that callers asking about a type that
+    // is still being probed share the one probe. Forget them when the display changes.
+    let probedTypes = new Map();
+
+    public.forgetProbedTypes = function () {
+        probedTypes.clear();
+    };
+
+    // Every type this script knows about. Probing them all as early as possible, such as before
+    // fetching the catalog, means the checks made when switching display mode answer at once.
+    public.allTypes = function () {
+        return [
+            ...Object.values(this.videoTypes),
+            ...Object.values(this.hdcpTypes),
+            ...Object.values(this.audioTypes)
+        ];
+    };
+
+    // Finds out whether each of the given types is supported, all at once. Returns an object with a
+    // true or false value for each type.
+    public.probeTypesAsync = async function (types) {
+        let unprobed = [...new Set(types.filter(type => !probedTypes.has(type)))];
+        if (unprobed.length > 0) {
+            let probe = probeUnprobedTypesAsync(unprobed);
+            unprobed.forEach((type, i) => probedTypes.set(type, probe.then(results => results[i])));
+        }
+
+        let results = {};
+        for (let type of types) {
+            results[type] = await probedTypes.get(type);
+        }
+        return results;
+    };
+
+    // Calls Windows.Media.Protection.ProtectionCapabilities().IsTypeSupported() until it gets a
+    // non-maybe result.
     // https://learn.microsoft.com/en-us/uwp/api/windows.media.protection.protectioncapabilities.istypesupported
     public.isTypeSupportedAsync = async function (type) {
+        let results = await this.probeTypesAsync([type]);
+        return results[type];
+    };
+
+    // The native MediaCapabilityProber probes all the types concurrently, and remembers the answers
+    // for this console and display so that later launches get them at once. Without it, or if it
+    // fails, each type is polled here instead, so that a failed probe is not remembered as the
+    // types being unsupported.
+    async function probeUnprobedTypesAsync(types) {
+        if (WindowsProxies.MediaCapabilityProber !== undefined) {
+            try {
+                let results = await WindowsProxies.MediaCapabilityProber.probeAsync(types, PLAYREADY_KEY_SYSTEM);
+                return types.map((type, i) => results.getAt(i));
+            } catch (error) {
+                console.error(error);
+            }
+        }
+
+        return await Promise.all(types.map(pollTypeSupportedAsync));
+    }
+
+    // Calls IsTypeSupported in a loop until it gets a non-maybe result.
+    async function pollTypeSupportedAsync(type) {
         try {
-            // This string checks for PlayReady SL3000 (hardware) support. Your app must
-            // specify the hevcPlayback capability in its appxmanifest file to use SL3000.
-            // If you only need SL2000, use "com.microsoft.playready.recommendation" instead.
-            // For more information see:
-            // https://learn.microsoft.com/en-us/playready/overview/key-system-strings
-            let playReadyVersion = "com.microsoft.playready.recommendation.3000";
             let protCap = Windows.Media.Protection.ProtectionCapabilities();
-            let result = protCap.isTypeSupported(type, playReadyVersion);
+            let result = protCap.isTypeSupported(type, PLAYREADY_KEY_SYSTEM);
 
             // Continue checking until we get a non-maybe result. This API will not return
             // "maybe" for more than 10 seconds.
             while (result == Windows.Media.Protection.ProtectionCapabilityResult.maybe) {
                 await new Promise(r => setTimeout(r, 100));
-                result = protCap.isTypeSupported(type, playReadyVersion);
+                result = protCap.isTypeSupported(type, PLAYREADY_KEY_SYSTEM);
             }
 
             return (result != Windows.Media.Protection.ProtectionCapabilityResult.notSupported);
@@ -195,7 +280,7 @@ var uwpDisplayMode = (function (Windows, WindowsProxies) {
         }
 
         return false;
-    };
+    }
 
     return public;
 }(Windows, WindowsProxies));
\ No newline at end of file
@@ -93,7 +93,18 @@ void App::OnLaunched(LaunchActivatedEventArgs const& e)
 void App::OnSuspending(IInspectable const&, SuspendingEventArgs const& e)
 {
     auto deferral{ e.SuspendingOperation().GetDeferral()};
-    //TODO: Save application state and stop any background activity
+
+    // Save the playback session in case the app is terminated while it is suspended. This is a
+    // handful of small synchronous writes, so it finishes well inside the deferral.
+    try
+    {
+        MainPage::GetMediaPlaybackController().SaveSession();
+    }
+    catch (hresult_error const& ex)
+    {
+        OutputDebugString((L"Failed to save the playback session: " + ex.message() + L"\n").c_str());
+    }
+
     ShowToast(L"Suspending");
     deferral.Complete();
 }
@@ -189,8 +200,16 @@ void App::CreateRootFrame(ApplicationExecutionState const& previousExecutionStat
 
         if (previousExecutionState == ApplicationExecutionState::Terminated)
         {
-            // Restore the saved session state only when appropriate, scheduling the
-            // final launch steps after the restore is complete
+            // Restore the playback session saved when the app was suspended, before the page
+            // loads, so that it finds the playlist already in place rather than fetching it
+            try
+            {
+                MainPage::GetMediaPlaybackController().RestoreSession();
+            }
+            catch (hresult_error const& ex)
+            {
+                OutputDebugString((L"Failed to restore the playback session: " + ex.message() + L"\n").c_str());
+            }
         }
 
         // Place the frame in the current Window
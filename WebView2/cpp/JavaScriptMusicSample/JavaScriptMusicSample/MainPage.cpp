@@ -9,6 +9,7 @@
 #include <winrt/Microsoft.Web.WebView2.Core.h>
 #include <winrt/Microsoft.UI.Xaml.Controls.h>
 #include <winrt/Windows.Media.h>
+#include <winrt/Windows.Storage.h>
 #include <winrt/Windows.System.h>
 #include <winrt/Windows.UI.ViewManagement.h>
 #include <winrt/Windows.UI.Xaml.Media.h>
@@ -17,6 +18,7 @@
 using namespace winrt::Microsoft::UI::Xaml::Controls;
 using namespace winrt::Microsoft::Web::WebView2::Core;
 using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Storage;
 using namespace winrt::Windows::System;
 using namespace winrt::Windows::UI::ViewManagement;
 using namespace winrt::Windows::UI::Xaml;
@@ -26,6 +28,17 @@ using namespace winrt;
 
 namespace winrt::JavaScriptMusicSample::implementation
 {
+    /// <summary>
+    /// The MediaPlaybackController that is injected into every WebView. Because it is static, it will
+    /// continue to survive even when the UI is destroyed, and it will not get re-created when the UI
+    /// is reconstructed.
+    /// </summary>
+    NativeMediaPlayer::MediaPlaybackController& MainPage::GetMediaPlaybackController()
+    {
+        static NativeMediaPlayer::MediaPlaybackController mediaPlaybackController{};
+        return mediaPlaybackController;
+    }
+
 	MainPage::MainPage()
     {
         // Xaml objects should not call InitializeComponent during construction.
@@ -93,10 +106,15 @@ namespace winrt::JavaScriptMusicSample::implementation
             // web, you should remove this line.
             coreWV2.SetVirtualHostNameToFolderMapping(L"local.webcode", L"WebCode", CoreWebView2HostResourceAccessKind::Allow);
 
-            // Inject a static instance of the MediaPlaybackController into the WebView so that it can
-            // be accessed through JavaScript. Because it is static, it will continue to survive even
-            // when this UI is destroyed, and it will not get re-created when the UI is reconstructed.
-            static NativeMediaPlayer::MediaPlaybackController mediaPlaybackController{};
+            // The MediaPlaybackController keeps downscaled copies of track artwork in this folder and
+            // points the page at them through this host name. Both must match its ThumbnailCache.
+            StorageFolder thumbnailFolder{ co_await ApplicationData::Current().LocalCacheFolder().CreateFolderAsync(L"Thumbnails", CreationCollisionOption::OpenIfExists) };
+            coreWV2.SetVirtualHostNameToFolderMapping(L"local.thumbnails", thumbnailFolder.Path(), CoreWebView2HostResourceAccessKind::Allow);
+
+            // Inject the MediaPlaybackController into the WebView so that it can be accessed through
+            // JavaScript, and let it know there is a UI to report to again
+            NativeMediaPlayer::MediaPlaybackController mediaPlaybackController{ GetMediaPlaybackController() };
+            mediaPlaybackController.ResumeEvents();
             WinRTAdapter::DispatchAdapter dispatchAdapter{ };
             coreWV2.AddHostObjectToScript(L"mediaPlaybackControllerInstance", dispatchAdapter.WrapObject(mediaPlaybackController, dispatchAdapter));
 
@@ -136,6 +154,10 @@ namespace winrt::JavaScriptMusicSample::implementation
     /// </summary>
     void MainPage::OnUnloaded(IInspectable const&, RoutedEventArgs const&)
     {
+        // Nothing will be displaying playback updates until the UI is recreated, so there is no point
+        // in the MediaPlaybackController waking up the UI thread to send them
+        GetMediaPlaybackController().SuspendEvents();
+
         // Drop references to the WebView so that it can be destructed
         // This allows our app to reduce its memory footprint
         if (webView != nullptr)
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "MainPage.g.h"
+#include "winrt/NativeMediaPlayer.h"
 
 namespace winrt::JavaScriptMusicSample::implementation
 {
@@ -11,6 +12,8 @@ namespace winrt::JavaScriptMusicSample::implementation
     public:
         MainPage();
 
+        static NativeMediaPlayer::MediaPlaybackController& GetMediaPlaybackController();
+
     private:
         /// <summary>
         /// The WebView in which we will be hosting our app's UI
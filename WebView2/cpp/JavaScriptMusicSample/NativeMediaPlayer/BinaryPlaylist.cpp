@@ -0,0 +1,231 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "BinaryPlaylist.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    constexpr char Magic[4]{ 'M', 'P', 'L', 'B' };
+
+    // A file is written here first, then moved over the one it replaces
+    constexpr wchar_t PartialFileExtension[]{ L".partial" };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    BinaryPlaylist::~BinaryPlaylist()
+    {
+        if (view)
+        {
+            UnmapViewOfFile(view);
+        }
+    }
+
+    std::shared_ptr<BinaryPlaylist> BinaryPlaylist::TryOpen(hstring const& path)
+    {
+        std::shared_ptr<BinaryPlaylist> playlist{ new BinaryPlaylist() };
+
+        playlist->file.attach(CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, nullptr));
+        if (!playlist->file)
+        {
+            return nullptr;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(playlist->file.get(), &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header)))
+        {
+            return nullptr;
+        }
+
+        playlist->mapping.attach(CreateFileMappingFromApp(playlist->file.get(), nullptr, PAGE_READONLY, 0, nullptr));
+        if (!playlist->mapping)
+        {
+            return nullptr;
+        }
+
+        playlist->view = static_cast<uint8_t const*>(MapViewOfFileFromApp(playlist->mapping.get(), FILE_MAP_READ, 0, 0));
+        if (!playlist->view)
+        {
+            return nullptr;
+        }
+        playlist->viewSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+        // The string table itself is never read here, so opening does not touch the whole file
+        Header const* header{ reinterpret_cast<Header const*>(playlist->view) };
+        if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 ||
+            header->version != FormatVersion ||
+            header->trackEntrySize != sizeof(TrackEntry))
+        {
+            OutputDebugString(L"Ignoring binary playlist with an unrecognized header or version.\n");
+            return nullptr;
+        }
+
+        uint64_t trackTableEnd{ static_cast<uint64_t>(header->trackTableOffset) + static_cast<uint64_t>(header->trackCount) * sizeof(TrackEntry) };
+        uint64_t stringTableEnd{ static_cast<uint64_t>(header->stringTableOffset) + static_cast<uint64_t>(header->stringTableLength) * sizeof(wchar_t) };
+        if (trackTableEnd > playlist->viewSize || stringTableEnd > playlist->viewSize ||
+            header->trackTableOffset % alignof(TrackEntry) != 0 || header->stringTableOffset % alignof(wchar_t) != 0)
+        {
+            OutputDebugString(L"Ignoring truncated binary playlist.\n");
+            return nullptr;
+        }
+
+        playlist->header = header;
+        playlist->trackTable = reinterpret_cast<TrackEntry const*>(playlist->view + header->trackTableOffset);
+        playlist->stringTable = reinterpret_cast<wchar_t const*>(playlist->view + header->stringTableOffset);
+        if (!playlist->HasValidStrings())
+        {
+            OutputDebugString(L"Ignoring binary playlist with a string reference out of range.\n");
+            return nullptr;
+        }
+        return playlist;
+    }
+
+    void BinaryPlaylist::Write(hstring const& path, std::vector<PlaylistTrackRecord> const& tracks, hstring(*resolveSrc)(hstring const&))
+    {
+        std::vector<wchar_t> stringTable{};
+        std::unordered_map<std::wstring_view, StringRef> internedStrings{};
+
+        // Keep a copy of every resolved src alive until the table is built, since the intern map
+        // holds views into them
+        std::vector<hstring> resolvedSrcs{};
+        resolvedSrcs.reserve(tracks.size());
+
+        auto intern = [&](std::wstring_view value)
+        {
+            if (auto it{ internedStrings.find(value) }; it != internedStrings.end())
+            {
+                return it->second;
+            }
+            StringRef ref{ static_cast<uint32_t>(stringTable.size()), static_cast<uint32_t>(value.size()) };
+            stringTable.insert(stringTable.end(), value.begin(), value.end());
+            internedStrings.emplace(value, ref);
+            return ref;
+        };
+
+        std::vector<TrackEntry> trackTable{};
+        trackTable.reserve(tracks.size());
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            resolvedSrcs.push_back(track.src.empty() ? resolveSrc(track.id) : track.src);
+
+            TrackEntry entry{};
+            entry.id = intern(track.id);
+            entry.src = intern(resolvedSrcs.back());
+            entry.title = intern(track.title);
+            entry.artist = intern(track.artist);
+            entry.image = intern(track.image);
+            trackTable.push_back(entry);
+        }
+
+        Header header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = FormatVersion;
+        header.trackEntrySize = sizeof(TrackEntry);
+        header.trackCount = static_cast<uint32_t>(trackTable.size());
+        header.trackTableOffset = sizeof(Header);
+        header.stringTableOffset = static_cast<uint32_t>(sizeof(Header) + trackTable.size() * sizeof(TrackEntry));
+        header.stringTableLength = static_cast<uint32_t>(stringTable.size());
+
+        hstring partialPath{ path + PartialFileExtension };
+        winrt::file_handle file{ CreateFile2(partialPath.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr) };
+        if (!file)
+        {
+            winrt::throw_last_error();
+        }
+
+        auto writeBytes = [&](void const* data, size_t size)
+        {
+            DWORD written{ 0 };
+            if (size > 0 && (!WriteFile(file.get(), data, static_cast<DWORD>(size), &written, nullptr) || written != size))
+            {
+                winrt::throw_last_error();
+            }
+        };
+        writeBytes(&header, sizeof(header));
+        writeBytes(trackTable.data(), trackTable.size() * sizeof(TrackEntry));
+        writeBytes(stringTable.data(), stringTable.size() * sizeof(wchar_t));
+        file.close();
+
+        // Readers never see a partly written file, and one that still has the old file mapped keeps
+        // reading the old version
+        if (!MoveFileEx(partialPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            winrt::throw_last_error();
+        }
+    }
+
+    uint32_t BinaryPlaylist::Size() const noexcept
+    {
+        return header->trackCount;
+    }
+
+    PlaylistTrackRecord BinaryPlaylist::GetTrack(uint32_t index) const
+    {
+        TrackEntry const& entry{ GetEntry(index) };
+        return PlaylistTrackRecord{
+            hstring{ GetString(entry.id) },
+            hstring{ GetString(entry.title) },
+            hstring{ GetString(entry.artist) },
+            hstring{ GetString(entry.image) },
+            hstring{ GetString(entry.src) }
+        };
+    }
+
+    std::wstring_view BinaryPlaylist::GetField(uint32_t index, Field field) const
+    {
+        TrackEntry const& entry{ GetEntry(index) };
+        switch (field)
+        {
+        case Field::Id:
+            return GetString(entry.id);
+        case Field::Src:
+            return GetString(entry.src);
+        case Field::Title:
+            return GetString(entry.title);
+        case Field::Artist:
+            return GetString(entry.artist);
+        case Field::Image:
+            return GetString(entry.image);
+        }
+        return {};
+    }
+
+    std::wstring_view BinaryPlaylist::GetString(StringRef const& ref) const noexcept
+    {
+        return std::wstring_view{ stringTable + ref.offset, ref.length };
+    }
+
+    BinaryPlaylist::TrackEntry const& BinaryPlaylist::GetEntry(uint32_t index) const
+    {
+        if (index >= header->trackCount)
+        {
+            throw hresult_out_of_bounds();
+        }
+        return trackTable[index];
+    }
+
+    /// <summary>
+    /// Whether every string reference in the track table lies within the string table, so that
+    /// GetString never has to check.
+    /// </summary>
+    bool BinaryPlaylist::HasValidStrings() const noexcept
+    {
+        auto isValid = [&](StringRef const& ref)
+        {
+            return static_cast<uint64_t>(ref.offset) + ref.length <= header->stringTableLength;
+        };
+
+        for (uint32_t i = 0; i < header->trackCount; i++)
+        {
+            TrackEntry const& entry{ trackTable[i] };
+            if (!isValid(entry.id) || !isValid(entry.src) || !isValid(entry.title) || !isValid(entry.artist) || !isValid(entry.image))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
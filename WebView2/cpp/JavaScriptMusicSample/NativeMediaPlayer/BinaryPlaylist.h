@@ -0,0 +1,119 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "PlaylistParser.h"
+#include <memory>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// A read-only, memory-mapped view of a playlist stored in the compact binary format.
+    ///
+    /// The file is laid out so that it can be used in place without any parsing:
+    ///
+    ///     Header       magic "MPLB", format version, track count and the offsets of the two tables
+    ///     Track table  one fixed-size TrackEntry per track, each field a (offset, length) reference
+    ///                  into the string table
+    ///     String table UTF-16 text for every distinct string in the playlist, without terminators
+    ///
+    /// Track URIs are resolved when the file is written, so a field of a track is read straight out
+    /// of the mapping. Opening checks that every string reference in the track table is in range,
+    /// which touches the track table but not the strings; after that no read can fail, and the
+    /// string table is only paged in as fields are read.
+    ///
+    /// Write replaces a file by moving a new one over it, and files are mapped with delete sharing,
+    /// so a playlist can be written again while an older version of it is still mapped.
+    ///
+    /// All integers are little-endian. Readers must reject versions they do not understand; new
+    /// fields should be added by bumping FormatVersion.
+    /// </summary>
+    class BinaryPlaylist
+    {
+    public:
+        enum class Field : uint32_t
+        {
+            Id,
+            Src,
+            Title,
+            Artist,
+            Image,
+        };
+
+        static constexpr wchar_t FileExtension[]{ L".mplb" };
+        static constexpr uint16_t FormatVersion{ 1 };
+
+        ~BinaryPlaylist();
+        BinaryPlaylist(BinaryPlaylist const&) = delete;
+        BinaryPlaylist& operator=(BinaryPlaylist const&) = delete;
+
+        /// <summary>
+        /// Maps the file at the given path. Returns nullptr if it does not exist or is not a playlist
+        /// in a version this code understands.
+        /// </summary>
+        static std::shared_ptr<BinaryPlaylist> TryOpen(hstring const& path);
+
+        /// <summary>
+        /// Writes tracks to the given path in the binary format. Strings that occur more than once,
+        /// such as artist names, are only stored once. Tracks without a resolved src have it
+        /// resolved with resolveSrc.
+        /// </summary>
+        static void Write(hstring const& path, std::vector<PlaylistTrackRecord> const& tracks, hstring(*resolveSrc)(hstring const&));
+
+        uint32_t Size() const noexcept;
+        PlaylistTrackRecord GetTrack(uint32_t index) const;
+
+        /// <summary>
+        /// A field of the track at index, pointing into the mapping. It stays valid for as long as
+        /// this object does.
+        /// </summary>
+        std::wstring_view GetField(uint32_t index, Field field) const;
+
+    private:
+#pragma pack(push, 1)
+        struct StringRef
+        {
+            uint32_t offset;    // in characters from the start of the string table
+            uint32_t length;    // in characters
+        };
+
+        struct TrackEntry
+        {
+            StringRef id;
+            StringRef src;
+            StringRef title;
+            StringRef artist;
+            StringRef image;
+        };
+
+        struct Header
+        {
+            char magic[4];
+            uint16_t version;
+            uint16_t trackEntrySize;
+            uint32_t trackCount;
+            uint32_t trackTableOffset;
+            uint32_t stringTableOffset;
+            uint32_t stringTableLength;     // in characters
+        };
+#pragma pack(pop)
+        static_assert(sizeof(Header) == 24, "The header layout is part of the file format");
+        static_assert(sizeof(TrackEntry) == 40, "The track entry layout is part of the file format");
+
+        BinaryPlaylist() = default;
+
+        std::wstring_view GetString(StringRef const& ref) const noexcept;
+        TrackEntry const& GetEntry(uint32_t index) const;
+        bool HasValidStrings() const noexcept;
+
+        winrt::file_handle file{};
+        winrt::handle mapping{};
+        uint8_t const* view{ nullptr };
+        uint64_t viewSize{ 0 };
+
+        Header const* header{ nullptr };
+        TrackEntry const* trackTable{ nullptr };
+        wchar_t const* stringTable{ nullptr };
+    };
+}
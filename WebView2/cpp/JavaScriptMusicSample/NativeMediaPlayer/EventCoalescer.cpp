@@ -0,0 +1,67 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "EventCoalescer.h"
+#include <bitset>
+#include <sstream>
+
+using namespace winrt;
+using namespace winrt::Windows::UI::Core;
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    EventCoalescer::EventCoalescer(CoreDispatcher const& dispatcher, std::function<void(PendingEvents const&)> deliver) :
+        EventCoalescer{ [dispatcher](std::function<void()> callback) { dispatcher.RunAsync(CoreDispatcherPriority::Normal, [callback]() { callback(); }); }, std::move(deliver) }
+    {
+    }
+
+    EventCoalescer::EventCoalescer(Scheduler schedule, std::function<void(PendingEvents const&)> deliver) :
+        schedule{ std::move(schedule) }, deliver{ std::move(deliver) }
+    {
+    }
+
+    void EventCoalescer::Raise(uint32_t kind, int64_t value)
+    {
+        stats.raised++;
+        values[kind].store(value, std::memory_order_release);
+        pending.fetch_or(1u << kind, std::memory_order_acq_rel);
+
+        // Whoever flips drainScheduled from false schedules the callback; everyone else piggybacks on it
+        if (!drainScheduled.exchange(true, std::memory_order_acq_rel))
+        {
+            schedule([this]() { Drain(); });
+        }
+    }
+
+    void EventCoalescer::Drain()
+    {
+        // Clear the flag before taking the mask. A raise that lands in between schedules another
+        // callback, which at worst finds nothing left to deliver; clearing it afterwards could
+        // strand that raise until the next one.
+        drainScheduled.store(false, std::memory_order_release);
+        uint32_t mask{ pending.exchange(0, std::memory_order_acq_rel) };
+        if (++stats.dispatcherCallbacks % StatisticsInterval == 0)
+        {
+            LogStatistics();
+        }
+        if (mask == 0)
+        {
+            return;
+        }
+
+        stats.delivered += std::bitset<MaxEventKinds>(mask).count();
+        deliver(PendingEvents{ mask, values });
+    }
+
+    void EventCoalescer::LogStatistics() const
+    {
+        std::wostringstream strStream{};
+        strStream << L"[EventCoalescer: "
+            << L"Raised=" << stats.raised << L", "
+            << L"Delivered=" << stats.delivered << L", "
+            << L"DispatcherCallbacks=" << stats.dispatcherCallbacks
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+}
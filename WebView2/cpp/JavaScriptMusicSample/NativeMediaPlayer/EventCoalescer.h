@@ -0,0 +1,90 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <functional>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Carries notifications raised on arbitrary threads over to the dispatcher thread, collapsing
+    /// repeats along the way.
+    ///
+    /// Each kind of event has a slot: a bit in a pending mask plus the latest value raised with it.
+    /// Raising an event sets its bit without taking a lock. At most one dispatcher callback is
+    /// outstanding at any time; when it runs it takes the whole mask and hands it to the deliver
+    /// handler, so any number of raises between two callbacks cost the dispatcher a single hop and
+    /// each event is delivered once with its most recent value.
+    /// </summary>
+    class EventCoalescer
+    {
+    public:
+        static constexpr uint32_t MaxEventKinds{ 32 };
+
+        /// <summary>
+        /// Counters for judging how much work coalescing saves the dispatcher thread.
+        /// </summary>
+        struct Statistics
+        {
+            std::atomic<uint64_t> raised{ 0 };
+            std::atomic<uint64_t> delivered{ 0 };
+            std::atomic<uint64_t> dispatcherCallbacks{ 0 };
+        };
+
+        /// <summary>
+        /// The events that were pending when a dispatcher callback ran, and the latest value raised
+        /// with each of them.
+        /// </summary>
+        class PendingEvents
+        {
+        public:
+            PendingEvents(uint32_t mask, std::array<std::atomic<int64_t>, MaxEventKinds> const& values) noexcept : mask{ mask }, values{ values } {}
+
+            bool Contains(uint32_t kind) const noexcept { return (mask & (1u << kind)) != 0; }
+            int64_t ValueOf(uint32_t kind) const noexcept { return values[kind].load(std::memory_order_acquire); }
+
+        private:
+            uint32_t mask;
+            std::array<std::atomic<int64_t>, MaxEventKinds> const& values;
+        };
+
+        /// <summary>
+        /// Runs a callback on the thread events are delivered on.
+        /// </summary>
+        using Scheduler = std::function<void(std::function<void()>)>;
+
+        EventCoalescer(winrt::Windows::UI::Core::CoreDispatcher const& dispatcher, std::function<void(PendingEvents const&)> deliver);
+
+        /// <summary>
+        /// A coalescer that hands its callbacks to schedule rather than to a CoreDispatcher, so that
+        /// tests can stand in for the dispatcher thread.
+        /// </summary>
+        EventCoalescer(Scheduler schedule, std::function<void(PendingEvents const&)> deliver);
+        EventCoalescer(EventCoalescer const&) = delete;
+        EventCoalescer& operator=(EventCoalescer const&) = delete;
+
+        /// <summary>
+        /// Marks kind as pending, recording value as its latest value. Safe to call from any thread.
+        /// </summary>
+        void Raise(uint32_t kind, int64_t value = 0);
+
+        Statistics const& Stats() const noexcept { return stats; }
+        void LogStatistics() const;
+
+    private:
+        void Drain();
+
+        Scheduler schedule;
+        std::function<void(PendingEvents const&)> deliver;
+
+        std::atomic<uint32_t> pending{ 0 };
+        std::array<std::atomic<int64_t>, MaxEventKinds> values{};
+        std::atomic<bool> drainScheduled{ false };
+        Statistics stats{};
+
+        // How many dispatcher callbacks go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 1000 };
+    };
+}
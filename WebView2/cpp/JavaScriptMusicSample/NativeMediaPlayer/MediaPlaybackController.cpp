@@ -6,8 +6,21 @@
 #include "MediaPlaybackController.g.cpp"
 #include "TrackMetadata.h"
 #include "TrackMetadata.g.h"
+#include "BinaryPlaylist.h"
+#include "PlaybackStateSnapshot.h"
+#include "PlaylistDataFetcher.h"
+#include "SessionSnapshot.h"
+#include "ThumbnailCache.h"
+#include "TrackMetadataList.h"
+#include "TrackPrefetcher.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <sstream>
 #include <winrt/Windows.Media.Core.h>
 #include <winrt/Windows.Storage.Streams.h>
+#include <winrt/Windows.System.h>
 
 using namespace winrt;
 using namespace winrt::Windows::Data::Json;
@@ -16,28 +29,57 @@ using namespace winrt::Windows::UI::Core;
 using namespace winrt::Windows::Media::Core;
 using namespace winrt::Windows::Media::Playback;
 using namespace winrt::Windows::Storage::Streams;
+using namespace winrt::Windows::System;
+using namespace winrt::Windows::System::Threading;
 
 namespace winrt::NativeMediaPlayer::implementation
 {
     MediaPlaybackController::MediaPlaybackController()
     {
         dispatcher = CoreWindow::GetForCurrentThread().Dispatcher();
+        playerEvents = std::make_unique<EventCoalescer>(dispatcher, [this](EventCoalescer::PendingEvents const& events) { DeliverPlayerEvents(events); });
 
         player.Volume(.1); // Set default volume low
 
-        player.PlaybackSession().PositionChanged({ this, &MediaPlaybackController::OnPlayerPositionChanged });
         player.PlaybackSession().PlaybackStateChanged({ this, &MediaPlaybackController::OnPlayerPlaybackStateChanged });
         player.SourceChanged({ this, &MediaPlaybackController::OnPlayerSourceChanged });
+
+        // These only need to invalidate the state snapshot; nothing is listening for them in JavaScript
+        player.VolumeChanged([this](auto&&, auto&&) { stateVersion++; });
+        player.IsMutedChanged([this](auto&&, auto&&) { stateVersion++; });
+        player.PlaybackSession().NaturalDurationChanged([this](auto&&, auto&&) { stateVersion++; AnchorClock(); SchedulePrefetch(); });
+
+        // Like pausing and stalling, which arrive as playback state changes, these break the
+        // playback clock's extrapolation and move the point at which the next track is prefetched
+        player.PlaybackSession().PlaybackRateChanged([this](auto&&, auto&&) { AnchorClock(); SchedulePrefetch(); });
+        player.PlaybackSession().SeekCompleted([this](auto&&, auto&&) { AnchorClock(); SchedulePrefetch(); });
+
+        // A restored session's position can only be applied once its track has opened
+        player.MediaOpened([this](auto&&, auto&&)
+        {
+            int64_t ticks{ restoredPositionTicks.exchange(-1) };
+            if (ticks >= 0)
+            {
+                player.PlaybackSession().Position(TimeSpan{ ticks });
+            }
+        });
+
+        // In repeat-one mode the window holds nothing after the current track, so the list ends with it
+        player.MediaEnded([this](auto&&, auto&&) { playerEvents->Raise(PlayerEvent::MediaEnded); });
+
+        // A different shuffle order every session, unless the app sets ShuffleSeed itself
+        std::random_device random{};
+        queue.SetShuffle(false, (static_cast<uint64_t>(random()) << 32) | random());
     }
     winrt::Windows::Foundation::Collections::IVector<winrt::NativeMediaPlayer::TrackMetadata> MediaPlaybackController::CurrentPlaylist()
     {
-        return currentPlaylist;
+        return *currentPlaylist;
     }
     winrt::NativeMediaPlayer::TrackMetadata MediaPlaybackController::CurrentTrack()
     {
-        if (currentTrackIndex >= 0 && currentTrackIndex < currentPlaylist.Size())
+        if (currentTrackIndex >= 0 && currentTrackIndex < currentPlaylist->Size())
         {
-            return currentPlaylist.GetAt(currentTrackIndex);
+            return currentPlaylist->GetAt(currentTrackIndex);
         }
         
         return nullptr;
@@ -61,6 +103,9 @@ namespace winrt::NativeMediaPlayer::implementation
     void MediaPlaybackController::Muted(bool value)
     {
         player.IsMuted(value);
+
+        // The player's IsMutedChanged event arrives later; the page may read the state straight away
+        stateVersion++;
     }
     double MediaPlaybackController::Volume()
     {
@@ -69,6 +114,7 @@ namespace winrt::NativeMediaPlayer::implementation
     void MediaPlaybackController::Volume(double value)
     {
         player.Volume(value);
+        stateVersion++;
     }
     double MediaPlaybackController::CurrentTime()
     {
@@ -82,6 +128,156 @@ namespace winrt::NativeMediaPlayer::implementation
     {
         return std::chrono::duration_cast<std::chrono::duration<double>>(player.PlaybackSession().NaturalDuration()).count();
     }
+    uint32_t MediaPlaybackController::PlaybackItemWindowSize()
+    {
+        return playbackItemWindowSize;
+    }
+    void MediaPlaybackController::PlaybackItemWindowSize(uint32_t value)
+    {
+        playbackItemWindowSize = value;
+        SyncWindow();
+    }
+    bool MediaPlaybackController::ShuffleEnabled()
+    {
+        return queue.ShuffleEnabled();
+    }
+    void MediaPlaybackController::ShuffleEnabled(bool value)
+    {
+        if (value != queue.ShuffleEnabled())
+        {
+            queue.SetShuffle(value, queue.ShuffleSeed());
+            stateVersion++;
+            SyncWindow();
+        }
+    }
+    uint64_t MediaPlaybackController::ShuffleSeed()
+    {
+        return queue.ShuffleSeed();
+    }
+    void MediaPlaybackController::ShuffleSeed(uint64_t value)
+    {
+        queue.SetShuffle(queue.ShuffleEnabled(), value);
+        SyncWindow();
+    }
+    winrt::NativeMediaPlayer::PlaybackRepeatMode MediaPlaybackController::RepeatMode()
+    {
+        return queue.RepeatMode();
+    }
+    void MediaPlaybackController::RepeatMode(winrt::NativeMediaPlayer::PlaybackRepeatMode value)
+    {
+        if (value != queue.RepeatMode())
+        {
+            queue.RepeatMode(value);
+            stateVersion++;
+            SyncWindow();
+        }
+    }
+    double MediaPlaybackController::TimeUpdateInterval()
+    {
+        return timeUpdateInterval;
+    }
+    void MediaPlaybackController::TimeUpdateInterval(double value)
+    {
+        timeUpdateInterval = std::max(value, 0.0);
+    }
+    double MediaPlaybackController::PrefetchLeadTime()
+    {
+        return prefetchLeadTime;
+    }
+    void MediaPlaybackController::PrefetchLeadTime(double value)
+    {
+        prefetchLeadTime = std::max(value, 0.0);
+        ApplyListPrefetchTime();
+        SchedulePrefetch();
+    }
+    uint64_t MediaPlaybackController::StateVersion()
+    {
+        return stateVersion;
+    }
+    hstring MediaPlaybackController::GetStateSnapshot()
+    {
+        // Read the version first, so that a change that lands while the snapshot is being built
+        // makes the snapshot look stale rather than current
+        uint64_t version{ stateVersion };
+
+        PlaybackStateSnapshot snapshot{};
+        snapshot.version = version;
+        snapshot.paused = Paused();
+        snapshot.ended = Ended();
+        snapshot.muted = Muted();
+        snapshot.volume = Volume();
+        snapshot.currentTime = CurrentTime();
+        snapshot.duration = Duration();
+        snapshot.currentTrackIndex = currentTrackIndex;
+        snapshot.playlistLength = currentPlaylist->Size();
+        snapshot.shuffleEnabled = queue.ShuffleEnabled();
+        snapshot.repeatMode = queue.RepeatMode();
+
+        if (NativeMediaPlayer::TrackMetadata track{ CurrentTrack() })
+        {
+            snapshot.currentTrack = PlaybackStateSnapshot::Track{
+                track.Src(),
+                track.Title(),
+                track.Artist(),
+                track.ThumbnailSrc(),
+                ThumbnailCache::Instance().TryGetPageUri(track.ThumbnailSrc()) };
+        }
+
+        return snapshot.Stringify();
+    }
+    uint64_t MediaPlaybackController::PlaylistSequenceNumber()
+    {
+        return playlistSequenceNumber;
+    }
+    bool MediaPlaybackController::PlaylistLoading()
+    {
+        return playlistLoading;
+    }
+    hstring MediaPlaybackController::GetPlaylistPage(uint32_t offset, uint32_t count)
+    {
+        return GetSortedPlaylistPage(NativeMediaPlayer::PlaylistSortOrder::Original, offset, count);
+    }
+    hstring MediaPlaybackController::GetSortedPlaylistPage(NativeMediaPlayer::PlaylistSortOrder order, uint32_t offset, uint32_t count)
+    {
+        uint32_t totalCount{ currentPlaylist->Size() };
+        uint32_t end{ offset < totalCount ? offset + std::min(count, totalCount - offset) : offset };
+
+        // The views only cover the tracks they have been given. While pages are still being appended
+        // the playlist is listed in its own order, as every page would otherwise cost a full sort;
+        // the page hears PlaylistUpdate once the last one is in, and the order is sorted then.
+        if (playlistLoading || sortViews->TrackCount() != totalCount)
+        {
+            order = NativeMediaPlayer::PlaylistSortOrder::Original;
+        }
+
+        JsonArray tracks{};
+        for (uint32_t i = offset; i < end; i++)
+        {
+            tracks.Append(GetTrackJson(sortViews->TrackAt(order, i)));
+        }
+
+        JsonObject page{};
+        page.SetNamedValue(L"sequenceNumber", JsonValue::CreateNumberValue(static_cast<double>(playlistSequenceNumber)));
+        page.SetNamedValue(L"offset", JsonValue::CreateNumberValue(offset));
+        page.SetNamedValue(L"totalCount", JsonValue::CreateNumberValue(totalCount));
+        page.SetNamedValue(L"tracks", tracks);
+        return page.Stringify();
+    }
+    hstring MediaPlaybackController::SearchPlaylist(hstring const& query, uint32_t maxResults)
+    {
+        JsonArray tracks{};
+        for (PlaylistSearchIndex::Result const& result : searchIndex->Search(query, maxResults))
+        {
+            JsonObject trackObject{ GetTrackJson(result.track) };
+            trackObject.SetNamedValue(L"score", JsonValue::CreateNumberValue(result.score));
+            tracks.Append(trackObject);
+        }
+
+        JsonObject results{};
+        results.SetNamedValue(L"sequenceNumber", JsonValue::CreateNumberValue(static_cast<double>(playlistSequenceNumber)));
+        results.SetNamedValue(L"tracks", tracks);
+        return results.Stringify();
+    }
     void MediaPlaybackController::Play()
     {
         player.Play();
@@ -94,14 +290,29 @@ namespace winrt::NativeMediaPlayer::implementation
     {
         if (playbackList)
         {
-            playbackList.MovePrevious();
+            if (std::optional<uint32_t> previousTrackIdx{ queue.Retreat() })
+            {
+                ChangeCurrentTrack(*previousTrackIdx);
+            }
         }
     }
     void MediaPlaybackController::SkipNext()
     {
         if (playbackList)
         {
-            playbackList.MoveNext();
+            // Skipping moves on even in repeat-one mode
+            if (std::optional<uint32_t> nextTrackIdx{ queue.Advance(true) })
+            {
+                ChangeCurrentTrack(*nextTrackIdx);
+            }
+        }
+    }
+    void MediaPlaybackController::PlayNext(uint32_t trackIndex)
+    {
+        if (playbackList && trackIndex < currentPlaylist->Size())
+        {
+            queue.PlayNext(trackIndex);
+            SyncWindow();
         }
     }
     winrt::Windows::Foundation::IAsyncAction MediaPlaybackController::PlayTrackAsync(hstring playlistId, hstring trackId)
@@ -112,151 +323,1565 @@ namespace winrt::NativeMediaPlayer::implementation
     {
         return PlayTrackAsync(playlistId, L"");
     }
+    void MediaPlaybackController::SaveSession()
+    {
+        auto started{ std::chrono::steady_clock::now() };
+        if (currentPlaylistId.empty() || currentTrackIndex >= currentPlaylist->Size())
+        {
+            SessionSnapshot::Delete();
+            savedSessionSequenceNumber.reset();
+            return;
+        }
+
+        // The tracks are most of the snapshot and rarely change between suspends, so they are only
+        // written when the playlist has changed since they last were
+        uint32_t trackCount{ currentPlaylist->Size() };
+        bool tracksWritten{ savedSessionSequenceNumber != playlistSequenceNumber };
+        if (tracksWritten)
+        {
+            std::vector<PlaylistTrackRecord> tracks{};
+            tracks.reserve(trackCount);
+            for (uint32_t i = 0; i < trackCount; i++)
+            {
+                tracks.push_back(PlaylistTrackRecord{
+                    GetTrackId(i),
+                    currentPlaylist->GetField(i, TrackMetadataStore::Field::Title),
+                    currentPlaylist->GetField(i, TrackMetadataStore::Field::Artist),
+                    currentPlaylist->GetField(i, TrackMetadataStore::Field::ThumbnailSrc),
+                    currentPlaylist->GetField(i, TrackMetadataStore::Field::Src)
+                });
+            }
+            SessionSnapshot::WriteTracks(tracks);
+            savedSessionSequenceNumber = playlistSequenceNumber;
+        }
+
+        SessionSnapshot snapshot{};
+        snapshot.playlistId = currentPlaylistId;
+        snapshot.trackCount = trackCount;
+        snapshot.currentTrackIndex = currentTrackIndex;
+        snapshot.position = player.PlaybackSession().Position();
+        snapshot.volume = player.Volume();
+        snapshot.muted = player.IsMuted();
+        snapshot.Write();
+
+        std::wostringstream strStream{};
+        strStream << L"[SessionSnapshot: "
+            << L"Tracks=" << trackCount << L", "
+            << L"TracksWritten=" << (tracksWritten ? L"true" : L"false") << L", "
+            << L"SaveUs=" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+    bool MediaPlaybackController::RestoreSession()
+    {
+        auto started{ std::chrono::steady_clock::now() };
+        std::shared_ptr<BinaryPlaylist> binaryPlaylist{};
+        std::optional<SessionSnapshot> snapshot{ SessionSnapshot::TryRead(binaryPlaylist) };
+        if (!snapshot)
+        {
+            return false;
+        }
+
+        // This replaces whatever was requested before, and comes back paused where it left off
+        ++playRequestGeneration;
+        player.Volume(snapshot->volume);
+        player.IsMuted(snapshot->muted);
+        player.AutoPlay(false);
+        currentPlaylistId = snapshot->playlistId;
+
+        // The tracks are read from the mapping as they are needed, so the list starts without any of
+        // them being copied; the search index and sort views follow in the background
+        PreparedPlaylist prepared{};
+        prepared.MapTracks(binaryPlaylist);
+        ResetPlaybackList(prepared, snapshot->currentTrackIndex);
+        restoredPositionTicks = snapshot->position.count();
+        savedSessionSequenceNumber = playlistSequenceNumber;
+        IndexBinaryPlaylistAsync();
+
+        std::wostringstream strStream{};
+        strStream << L"[SessionSnapshot: "
+            << L"Tracks=" << binaryPlaylist->Size() << L", "
+            << L"RestoreUs=" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+        return true;
+    }
+    hstring MediaPlaybackController::GetPlaybackClock()
+    {
+        PlaybackClock anchor{};
+        {
+            std::lock_guard<std::mutex> lock{ clockMutex };
+            anchor = clock;
+        }
+
+        hstring state{};
+        switch (anchor.state)
+        {
+        case MediaPlaybackState::Opening: state = L"opening"; break;
+        case MediaPlaybackState::Buffering: state = L"buffering"; break;
+        case MediaPlaybackState::Playing: state = L"playing"; break;
+        case MediaPlaybackState::Paused: state = L"paused"; break;
+        default: state = L"none"; break;
+        }
+
+        auto seconds = [](TimeSpan const& time) { return std::chrono::duration_cast<std::chrono::duration<double>>(time).count(); };
+        auto timestamp{ std::chrono::duration_cast<std::chrono::milliseconds>(anchor.anchoredAt.time_since_epoch()) };
+
+        JsonObject clockObject{};
+        clockObject.SetNamedValue(L"version", JsonValue::CreateNumberValue(static_cast<double>(anchor.version)));
+        clockObject.SetNamedValue(L"position", JsonValue::CreateNumberValue(seconds(anchor.position)));
+        clockObject.SetNamedValue(L"timestamp", JsonValue::CreateNumberValue(static_cast<double>(timestamp.count())));
+        clockObject.SetNamedValue(L"rate", JsonValue::CreateNumberValue(anchor.rate));
+        clockObject.SetNamedValue(L"duration", JsonValue::CreateNumberValue(seconds(anchor.duration)));
+        clockObject.SetNamedValue(L"state", JsonValue::CreateStringValue(state));
+        return clockObject.Stringify();
+    }
     winrt::event_token MediaPlaybackController::TimeUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler)
     {
-        return timeUpdateEvent.add(handler);
+        winrt::event_token token{ timeUpdateEvent.add(handler) };
+        eventHandlerCount++;
+        UpdateEventDelivery();
+        return token;
     }
     void MediaPlaybackController::TimeUpdate(winrt::event_token const& token) noexcept
     {
         timeUpdateEvent.remove(token);
+        eventHandlerCount = eventHandlerCount > 0 ? eventHandlerCount - 1 : 0;
+        UpdateEventDelivery();
     }
     winrt::event_token MediaPlaybackController::PlaybackUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler)
     {
-        return playbackUpdateEvent.add(handler);
+        winrt::event_token token{ playbackUpdateEvent.add(handler) };
+        eventHandlerCount++;
+        UpdateEventDelivery();
+        return token;
     }
     void MediaPlaybackController::PlaybackUpdate(winrt::event_token const& token) noexcept
     {
         playbackUpdateEvent.remove(token);
+        eventHandlerCount = eventHandlerCount > 0 ? eventHandlerCount - 1 : 0;
+        UpdateEventDelivery();
     }
     winrt::event_token MediaPlaybackController::SourceUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::NativeMediaPlayer::TrackMetadata> const& handler)
     {
-        return sourceUpdateEvent.add(handler);
+        winrt::event_token token{ sourceUpdateEvent.add(handler) };
+        eventHandlerCount++;
+        UpdateEventDelivery();
+        return token;
     }
     void MediaPlaybackController::SourceUpdate(winrt::event_token const& token) noexcept
     {
         sourceUpdateEvent.remove(token);
+        eventHandlerCount = eventHandlerCount > 0 ? eventHandlerCount - 1 : 0;
+        UpdateEventDelivery();
+    }
+    winrt::event_token MediaPlaybackController::ClockUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler)
+    {
+        winrt::event_token token{ clockUpdateEvent.add(handler) };
+        eventHandlerCount++;
+        UpdateEventDelivery();
+        return token;
+    }
+    void MediaPlaybackController::ClockUpdate(winrt::event_token const& token) noexcept
+    {
+        clockUpdateEvent.remove(token);
+        eventHandlerCount = eventHandlerCount > 0 ? eventHandlerCount - 1 : 0;
+        UpdateEventDelivery();
+    }
+    winrt::event_token MediaPlaybackController::PlaylistUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler)
+    {
+        winrt::event_token token{ playlistUpdateEvent.add(handler) };
+        eventHandlerCount++;
+        UpdateEventDelivery();
+        return token;
+    }
+    void MediaPlaybackController::PlaylistUpdate(winrt::event_token const& token) noexcept
+    {
+        playlistUpdateEvent.remove(token);
+        eventHandlerCount = eventHandlerCount > 0 ? eventHandlerCount - 1 : 0;
+        UpdateEventDelivery();
+    }
+    void MediaPlaybackController::SuspendEvents()
+    {
+        eventsSuspended = true;
+        UpdateEventDelivery();
+    }
+    void MediaPlaybackController::ResumeEvents()
+    {
+        eventsSuspended = false;
+        UpdateEventDelivery();
     }
 
     IAsyncAction MediaPlaybackController::PlayTrackInternalAsync(hstring playlistId, hstring trackId)
     {
-        // Remove event listeners from the old list
-        if (playbackList)
+        // Each request supersedes any that are still in flight. Those notice at their next co_await
+        // and give up, so a burst of requests only ever builds the MediaPlaybackList for the last one.
+        uint64_t generation{ ++playRequestGeneration };
+        playRequestStats.requests++;
+
+        // The time this request keeps the UI thread busy, which is time the WebView cannot handle
+        // input. It is added up a slice at a time, from each resumption on the UI thread to the next
+        // co_await that leaves it; operations are started before the slice ends, since they run
+        // synchronously up to their own first co_await.
+        auto requestedAt{ std::chrono::steady_clock::now() };
+        auto sliceStartedAt{ requestedAt };
+        std::chrono::steady_clock::duration uiThreadTime{};
+        auto endSlice = [&]() { uiThreadTime += std::chrono::steady_clock::now() - sliceStartedAt; };
+        auto startSlice = [&]() { sliceStartedAt = std::chrono::steady_clock::now(); };
+
+        // Jumping to another track in the playlist that is already loaded only needs a MoveTo, which
+        // keeps the current MediaPlaybackList and everything it has buffered
+        if (playbackList && playlistId == currentPlaylistId)
         {
-            playbackList.CurrentItemChanged(playbackListItemChangedToken);
+            std::optional<uint32_t> targetTrackIdx{ trackId.empty() ? std::optional<uint32_t>{ 0 } : FindTrackIndex(trackId) };
+            if (!targetTrackIdx && !playlistLoading)
+            {
+                // The track may have been added since the playlist was loaded
+                IAsyncAction refreshed{ RefreshPlaylistInternalAsync(generation) };
+                endSlice();
+                co_await refreshed;
+                startSlice();
+                if (IsSuperseded(generation))
+                {
+                    co_return;
+                }
+                targetTrackIdx = FindTrackIndex(trackId);
+            }
+
+            // A track on a page that has not been appended yet is found by loading the playlist again
+            if (playlistId == currentPlaylistId && (targetTrackIdx || !playlistLoading))
+            {
+                // A restored session leaves the player paused with AutoPlay off, which MoveTo keeps
+                MoveToTrack(targetTrackIdx.value_or(0));
+                player.AutoPlay(true);
+                player.Play();
+                endSlice();
+                LogPlayRequestTime(uiThreadTime, requestedAt);
+                co_return;
+            }
         }
 
-        // Fetch the JSON data describing the requested playlist
-        hstring trackDataString{ co_await PlaylistDataFetcher::GetPlaylistTracks(playlistId) };
-        JsonObject trackData{ JsonObject::Parse(trackDataString) };
-        JsonArray trackListJson{ trackData.GetNamedArray(L"Tracks") };
-        uint32_t initialTrackIdx{ 0 };
+        playRequestedAt = requestedAt;
 
-        currentPlaylist.Clear();
-        playbackList = MediaPlaybackList();
+        // Reading the tracks and preparing the playlist from them both happen on background threads;
+        // only swapping the result in and handing the new list to the player use the UI thread.
+        //
+        // Pages are only read until the track to play, and the tracks the playback window holds after
+        // it, are known. Whatever follows is appended once playback has started, so the time to first
+        // audio does not grow with the length of the playlist. A binary playlist is not read at all:
+        // it is mapped, and its tracks are read from the mapping as they are needed.
+        std::vector<PlaylistTrackRecord> tracks{};
+        std::shared_ptr<BinaryPlaylist> binaryPlaylist{};
+        std::optional<uint32_t> targetTrackIdx{};
+        hstring nextPageId{ playlistId };
+        uint32_t pagesLoaded{ 0 };
+        if (PlaylistDataFetcher::IsBinaryPlaylistId(playlistId))
+        {
+            IAsyncAction opened{ OpenBinaryPlaylistAsync(playlistId, trackId, binaryPlaylist, targetTrackIdx) };
+            endSlice();
+            co_await opened;
+            startSlice();
+            if (IsSuperseded(generation))
+            {
+                co_return;
+            }
+        }
+        else
+        {
+            do
+            {
+                size_t pageStart{ tracks.size() };
+                IAsyncAction loaded{ LoadPlaylistPageAsync(nextPageId, generation, tracks, nextPageId) };
+                endSlice();
+                co_await loaded;
+                startSlice();
+                if (IsSuperseded(generation))
+                {
+                    co_return;
+                }
+                pagesLoaded++;
+
+                if (trackId.empty())
+                {
+                    targetTrackIdx = 0;
+                }
+                else if (!targetTrackIdx)
+                {
+                    auto it{ std::find_if(tracks.begin() + pageStart, tracks.end(), [&](PlaylistTrackRecord const& track) { return track.id == trackId; }) };
+                    if (it != tracks.end())
+                    {
+                        targetTrackIdx = static_cast<uint32_t>(it - tracks.begin());
+                    }
+                }
+            } while (!nextPageId.empty() && pagesLoaded < MaxPlaylistPages &&
+                (!targetTrackIdx || tracks.size() <= *targetTrackIdx + playbackItemWindowSize));
+        }
+
+        PreparedPlaylist prepared{};
+        if (binaryPlaylist)
+        {
+            prepared.MapTracks(binaryPlaylist);
+        }
+        else
+        {
+            IAsyncAction preparedAction{ PreparePlaylistAsync(tracks, prepared, true) };
+            endSlice();
+            co_await preparedAction;
+            startSlice();
+            if (IsSuperseded(generation))
+            {
+                co_return;
+            }
+        }
+
+        // A restored session is cued paused; anything the user picks plays straight away
+        currentPlaylistId = playlistId;
+        player.AutoPlay(true);
+        ResetPlaybackList(prepared, targetTrackIdx.value_or(0));
+
+        if (binaryPlaylist)
+        {
+            IndexBinaryPlaylistAsync();
+        }
+        else if (!nextPageId.empty() && pagesLoaded < MaxPlaylistPages)
+        {
+            LoadRemainingPagesAsync(nextPageId, pagesLoaded);
+        }
+
+        endSlice();
+        LogPlayRequestTime(uiThreadTime, requestedAt);
+    }
+
+    IAsyncAction MediaPlaybackController::RefreshPlaylistAsync()
+    {
+        // A refresh does not supersede anything, but is itself superseded by any later PlayTrackAsync
+        return RefreshPlaylistInternalAsync(playRequestGeneration);
+    }
+
+    IAsyncAction MediaPlaybackController::RefreshPlaylistInternalAsync(uint64_t generation)
+    {
+        // A playlist that is still loading its pages is as fresh as it gets
+        if (!playbackList || currentPlaylistId.empty() || playlistLoading)
+        {
+            co_return;
+        }
+
+        hstring playlistId{ currentPlaylistId };
+        std::vector<PlaylistTrackRecord> tracks{};
+        co_await LoadPlaylistTracksAsync(playlistId, generation, tracks);
+        PreparedPlaylist prepared{};
+
+        // An update copies the few tracks that changed into the current metadata store, so the store
+        // for the new version is only filled if the playlist has to be reset after all
+        co_await PreparePlaylistAsync(tracks, prepared, false);
 
-        // Create a TrackMetadata and MediaPlaybackItem from each track
-        for (uint32_t i = 0; i < trackListJson.Size(); i++)
+        // Another playlist may have been started while this one was loading
+        if (generation != playRequestGeneration || playlistId != currentPlaylistId)
         {
-            JsonObject trackJson{ trackListJson.GetObjectAt(i) };
+            co_return;
+        }
 
-            if (!trackId.empty() && trackJson.GetNamedString(L"Id", L"") == trackId)
+        if (!UpdatePlaylist(tracks, prepared))
+        {
+            co_await StoreTracksAsync(tracks, prepared);
+            if (generation != playRequestGeneration || playlistId != currentPlaylistId)
             {
-                initialTrackIdx = i;
+                co_return;
             }
 
-            NativeMediaPlayer::TrackMetadata metadata{ CreateTrackMetadataFromJson(trackJson) };
-            currentPlaylist.Append(metadata);
-            playbackList.Items().Append(CreatePlaybackItemFromMetadata(metadata));
+            // The current track is gone, so there is nothing to preserve
+            ResetPlaybackList(prepared, tracks.empty() ? 0 : std::min(currentTrackIndex, static_cast<uint32_t>(tracks.size() - 1)));
         }
+    }
 
-        // Register for event callbacks when the current item changes
-        playbackList.CurrentItemChanged({ this, &MediaPlaybackController::OnCurrentPlaybackItemChanged });
+    /// <summary>
+    /// Reads every track in a playlist, following its pages to the end. Leaves tracks empty if the
+    /// request for generation is superseded before they are parsed. Awaiting this resumes the caller
+    /// on its own thread.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::LoadPlaylistTracksAsync(hstring playlistId, uint64_t generation, std::vector<PlaylistTrackRecord>& tracks)
+    {
+        hstring nextPageId{ playlistId };
+        for (uint32_t pagesLoaded = 0; !nextPageId.empty() && pagesLoaded < MaxPlaylistPages; pagesLoaded++)
+        {
+            co_await LoadPlaylistPageAsync(nextPageId, generation, tracks, nextPageId);
+            if (generation != playRequestGeneration)
+            {
+                tracks.clear();
+                co_return;
+            }
+        }
+    }
 
-        // Keep track of the current track. Note that playbackList.CurrentItemIndex
-        // updates asynchronously--it may not be set by the time this function returns--
-        // so we keep track of the intended index locally so we can provide a consistent
-        // experience for the JavaScript code.
-        currentTrackIndex = initialTrackIdx;
+    /// <summary>
+    /// Reads a single page of a playlist, from either its binary or its JSON form, and appends its
+    /// tracks. Sets nextPageId to the id of the page after it, or to an empty string if it is the
+    /// last; binary playlists are always a single page. Appends nothing, and leaves nextPageId alone,
+    /// if the request for generation is superseded before the page is parsed. The tracks are read on
+    /// a background thread; awaiting this still resumes the caller on its own thread.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::LoadPlaylistPageAsync(hstring pageId, uint64_t generation, std::vector<PlaylistTrackRecord>& tracks, hstring& nextPageId)
+    {
+        if (PlaylistDataFetcher::IsBinaryPlaylistId(pageId))
+        {
+            if constexpr (PreparePlaylistsInBackground)
+            {
+                co_await resume_background();
+            }
 
-        // Update the player's current source to draw from the new list
-        player.Source(playbackList);
+            // PlayTrackAsync maps a binary playlist without reading it. Refreshing one, or a JSON
+            // page that continues in one, compares or appends records, so every track is read here.
+            std::shared_ptr<BinaryPlaylist> binaryPlaylist{ PlaylistDataFetcher::OpenBinaryPlaylist(pageId) };
+            if (!binaryPlaylist)
+            {
+                throw hresult_error(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), L"Binary playlist not found: " + pageId);
+            }
 
-        // Move to the specified track's index, if any
-        // This can only be called after the list is set as the MediaPlayer's Source
-        playbackList.MoveTo(initialTrackIdx);
+            tracks.reserve(tracks.size() + binaryPlaylist->Size());
+            for (uint32_t i = 0; i < binaryPlaylist->Size(); i++)
+            {
+                tracks.push_back(binaryPlaylist->GetTrack(i));
+            }
+            nextPageId = hstring{};
+        }
+        else
+        {
+            // Fetch the JSON data describing the requested page
+            hstring trackDataString{ co_await PlaylistDataFetcher::GetPlaylistTracks(pageId) };
+            if (generation != playRequestGeneration)
+            {
+                playRequestStats.charactersDiscarded += trackDataString.size();
+                co_return;
+            }
+
+            if constexpr (PreparePlaylistsInBackground)
+            {
+                co_await resume_background();
+            }
+
+            // Parse the track list in a single pass. This avoids building a JsonObject for the whole
+            // document, which gets expensive for large playlists.
+            nextPageId = PlaylistParser::Parse(trackDataString, [&](PlaylistTrackRecord&& track)
+            {
+                tracks.push_back(std::move(track));
+            });
+        }
     }
 
-    NativeMediaPlayer::TrackMetadata MediaPlaybackController::CreateTrackMetadataFromJson(JsonObject const& json)
+    /// <summary>
+    /// Maps the binary playlist playlistId and finds the track trackId in it, or its first track if
+    /// trackId is empty, on a background thread. Awaiting this still resumes the caller on its own
+    /// thread.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::OpenBinaryPlaylistAsync(hstring playlistId, hstring trackId, std::shared_ptr<BinaryPlaylist>& binaryPlaylist, std::optional<uint32_t>& trackIdx)
     {
-        return NativeMediaPlayer::TrackMetadata(
-            PlaylistDataFetcher::GetUriFromTrackId(json.GetNamedString(L"Id", L"")),
-            json.GetNamedString(L"Title", L""),
-            json.GetNamedString(L"Artist", L""),
-            json.GetNamedString(L"Image", L"")
-        );
+        if constexpr (PreparePlaylistsInBackground)
+        {
+            co_await resume_background();
+        }
+
+        binaryPlaylist = PlaylistDataFetcher::OpenBinaryPlaylist(playlistId);
+        if (!binaryPlaylist)
+        {
+            throw hresult_error(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), L"Binary playlist not found: " + playlistId);
+        }
+        trackIdx = trackId.empty() ? std::optional<uint32_t>{ 0 } : FindBinaryTrack(*binaryPlaylist, trackId);
     }
 
-    MediaPlaybackItem MediaPlaybackController::CreatePlaybackItemFromMetadata(NativeMediaPlayer::TrackMetadata const& track)
+    /// <summary>
+    /// Appends the current playlist's pages from pageId on, one page at a time, raising PlaylistUpdate
+    /// for each. Stops early if the playlist is replaced in the meantime.
+    /// </summary>
+    fire_and_forget MediaPlaybackController::LoadRemainingPagesAsync(hstring pageId, uint32_t pagesLoaded)
     {
-        MediaSource source{ MediaSource::CreateFromUri(Uri(track.Src())) };
-        MediaPlaybackItem playbackItem{ source };
+        auto strongThis{ get_strong() };
+        uint64_t generation{ playlistGeneration };
+        playlistLoading = true;
+        RaisePageEvent(PlayerEvent::PlaylistChanged);
 
-        // This is where the display properties are set.
-        // Other MusicProperties exist, if you want to provide them.
-        MediaItemDisplayProperties props{ playbackItem.GetDisplayProperties() };
-        props.Type(Windows::Media::MediaPlaybackType::Music);
-        props.MusicProperties().Title(track.Title());
-        props.MusicProperties().Artist(track.Artist());
+        auto started{ std::chrono::steady_clock::now() };
+        uint32_t tracksAppended{ 0 };
+        try
+        {
+            while (!pageId.empty() && pagesLoaded < MaxPlaylistPages)
+            {
+                // Jumping to another track supersedes play requests, but not the playlist it is in, so
+                // a page it interrupts is simply fetched again
+                std::vector<PlaylistTrackRecord> tracks{};
+                hstring nextPageId{ pageId };
+                co_await LoadPlaylistPageAsync(pageId, playRequestGeneration, tracks, nextPageId);
+                if (generation != playlistGeneration)
+                {
+                    co_return;
+                }
 
-        // Fetch the thumbnail as a RandomAccessStreamReference
-        hstring thumbnailSrc = track.ThumbnailSrc();
-        if (!thumbnailSrc.empty())
+                // A superseded page leaves nextPageId alone and appends nothing, so it does not count
+                // towards MaxPlaylistPages
+                if (nextPageId == pageId)
+                {
+                    continue;
+                }
+
+                pagesLoaded++;
+                AppendTracks(tracks);
+                tracksAppended += static_cast<uint32_t>(tracks.size());
+                pageId = nextPageId;
+            }
+        }
+        catch (hresult_error const& ex)
         {
-            props.Thumbnail(RandomAccessStreamReference::CreateFromUri(Uri(thumbnailSrc)));
+            // The tracks that did load keep playing
+            OutputDebugString((L"Failed to load the rest of the playlist: " + ex.message() + L"\n").c_str());
         }
 
-        // Add the modified properties back to the playbackItem
-        playbackItem.ApplyDisplayProperties(props);
+        if (generation != playlistGeneration)
+        {
+            co_return;
+        }
+        playlistLoading = false;
+        stateVersion++;
+        RaisePageEvent(PlayerEvent::PlaylistChanged);
 
-        return playbackItem;
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"PlaylistPages=" << pagesLoaded << L", "
+            << L"TracksAppended=" << tracksAppended << L", "
+            << L"Tracks=" << currentPlaylist->Size() << L", "
+            << L"RemainingPagesMs=" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
     }
 
-    fire_and_forget MediaPlaybackController::OnPlayerPositionChanged(MediaPlaybackSession sender, IInspectable args)
+    /// <summary>
+    /// Adds a page of tracks to the end of the current playlist. The tracks already there keep their
+    /// indices, so the queue and the playback window carry over unchanged, and may now reach into the
+    /// new tracks.
+    /// </summary>
+    void MediaPlaybackController::AppendTracks(std::vector<PlaylistTrackRecord> const& tracks)
     {
-        // Marshal back to the UI thread before firing an event the JavaScript may be
-        // listening to
-        co_await dispatcher;
-        timeUpdateEvent(*this, nullptr);
+        if (tracks.empty())
+        {
+            return;
+        }
+
+        UnmapTrackIds();
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            currentPlaylist->AppendTrack(GetTrackSrc(track), track.title, track.artist, track.image);
+            currentTrackIds.push_back(track.id);
+            searchIndex->AddTrack(track.title, track.artist);
+            sortViews->AddTrack(track.title, track.artist);
+        }
+        playlistSequenceNumber++;
+
+        queue.Remap(currentPlaylist->Size(), [](uint32_t trackIdx) { return std::optional<uint32_t>{ trackIdx }; });
+        SyncWindow();
+        stateVersion++;
+        RaisePageEvent(PlayerEvent::PlaylistChanged);
     }
 
-    fire_and_forget MediaPlaybackController::OnPlayerPlaybackStateChanged(MediaPlaybackSession sender, IInspectable args)
+    /// <summary>
+    /// Builds the search index and sort views for tracks, and the metadata store too if storeTracks
+    /// is set. They do not depend on each other, so in the background the index and views are each
+    /// built on a thread pool thread while the store is filled on this one. Awaiting this resumes the
+    /// caller on its own thread, and tracks and prepared must outlive it.
+    ///
+    /// MediaPlaybackItems are not prepared here. They are only created for the window of tracks
+    /// around the one that is playing, and must be added to the MediaPlaybackList on the UI thread.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::PreparePlaylistAsync(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared, bool storeTracks)
     {
-        // Marshal back to the UI thread before firing an event the JavaScript may be
-        // listening to
-        co_await dispatcher;
-        playbackUpdateEvent(*this, nullptr);
+        if constexpr (!PreparePlaylistsInBackground)
+        {
+            if (storeTracks)
+            {
+                prepared.StoreTracks(tracks);
+            }
+            prepared.IndexTracks(tracks);
+            prepared.SortTracks(tracks);
+            co_return;
+        }
+
+        co_await resume_background();
+        IAsyncAction indexed{ ThreadPool::RunAsync([&](auto&&) { prepared.IndexTracks(tracks); }) };
+        IAsyncAction sorted{ ThreadPool::RunAsync([&](auto&&) { prepared.SortTracks(tracks); }) };
+
+        // The work items use tracks and prepared, so both must finish before anything is rethrown
+        std::exception_ptr error{};
+        try
+        {
+            if (storeTracks)
+            {
+                prepared.StoreTracks(tracks);
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        for (IAsyncAction const& work : { indexed, sorted })
+        {
+            try
+            {
+                co_await work;
+            }
+            catch (...)
+            {
+                error = error ? error : std::current_exception();
+            }
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
     }
 
-    fire_and_forget MediaPlaybackController::OnPlayerSourceChanged(MediaPlayer sender, IInspectable args)
+    /// <summary>
+    /// Fills the metadata store of a playlist that PreparePlaylistAsync was told not to store.
+    /// Awaiting this resumes the caller on its own thread, and tracks and prepared must outlive it.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::StoreTracksAsync(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared)
     {
-        // Marshal back to the UI thread before firing an event the JavaScript may be
-        // listening to
-        co_await dispatcher;
-        sourceUpdateEvent(*this, nullptr);
+        if constexpr (PreparePlaylistsInBackground)
+        {
+            co_await resume_background();
+        }
+        prepared.StoreTracks(tracks);
     }
 
-    fire_and_forget MediaPlaybackController::OnCurrentPlaybackItemChanged(MediaPlaybackList sender, CurrentMediaPlaybackItemChangedEventArgs args)
+    /// <summary>
+    /// Builds the search index and sort views for a binary playlist, reading titles and artists
+    /// straight from the mapping. In the background the views are sorted on a thread pool thread
+    /// while the index is built on this one. Awaiting this resumes the caller on its own thread, and
+    /// prepared must outlive it.
+    /// </summary>
+    IAsyncAction MediaPlaybackController::PrepareBinaryPlaylistAsync(std::shared_ptr<BinaryPlaylist> binaryPlaylist, PreparedPlaylist& prepared)
     {
-        // Marshal back to the UI thread before firing an event the JavaScript may be
-        // listening to
-        co_await dispatcher;
-        currentTrackIndex = sender.CurrentItemIndex();
+        if constexpr (!PreparePlaylistsInBackground)
+        {
+            prepared.IndexTracks(*binaryPlaylist);
+            prepared.SortTracks(*binaryPlaylist);
+            co_return;
+        }
 
-        // For the purposes of this sample, the JavaScript code does not need to distinguish between
-        // the MediaPlayer's Source list changing completely and an individual track changing in the
-        // current playbackList.
-        // If it did, we could introduce a new event to fire in this instance instead of reusing
-        // SourceUpdate here.
-        sourceUpdateEvent(*this, CurrentTrack());
+        co_await resume_background();
+        IAsyncAction sorted{ ThreadPool::RunAsync([&](auto&&) { prepared.SortTracks(*binaryPlaylist); }) };
+
+        // The work item uses prepared, so it must finish before anything is rethrown
+        std::exception_ptr error{};
+        try
+        {
+            prepared.IndexTracks(*binaryPlaylist);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        try
+        {
+            co_await sorted;
+        }
+        catch (...)
+        {
+            error = error ? error : std::current_exception();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /// <summary>
+    /// Builds the search index and sort views of the binary playlist that ResetPlaybackList has just
+    /// started, so that none of it delays the first track. Until they are swapped in, PlaylistLoading
+    /// is true: the playlist is listed in its own order, and searches find nothing. Stops early if the
+    /// playlist is replaced in the meantime.
+    /// </summary>
+    fire_and_forget MediaPlaybackController::IndexBinaryPlaylistAsync()
+    {
+        auto strongThis{ get_strong() };
+        uint64_t generation{ playlistGeneration };
+        std::shared_ptr<BinaryPlaylist> binaryPlaylist{ currentBinaryPlaylist };
+        playlistLoading = true;
+        RaisePageEvent(PlayerEvent::PlaylistChanged);
+
+        auto started{ std::chrono::steady_clock::now() };
+        PreparedPlaylist prepared{};
+        co_await PrepareBinaryPlaylistAsync(binaryPlaylist, prepared);
+        if (generation != playlistGeneration)
+        {
+            co_return;
+        }
+
+        searchIndex = std::move(prepared.searchIndex);
+        sortViews = std::move(prepared.sortViews);
+        playlistLoading = false;
+        stateVersion++;
+        RaisePageEvent(PlayerEvent::PlaylistChanged);
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"MappedTracks=" << binaryPlaylist->Size() << L", "
+            << L"IndexMs=" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Adds a row to the metadata store for each track; TrackMetadata objects are only created as
+    /// tracks are read.
+    /// </summary>
+    void MediaPlaybackController::PreparedPlaylist::StoreTracks(std::vector<PlaylistTrackRecord> const& tracks)
+    {
+        store->Reserve(static_cast<uint32_t>(tracks.size()));
+        rows.reserve(tracks.size());
+        trackIds.reserve(tracks.size());
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            rows.push_back(store->Append(GetTrackSrc(track), track.title, track.artist, track.image));
+            trackIds.push_back(track.id);
+        }
+    }
+
+    /// <summary>
+    /// Makes the metadata store a front for playlist, whose tracks become its rows without any of
+    /// them being read. Their Ids stay in the mapping too, so trackIds is left empty.
+    /// </summary>
+    void MediaPlaybackController::PreparedPlaylist::MapTracks(std::shared_ptr<BinaryPlaylist> const& playlist)
+    {
+        store = std::make_shared<TrackMetadataStore>(playlist);
+        rows.resize(playlist->Size());
+        std::iota(rows.begin(), rows.end(), 0);
+        binaryPlaylist = playlist;
+    }
+
+    void MediaPlaybackController::PreparedPlaylist::IndexTracks(std::vector<PlaylistTrackRecord> const& tracks)
+    {
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            searchIndex->AddTrack(track.title, track.artist);
+        }
+    }
+
+    void MediaPlaybackController::PreparedPlaylist::IndexTracks(BinaryPlaylist const& playlist)
+    {
+        for (uint32_t i = 0; i < playlist.Size(); i++)
+        {
+            searchIndex->AddTrack(playlist.GetField(i, BinaryPlaylist::Field::Title), playlist.GetField(i, BinaryPlaylist::Field::Artist));
+        }
+    }
+
+    void MediaPlaybackController::PreparedPlaylist::SortTracks(std::vector<PlaylistTrackRecord> const& tracks)
+    {
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            sortViews->AddTrack(track.title, track.artist);
+        }
+    }
+
+    void MediaPlaybackController::PreparedPlaylist::SortTracks(BinaryPlaylist const& playlist)
+    {
+        for (uint32_t i = 0; i < playlist.Size(); i++)
+        {
+            sortViews->AddTrack(playlist.GetField(i, BinaryPlaylist::Field::Title), playlist.GetField(i, BinaryPlaylist::Field::Artist));
+        }
+    }
+
+    /// <summary>
+    /// Replaces the playlist with a prepared one and starts a new MediaPlaybackList for it.
+    /// </summary>
+    void MediaPlaybackController::ResetPlaybackList(PreparedPlaylist& prepared, uint32_t initialTrackIdx)
+    {
+        // Remove event listeners from the old list
+        if (playbackList)
+        {
+            playbackList.CurrentItemChanged(playbackListItemChangedToken);
+        }
+
+        // Any position left over from a restored session belongs to the list being replaced, as do
+        // any of its pages still loading
+        restoredPositionTicks = -1;
+        playlistGeneration++;
+        playlistLoading = false;
+
+        // Everything built from the tracks is swapped in whole. MediaPlaybackItems are much heavier
+        // than metadata rows, since each one holds a MediaSource and a thumbnail stream reference,
+        // so they are only created for the window of tracks around the one that is about to play.
+        currentPlaylist->Assign(std::move(prepared.store), std::move(prepared.rows));
+        playlistSequenceNumber++;
+        currentTrackIds = std::move(prepared.trackIds);
+        currentBinaryPlaylist = std::move(prepared.binaryPlaylist);
+        searchIndex = std::move(prepared.searchIndex);
+        sortViews = std::move(prepared.sortViews);
+        playbackList = MediaPlaybackList();
+        requestedItem = nullptr;
+        ApplyListPrefetchTime();
+        currentPlaylist->LogStatistics();
+        queue.Reset(currentPlaylist->Size(), initialTrackIdx);
+        windowTracks.clear();
+        SyncWindow();
+
+        // Register for event callbacks when the current item changes
+        playbackListItemChangedToken = playbackList.CurrentItemChanged({ this, &MediaPlaybackController::OnCurrentPlaybackItemChanged });
+
+        // Keep track of the current track. Note that playbackList.CurrentItemIndex
+        // updates asynchronously--it may not be set by the time this function returns--
+        // so we keep track of the intended index locally so we can provide a consistent
+        // experience for the JavaScript code.
+        currentTrackIndex = initialTrackIdx;
+        stateVersion++;
+
+        // Update the player's current source to draw from the new list
+        player.Source(playbackList);
+
+        // Move to the specified track's index, if any
+        // This can only be called after the list is set as the MediaPlayer's Source
+        MoveToWindowCurrent();
+    }
+
+    /// <summary>
+    /// Brings currentPlaylist and the playbackList in line with a new version of the current
+    /// playlist, keeping the item that is playing and its buffered data. Tracks are matched by Id.
+    /// Returns false, without changing anything, if the current track is no longer in the playlist.
+    /// </summary>
+    bool MediaPlaybackController::UpdatePlaylist(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared)
+    {
+        if (currentTrackIndex >= currentPlaylist->Size())
+        {
+            return false;
+        }
+
+        std::vector<hstring> newTrackIds{};
+        newTrackIds.reserve(tracks.size());
+        for (PlaylistTrackRecord const& track : tracks)
+        {
+            newTrackIds.push_back(track.id);
+        }
+
+        UnmapTrackIds();
+        PlaylistDiff playlistDiff{ PlaylistDiff::Compute(currentTrackIds, newTrackIds, currentTrackIndex) };
+        std::optional<uint32_t> newTrackIdx{ playlistDiff.NewIndexOf(currentTrackIndex) };
+        if (!newTrackIdx)
+        {
+            return false;
+        }
+
+        playlistDiff.Apply(currentPlaylist.as<Collections::IVector<NativeMediaPlayer::TrackMetadata>>(), [&](uint32_t newIndex)
+        {
+            return CreateTrackMetadataFromRecord(tracks[newIndex]);
+        });
+        currentTrackIds = std::move(newTrackIds);
+
+        // Tracks that kept their Id may still have new details
+        std::vector<uint32_t> changedTracks{};
+        for (uint32_t i = 0; i < tracks.size(); i++)
+        {
+            if (!playlistDiff.OldIndexOf(i))
+            {
+                continue;
+            }
+
+            PlaylistTrackRecord const& track{ tracks[i] };
+            if (currentPlaylist->GetField(i, TrackMetadataStore::Field::Title) != track.title ||
+                currentPlaylist->GetField(i, TrackMetadataStore::Field::Artist) != track.artist ||
+                currentPlaylist->GetField(i, TrackMetadataStore::Field::ThumbnailSrc) != track.image ||
+                currentPlaylist->GetField(i, TrackMetadataStore::Field::Src) != GetTrackSrc(track))
+            {
+                currentPlaylist->SetAt(i, CreateTrackMetadataFromRecord(track));
+                changedTracks.push_back(i);
+            }
+        }
+        if (playlistDiff.Insertions() > 0 || playlistDiff.Removals() > 0 || playlistDiff.Moves() > 0 || !changedTracks.empty())
+        {
+            playlistSequenceNumber++;
+
+            // The index and views identify tracks by position, so any change means taking the ones
+            // prepared from the new tracks
+            searchIndex = std::move(prepared.searchIndex);
+            sortViews = std::move(prepared.sortViews);
+        }
+
+        // Carry the queue and the window over to the new track indices. Window entries for removed
+        // tracks match nothing, so SyncWindow drops their items; the playing item is never removed.
+        auto mapTrack = [&](uint32_t trackIdx) { return playlistDiff.NewIndexOf(trackIdx); };
+        queue.Remap(currentPlaylist->Size(), mapTrack);
+        for (uint32_t& trackIdx : windowTracks)
+        {
+            trackIdx = mapTrack(trackIdx).value_or(UINT32_MAX);
+        }
+        uint32_t playbackItemsCreated{ SyncWindow() };
+        currentTrackIndex = *newTrackIdx;
+        stateVersion++;
+
+        MediaPlaybackItem playingItem{ playbackList.CurrentItem() };
+        for (uint32_t position = 0; position < windowTracks.size(); position++)
+        {
+            uint32_t trackIdx{ windowTracks[position] };
+            if (!std::binary_search(changedTracks.begin(), changedTracks.end(), trackIdx))
+            {
+                continue;
+            }
+
+            MediaPlaybackItem item{ playbackList.Items().GetAt(position) };
+            if (item == playingItem)
+            {
+                // Swapping out the playing item would restart it; only its display properties are updated
+                ApplyDisplayProperties(item, currentPlaylist->GetAt(trackIdx));
+            }
+            else
+            {
+                playbackList.Items().SetAt(position, CreatePlaybackItemFromMetadata(currentPlaylist->GetAt(trackIdx)));
+                playbackItemsCreated++;
+            }
+        }
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"PlaylistLength=" << currentPlaylist->Size() << L", "
+            << L"Inserted=" << playlistDiff.Insertions() << L", "
+            << L"Removed=" << playlistDiff.Removals() << L", "
+            << L"Moved=" << playlistDiff.Moves() << L", "
+            << L"Changed=" << changedTracks.size() << L", "
+            << L"PlaybackItemsCreated=" << playbackItemsCreated
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+        return true;
+    }
+
+    /// <summary>
+    /// Whether a newer request has replaced the one for generation. Call after every co_await.
+    /// </summary>
+    bool MediaPlaybackController::IsSuperseded(uint64_t generation)
+    {
+        if (generation == playRequestGeneration)
+        {
+            return false;
+        }
+
+        playRequestStats.superseded++;
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"PlayRequests=" << playRequestStats.requests << L", "
+            << L"Superseded=" << playRequestStats.superseded << L", "
+            << L"FetchedCharactersDiscarded=" << playRequestStats.charactersDiscarded
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+        return true;
+    }
+
+    void MediaPlaybackController::LogPlayRequestTime(std::chrono::steady_clock::duration uiThreadTime, std::chrono::steady_clock::time_point requestedAt)
+    {
+        uint64_t uiThreadMicroseconds{ static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(uiThreadTime).count()) };
+        playRequestStats.uiThreadMicroseconds += uiThreadMicroseconds;
+        playRequestStats.maxUIThreadMicroseconds = std::max(playRequestStats.maxUIThreadMicroseconds, uiThreadMicroseconds);
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"PlaylistLength=" << currentPlaylist->Size() << L", "
+            << L"PreparedInBackground=" << (PreparePlaylistsInBackground ? L"true" : L"false") << L", "
+            << L"UIThreadUs=" << uiThreadMicroseconds << L", "
+            << L"TotalUs=" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - requestedAt).count() << L", "
+            << L"MaxUIThreadUs=" << playRequestStats.maxUIThreadMicroseconds << L", "
+            << L"TotalUIThreadUs=" << playRequestStats.uiThreadMicroseconds
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    void MediaPlaybackController::MoveToTrack(uint32_t trackIdx)
+    {
+        if (trackIdx >= currentPlaylist->Size())
+        {
+            return;
+        }
+
+        queue.JumpTo(trackIdx);
+        ChangeCurrentTrack(trackIdx);
+    }
+
+    /// <summary>
+    /// Switches playback to trackIdx, which the queue has just made its current track.
+    /// </summary>
+    void MediaPlaybackController::ChangeCurrentTrack(uint32_t trackIdx)
+    {
+        currentTrackIndex = trackIdx;
+        stateVersion++;
+        SyncWindow();
+        MoveToWindowCurrent();
+    }
+
+    std::optional<uint32_t> MediaPlaybackController::FindTrackIndex(hstring const& trackId) const
+    {
+        if (currentBinaryPlaylist)
+        {
+            return FindBinaryTrack(*currentBinaryPlaylist, trackId);
+        }
+
+        auto it{ std::find(currentTrackIds.begin(), currentTrackIds.end(), trackId) };
+        if (it == currentTrackIds.end())
+        {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(it - currentTrackIds.begin());
+    }
+
+    hstring MediaPlaybackController::GetTrackId(uint32_t trackIdx) const
+    {
+        if (currentBinaryPlaylist)
+        {
+            return trackIdx < currentBinaryPlaylist->Size() ? hstring{ currentBinaryPlaylist->GetField(trackIdx, BinaryPlaylist::Field::Id) } : hstring{};
+        }
+        return trackIdx < currentTrackIds.size() ? currentTrackIds[trackIdx] : hstring{};
+    }
+
+    /// <summary>
+    /// Copies the Ids of a binary playlist out of its mapping into currentTrackIds, before the
+    /// tracks are changed. Does nothing for any other playlist.
+    /// </summary>
+    void MediaPlaybackController::UnmapTrackIds()
+    {
+        if (!currentBinaryPlaylist)
+        {
+            return;
+        }
+
+        currentTrackIds.clear();
+        currentTrackIds.reserve(currentBinaryPlaylist->Size());
+        for (uint32_t i = 0; i < currentBinaryPlaylist->Size(); i++)
+        {
+            currentTrackIds.emplace_back(currentBinaryPlaylist->GetField(i, BinaryPlaylist::Field::Id));
+        }
+        currentBinaryPlaylist = nullptr;
+    }
+
+    std::optional<uint32_t> MediaPlaybackController::FindBinaryTrack(BinaryPlaylist const& binaryPlaylist, std::wstring_view trackId)
+    {
+        for (uint32_t i = 0; i < binaryPlaylist.Size(); i++)
+        {
+            if (binaryPlaylist.GetField(i, BinaryPlaylist::Field::Id) == trackId)
+            {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// <summary>
+    /// The track at trackIdx in currentPlaylist, as one element of the tracks array of GetPlaylistPage.
+    /// </summary>
+    JsonObject MediaPlaybackController::GetTrackJson(uint32_t trackIdx) const
+    {
+        JsonObject trackObject{};
+        trackObject.SetNamedValue(L"index", JsonValue::CreateNumberValue(trackIdx));
+        trackObject.SetNamedValue(L"id", JsonValue::CreateStringValue(GetTrackId(trackIdx)));
+        trackObject.SetNamedValue(L"src", JsonValue::CreateStringValue(currentPlaylist->GetField(trackIdx, TrackMetadataStore::Field::Src)));
+        trackObject.SetNamedValue(L"title", JsonValue::CreateStringValue(currentPlaylist->GetField(trackIdx, TrackMetadataStore::Field::Title)));
+        trackObject.SetNamedValue(L"artist", JsonValue::CreateStringValue(currentPlaylist->GetField(trackIdx, TrackMetadataStore::Field::Artist)));
+        trackObject.SetNamedValue(L"thumbnailSrc", JsonValue::CreateStringValue(currentPlaylist->GetField(trackIdx, TrackMetadataStore::Field::ThumbnailSrc)));
+        return trackObject;
+    }
+
+    NativeMediaPlayer::TrackMetadata MediaPlaybackController::CreateTrackMetadataFromRecord(PlaylistTrackRecord const& track)
+    {
+        return currentPlaylist->CreateTrack(GetTrackSrc(track), track.title, track.artist, track.image);
+    }
+
+    hstring MediaPlaybackController::GetTrackSrc(PlaylistTrackRecord const& track)
+    {
+        return track.src.empty() ? PlaylistDataFetcher::GetUriFromTrackId(track.id) : track.src;
+    }
+
+    MediaPlaybackItem MediaPlaybackController::CreatePlaybackItemFromMetadata(NativeMediaPlayer::TrackMetadata const& track)
+    {
+        // The source is bound when the player gets around to opening the item, by which time the
+        // start of the track may have been prefetched
+        MediaBinder binder{};
+        binder.Token(track.Src());
+        binder.Binding([](MediaBinder const& sender, MediaBindingEventArgs const& args)
+        {
+            hstring contentType{};
+            if (auto stream{ TrackPrefetcher::Instance().TryOpenStream(sender.Token(), contentType) })
+            {
+                args.SetStream(stream, contentType);
+            }
+            else
+            {
+                args.SetUri(Uri{ sender.Token() });
+            }
+        });
+        MediaSource source{ MediaSource::CreateFromMediaBinder(binder) };
+        MediaPlaybackItem playbackItem{ source };
+        ApplyDisplayProperties(playbackItem, track);
+        return playbackItem;
+    }
+
+    void MediaPlaybackController::ApplyDisplayProperties(MediaPlaybackItem const& playbackItem, NativeMediaPlayer::TrackMetadata const& track)
+    {
+        // This is where the display properties are set.
+        // Other MusicProperties exist, if you want to provide them.
+        MediaItemDisplayProperties props{ playbackItem.GetDisplayProperties() };
+        props.Type(Windows::Media::MediaPlaybackType::Music);
+        props.MusicProperties().Title(track.Title());
+        props.MusicProperties().Artist(track.Artist());
+
+        // The thumbnail is served scaled down from the thumbnail cache. If it is not there yet, the
+        // item goes without until it has been fetched.
+        hstring thumbnailSrc = track.ThumbnailSrc();
+        if (!thumbnailSrc.empty())
+        {
+            if (RandomAccessStreamReference thumbnail{ ThumbnailCache::Instance().TryGetThumbnail(thumbnailSrc) })
+            {
+                props.Thumbnail(thumbnail);
+            }
+            else
+            {
+                FetchThumbnailAsync(playbackItem, thumbnailSrc);
+            }
+        }
+
+        // Add the modified properties back to the playbackItem
+        playbackItem.ApplyDisplayProperties(props);
+    }
+
+    /// <summary>
+    /// Caches the thumbnail for an item whose display properties went without one, then gives it the
+    /// thumbnail, or the full size image if it could not be cached. If the item is playing, the page
+    /// is told to pick up the cached thumbnail as well.
+    /// </summary>
+    fire_and_forget MediaPlaybackController::FetchThumbnailAsync(MediaPlaybackItem playbackItem, hstring thumbnailSrc)
+    {
+        auto strongThis{ get_strong() };
+        bool cached{ co_await ThumbnailCache::Instance().CacheAsync(thumbnailSrc) };
+        co_await resume_foreground(dispatcher);
+
+        RandomAccessStreamReference thumbnail{ cached ? ThumbnailCache::Instance().TryGetThumbnail(thumbnailSrc) : nullptr };
+        MediaItemDisplayProperties props{ playbackItem.GetDisplayProperties() };
+        props.Thumbnail(thumbnail ? thumbnail : RandomAccessStreamReference::CreateFromUri(Uri(thumbnailSrc)));
+        playbackItem.ApplyDisplayProperties(props);
+
+        if (cached && playbackList && playbackItem == playbackList.CurrentItem())
+        {
+            stateVersion++;
+            RaisePageEvent(PlayerEvent::SourceChanged);
+        }
+    }
+
+    /// <summary>
+    /// Brings the playbackList in line with the queue: the tracks PeekBehind returns, in reverse, then
+    /// the current track, then the tracks PeekAhead returns, PlaybackItemWindowSize of each. Items
+    /// that are still wanted are reused and the playing item is never removed. Returns the number of
+    /// MediaPlaybackItems created.
+    /// </summary>
+    uint32_t MediaPlaybackController::SyncWindow()
+    {
+        std::optional<uint32_t> currentTrackIdx{ queue.Current() };
+        if (!playbackList || !currentTrackIdx)
+        {
+            return 0;
+        }
+
+        // With no window, every track is loaded; the current one plus all the others either way
+        uint32_t reach{ playbackItemWindowSize };
+        if (reach == 0)
+        {
+            reach = currentPlaylist->Size() - 1;
+        }
+
+        std::vector<uint32_t> behind{ queue.PeekBehind(reach) };
+        std::vector<uint32_t> ahead{ queue.PeekAhead(reach) };
+        std::vector<uint32_t> desired(behind.rbegin(), behind.rend());
+        desired.push_back(*currentTrackIdx);
+        desired.insert(desired.end(), ahead.begin(), ahead.end());
+
+        auto items{ playbackList.Items() };
+        std::optional<uint32_t> playingPosition{};
+        uint32_t position{ 0 };
+        if (MediaPlaybackItem playingItem{ playbackList.CurrentItem() }; playingItem && items.IndexOf(playingItem, position))
+        {
+            playingPosition = position;
+        }
+
+        PlaylistDiff windowDiff{ PlaylistDiff::Compute(windowTracks, desired, playingPosition) };
+        windowDiff.Apply(items, [&](uint32_t newIndex)
+        {
+            return CreatePlaybackItemFromMetadata(currentPlaylist->GetAt(desired[newIndex]));
+        });
+        windowTracks = std::move(desired);
+        windowCurrent = static_cast<uint32_t>(behind.size());
+        return windowDiff.Insertions();
+    }
+
+    /// <summary>
+    /// Makes the playbackList play the queue's current track, unless it already is.
+    /// This can only be called after the list is set as the MediaPlayer's Source.
+    /// </summary>
+    void MediaPlaybackController::MoveToWindowCurrent()
+    {
+        auto items{ playbackList.Items() };
+        if (windowCurrent < items.Size() && playbackList.CurrentItem() != items.GetAt(windowCurrent))
+        {
+            requestedItem = items.GetAt(windowCurrent);
+            playbackList.MoveTo(windowCurrent);
+        }
+    }
+
+    void MediaPlaybackController::LogTimeToFirstAudio()
+    {
+        auto timeToFirstAudio{ std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *playRequestedAt) };
+        playRequestedAt.reset();
+
+        // AppMemoryReport is the closest thing to a peak working set that a UWP app can query
+        AppMemoryReport memoryReport{ MemoryManager::GetAppMemoryReport() };
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"PlaylistLength=" << currentPlaylist->Size() << L", "
+            << L"PlaybackItemWindowSize=" << playbackItemWindowSize << L", "
+            << L"MaterializedItems=" << (playbackList ? playbackList.Items().Size() : 0) << L", "
+            << L"TimeToFirstAudioMs=" << timeToFirstAudio.count() << L", "
+            << L"PrivateCommitBytes=" << memoryReport.PrivateCommitUsage() << L", "
+            << L"PeakPrivateCommitBytes=" << memoryReport.PeakPrivateCommitUsage()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Fires the events for every player notification raised since the last delivery, on the UI thread.
+    /// </summary>
+    void MediaPlaybackController::DeliverPlayerEvents(EventCoalescer::PendingEvents const& events)
+    {
+        if (events.Contains(PlayerEvent::CurrentItemChanged))
+        {
+            HandleCurrentPlaybackItemChanged(static_cast<MediaPlaybackItemChangedReason>(events.ValueOf(PlayerEvent::CurrentItemChanged)));
+        }
+        if (events.Contains(PlayerEvent::MediaEnded))
+        {
+            HandleMediaEnded();
+        }
+
+        // Everything else only feeds the page
+        if (!eventsDelivered)
+        {
+            return;
+        }
+
+        if (events.Contains(PlayerEvent::SourceChanged) && !events.Contains(PlayerEvent::CurrentItemChanged))
+        {
+            // A current item change reports the new source as well, so this only needs to fire on its own
+            sourceUpdateEvent(*this, nullptr);
+        }
+
+        if (events.Contains(PlayerEvent::PlaybackStateChanged))
+        {
+            if (playRequestedAt && player.PlaybackSession().PlaybackState() == MediaPlaybackState::Playing)
+            {
+                LogTimeToFirstAudio();
+            }
+            playbackUpdateEvent(*this, nullptr);
+        }
+
+        if (events.Contains(PlayerEvent::ClockChanged))
+        {
+            clockUpdateEvent(*this, nullptr);
+        }
+
+        if (events.Contains(PlayerEvent::PlaylistChanged))
+        {
+            // However many pages were appended since the last delivery, the page hears about them once
+            playlistUpdateEvent(*this, nullptr);
+        }
+
+        if (events.Contains(PlayerEvent::PositionChanged))
+        {
+            timeUpdateEvent(*this, nullptr);
+        }
+    }
+
+    /// <summary>
+    /// Sets the prefetch timer to go off PrefetchLeadTime before the current track ends, or cancels it
+    /// if the player is not playing. Called from media threads whenever that point may have moved.
+    /// </summary>
+    void MediaPlaybackController::SchedulePrefetch()
+    {
+        std::lock_guard<std::mutex> lock{ prefetchMutex };
+        if (prefetchTimer)
+        {
+            prefetchTimer.Cancel();
+            prefetchTimer = nullptr;
+        }
+
+        MediaPlaybackSession session{ player.PlaybackSession() };
+        double leadTime{ prefetchLeadTime };
+        if (leadTime <= 0 || session.PlaybackState() != MediaPlaybackState::Playing || session.PlaybackRate() <= 0)
+        {
+            return;
+        }
+
+        using seconds = std::chrono::duration<double>;
+        seconds remaining{ std::chrono::duration_cast<seconds>(session.NaturalDuration() - session.Position()) };
+        if (remaining.count() <= 0)
+        {
+            return;
+        }
+        seconds untilPrefetch{ std::max((remaining.count() - leadTime) / session.PlaybackRate(), 0.0) };
+
+        prefetchTimer = ThreadPoolTimer::CreateTimer([this](ThreadPoolTimer const&)
+        {
+            dispatcher.RunAsync(CoreDispatcherPriority::Low, [this]() { PrefetchUpcomingTracks(); });
+        }, std::chrono::duration_cast<TimeSpan>(untilPrefetch));
+    }
+
+    /// <summary>
+    /// Items bind their source when the playbackList starts preparing them, and only find their start
+    /// in TrackPrefetcher if it was fetched by then. Left to itself the list may prepare the next item
+    /// well before PrefetchLeadTime, so it is held back to half of it, which also gives the prefetch
+    /// that long to complete.
+    /// </summary>
+    void MediaPlaybackController::ApplyListPrefetchTime()
+    {
+        if (!playbackList)
+        {
+            return;
+        }
+
+        double leadTime{ prefetchLeadTime };
+        if (leadTime > 0)
+        {
+            playbackList.MaxPrefetchTime(std::chrono::duration_cast<TimeSpan>(std::chrono::duration<double>(leadTime / 2)));
+        }
+        else
+        {
+            playbackList.MaxPrefetchTime(nullptr);
+        }
+    }
+
+    /// <summary>
+    /// Starts fetching the beginning of the tracks the queue will play next.
+    /// </summary>
+    void MediaPlaybackController::PrefetchUpcomingTracks()
+    {
+        for (uint32_t trackIdx : queue.PeekAhead(PrefetchTrackCount))
+        {
+            if (trackIdx < currentPlaylist->Size() && trackIdx != queue.Current())
+            {
+                TrackPrefetcher::Instance().PrefetchAsync(currentPlaylist->GetField(trackIdx, TrackMetadataStore::Field::Src));
+            }
+        }
+    }
+
+    /// <summary>
+    /// Starts or stops delivering events to the page, whichever SuspendEvents, ResumeEvents and the
+    /// number of registered handlers now call for. Resuming raises every event once, so that the page
+    /// can catch up on whatever it missed in a single dispatcher callback.
+    /// </summary>
+    void MediaPlaybackController::UpdateEventDelivery()
+    {
+        bool deliver{ !eventsSuspended && eventHandlerCount > 0 };
+        if (deliver == eventsDelivered)
+        {
+            return;
+        }
+        eventsDelivered = deliver;
+
+        MediaPlaybackSession session{ player.PlaybackSession() };
+        if (deliver)
+        {
+            positionChangedToken = session.PositionChanged({ this, &MediaPlaybackController::OnPlayerPositionChanged });
+            AnchorClock();
+            RaisePageEvent(PlayerEvent::SourceChanged);
+            RaisePageEvent(PlayerEvent::PlaybackStateChanged);
+            RaisePageEvent(PlayerEvent::PositionChanged);
+            RaisePageEvent(PlayerEvent::PlaylistChanged);
+        }
+        else
+        {
+            session.PositionChanged(positionChangedToken);
+        }
+
+        std::wostringstream strStream{};
+        strStream << L"[MediaPlaybackController: "
+            << L"EventsDelivered=" << deliver << L", "
+            << L"EventsSuspended=" << eventsSuspended << L", "
+            << L"EventHandlers=" << eventHandlerCount
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Raises a player event whose only purpose is to update the page, unless nothing is listening.
+    /// </summary>
+    void MediaPlaybackController::RaisePageEvent(PlayerEvent kind)
+    {
+        if (eventsDelivered)
+        {
+            playerEvents->Raise(kind);
+        }
+    }
+
+    /// <summary>
+    /// Takes a new playback clock anchor from the player's current state and lets the page know.
+    /// Called from media threads whenever position can no longer be extrapolated from the last one.
+    /// While events are not being delivered there is no page to extrapolate, so nothing is done.
+    /// </summary>
+    void MediaPlaybackController::AnchorClock()
+    {
+        if (!eventsDelivered)
+        {
+            return;
+        }
+
+        MediaPlaybackSession session{ player.PlaybackSession() };
+        MediaPlaybackState state{ session.PlaybackState() };
+        TimeSpan position{ session.Position() };
+        double rate{ state == MediaPlaybackState::Playing ? session.PlaybackRate() : 0.0 };
+        TimeSpan duration{ session.NaturalDuration() };
+        {
+            std::lock_guard<std::mutex> lock{ clockMutex };
+            clock.version++;
+            clock.position = position;
+            clock.anchoredAt = std::chrono::system_clock::now();
+            clock.anchoredAtSteady = std::chrono::steady_clock::now();
+            clock.rate = rate;
+            clock.duration = duration;
+            clock.state = state;
+        }
+        RaisePageEvent(PlayerEvent::ClockChanged);
+    }
+
+    /// <summary>
+    /// Whether the player's position has strayed from what the current anchor predicts, as it does
+    /// after a seek or when playback starts a new track.
+    /// </summary>
+    bool MediaPlaybackController::IsClockDiscontinuous()
+    {
+        TimeSpan position{ player.PlaybackSession().Position() };
+
+        std::lock_guard<std::mutex> lock{ clockMutex };
+        auto elapsed{ std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - clock.anchoredAtSteady) };
+        double predicted{ std::chrono::duration_cast<std::chrono::duration<double>>(clock.position).count() + elapsed.count() * clock.rate };
+        double actual{ std::chrono::duration_cast<std::chrono::duration<double>>(position).count() };
+        return std::abs(actual - predicted) > std::chrono::duration<double>(ClockDriftTolerance).count();
+    }
+
+    void MediaPlaybackController::HandleCurrentPlaybackItemChanged(MediaPlaybackItemChangedReason reason)
+    {
+        if (!playbackList)
+        {
+            return;
+        }
+
+        // MoveTo completes asynchronously, and only the latest change is delivered. Until the item
+        // this controller last moved to is current, a change it requested is left over from an
+        // earlier move (or is the list's initial item) and says nothing about where the queue is.
+        MediaPlaybackItem currentItem{ playbackList.CurrentItem() };
+        uint32_t position{ 0 };
+        if (requestedItem && currentItem != requestedItem &&
+            (reason == MediaPlaybackItemChangedReason::AppRequested || reason == MediaPlaybackItemChangedReason::InitialItem) &&
+            playbackList.Items().IndexOf(requestedItem, position))
+        {
+            return;
+        }
+
+        // Either the move landed, or the list moved on by itself from the requested item or instead
+        // of reaching it
+        requestedItem = nullptr;
+
+        // The playbackList only holds the window of tracks around the current one. If it has moved on
+        // by itself, because a track finished, failed or the system media controls were used, step
+        // the queue along to the track of the item it is now playing, then move the window with it.
+        if (currentItem && playbackList.Items().IndexOf(currentItem, position) && position < windowTracks.size() && position != windowCurrent)
+        {
+            uint32_t track{ windowTracks[position] };
+            bool userInitiated{ reason != MediaPlaybackItemChangedReason::EndOfStream };
+            for (uint32_t i = windowCurrent; i < position && queue.Current() != track; i++)
+            {
+                queue.Advance(userInitiated);
+            }
+            for (uint32_t i = position; i < windowCurrent && queue.Current() != track; i++)
+            {
+                queue.Retreat();
+            }
+            if (queue.Current() != track)
+            {
+                queue.JumpTo(track);
+            }
+            SyncWindow();
+            MoveToWindowCurrent();
+        }
+
+        // The list's own index is a position in the window, not in CurrentPlaylist; the queue
+        // always knows which track is current
+        currentTrackIndex = queue.Current().value_or(currentTrackIndex);
+        stateVersion++;
+
+        // For the purposes of this sample, the JavaScript code does not need to distinguish between
+        // the MediaPlayer's Source list changing completely and an individual track changing in the
+        // current playbackList.
+        // If it did, we could introduce a new event to fire in this instance instead of reusing
+        // SourceUpdate here.
+        if (eventsDelivered)
+        {
+            sourceUpdateEvent(*this, CurrentTrack());
+        }
+    }
+
+    /// <summary>
+    /// Plays the current track again in repeat-one mode. Restarting the item, rather than queuing a
+    /// second copy of it, keeps its buffered data and doesn't change the source.
+    /// </summary>
+    void MediaPlaybackController::HandleMediaEnded()
+    {
+        if (playbackList && queue.RepeatMode() == PlaybackRepeatMode::One)
+        {
+            player.PlaybackSession().Position(TimeSpan::zero());
+            player.Play();
+        }
+    }
+
+    void MediaPlaybackController::OnPlayerPositionChanged(MediaPlaybackSession sender, IInspectable args)
+    {
+        // Only registered while events are being delivered, but one may already be on its way
+        if (!eventsDelivered)
+        {
+            return;
+        }
+
+        if (IsClockDiscontinuous())
+        {
+            AnchorClock();
+        }
+
+        // Pages that follow the playback clock can turn TimeUpdate down, or off, with TimeUpdateInterval
+        if (double interval{ timeUpdateInterval }; interval > 0)
+        {
+            auto now{ std::chrono::steady_clock::now().time_since_epoch() };
+            auto last{ lastTimeUpdateRaised.load() };
+            if (now.count() - last < std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval)).count() ||
+                !lastTimeUpdateRaised.compare_exchange_strong(last, now.count()))
+            {
+                return;
+            }
+        }
+        RaisePageEvent(PlayerEvent::PositionChanged);
+    }
+
+    void MediaPlaybackController::OnPlayerPlaybackStateChanged(MediaPlaybackSession sender, IInspectable args)
+    {
+        stateVersion++;
+        AnchorClock();
+        SchedulePrefetch();
+        RaisePageEvent(PlayerEvent::PlaybackStateChanged);
+    }
+
+    void MediaPlaybackController::OnPlayerSourceChanged(MediaPlayer sender, IInspectable args)
+    {
+        stateVersion++;
+        AnchorClock();
+        RaisePageEvent(PlayerEvent::SourceChanged);
+    }
+
+    void MediaPlaybackController::OnCurrentPlaybackItemChanged(MediaPlaybackList sender, CurrentMediaPlaybackItemChangedEventArgs args)
+    {
+        playerEvents->Raise(PlayerEvent::CurrentItemChanged, static_cast<int64_t>(args.Reason()));
     }
 }
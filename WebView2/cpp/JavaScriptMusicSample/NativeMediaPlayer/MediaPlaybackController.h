@@ -3,6 +3,20 @@
 
 #pragma once
 #include "MediaPlaybackController.g.h"
+#include "BinaryPlaylist.h"
+#include "EventCoalescer.h"
+#include "PlayQueue.h"
+#include "PlaylistDiff.h"
+#include "PlaylistParser.h"
+#include "PlaylistSearchIndex.h"
+#include "PlaylistSortViews.h"
+#include "TrackMetadataList.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <winrt/Windows.System.Threading.h>
 
 namespace winrt::NativeMediaPlayer::implementation
 {
@@ -23,18 +37,48 @@ namespace winrt::NativeMediaPlayer::implementation
         double CurrentTime();
         void CurrentTime(double value);
         double Duration();
+        uint32_t PlaybackItemWindowSize();
+        void PlaybackItemWindowSize(uint32_t value);
+        bool ShuffleEnabled();
+        void ShuffleEnabled(bool value);
+        uint64_t ShuffleSeed();
+        void ShuffleSeed(uint64_t value);
+        winrt::NativeMediaPlayer::PlaybackRepeatMode RepeatMode();
+        void RepeatMode(winrt::NativeMediaPlayer::PlaybackRepeatMode value);
+        uint64_t StateVersion();
+        hstring GetStateSnapshot();
+        uint64_t PlaylistSequenceNumber();
+        bool PlaylistLoading();
+        hstring GetPlaylistPage(uint32_t offset, uint32_t count);
+        hstring GetSortedPlaylistPage(winrt::NativeMediaPlayer::PlaylistSortOrder order, uint32_t offset, uint32_t count);
+        hstring SearchPlaylist(hstring const& query, uint32_t maxResults);
+        hstring GetPlaybackClock();
+        double TimeUpdateInterval();
+        void TimeUpdateInterval(double value);
+        double PrefetchLeadTime();
+        void PrefetchLeadTime(double value);
         void Play();
         void Pause();
         void SkipPrevious();
         void SkipNext();
+        void PlayNext(uint32_t trackIndex);
         winrt::Windows::Foundation::IAsyncAction PlayTrackAsync(hstring playlistId, hstring trackId);
         winrt::Windows::Foundation::IAsyncAction PlayPlaylistAsync(hstring playlistId);
+        winrt::Windows::Foundation::IAsyncAction RefreshPlaylistAsync();
+        void SaveSession();
+        bool RestoreSession();
+        void SuspendEvents();
+        void ResumeEvents();
         winrt::event_token TimeUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler);
         void TimeUpdate(winrt::event_token const& token) noexcept;
         winrt::event_token PlaybackUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler);
         void PlaybackUpdate(winrt::event_token const& token) noexcept;
         winrt::event_token SourceUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::NativeMediaPlayer::TrackMetadata> const& handler);
         void SourceUpdate(winrt::event_token const& token) noexcept;
+        winrt::event_token ClockUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler);
+        void ClockUpdate(winrt::event_token const& token) noexcept;
+        winrt::event_token PlaylistUpdate(winrt::Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable> const& handler);
+        void PlaylistUpdate(winrt::event_token const& token) noexcept;
     private:
         // The dispatcher for the thread the MediaPlaybackController was created on.
         // In this sample, it is expected to be the UI thread.
@@ -50,19 +94,210 @@ namespace winrt::NativeMediaPlayer::implementation
         winrt::Windows::Media::Playback::MediaPlaybackList playbackList{ nullptr };
 
         winrt::event_token playbackListItemChangedToken{};
-        winrt::Windows::Foundation::Collections::IVector<winrt::NativeMediaPlayer::TrackMetadata> currentPlaylist{ winrt::single_threaded_vector<winrt::NativeMediaPlayer::TrackMetadata>() };
+
+        // Player callbacks arrive on arbitrary threads, often in bursts (a seek produces a run of
+        // position changes). Rather than each one hopping to the dispatcher on its own, they are
+        // coalesced here and delivered together by DeliverPlayerEvents.
+        enum PlayerEvent : uint32_t
+        {
+            PositionChanged,
+            PlaybackStateChanged,
+            SourceChanged,
+            CurrentItemChanged,     // value: the MediaPlaybackItemChangedReason
+            ClockChanged,
+            PlaylistChanged,        // tracks were appended by LoadRemainingPagesAsync
+            MediaEnded,
+        };
+        std::unique_ptr<EventCoalescer> playerEvents{};
+
+        // Events are only delivered while the host has not suspended them and something is listening.
+        // Otherwise player notifications that only feed the page are dropped before they reach the
+        // dispatcher, and the position is not tracked at all. eventsDelivered caches the outcome of
+        // the two, so that media threads can check it cheaply; it only changes on the UI thread.
+        bool eventsSuspended{ false };
+        uint32_t eventHandlerCount{ 0 };
+        std::atomic<bool> eventsDelivered{ false };
+        winrt::event_token positionChangedToken{};
+
+        // See GetPlaybackClock in the IDL. The anchor is taken on media threads and read on the UI
+        // thread, so it is guarded by clockMutex.
+        struct PlaybackClock
+        {
+            uint64_t version{ 0 };
+            winrt::Windows::Foundation::TimeSpan position{};
+            std::chrono::system_clock::time_point anchoredAt{};
+            std::chrono::steady_clock::time_point anchoredAtSteady{};
+            double rate{ 0 };     // 0 unless the player is actually playing
+            winrt::Windows::Foundation::TimeSpan duration{};
+            winrt::Windows::Media::Playback::MediaPlaybackState state{ winrt::Windows::Media::Playback::MediaPlaybackState::None };
+        };
+        std::mutex clockMutex{};
+        PlaybackClock clock{};
+
+        // A reported position further than this from where the clock predicts is treated as a seek
+        static constexpr std::chrono::milliseconds ClockDriftTolerance{ 250 };
+
+        // See TimeUpdateInterval in the IDL; 0 raises TimeUpdate for every position change
+        std::atomic<double> timeUpdateInterval{ 0 };
+        std::atomic<std::chrono::steady_clock::rep> lastTimeUpdateRaised{ 0 };
+        winrt::com_ptr<TrackMetadataList> currentPlaylist{ winrt::make_self<TrackMetadataList>() };
         uint32_t currentTrackIndex{ 0 };
+
+        // The playlist that currentPlaylist was loaded from, and the Id of each of its tracks. Ids are
+        // what lets a reloaded playlist be matched up against the one that is playing. A binary
+        // playlist keeps its Ids in currentBinaryPlaylist, which currentPlaylist's store is a front
+        // for, and currentTrackIds is then empty; see GetTrackId.
+        hstring currentPlaylistId{};
+        std::vector<hstring> currentTrackIds{};
+        std::shared_ptr<BinaryPlaylist> currentBinaryPlaylist{};
+
+        // See PlaylistSequenceNumber in the IDL
+        uint64_t playlistSequenceNumber{ 0 };
+
+        // A playlist whose JSON names a "Next" page starts playing as soon as the page holding the
+        // track to play has loaded; the rest is appended in the background. A binary playlist starts
+        // playing as soon as it is mapped, and its search index and sort views are built in the
+        // background. See PlaylistLoading in the IDL. playlistGeneration is bumped whenever
+        // currentPlaylist is replaced, which stops any pages still loading for the one it replaced.
+        bool playlistLoading{ false };
+        uint64_t playlistGeneration{ 0 };
+
+        // Pages followed for a single playlist before the rest is ignored, so that pages which link
+        // back to each other cannot keep it loading forever
+        static constexpr uint32_t MaxPlaylistPages{ 1000 };
+
+        // Indexes the titles and artists of currentPlaylist for SearchPlaylist
+        std::unique_ptr<PlaylistSearchIndex> searchIndex{ std::make_unique<PlaylistSearchIndex>() };
+
+        // The orders GetSortedPlaylistPage lists currentPlaylist in
+        std::unique_ptr<PlaylistSortViews> sortViews{ std::make_unique<PlaylistSortViews>() };
+
+        // Everything about a playlist that can be built away from the UI thread, to be swapped in
+        // by ResetPlaybackList or UpdatePlaylist. See PreparePlaylistAsync.
+        struct PreparedPlaylist
+        {
+            std::shared_ptr<TrackMetadataStore> store{ std::make_shared<TrackMetadataStore>() };
+            std::vector<uint32_t> rows{};
+            std::vector<hstring> trackIds{};
+            std::unique_ptr<PlaylistSearchIndex> searchIndex{ std::make_unique<PlaylistSearchIndex>() };
+            std::unique_ptr<PlaylistSortViews> sortViews{ std::make_unique<PlaylistSortViews>() };
+            std::shared_ptr<BinaryPlaylist> binaryPlaylist{};
+
+            void StoreTracks(std::vector<PlaylistTrackRecord> const& tracks);
+            void MapTracks(std::shared_ptr<BinaryPlaylist> const& playlist);
+            void IndexTracks(std::vector<PlaylistTrackRecord> const& tracks);
+            void IndexTracks(BinaryPlaylist const& playlist);
+            void SortTracks(std::vector<PlaylistTrackRecord> const& tracks);
+            void SortTracks(BinaryPlaylist const& playlist);
+        };
+
+        // Set to false to parse and prepare playlists on the UI thread, as they used to be, to compare
+        // the UIThreadUs that each PlayTrackAsync logs
+        static constexpr bool PreparePlaylistsInBackground{ true };
+
+        // Decides the order tracks are played in: shuffle, repeat and tracks queued with PlayNext
+        PlayQueue queue{};
+
+        // Only this many MediaPlaybackItems on either side of the current track are kept in the
+        // playbackList; see PlaybackItemWindowSize in the IDL. The playbackList holds the tracks the
+        // queue would go back to, the current track and the tracks it plays next, in play order.
+        // windowTracks mirrors it with the index of each item's track in currentPlaylist, and
+        // windowCurrent is the position of the queue's current track.
+        static constexpr uint32_t DefaultPlaybackItemWindowSize{ 2 };
+        uint32_t playbackItemWindowSize{ DefaultPlaybackItemWindowSize };
+        std::vector<uint32_t> windowTracks{};
+        uint32_t windowCurrent{ 0 };
+
+        // The item MoveToWindowCurrent last moved the playbackList to, until it becomes current
+        winrt::Windows::Media::Playback::MediaPlaybackItem requestedItem{ nullptr };
+
+        // See PrefetchLeadTime in the IDL. The timer fires that long before the current track ends and
+        // is rescheduled whenever playback jumps or changes speed; prefetchMutex guards it, since that
+        // happens on media threads.
+        static constexpr double DefaultPrefetchLeadTime{ 30 };
+        static constexpr uint32_t PrefetchTrackCount{ 1 };
+        std::atomic<double> prefetchLeadTime{ DefaultPrefetchLeadTime };
+        std::mutex prefetchMutex{};
+        winrt::Windows::System::Threading::ThreadPoolTimer prefetchTimer{ nullptr };
+
+        // See StateVersion in the IDL. Bumped from MediaPlayer callbacks, which arrive on arbitrary threads.
+        std::atomic<uint64_t> stateVersion{ 0 };
+
+        // Incremented by every PlayTrackAsync. A request whose generation is no longer current has been
+        // superseded and must stop at its next co_await. Only touched on the UI thread.
+        uint64_t playRequestGeneration{ 0 };
+        struct PlayRequestStatistics
+        {
+            uint64_t requests{ 0 };
+            uint64_t superseded{ 0 };
+            uint64_t charactersDiscarded{ 0 };     // playlist text fetched for requests superseded before parsing
+            uint64_t uiThreadMicroseconds{ 0 };    // spent on the UI thread by requests that completed
+            uint64_t maxUIThreadMicroseconds{ 0 };
+        };
+        PlayRequestStatistics playRequestStats{};
+
+        // The playlistSequenceNumber whose tracks SaveSession last wrote, so that saving again only
+        // writes the playback state
+        std::optional<uint64_t> savedSessionSequenceNumber{};
+
+        // The position a restored session resumes at, in ticks, until its track has opened; -1 once
+        // it has been applied. Set on the UI thread and taken on a media thread.
+        std::atomic<int64_t> restoredPositionTicks{ -1 };
+
+        // Set when a new playlist is requested and cleared once it starts playing, so that the
+        // time to first audio can be reported
+        std::optional<std::chrono::steady_clock::time_point> playRequestedAt{};
+
         winrt::event<Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable>> timeUpdateEvent;
         winrt::event<Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable>> playbackUpdateEvent;
         winrt::event<Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::NativeMediaPlayer::TrackMetadata>> sourceUpdateEvent;
+        winrt::event<Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable>> clockUpdateEvent;
+        winrt::event<Windows::Foundation::TypedEventHandler<winrt::NativeMediaPlayer::MediaPlaybackController, winrt::Windows::Foundation::IInspectable>> playlistUpdateEvent;
 
         winrt::Windows::Foundation::IAsyncAction PlayTrackInternalAsync(winrt::hstring playlistId, winrt::hstring trackId);
-        winrt::NativeMediaPlayer::TrackMetadata CreateTrackMetadataFromJson(winrt::Windows::Data::Json::JsonObject const& json);
+        winrt::Windows::Foundation::IAsyncAction RefreshPlaylistInternalAsync(uint64_t generation);
+        winrt::Windows::Foundation::IAsyncAction LoadPlaylistTracksAsync(winrt::hstring playlistId, uint64_t generation, std::vector<PlaylistTrackRecord>& tracks);
+        winrt::Windows::Foundation::IAsyncAction LoadPlaylistPageAsync(winrt::hstring pageId, uint64_t generation, std::vector<PlaylistTrackRecord>& tracks, winrt::hstring& nextPageId);
+        winrt::Windows::Foundation::IAsyncAction OpenBinaryPlaylistAsync(winrt::hstring playlistId, winrt::hstring trackId, std::shared_ptr<BinaryPlaylist>& binaryPlaylist, std::optional<uint32_t>& trackIdx);
+        fire_and_forget LoadRemainingPagesAsync(winrt::hstring pageId, uint32_t pagesLoaded);
+        void AppendTracks(std::vector<PlaylistTrackRecord> const& tracks);
+        winrt::Windows::Foundation::IAsyncAction PreparePlaylistAsync(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared, bool storeTracks);
+        winrt::Windows::Foundation::IAsyncAction StoreTracksAsync(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared);
+        winrt::Windows::Foundation::IAsyncAction PrepareBinaryPlaylistAsync(std::shared_ptr<BinaryPlaylist> binaryPlaylist, PreparedPlaylist& prepared);
+        fire_and_forget IndexBinaryPlaylistAsync();
+        bool IsSuperseded(uint64_t generation);
+        void LogPlayRequestTime(std::chrono::steady_clock::duration uiThreadTime, std::chrono::steady_clock::time_point requestedAt);
+        void ResetPlaybackList(PreparedPlaylist& prepared, uint32_t initialTrackIdx);
+        bool UpdatePlaylist(std::vector<PlaylistTrackRecord> const& tracks, PreparedPlaylist& prepared);
+        void MoveToTrack(uint32_t trackIdx);
+        void ChangeCurrentTrack(uint32_t trackIdx);
+        std::optional<uint32_t> FindTrackIndex(hstring const& trackId) const;
+        hstring GetTrackId(uint32_t trackIdx) const;
+        void UnmapTrackIds();
+        static std::optional<uint32_t> FindBinaryTrack(BinaryPlaylist const& binaryPlaylist, std::wstring_view trackId);
+        winrt::Windows::Data::Json::JsonObject GetTrackJson(uint32_t trackIdx) const;
+        winrt::NativeMediaPlayer::TrackMetadata CreateTrackMetadataFromRecord(PlaylistTrackRecord const& track);
+        static hstring GetTrackSrc(PlaylistTrackRecord const& track);
         winrt::Windows::Media::Playback::MediaPlaybackItem CreatePlaybackItemFromMetadata(winrt::NativeMediaPlayer::TrackMetadata const& track);
-        winrt::fire_and_forget OnPlayerPositionChanged(winrt::Windows::Media::Playback::MediaPlaybackSession sender, IInspectable args);
-        winrt::fire_and_forget OnPlayerPlaybackStateChanged(winrt::Windows::Media::Playback::MediaPlaybackSession sender, IInspectable args);
-        winrt::fire_and_forget OnPlayerSourceChanged(winrt::Windows::Media::Playback::MediaPlayer sender, IInspectable args);
-        winrt::fire_and_forget OnCurrentPlaybackItemChanged(winrt::Windows::Media::Playback::MediaPlaybackList sender, winrt::Windows::Media::Playback::CurrentMediaPlaybackItemChangedEventArgs args);
+        void ApplyDisplayProperties(winrt::Windows::Media::Playback::MediaPlaybackItem const& playbackItem, winrt::NativeMediaPlayer::TrackMetadata const& track);
+        fire_and_forget FetchThumbnailAsync(winrt::Windows::Media::Playback::MediaPlaybackItem playbackItem, hstring thumbnailSrc);
+        uint32_t SyncWindow();
+        void MoveToWindowCurrent();
+        void LogTimeToFirstAudio();
+        void ApplyListPrefetchTime();
+        void SchedulePrefetch();
+        void PrefetchUpcomingTracks();
+        void AnchorClock();
+        bool IsClockDiscontinuous();
+        void DeliverPlayerEvents(EventCoalescer::PendingEvents const& events);
+        void UpdateEventDelivery();
+        void RaisePageEvent(PlayerEvent kind);
+        void HandleCurrentPlaybackItemChanged(winrt::Windows::Media::Playback::MediaPlaybackItemChangedReason reason);
+        void HandleMediaEnded();
+        void OnPlayerPositionChanged(winrt::Windows::Media::Playback::MediaPlaybackSession sender, IInspectable args);
+        void OnPlayerPlaybackStateChanged(winrt::Windows::Media::Playback::MediaPlaybackSession sender, IInspectable args);
+        void OnPlayerSourceChanged(winrt::Windows::Media::Playback::MediaPlayer sender, IInspectable args);
+        void OnCurrentPlaybackItemChanged(winrt::Windows::Media::Playback::MediaPlaybackList sender, winrt::Windows::Media::Playback::CurrentMediaPlaybackItemChangedEventArgs args);
     };
 }
 namespace winrt::NativeMediaPlayer::factory_implementation
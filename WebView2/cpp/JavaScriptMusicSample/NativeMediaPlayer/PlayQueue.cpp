@@ -0,0 +1,378 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlayQueue.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t FeistelRounds{ 4 };
+
+    // splitmix64's finalizer: a cheap, well-distributed 64-bit hash
+    uint64_t Mix(uint64_t value) noexcept
+    {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ull;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebull;
+        value ^= value >> 31;
+        return value;
+    }
+
+    uint32_t RoundFunction(uint32_t half, uint32_t round, uint64_t key, uint32_t mask) noexcept
+    {
+        return static_cast<uint32_t>(Mix(key ^ (static_cast<uint64_t>(round) << 32) ^ half)) & mask;
+    }
+
+    /// <summary>
+    /// A keyed permutation of [0, size), built from a Feistel network over the smallest even power
+    /// of two that covers size. Values that land outside the range are fed through again (cycle
+    /// walking), which takes fewer than four steps on average.
+    /// </summary>
+    class Permutation
+    {
+    public:
+        Permutation(uint32_t size, uint64_t key) noexcept : size{ size }, key{ key }
+        {
+            while (halfBits < 16 && (uint64_t{ 1 } << (2 * halfBits)) < size)
+            {
+                halfBits++;
+            }
+            mask = (1u << halfBits) - 1;
+        }
+
+        uint32_t Forward(uint32_t value) const noexcept
+        {
+            do
+            {
+                value = Encrypt(value);
+            } while (value >= size);
+            return value;
+        }
+
+        uint32_t Inverse(uint32_t value) const noexcept
+        {
+            do
+            {
+                value = Decrypt(value);
+            } while (value >= size);
+            return value;
+        }
+
+    private:
+        uint32_t Encrypt(uint32_t value) const noexcept
+        {
+            uint32_t left{ value >> halfBits };
+            uint32_t right{ value & mask };
+            for (uint32_t round = 0; round < FeistelRounds; round++)
+            {
+                uint32_t next{ left ^ RoundFunction(right, round, key, mask) };
+                left = right;
+                right = next;
+            }
+            return (left << halfBits) | right;
+        }
+
+        uint32_t Decrypt(uint32_t value) const noexcept
+        {
+            uint32_t left{ value >> halfBits };
+            uint32_t right{ value & mask };
+            for (uint32_t round = FeistelRounds; round-- > 0;)
+            {
+                uint32_t previous{ right ^ RoundFunction(left, round, key, mask) };
+                right = left;
+                left = previous;
+            }
+            return (left << halfBits) | right;
+        }
+
+        uint32_t size;
+        uint64_t key;
+        uint32_t halfBits{ 1 };
+        uint32_t mask{ 1 };
+    };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    void PlayQueue::Reset(uint32_t newTrackCount, uint32_t startTrack)
+    {
+        trackCount = newTrackCount;
+        upNext.clear();
+        history.clear();
+        cycle = 0;
+
+        if (trackCount == 0)
+        {
+            current.reset();
+            nextPosition = 0;
+            return;
+        }
+
+        current = Entry{ std::min(startTrack, trackCount - 1), false };
+        StartOrderAt(current->track);
+    }
+
+    void PlayQueue::Remap(uint32_t newTrackCount, std::function<std::optional<uint32_t>(uint32_t)> const& mapTrack)
+    {
+        auto remapEntries = [&](auto& entries, auto&& trackOf)
+        {
+            auto out{ entries.begin() };
+            for (auto& entry : entries)
+            {
+                if (std::optional<uint32_t> mapped{ mapTrack(trackOf(entry)) })
+                {
+                    trackOf(entry) = *mapped;
+                    *out++ = entry;
+                }
+            }
+            entries.erase(out, entries.end());
+        };
+        remapEntries(upNext, [](uint32_t& track) -> uint32_t& { return track; });
+        remapEntries(history, [](Entry& entry) -> uint32_t& { return entry.track; });
+
+        trackCount = newTrackCount;
+        cycle = 0;
+        if (current)
+        {
+            current->track = mapTrack(current->track).value_or(0);
+            StartOrderAt(current->track);
+        }
+    }
+
+    std::optional<uint32_t> PlayQueue::Current() const noexcept
+    {
+        if (!current)
+        {
+            return std::nullopt;
+        }
+        return current->track;
+    }
+
+    void PlayQueue::SetShuffle(bool enabled, uint64_t seed)
+    {
+        shuffleEnabled = enabled;
+        shuffleSeed = seed;
+        cycle = 0;
+        if (current)
+        {
+            StartOrderAt(current->track);
+        }
+    }
+
+    std::optional<uint32_t> PlayQueue::Advance(bool userInitiated)
+    {
+        if (!current)
+        {
+            return std::nullopt;
+        }
+
+        if (repeatMode == PlaybackRepeatMode::One && !userInitiated)
+        {
+            return current->track;
+        }
+
+        Entry next{};
+        if (!upNext.empty())
+        {
+            next = Entry{ upNext.front(), true };
+            upNext.pop_front();
+        }
+        else
+        {
+            if (nextPosition >= trackCount)
+            {
+                // Skipping forward past the end wraps around in either repeat mode
+                if (repeatMode == PlaybackRepeatMode::None)
+                {
+                    return std::nullopt;
+                }
+                nextPosition = 0;
+                cycle++;
+            }
+            next = Entry{ TrackAt(nextPosition, cycle), false };
+            nextPosition++;
+        }
+
+        PushHistory(*current);
+        current = next;
+        return current->track;
+    }
+
+    std::optional<uint32_t> PlayQueue::Retreat()
+    {
+        if (!current)
+        {
+            return std::nullopt;
+        }
+
+        Entry previous{};
+        if (!history.empty())
+        {
+            previous = history.back();
+            history.pop_back();
+        }
+        else
+        {
+            // Nothing has been played before this track, for instance because playback started
+            // part way through the playlist. Fall back to the base order.
+            if (current->queuedByPlayNext || nextPosition <= 1)
+            {
+                return std::nullopt;
+            }
+            previous = Entry{ TrackAt(nextPosition - 2, cycle), false };
+        }
+
+        // The track being left plays again on the next Advance
+        if (current->queuedByPlayNext)
+        {
+            upNext.push_front(current->track);
+        }
+        else
+        {
+            nextPosition = PositionOf(current->track, cycle);
+        }
+
+        current = previous;
+        if (!previous.queuedByPlayNext)
+        {
+            nextPosition = PositionOf(previous.track, cycle) + 1;
+        }
+        return current->track;
+    }
+
+    void PlayQueue::JumpTo(uint32_t track)
+    {
+        if (track >= trackCount)
+        {
+            return;
+        }
+
+        if (current)
+        {
+            PushHistory(*current);
+        }
+        current = Entry{ track, false };
+        nextPosition = PositionOf(track, cycle) + 1;
+    }
+
+    void PlayQueue::PlayNext(uint32_t track)
+    {
+        if (track < trackCount)
+        {
+            upNext.push_front(track);
+        }
+    }
+
+    std::vector<uint32_t> PlayQueue::PeekAhead(uint32_t count) const
+    {
+        std::vector<uint32_t> tracks{};
+        if (!current)
+        {
+            return tracks;
+        }
+
+        // Every automatic advance repeats the current track, which the player does by restarting it
+        // rather than by moving on to another copy of it
+        if (repeatMode == PlaybackRepeatMode::One)
+        {
+            return tracks;
+        }
+
+        tracks.reserve(count);
+        for (auto it{ upNext.begin() }; it != upNext.end() && tracks.size() < count; it++)
+        {
+            tracks.push_back(*it);
+        }
+
+        uint32_t position{ nextPosition };
+        uint32_t peekCycle{ cycle };
+        while (tracks.size() < count)
+        {
+            if (position >= trackCount)
+            {
+                if (repeatMode != PlaybackRepeatMode::All || trackCount == 0)
+                {
+                    break;
+                }
+                position = 0;
+                peekCycle++;
+            }
+            tracks.push_back(TrackAt(position++, peekCycle));
+        }
+        return tracks;
+    }
+
+    std::vector<uint32_t> PlayQueue::PeekBehind(uint32_t count) const
+    {
+        std::vector<uint32_t> tracks{};
+        if (!current)
+        {
+            return tracks;
+        }
+
+        tracks.reserve(count);
+        for (auto it{ history.rbegin() }; it != history.rend() && tracks.size() < count; it++)
+        {
+            tracks.push_back(it->track);
+        }
+
+        // As in Retreat, fall back to the base order once the history runs out
+        if (history.empty() && !current->queuedByPlayNext && nextPosition > 0)
+        {
+            for (uint32_t position = nextPosition - 1; position > 0 && tracks.size() < count; position--)
+            {
+                tracks.push_back(TrackAt(position - 1, cycle));
+            }
+        }
+        return tracks;
+    }
+
+    uint32_t PlayQueue::TrackAt(uint32_t position, uint32_t passCycle) const
+    {
+        if (!shuffleEnabled)
+        {
+            return position;
+        }
+        Permutation permutation{ trackCount, Mix(shuffleSeed + passCycle) };
+        return permutation.Forward(static_cast<uint32_t>((static_cast<uint64_t>(position) + shuffleOffset) % trackCount));
+    }
+
+    uint32_t PlayQueue::PositionOf(uint32_t track, uint32_t passCycle) const
+    {
+        if (!shuffleEnabled)
+        {
+            return track;
+        }
+        Permutation permutation{ trackCount, Mix(shuffleSeed + passCycle) };
+        return static_cast<uint32_t>((static_cast<uint64_t>(permutation.Inverse(track)) + trackCount - shuffleOffset) % trackCount);
+    }
+
+    void PlayQueue::PushHistory(Entry const& entry)
+    {
+        history.push_back(entry);
+        if (history.size() > MaxHistoryLength)
+        {
+            history.pop_front();
+        }
+    }
+
+    /// <summary>
+    /// Makes track the current position in the base order. With shuffle on, the permutation is
+    /// rotated so that track comes first and every other track follows it before the pass ends.
+    /// </summary>
+    void PlayQueue::StartOrderAt(uint32_t track)
+    {
+        if (shuffleEnabled && trackCount > 0)
+        {
+            shuffleOffset = 0;
+            shuffleOffset = Permutation{ trackCount, Mix(shuffleSeed + cycle) }.Inverse(track);
+            nextPosition = 1;
+        }
+        else
+        {
+            nextPosition = track + 1;
+        }
+    }
+}
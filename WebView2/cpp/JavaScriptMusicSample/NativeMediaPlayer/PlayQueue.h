@@ -0,0 +1,108 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "winrt/NativeMediaPlayer.h"
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Decides which track of the current playlist plays next. Tracks are identified by their index
+    /// in the playlist.
+    ///
+    /// The base order is either playlist order or, with shuffle on, a permutation of it derived from
+    /// a seed. The permutation is never stored: a small Feistel network maps positions to tracks and
+    /// back, so looking up either direction takes constant time and memory no matter how long the
+    /// playlist is, and turning shuffle on costs nothing. The same seed always produces the same order.
+    /// With repeat-all on, each pass through the playlist uses a fresh permutation.
+    ///
+    /// Tracks queued with PlayNext play before the base order continues. Tracks that are moved away
+    /// from are kept in a bounded history, so that Retreat retraces what was actually played.
+    /// </summary>
+    class PlayQueue
+    {
+    public:
+        static constexpr size_t MaxHistoryLength{ 10000 };
+
+        /// <summary>
+        /// Starts over on a playlist of trackCount tracks, with startTrack playing. Shuffle and repeat
+        /// settings are kept; with shuffle on, startTrack becomes the first track of the permutation.
+        /// </summary>
+        void Reset(uint32_t trackCount, uint32_t startTrack);
+
+        /// <summary>
+        /// Carries the queue over to a new version of the playlist. mapTrack returns the new index of
+        /// a track, or nullopt if it was removed; the current track must not have been removed.
+        /// </summary>
+        void Remap(uint32_t trackCount, std::function<std::optional<uint32_t>(uint32_t)> const& mapTrack);
+
+        std::optional<uint32_t> Current() const noexcept;
+
+        bool ShuffleEnabled() const noexcept { return shuffleEnabled; }
+        uint64_t ShuffleSeed() const noexcept { return shuffleSeed; }
+        void SetShuffle(bool enabled, uint64_t seed);
+        PlaybackRepeatMode RepeatMode() const noexcept { return repeatMode; }
+        void RepeatMode(PlaybackRepeatMode mode) noexcept { repeatMode = mode; }
+
+        /// <summary>
+        /// Moves to the next track and returns it, or nullopt at the end of the queue. An automatic
+        /// advance, when a track finishes, repeats the track in repeat-one mode; a user-initiated one
+        /// moves on.
+        /// </summary>
+        std::optional<uint32_t> Advance(bool userInitiated);
+
+        /// <summary>
+        /// Moves back to the previously played track and returns it, or nullopt if there is none.
+        /// </summary>
+        std::optional<uint32_t> Retreat();
+
+        void JumpTo(uint32_t track);
+        void PlayNext(uint32_t track);
+
+        /// <summary>
+        /// The tracks that successive automatic advances would play, up to count of them. None in
+        /// repeat-one mode, where the current track plays again instead.
+        /// </summary>
+        std::vector<uint32_t> PeekAhead(uint32_t count) const;
+
+        /// <summary>
+        /// The tracks that successive calls to Retreat would return, up to count of them.
+        /// </summary>
+        std::vector<uint32_t> PeekBehind(uint32_t count) const;
+
+    private:
+        struct Entry
+        {
+            uint32_t track{ 0 };
+            bool queuedByPlayNext{ false };
+        };
+
+        uint32_t TrackAt(uint32_t position, uint32_t cycle) const;
+        uint32_t PositionOf(uint32_t track, uint32_t cycle) const;
+        void PushHistory(Entry const& entry);
+        void StartOrderAt(uint32_t track);
+
+        uint32_t trackCount{ 0 };
+        bool shuffleEnabled{ false };
+        uint64_t shuffleSeed{ 0 };
+        PlaybackRepeatMode repeatMode{ PlaybackRepeatMode::None };
+
+        // With shuffle on, positions are rotated by this much so that the track shuffle started from
+        // is at position 0
+        uint32_t shuffleOffset{ 0 };
+
+        std::optional<Entry> current{};
+
+        // The position in the base order, and the pass through the playlist, that plays next once
+        // upNext is empty. nextPosition may equal trackCount, meaning the end of the pass.
+        uint32_t nextPosition{ 0 };
+        uint32_t cycle{ 0 };
+
+        std::deque<uint32_t> upNext{};
+        std::deque<Entry> history{};
+    };
+}
@@ -0,0 +1,43 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaybackStateSnapshot.h"
+
+using namespace winrt::Windows::Data::Json;
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    hstring PlaybackStateSnapshot::Stringify() const
+    {
+        JsonObject snapshot{};
+        snapshot.SetNamedValue(L"version", JsonValue::CreateNumberValue(static_cast<double>(version)));
+        snapshot.SetNamedValue(L"paused", JsonValue::CreateBooleanValue(paused));
+        snapshot.SetNamedValue(L"ended", JsonValue::CreateBooleanValue(ended));
+        snapshot.SetNamedValue(L"muted", JsonValue::CreateBooleanValue(muted));
+        snapshot.SetNamedValue(L"volume", JsonValue::CreateNumberValue(volume));
+        snapshot.SetNamedValue(L"currentTime", JsonValue::CreateNumberValue(currentTime));
+        snapshot.SetNamedValue(L"duration", JsonValue::CreateNumberValue(duration));
+        snapshot.SetNamedValue(L"currentTrackIndex", JsonValue::CreateNumberValue(currentTrackIndex));
+        snapshot.SetNamedValue(L"playlistLength", JsonValue::CreateNumberValue(playlistLength));
+        snapshot.SetNamedValue(L"shuffleEnabled", JsonValue::CreateBooleanValue(shuffleEnabled));
+        snapshot.SetNamedValue(L"repeatMode", JsonValue::CreateNumberValue(static_cast<double>(repeatMode)));
+
+        if (currentTrack)
+        {
+            JsonObject trackObject{};
+            trackObject.SetNamedValue(L"src", JsonValue::CreateStringValue(currentTrack->src));
+            trackObject.SetNamedValue(L"title", JsonValue::CreateStringValue(currentTrack->title));
+            trackObject.SetNamedValue(L"artist", JsonValue::CreateStringValue(currentTrack->artist));
+            trackObject.SetNamedValue(L"thumbnailSrc", JsonValue::CreateStringValue(currentTrack->thumbnailSrc));
+            trackObject.SetNamedValue(L"cachedThumbnailSrc", JsonValue::CreateStringValue(currentTrack->cachedThumbnailSrc));
+            snapshot.SetNamedValue(L"currentTrack", trackObject);
+        }
+        else
+        {
+            snapshot.SetNamedValue(L"currentTrack", JsonValue::CreateNullValue());
+        }
+
+        return snapshot.Stringify();
+    }
+}
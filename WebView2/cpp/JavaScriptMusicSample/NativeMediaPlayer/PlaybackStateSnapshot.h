@@ -0,0 +1,48 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "winrt/NativeMediaPlayer.h"
+#include <optional>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The playback state MediaPlaybackController::GetStateSnapshot returns to the page in one call.
+    /// It is filled in by the controller and turned into JSON here, so that the format can be
+    /// checked and measured without a MediaPlayer.
+    /// </summary>
+    class PlaybackStateSnapshot
+    {
+    public:
+        struct Track
+        {
+            hstring src{};
+            hstring title{};
+            hstring artist{};
+            hstring thumbnailSrc{};
+
+            // The URL of a downscaled copy of the artwork on the local.thumbnails host, or empty
+            // until ThumbnailCache has one
+            hstring cachedThumbnailSrc{};
+        };
+
+        uint64_t version{ 0 };
+        bool paused{ false };
+        bool ended{ false };
+        bool muted{ false };
+        double volume{ 0 };
+        double currentTime{ 0 };
+        double duration{ 0 };
+        uint32_t currentTrackIndex{ 0 };
+        uint32_t playlistLength{ 0 };
+        bool shuffleEnabled{ false };
+        PlaybackRepeatMode repeatMode{ PlaybackRepeatMode::None };
+        std::optional<Track> currentTrack{};
+
+        /// <summary>
+        /// The snapshot as the JSON object documented on GetStateSnapshot.
+        /// </summary>
+        hstring Stringify() const;
+    };
+}
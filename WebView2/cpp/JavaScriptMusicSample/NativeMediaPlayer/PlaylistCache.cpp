@@ -0,0 +1,510 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaylistCache.h"
+#include "SharedHttpClient.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <winrt/Windows.Storage.FileProperties.h>
+#include <winrt/Windows.System.h>
+#include <winrt/Windows.Web.Http.Headers.h>
+
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Foundation::Collections;
+using namespace winrt::Windows::Storage;
+using namespace winrt::Windows::System;
+using namespace winrt::Windows::Web::Http;
+
+namespace
+{
+    constexpr wchar_t DiskCacheFolderName[]{ L"PlaylistCache" };
+
+    // Disk entries are written here first, then moved over the entry's own file
+    constexpr wchar_t PartialFileExtension[]{ L".partial" };
+
+    size_t SizeInBytes(winrt::hstring const& text)
+    {
+        return text.size() * sizeof(wchar_t);
+    }
+
+    ApplicationDataContainer GetValidatorContainer()
+    {
+        return ApplicationData::Current().LocalSettings().CreateContainer(DiskCacheFolderName, ApplicationDataCreateDisposition::Always);
+    }
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    PlaylistCache& PlaylistCache::Instance()
+    {
+        static PlaylistCache instance{ ApplicationData::Current().LocalCacheFolder(), GetValidatorContainer().Values() };
+
+        // Give memory back when the app gets close to its limit, such as right after it moves to
+        // the background. Everything remote is still on disk, so the cost is a file read later.
+        static event_token memoryUsageIncreased{ MemoryManager::AppMemoryUsageIncreased([](auto&&, auto&&)
+        {
+            if (MemoryManager::AppMemoryUsageLevel() >= AppMemoryUsageLevel::High)
+            {
+                instance.TrimMemory();
+            }
+        }) };
+        return instance;
+    }
+
+    PlaylistCache::PlaylistCache(StorageFolder rootFolder, IPropertySet validators, uint64_t diskBudgetBytes) :
+        rootFolder{ std::move(rootFolder) }, validators{ std::move(validators) }, diskBudgetBytes{ diskBudgetBytes }
+    {
+    }
+
+    /// <summary>
+    /// Returns the text of a playlist, from the cache if possible.
+    /// </summary>
+    /// <param name="playlistId">The key the playlist is cached under.</param>
+    /// <param name="uri">Where to fetch the playlist from if it is not cached or has gone stale.</param>
+    IAsyncOperation<hstring> PlaylistCache::GetAsync(hstring playlistId, Uri uri)
+    {
+        std::wstring key{ playlistId };
+        if (++stats.requests % StatisticsInterval == 0)
+        {
+            LogStatistics();
+        }
+
+        std::shared_ptr<PendingFetch> pendingFetch{};
+        bool ownsFetch{ false };
+        hstring memoryHit{};
+        bool isMemoryHit{ false };
+
+        {
+            std::lock_guard lock{ mutex };
+
+            if (auto it{ entries.find(key) }; it != entries.end() && IsFresh(it->second))
+            {
+                lru.splice(lru.begin(), lru, it->second.lruPosition);
+                stats.memoryHits++;
+                stats.bytesServedFromCache += SizeInBytes(it->second.text);
+                memoryHit = it->second.text;
+                isMemoryHit = true;
+            }
+            else if (auto pendingIt{ pendingFetches.find(key) }; pendingIt != pendingFetches.end())
+            {
+                // Someone is already fetching this playlist; wait for them instead of fetching it twice
+                stats.sharedFetches++;
+                pendingFetch = pendingIt->second;
+            }
+            else
+            {
+                pendingFetch = std::make_shared<PendingFetch>();
+                pendingFetches.emplace(key, pendingFetch);
+                ownsFetch = true;
+            }
+        }
+
+        if (isMemoryHit)
+        {
+            co_return memoryHit;
+        }
+
+        if (ownsFetch)
+        {
+            try
+            {
+                pendingFetch->text = co_await LoadAsync(key, uri);
+            }
+            catch (...)
+            {
+                pendingFetch->error = std::current_exception();
+            }
+
+            {
+                std::lock_guard lock{ mutex };
+                pendingFetches.erase(key);
+            }
+            SetEvent(pendingFetch->completed.get());
+        }
+        else
+        {
+            co_await winrt::resume_on_signal(pendingFetch->completed.get());
+        }
+
+        if (pendingFetch->error)
+        {
+            std::rethrow_exception(pendingFetch->error);
+        }
+        co_return pendingFetch->text;
+    }
+
+    /// <summary>
+    /// Drops the memory tier. Remote playlists can still be served from disk afterwards.
+    /// </summary>
+    void PlaylistCache::TrimMemory()
+    {
+        std::lock_guard lock{ mutex };
+        entries.clear();
+        lru.clear();
+        memoryBytes = 0;
+    }
+
+    void PlaylistCache::LogStatistics() const
+    {
+        std::wostringstream strStream{};
+        strStream << L"[PlaylistCache: "
+            << L"Requests=" << stats.requests.load() << L", "
+            << L"MemoryHits=" << stats.memoryHits.load() << L", "
+            << L"DiskHits=" << stats.diskHits.load() << L", "
+            << L"RevalidatedHits=" << stats.revalidatedHits.load() << L", "
+            << L"Misses=" << stats.misses.load() << L", "
+            << L"SharedFetches=" << stats.sharedFetches.load() << L", "
+            << L"BytesFetched=" << stats.bytesFetched.load() << L", "
+            << L"BytesServedFromCache=" << stats.bytesServedFromCache.load() << L", "
+            << L"DiskEvictions=" << stats.diskEvictions.load()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Produces the text of a playlist that is not fresh in memory, checking the disk tier and then
+    /// the network. Only one LoadAsync runs per key at a time.
+    /// </summary>
+    IAsyncOperation<hstring> PlaylistCache::LoadAsync(std::wstring key, Uri uri)
+    {
+        if (uri.SchemeName() == L"ms-appx")
+        {
+            // Files inside the app package cannot change while the app is running, so once they are
+            // in memory they never need revalidating.
+            StorageFile file{ co_await StorageFile::GetFileFromApplicationUriAsync(uri) };
+            hstring text{ co_await FileIO::ReadTextAsync(file) };
+            stats.misses++;
+            stats.bytesFetched += SizeInBytes(text);
+            StoreMemoryEntry(key, Entry{ text, L"", L"", winrt::clock::now(), false });
+            co_return text;
+        }
+
+        hstring fileName{ GetDiskFileName(key) };
+
+        // Start from whatever we already know about this playlist: the memory entry if it is merely
+        // stale, otherwise the copy on disk.
+        Entry cached{};
+        bool haveCached{ TryGetMemoryEntry(key, cached) };
+        if (!haveCached)
+        {
+            if (TryReadDiskValidators(fileName, cached))
+            {
+                hstring text{ co_await ReadDiskEntryAsync(fileName) };
+                if (!text.empty())
+                {
+                    cached.text = text;
+                    haveCached = true;
+
+                    if (IsFresh(cached))
+                    {
+                        stats.diskHits++;
+                        stats.bytesServedFromCache += SizeInBytes(cached.text);
+                        StoreMemoryEntry(key, cached);
+                        co_return cached.text;
+                    }
+                }
+            }
+        }
+
+        HttpRequestMessage getRequest{ HttpMethod::Get(), uri };
+        if (haveCached)
+        {
+            // Ask the server to only send the playlist if it changed since we last saw it
+            if (!cached.eTag.empty())
+            {
+                getRequest.Headers().TryAppendWithoutValidation(L"If-None-Match", cached.eTag);
+            }
+            if (!cached.lastModified.empty())
+            {
+                getRequest.Headers().TryAppendWithoutValidation(L"If-Modified-Since", cached.lastModified);
+            }
+        }
+
+        HttpResponseMessage response{ nullptr };
+        try
+        {
+            response = co_await GetSharedHttpClient().SendRequestAsync(getRequest);
+        }
+        catch (hresult_error const& ex)
+        {
+            if (!haveCached)
+            {
+                throw;
+            }
+
+            // Being offline is not a reason to stop playing a playlist we already have
+            hstring errStr = L"Failed to revalidate playlist, serving cached copy: " + uri.ToString() + L" " + ex.message() + L"\n";
+            OutputDebugString(errStr.c_str());
+            stats.bytesServedFromCache += SizeInBytes(cached.text);
+            co_return cached.text;
+        }
+
+        if (haveCached && response.StatusCode() == HttpStatusCode::NotModified)
+        {
+            stats.revalidatedHits++;
+            stats.bytesServedFromCache += SizeInBytes(cached.text);
+            cached.validatedAt = winrt::clock::now();
+            StoreMemoryEntry(key, cached);
+            try
+            {
+                UpdateDiskValidatedAt(fileName, cached.validatedAt);
+            }
+            catch (hresult_error const& ex)
+            {
+                // The text is still good; the disk copy will just be revalidated again next launch
+                hstring errStr = L"Failed to write playlist cache validators " + fileName + L": " + ex.message() + L"\n";
+                OutputDebugString(errStr.c_str());
+            }
+            co_return cached.text;
+        }
+
+        if (!response.IsSuccessStatusCode())
+        {
+            hstring errStr = L"Failed to retrieve string from URI: " + uri.ToString() + L" Failure Code: " + to_hstring(static_cast<int>(response.StatusCode())) + L"\n";
+            OutputDebugString(errStr.c_str());
+            co_return haveCached ? cached.text : hstring{ L"" };
+        }
+
+        Entry fetched{};
+        fetched.text = co_await response.Content().ReadAsStringAsync();
+        fetched.eTag = response.Headers().HasKey(L"ETag") ? response.Headers().Lookup(L"ETag") : L"";
+        fetched.lastModified = response.Content().Headers().HasKey(L"Last-Modified") ? response.Content().Headers().Lookup(L"Last-Modified") : L"";
+        fetched.validatedAt = winrt::clock::now();
+        fetched.isRemote = true;
+
+        stats.misses++;
+        stats.bytesFetched += SizeInBytes(fetched.text);
+
+        StoreMemoryEntry(key, fetched);
+
+        // The memory tier already holds the text, so the caller needn't wait for the disk tier.
+        // WriteDiskEntryAsync reports its own failures.
+        WriteDiskEntryAsync(fileName, fetched);
+        co_return fetched.text;
+    }
+
+    IAsyncOperation<hstring> PlaylistCache::ReadDiskEntryAsync(hstring fileName)
+    {
+        StorageFolder cacheFolder{ co_await GetDiskFolderAsync() };
+        IStorageItem item{ co_await cacheFolder.TryGetItemAsync(fileName) };
+        if (auto file{ item.try_as<StorageFile>() })
+        {
+            hstring text{ co_await FileIO::ReadTextAsync(file) };
+            co_return text;
+        }
+        co_return L"";
+    }
+
+    IAsyncAction PlaylistCache::WriteDiskEntryAsync(hstring fileName, Entry entry)
+    {
+        try
+        {
+            // Nothing may point at the old file while it is replaced, so its validators go first. The
+            // new text is written to a file of its own and only then moved over the old one, and the
+            // validators written last, so an interrupted write leaves no entry rather than one whose
+            // validators describe a partial or outdated file.
+            RemoveDiskValidators(fileName);
+            StorageFolder cacheFolder{ co_await GetDiskFolderAsync() };
+            StorageFile file{ co_await cacheFolder.CreateFileAsync(fileName + PartialFileExtension, CreationCollisionOption::ReplaceExisting) };
+            co_await FileIO::WriteTextAsync(file, entry.text);
+            co_await file.MoveAsync(cacheFolder, fileName, NameCollisionOption::ReplaceExisting);
+            uint64_t size{ (co_await file.GetBasicPropertiesAsync()).Size() };
+
+            WriteDiskValidators(fileName, entry, size);
+            co_await TrimDiskAsync(cacheFolder);
+        }
+        catch (hresult_error const& ex)
+        {
+            // Failing to write the disk tier only costs us a download next launch
+            hstring errStr = L"Failed to write playlist cache entry " + fileName + L": " + ex.message() + L"\n";
+            OutputDebugString(errStr.c_str());
+        }
+    }
+
+    /// <summary>
+    /// Drops the entries validated longest ago until the files on disk fit in the disk budget. Each
+    /// entry's validators are removed before its file is deleted.
+    /// </summary>
+    IAsyncAction PlaylistCache::TrimDiskAsync(StorageFolder cacheFolder)
+    {
+        struct DiskEntry
+        {
+            hstring fileName{};
+            uint64_t size{ 0 };
+            int64_t validatedAt{ 0 };
+        };
+
+        std::vector<hstring> evicted{};
+        {
+            std::lock_guard lock{ mutex };
+            std::vector<DiskEntry> diskEntries{};
+            uint64_t diskBytes{ 0 };
+            for (auto const& pair : validators)
+            {
+                if (auto composite{ pair.Value().try_as<ApplicationDataCompositeValue>() })
+                {
+                    uint64_t size{ unbox_value_or<uint64_t>(composite.TryLookup(L"Size"), 0) };
+                    diskEntries.push_back(DiskEntry{ pair.Key(), size, unbox_value_or<int64_t>(composite.TryLookup(L"ValidatedAt"), 0) });
+                    diskBytes += size;
+                }
+            }
+            if (diskBytes <= diskBudgetBytes)
+            {
+                co_return;
+            }
+
+            std::sort(diskEntries.begin(), diskEntries.end(), [](DiskEntry const& a, DiskEntry const& b) { return a.validatedAt < b.validatedAt; });
+            for (DiskEntry const& diskEntry : diskEntries)
+            {
+                if (diskBytes <= diskBudgetBytes)
+                {
+                    break;
+                }
+                validators.Remove(diskEntry.fileName);
+                diskBytes -= diskEntry.size;
+                evicted.push_back(diskEntry.fileName);
+                stats.diskEvictions++;
+            }
+        }
+
+        for (hstring const& fileName : evicted)
+        {
+            if (IStorageItem item{ co_await cacheFolder.TryGetItemAsync(fileName) })
+            {
+                co_await item.DeleteAsync();
+            }
+        }
+    }
+
+    IAsyncOperation<StorageFolder> PlaylistCache::GetDiskFolderAsync() const
+    {
+        co_return co_await rootFolder.CreateFolderAsync(DiskCacheFolderName, CreationCollisionOption::OpenIfExists);
+    }
+
+    /// <summary>
+    /// Reads the validators of the disk entry in fileName into entry. Returns false if there is no
+    /// such entry.
+    /// </summary>
+    bool PlaylistCache::TryReadDiskValidators(hstring const& fileName, Entry& entry)
+    {
+        std::lock_guard lock{ mutex };
+        auto composite{ validators.TryLookup(fileName).try_as<ApplicationDataCompositeValue>() };
+        if (!composite)
+        {
+            return false;
+        }
+
+        entry.eTag = unbox_value_or<hstring>(composite.TryLookup(L"ETag"), L"");
+        entry.lastModified = unbox_value_or<hstring>(composite.TryLookup(L"LastModified"), L"");
+        entry.validatedAt = DateTime{ TimeSpan{ unbox_value_or<int64_t>(composite.TryLookup(L"ValidatedAt"), 0) } };
+        entry.isRemote = true;
+        return true;
+    }
+
+    void PlaylistCache::WriteDiskValidators(hstring const& fileName, Entry const& entry, uint64_t size)
+    {
+        ApplicationDataCompositeValue composite{};
+        composite.Insert(L"ETag", box_value(entry.eTag));
+        composite.Insert(L"LastModified", box_value(entry.lastModified));
+        composite.Insert(L"ValidatedAt", box_value(entry.validatedAt.time_since_epoch().count()));
+        composite.Insert(L"Size", box_value(size));
+
+        std::lock_guard lock{ mutex };
+        validators.Insert(fileName, composite);
+    }
+
+    /// <summary>
+    /// Records that the disk entry in fileName, if there still is one, was found to be current at
+    /// validatedAt.
+    /// </summary>
+    void PlaylistCache::UpdateDiskValidatedAt(hstring const& fileName, DateTime validatedAt)
+    {
+        std::lock_guard lock{ mutex };
+        if (auto composite{ validators.TryLookup(fileName).try_as<ApplicationDataCompositeValue>() })
+        {
+            // Settings are stored when they are inserted, so the changed value has to be put back
+            composite.Insert(L"ValidatedAt", box_value(validatedAt.time_since_epoch().count()));
+            validators.Insert(fileName, composite);
+        }
+    }
+
+    void PlaylistCache::RemoveDiskValidators(hstring const& fileName)
+    {
+        std::lock_guard lock{ mutex };
+        if (validators.HasKey(fileName))
+        {
+            validators.Remove(fileName);
+        }
+    }
+
+    bool PlaylistCache::TryGetMemoryEntry(std::wstring const& key, Entry& entry)
+    {
+        std::lock_guard lock{ mutex };
+        if (auto it{ entries.find(key) }; it != entries.end())
+        {
+            entry = it->second;
+            return true;
+        }
+        return false;
+    }
+
+    void PlaylistCache::StoreMemoryEntry(std::wstring const& key, Entry entry)
+    {
+        // A single playlist larger than the whole budget would just evict everything else
+        if (SizeInBytes(entry.text) > MemoryBudgetBytes)
+        {
+            return;
+        }
+
+        std::lock_guard lock{ mutex };
+        if (auto it{ entries.find(key) }; it != entries.end())
+        {
+            memoryBytes -= SizeInBytes(it->second.text);
+            lru.erase(it->second.lruPosition);
+            entries.erase(it);
+        }
+
+        lru.push_front(key);
+        entry.lruPosition = lru.begin();
+        memoryBytes += SizeInBytes(entry.text);
+        entries.emplace(key, std::move(entry));
+        EvictToBudget();
+    }
+
+    // Must be called with the mutex held
+    void PlaylistCache::EvictToBudget()
+    {
+        while (memoryBytes > MemoryBudgetBytes && !lru.empty())
+        {
+            auto it{ entries.find(lru.back()) };
+            memoryBytes -= SizeInBytes(it->second.text);
+            entries.erase(it);
+            lru.pop_back();
+        }
+    }
+
+    bool PlaylistCache::IsFresh(Entry const& entry)
+    {
+        return !entry.isRemote || (winrt::clock::now() - entry.validatedAt) < FreshnessLifetime;
+    }
+
+    /// <summary>
+    /// Playlist ids may be full URLs, so hash them into something that is safe to use as a file name.
+    /// </summary>
+    hstring PlaylistCache::GetDiskFileName(std::wstring const& key)
+    {
+        // 64-bit FNV-1a
+        uint64_t hash{ 14695981039346656037ull };
+        for (wchar_t c : key)
+        {
+            hash = (hash ^ static_cast<uint64_t>(c)) * 1099511628211ull;
+        }
+
+        std::wostringstream strStream{};
+        strStream << std::hex << std::setw(16) << std::setfill(L'0') << hash << L".json";
+        return strStream.str().c_str();
+    }
+}
@@ -0,0 +1,130 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <winrt/Windows.Storage.h>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Caches playlist JSON so that replaying a playlist the user has already visited does not
+    /// require reading or downloading it again.
+    ///
+    /// There are two tiers. The memory tier is an LRU list bounded by MemoryBudgetBytes. Playlists
+    /// that come from the web are additionally written to the app's LocalCacheFolder together with
+    /// the ETag and Last-Modified headers the server returned, so that once an entry goes stale it
+    /// can be revalidated with a conditional request rather than downloaded in full. The disk tier
+    /// is bounded by DiskBudgetBytes, dropping the entries validated longest ago first. Concurrent
+    /// requests for the same playlist share a single fetch.
+    ///
+    /// A file on disk only counts as an entry while its validators exist. They are removed before
+    /// the file is replaced and written once the new file has been moved into place, so a write
+    /// that is interrupted leaves no entry rather than a partial one.
+    /// </summary>
+    class PlaylistCache
+    {
+    public:
+        /// <summary>
+        /// Counters describing how effective the cache has been since the app started.
+        /// </summary>
+        struct Statistics
+        {
+            std::atomic<uint64_t> requests{ 0 };
+            std::atomic<uint64_t> memoryHits{ 0 };
+            std::atomic<uint64_t> diskHits{ 0 };
+            std::atomic<uint64_t> revalidatedHits{ 0 };
+            std::atomic<uint64_t> misses{ 0 };
+            std::atomic<uint64_t> sharedFetches{ 0 };
+            std::atomic<uint64_t> bytesFetched{ 0 };
+            std::atomic<uint64_t> bytesServedFromCache{ 0 };
+            std::atomic<uint64_t> diskEvictions{ 0 };
+        };
+
+        /// <summary>
+        /// The maximum number of bytes of playlist text kept in memory at once.
+        /// </summary>
+        static constexpr size_t MemoryBudgetBytes{ 16 * 1024 * 1024 };
+
+        /// <summary>
+        /// The maximum number of bytes of playlist files kept on disk at once.
+        /// </summary>
+        static constexpr uint64_t DiskBudgetBytes{ 64 * 1024 * 1024 };
+
+        /// <summary>
+        /// How long a remote playlist is served from the cache before it is revalidated with the server.
+        /// Playlists inside the app package never change, so they are never revalidated.
+        /// </summary>
+        static constexpr winrt::Windows::Foundation::TimeSpan FreshnessLifetime{ std::chrono::minutes(5) };
+
+        static PlaylistCache& Instance();
+
+        /// <summary>
+        /// A cache whose disk tier keeps its files in a PlaylistCache folder inside rootFolder, and
+        /// their validators in validators. Instance uses the app's LocalCacheFolder and a container
+        /// in its LocalSettings; tests use a folder and property set of their own.
+        /// </summary>
+        PlaylistCache(winrt::Windows::Storage::StorageFolder rootFolder, winrt::Windows::Foundation::Collections::IPropertySet validators, uint64_t diskBudgetBytes = DiskBudgetBytes);
+        PlaylistCache(PlaylistCache const&) = delete;
+        PlaylistCache& operator=(PlaylistCache const&) = delete;
+
+        winrt::Windows::Foundation::IAsyncOperation<hstring> GetAsync(hstring playlistId, winrt::Windows::Foundation::Uri uri);
+        void TrimMemory();
+        Statistics const& Stats() const noexcept { return stats; }
+        void LogStatistics() const;
+
+    private:
+        struct Entry
+        {
+            hstring text{};
+            hstring eTag{};
+            hstring lastModified{};
+            winrt::Windows::Foundation::DateTime validatedAt{};
+            bool isRemote{ false };
+            std::list<std::wstring>::iterator lruPosition{};
+        };
+
+        struct PendingFetch
+        {
+            winrt::handle completed{ CreateEvent(nullptr, true, false, nullptr) };
+            hstring text{};
+            std::exception_ptr error{};
+        };
+
+        winrt::Windows::Foundation::IAsyncOperation<hstring> LoadAsync(std::wstring key, winrt::Windows::Foundation::Uri uri);
+        winrt::Windows::Foundation::IAsyncOperation<hstring> ReadDiskEntryAsync(hstring fileName);
+        winrt::Windows::Foundation::IAsyncAction WriteDiskEntryAsync(hstring fileName, Entry entry);
+        winrt::Windows::Foundation::IAsyncAction TrimDiskAsync(winrt::Windows::Storage::StorageFolder cacheFolder);
+        winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Storage::StorageFolder> GetDiskFolderAsync() const;
+        bool TryReadDiskValidators(hstring const& fileName, Entry& entry);
+        void WriteDiskValidators(hstring const& fileName, Entry const& entry, uint64_t size);
+        void UpdateDiskValidatedAt(hstring const& fileName, winrt::Windows::Foundation::DateTime validatedAt);
+        void RemoveDiskValidators(hstring const& fileName);
+        bool TryGetMemoryEntry(std::wstring const& key, Entry& entry);
+        void StoreMemoryEntry(std::wstring const& key, Entry entry);
+        void EvictToBudget();
+
+        static bool IsFresh(Entry const& entry);
+        static hstring GetDiskFileName(std::wstring const& key);
+
+        winrt::Windows::Storage::StorageFolder rootFolder;
+        winrt::Windows::Foundation::Collections::IPropertySet validators;
+        uint64_t diskBudgetBytes;
+
+        // Guards the memory tier and validators alike
+        std::mutex mutex{};
+        std::list<std::wstring> lru{};
+        std::unordered_map<std::wstring, Entry> entries{};
+        std::unordered_map<std::wstring, std::shared_ptr<PendingFetch>> pendingFetches{};
+        size_t memoryBytes{ 0 };
+        Statistics stats{};
+
+        // How many requests go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 20 };
+    };
+}
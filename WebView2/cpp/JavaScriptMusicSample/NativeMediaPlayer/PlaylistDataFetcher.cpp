@@ -4,21 +4,37 @@
 #include "pch.h"
 #include "PlaylistDataFetcher.h"
 #include "PlaylistDataFetcher.g.cpp"
+#include "PlaylistCache.h"
 #include <sstream>
+#include <winrt/Windows.ApplicationModel.h>
 #include <winrt/Windows.Storage.h>
 
+using namespace winrt::Windows::ApplicationModel;
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Storage;
-using namespace winrt::Windows::Web::Http;
+
+namespace
+{
+    // Binary playlists produced by ConvertPlaylistToBinaryAsync are written here, inside LocalCacheFolder
+    constexpr wchar_t ConvertedPlaylistFolderName[]{ L"Playlists" };
+
+    // Pages followed when converting a paged playlist, so that pages which link back to each other
+    // cannot keep it converting forever
+    constexpr uint32_t MaxConvertedPages{ 1000 };
+}
 
 namespace winrt::NativeMediaPlayer::implementation
 {
     winrt::Windows::Foundation::IAsyncOperation<hstring> PlaylistDataFetcher::GetPlaylistTracks(hstring playlistId)
     {
-        std::wostringstream strStream{};
-        strStream << L"ms-appx:///WebCode/playlistdata/" << playlistId.c_str() << L".json";
-        Uri uri{ strStream.str() };
-        hstring str{ co_await FetchStringFromUri(uri) };
+        if (IsBinaryPlaylistId(playlistId))
+        {
+            throw hresult_invalid_argument(L"Binary playlists cannot be returned as JSON: " + playlistId);
+        }
+
+        // Replaying a playlist the user has already visited is served from PlaylistCache,
+        // which only goes back to the source when the entry is missing or stale.
+        hstring str{ co_await PlaylistCache::Instance().GetAsync(playlistId, GetUriFromPlaylistId(playlistId)) };
         co_return str;
     }
     hstring PlaylistDataFetcher::GetUriFromTrackId(hstring const& trackId)
@@ -28,40 +44,83 @@ namespace winrt::NativeMediaPlayer::implementation
         return strStream.str().c_str();
     }
 
+    IAsyncOperation<hstring> PlaylistDataFetcher::ConvertPlaylistToBinaryAsync(hstring playlistId)
+    {
+        std::wstring_view id{ playlistId };
+        if (IsBinaryPlaylistId(playlistId) || id.find_first_of(L"/\\:") != std::wstring_view::npos)
+        {
+            throw hresult_invalid_argument(L"Only JSON playlists inside the app package can be converted: " + playlistId);
+        }
+
+        StorageFolder outputFolder{ co_await ApplicationData::Current().LocalCacheFolder().CreateFolderAsync(ConvertedPlaylistFolderName, CreationCollisionOption::OpenIfExists) };
+
+        // Parsing and writing a large playlist is blocking work; keep it off the caller's thread
+        co_await winrt::resume_background();
+
+        // Every page goes into the one binary playlist
+        std::vector<PlaylistTrackRecord> tracks{};
+        hstring pageId{ playlistId };
+        for (uint32_t pages = 0; !pageId.empty() && pages < MaxConvertedPages; pages++)
+        {
+            hstring trackDataString{ co_await GetPlaylistTracks(pageId) };
+            pageId = PlaylistParser::Parse(trackDataString, [&](PlaylistTrackRecord&& track)
+            {
+                tracks.push_back(std::move(track));
+            });
+        }
+
+        hstring binaryPlaylistId{ playlistId + BinaryPlaylist::FileExtension };
+        BinaryPlaylist::Write(outputFolder.Path() + L"\\" + binaryPlaylistId, tracks, &PlaylistDataFetcher::GetUriFromTrackId);
+        co_return binaryPlaylistId;
+    }
+
+    /// <summary>
+    /// The loader for a playlist is chosen by the extension on its id: ids ending in
+    /// BinaryPlaylist::FileExtension are memory-mapped, everything else is fetched as JSON.
+    /// </summary>
+    bool PlaylistDataFetcher::IsBinaryPlaylistId(hstring const& playlistId)
+    {
+        return std::wstring_view{ playlistId }.ends_with(BinaryPlaylist::FileExtension);
+    }
+
     /// <summary>
-    /// Helper function to retrieve the contents of a text file either from local storage or the web.
+    /// Maps a binary playlist, looking first next to the JSON playlists in the app package and then in
+    /// the folder ConvertPlaylistToBinaryAsync writes to. Returns nullptr if neither exists.
     /// </summary>
-    /// <param name="uri">URI to the file to retrieve.</param>
-    /// <returns>A string containing the contents for the file.</returns>
-    IAsyncOperation<hstring> PlaylistDataFetcher::FetchStringFromUri(Uri uri)
+    std::shared_ptr<BinaryPlaylist> PlaylistDataFetcher::OpenBinaryPlaylist(hstring const& playlistId)
     {
-        if (uri.SchemeName() == L"ms-appx")
+        if (std::wstring_view{ playlistId }.find_first_of(L"/\\:") != std::wstring_view::npos)
         {
-            StorageFile file{ co_await StorageFile::GetFileFromApplicationUriAsync(uri) };
-            hstring text{ co_await FileIO::ReadTextAsync(file) };
-            co_return text;
+            return nullptr;
         }
-        else
+
+        hstring packagePath{ Package::Current().InstalledLocation().Path() + L"\\WebCode\\playlistdata\\" + playlistId };
+        if (auto playlist{ BinaryPlaylist::TryOpen(packagePath) })
         {
-            // It is best to avoid re-creating an HttpClient every time a new request is made, for performance.
-            // Depending on your scenario, you may need to cusomize the HttpClient's settings further.
-            // For more details, see:
-            // https://learn.microsoft.com/en-us/dotnet/fundamentals/networking/http/httpclient-guidelines
-            static const HttpClient httpClient{};
-
-            HttpRequestMessage getRequest{ HttpMethod::Get(), uri };
-            HttpResponseMessage response{ co_await httpClient.SendRequestAsync(getRequest) };
-            if (response.IsSuccessStatusCode())
-            {
-                hstring text{ co_await response.Content().ReadAsStringAsync() };
-                co_return text;
-            }
-            else
-            {
-                hstring errStr = L"Failed to retrieve string from URI: " + uri.ToString() + L" Failure Code: " + to_hstring(static_cast<int>(response.StatusCode()));
-                OutputDebugString(errStr.c_str());
-                co_return L"";
-            }
+            return playlist;
+        }
+
+        hstring convertedPath{ ApplicationData::Current().LocalCacheFolder().Path() + L"\\" + ConvertedPlaylistFolderName + L"\\" + playlistId };
+        return BinaryPlaylist::TryOpen(convertedPath);
+    }
+
+    /// <summary>
+    /// Constructs the URI a playlist is fetched from. Playlist ids that are already absolute web URLs
+    /// are used as-is, which allows playlists to be served dynamically. Any other id refers to a
+    /// json file inside the app package.
+    /// </summary>
+    /// <param name="playlistId">A unique identifier for the playlist.</param>
+    /// <returns>A fully-qualified URI to the playlist data.</returns>
+    Uri PlaylistDataFetcher::GetUriFromPlaylistId(hstring const& playlistId)
+    {
+        std::wstring_view id{ playlistId };
+        if (id.starts_with(L"https://") || id.starts_with(L"http://"))
+        {
+            return Uri{ playlistId };
         }
+
+        std::wostringstream strStream{};
+        strStream << L"ms-appx:///WebCode/playlistdata/" << playlistId.c_str() << L".json";
+        return Uri{ strStream.str() };
     }
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 #include "PlaylistDataFetcher.g.h"
+#include "BinaryPlaylist.h"
 
 namespace winrt::NativeMediaPlayer::implementation
 {
@@ -13,9 +14,13 @@ namespace winrt::NativeMediaPlayer::implementation
 
         static winrt::Windows::Foundation::IAsyncOperation<hstring> GetPlaylistTracks(hstring playlistId);
         static hstring GetUriFromTrackId(hstring const& trackId);
+        static winrt::Windows::Foundation::IAsyncOperation<hstring> ConvertPlaylistToBinaryAsync(hstring playlistId);
+
+        static bool IsBinaryPlaylistId(hstring const& playlistId);
+        static std::shared_ptr<BinaryPlaylist> OpenBinaryPlaylist(hstring const& playlistId);
 
     private:
-        static winrt::Windows::Foundation::IAsyncOperation<hstring> FetchStringFromUri(winrt::Windows::Foundation::Uri uri);
+        static winrt::Windows::Foundation::Uri GetUriFromPlaylistId(hstring const& playlistId);
     };
 }
 namespace winrt::NativeMediaPlayer::factory_implementation
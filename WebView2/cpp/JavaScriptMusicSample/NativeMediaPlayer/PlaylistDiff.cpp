@@ -0,0 +1,140 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaylistDiff.h"
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Pairs up entries with equal Ids. If an Id occurs more than once, occurrences are paired up in order.
+    /// </summary>
+    template <typename Key, typename Id>
+    PlaylistDiff PlaylistDiff::Match(std::vector<Id> const& oldIds, std::vector<Id> const& newIds)
+    {
+        PlaylistDiff diff{};
+        diff.sources.assign(newIds.size(), std::nullopt);
+        diff.targets.assign(oldIds.size(), std::nullopt);
+        diff.stays.assign(oldIds.size(), false);
+
+        std::unordered_map<Key, std::vector<uint32_t>> oldPositions{};
+        for (uint32_t oldIndex = static_cast<uint32_t>(oldIds.size()); oldIndex-- > 0;)
+        {
+            oldPositions[oldIds[oldIndex]].push_back(oldIndex);
+        }
+        for (uint32_t newIndex = 0; newIndex < newIds.size(); newIndex++)
+        {
+            auto it{ oldPositions.find(newIds[newIndex]) };
+            if (it != oldPositions.end() && !it->second.empty())
+            {
+                uint32_t oldIndex{ it->second.back() };
+                it->second.pop_back();
+                diff.sources[newIndex] = oldIndex;
+                diff.targets[oldIndex] = newIndex;
+            }
+        }
+        return diff;
+    }
+
+    PlaylistDiff PlaylistDiff::Compute(std::vector<hstring> const& oldIds, std::vector<hstring> const& newIds, std::optional<uint32_t> pinnedOldIndex)
+    {
+        PlaylistDiff diff{ Match<std::wstring_view>(oldIds, newIds) };
+        diff.KeepLongestRun(pinnedOldIndex);
+        return diff;
+    }
+
+    PlaylistDiff PlaylistDiff::Compute(std::vector<uint32_t> const& oldIds, std::vector<uint32_t> const& newIds, std::optional<uint32_t> pinnedOldIndex)
+    {
+        PlaylistDiff diff{ Match<uint32_t>(oldIds, newIds) };
+        diff.KeepLongestRun(pinnedOldIndex);
+        return diff;
+    }
+
+    /// <summary>
+    /// Decides which matched entries stay in place and counts the operations the diff is made of.
+    /// </summary>
+    void PlaylistDiff::KeepLongestRun(std::optional<uint32_t> pinnedOldIndex)
+    {
+        // If the pinned entry survives, only entries on the same side of it in both lists can stay
+        // in place alongside it
+        std::optional<uint32_t> pinnedNewIndex{};
+        if (pinnedOldIndex && *pinnedOldIndex < targets.size())
+        {
+            pinnedNewIndex = targets[*pinnedOldIndex];
+        }
+        auto isCandidate = [&](uint32_t newIndex)
+        {
+            std::optional<uint32_t> const& source{ sources[newIndex] };
+            if (!source)
+            {
+                return false;
+            }
+            if (!pinnedNewIndex)
+            {
+                return true;
+            }
+            return (newIndex < *pinnedNewIndex && *source < *pinnedOldIndex) ||
+                (newIndex > *pinnedNewIndex && *source > *pinnedOldIndex) ||
+                newIndex == *pinnedNewIndex;
+        };
+
+        // Longest increasing subsequence of old positions, taken in new order (patience sorting).
+        // tails[k] is the new index ending the best run of length k + 1 found so far.
+        std::vector<uint32_t> tails{};
+        std::vector<std::optional<uint32_t>> previous(sources.size(), std::nullopt);
+        for (uint32_t newIndex = 0; newIndex < sources.size(); newIndex++)
+        {
+            if (!isCandidate(newIndex))
+            {
+                continue;
+            }
+            uint32_t source{ *sources[newIndex] };
+            auto it{ std::lower_bound(tails.begin(), tails.end(), source, [&](uint32_t tail, uint32_t value)
+            {
+                return *sources[tail] < value;
+            }) };
+            if (it != tails.begin())
+            {
+                previous[newIndex] = *(it - 1);
+            }
+            if (it == tails.end())
+            {
+                tails.push_back(newIndex);
+            }
+            else
+            {
+                *it = newIndex;
+            }
+        }
+        for (std::optional<uint32_t> newIndex{ tails.empty() ? std::nullopt : std::optional<uint32_t>{ tails.back() } }; newIndex; newIndex = previous[*newIndex])
+        {
+            stays[*sources[*newIndex]] = true;
+        }
+
+        for (uint32_t oldIndex = 0; oldIndex < targets.size(); oldIndex++)
+        {
+            if (!targets[oldIndex])
+            {
+                removals++;
+            }
+            else if (!stays[oldIndex])
+            {
+                moves++;
+            }
+        }
+        insertions = static_cast<uint32_t>(std::count(sources.begin(), sources.end(), std::nullopt));
+    }
+
+    std::optional<uint32_t> PlaylistDiff::NewIndexOf(uint32_t oldIndex) const
+    {
+        return oldIndex < targets.size() ? targets[oldIndex] : std::nullopt;
+    }
+
+    std::optional<uint32_t> PlaylistDiff::OldIndexOf(uint32_t newIndex) const
+    {
+        return newIndex < sources.size() ? sources[newIndex] : std::nullopt;
+    }
+}
@@ -0,0 +1,90 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <optional>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The edits needed to turn one list of track Ids into another.
+    ///
+    /// Entries are matched by Id. The longest run of matched entries that are already in the right
+    /// relative order stays where it is; every other matched entry is moved (removed and reinserted),
+    /// unmatched old entries are removed and unmatched new entries are inserted. This keeps the number
+    /// of operations applied to a MediaPlaybackList, and therefore the number of items it has to
+    /// reopen, as small as possible.
+    /// </summary>
+    class PlaylistDiff
+    {
+    public:
+        /// <summary>
+        /// Compares two lists of Ids. If pinnedOldIndex is given and that entry is still present in
+        /// newIds, it is guaranteed to stay in place, so that applying the diff to a MediaPlaybackList
+        /// never removes the item that is playing.
+        /// </summary>
+        static PlaylistDiff Compute(std::vector<hstring> const& oldIds, std::vector<hstring> const& newIds, std::optional<uint32_t> pinnedOldIndex = std::nullopt);
+        static PlaylistDiff Compute(std::vector<uint32_t> const& oldIds, std::vector<uint32_t> const& newIds, std::optional<uint32_t> pinnedOldIndex = std::nullopt);
+
+        /// <summary>
+        /// The position in the new list that an entry of the old list ends up at, if it survives.
+        /// </summary>
+        std::optional<uint32_t> NewIndexOf(uint32_t oldIndex) const;
+
+        /// <summary>
+        /// The position in the old list that an entry of the new list came from, or nullopt if it is new.
+        /// </summary>
+        std::optional<uint32_t> OldIndexOf(uint32_t newIndex) const;
+
+        uint32_t Insertions() const noexcept { return insertions; }
+        uint32_t Removals() const noexcept { return removals; }
+        uint32_t Moves() const noexcept { return moves; }
+
+        /// <summary>
+        /// Applies the diff to a vector that currently mirrors the old list. Moved entries are reused;
+        /// createItem(newIndex) is called for each inserted one.
+        /// </summary>
+        template <typename T, typename CreateItem>
+        void Apply(winrt::Windows::Foundation::Collections::IVector<T> const& vector, CreateItem&& createItem) const
+        {
+            // Take out everything that is not staying in place, back to front so indices stay valid
+            std::vector<T> detached(stays.size(), T{ nullptr });
+            for (uint32_t oldIndex = static_cast<uint32_t>(stays.size()); oldIndex-- > 0;)
+            {
+                if (!stays[oldIndex])
+                {
+                    if (targets[oldIndex])
+                    {
+                        detached[oldIndex] = vector.GetAt(oldIndex);
+                    }
+                    vector.RemoveAt(oldIndex);
+                }
+            }
+
+            // What is left is in the right order, so filling the gaps front to back puts every entry
+            // at its final index
+            for (uint32_t newIndex = 0; newIndex < sources.size(); newIndex++)
+            {
+                std::optional<uint32_t> const& source{ sources[newIndex] };
+                if (source && stays[*source])
+                {
+                    continue;
+                }
+                vector.InsertAt(newIndex, source ? detached[*source] : createItem(newIndex));
+            }
+        }
+
+    private:
+        template <typename Key, typename Id>
+        static PlaylistDiff Match(std::vector<Id> const& oldIds, std::vector<Id> const& newIds);
+        void KeepLongestRun(std::optional<uint32_t> pinnedOldIndex);
+
+        std::vector<std::optional<uint32_t>> sources{};     // indexed by new position
+        std::vector<std::optional<uint32_t>> targets{};     // indexed by old position
+        std::vector<bool> stays{};                          // indexed by old position
+        uint32_t insertions{ 0 };
+        uint32_t removals{ 0 };
+        uint32_t moves{ 0 };
+    };
+}
@@ -0,0 +1,350 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaylistParser.h"
+#include <sstream>
+
+namespace
+{
+    // Unknown values nested deeper than this are rejected rather than risk exhausting the stack
+    constexpr uint32_t MaxNestingDepth{ 64 };
+
+    bool IsWhitespace(wchar_t c) noexcept
+    {
+        return c == L' ' || c == L'\t' || c == L'\n' || c == L'\r';
+    }
+
+    int HexValue(wchar_t c) noexcept
+    {
+        if (c >= L'0' && c <= L'9') return c - L'0';
+        if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+        if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+        return -1;
+    }
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    hstring PlaylistParser::Parse(std::wstring_view json, std::function<void(PlaylistTrackRecord&&)> const& onTrack)
+    {
+        // Tolerate a byte order mark left over from decoding the file
+        if (json.starts_with(L'\xFEFF'))
+        {
+            json.remove_prefix(1);
+        }
+
+        PlaylistParser parser{ json };
+        return parser.ParseRoot(onTrack);
+    }
+
+    /// <summary>
+    /// { "Tracks": [ ... ], "Next": "...", ... }
+    /// </summary>
+    hstring PlaylistParser::ParseRoot(std::function<void(PlaylistTrackRecord&&)> const& onTrack)
+    {
+        hstring next{};
+        bool sawTracks{ false };
+
+        Expect(L'{');
+        if (Peek() != L'}')
+        {
+            do
+            {
+                std::wstring_view key{ ParseString() };
+                bool isTracks{ key == L"Tracks" };
+                bool isNext{ key == L"Next" };
+                Expect(L':');
+                if (isTracks)
+                {
+                    sawTracks = true;
+                    ParseTracks(onTrack);
+                }
+                else if (isNext && Peek() == L'"')
+                {
+                    next = ParseString();
+                }
+                else
+                {
+                    SkipValue();
+                }
+            } while (ConsumeIf(L','));
+        }
+        Expect(L'}');
+
+        SkipWhitespace();
+        if (position != json.size())
+        {
+            Fail(L"unexpected data after the end of the document");
+        }
+
+        // An error page or some other object is not an empty playlist
+        if (!sawTracks)
+        {
+            Fail(L"missing Tracks");
+        }
+        return next;
+    }
+
+    void PlaylistParser::ParseTracks(std::function<void(PlaylistTrackRecord&&)> const& onTrack)
+    {
+        Expect(L'[');
+        if (Peek() != L']')
+        {
+            do
+            {
+                onTrack(ParseTrack());
+            } while (ConsumeIf(L','));
+        }
+        Expect(L']');
+    }
+
+    /// <summary>
+    /// { "Title": "...", "Artist": "...", "Id": "...", "Image": "..." }
+    /// Missing fields are left empty, the same as GetNamedString(name, L"") would return.
+    /// </summary>
+    PlaylistTrackRecord PlaylistParser::ParseTrack()
+    {
+        PlaylistTrackRecord track{};
+
+        Expect(L'{');
+        if (Peek() != L'}')
+        {
+            do
+            {
+                // The key has to be matched before the value is parsed, because both may be
+                // backed by the same unescape buffer
+                std::wstring_view keyView{ ParseString() };
+                hstring* field{ nullptr };
+                if (keyView == L"Id") field = &track.id;
+                else if (keyView == L"Title") field = &track.title;
+                else if (keyView == L"Artist") field = &track.artist;
+                else if (keyView == L"Image") field = &track.image;
+
+                Expect(L':');
+                if (field && Peek() == L'"')
+                {
+                    *field = ParseString();
+                }
+                else
+                {
+                    SkipValue();
+                }
+            } while (ConsumeIf(L','));
+        }
+        Expect(L'}');
+
+        return track;
+    }
+
+    /// <summary>
+    /// Reads a string literal. The returned view points into the source text when the literal has no
+    /// escape sequences, and into the unescape buffer otherwise; either way it is only valid until the
+    /// next call.
+    /// </summary>
+    std::wstring_view PlaylistParser::ParseString()
+    {
+        Expect(L'"');
+
+        size_t start{ position };
+        while (position < json.size() && json[position] != L'"' && json[position] != L'\\')
+        {
+            position++;
+        }
+        if (position >= json.size())
+        {
+            Fail(L"unterminated string");
+        }
+        if (json[position] == L'"')
+        {
+            return json.substr(start, position++ - start);
+        }
+
+        // Slow path: the string contains escape sequences
+        unescaped.assign(json.substr(start, position - start));
+        while (position < json.size())
+        {
+            wchar_t c{ json[position++] };
+            if (c == L'"')
+            {
+                return unescaped;
+            }
+            if (c != L'\\')
+            {
+                unescaped.push_back(c);
+                continue;
+            }
+            if (position >= json.size())
+            {
+                break;
+            }
+
+            switch (wchar_t escaped{ json[position++] })
+            {
+            case L'"':
+            case L'\\':
+            case L'/':
+                unescaped.push_back(escaped);
+                break;
+            case L'b': unescaped.push_back(L'\b'); break;
+            case L'f': unescaped.push_back(L'\f'); break;
+            case L'n': unescaped.push_back(L'\n'); break;
+            case L'r': unescaped.push_back(L'\r'); break;
+            case L't': unescaped.push_back(L'\t'); break;
+            case L'u':
+            {
+                // Surrogate pairs arrive as two consecutive \u escapes, which is exactly how they
+                // need to be laid out in UTF-16, so no special handling is needed.
+                if (position + 4 > json.size())
+                {
+                    Fail(L"truncated \\u escape");
+                }
+                int value{ 0 };
+                for (size_t i = 0; i < 4; i++)
+                {
+                    int digit{ HexValue(json[position++]) };
+                    if (digit < 0)
+                    {
+                        Fail(L"invalid \\u escape");
+                    }
+                    value = (value << 4) | digit;
+                }
+                unescaped.push_back(static_cast<wchar_t>(value));
+                break;
+            }
+            default:
+                Fail(L"invalid escape sequence");
+            }
+        }
+
+        Fail(L"unterminated string");
+    }
+
+    void PlaylistParser::SkipValue(uint32_t depth)
+    {
+        if (depth > MaxNestingDepth)
+        {
+            Fail(L"nesting too deep");
+        }
+
+        switch (Peek())
+        {
+        case L'"':
+            ParseString();
+            break;
+        case L'{':
+            position++;
+            if (Peek() != L'}')
+            {
+                do
+                {
+                    ParseString();
+                    Expect(L':');
+                    SkipValue(depth + 1);
+                } while (ConsumeIf(L','));
+            }
+            Expect(L'}');
+            break;
+        case L'[':
+            position++;
+            if (Peek() != L']')
+            {
+                do
+                {
+                    SkipValue(depth + 1);
+                } while (ConsumeIf(L','));
+            }
+            Expect(L']');
+            break;
+        case L't':
+            SkipLiteral(L"true");
+            break;
+        case L'f':
+            SkipLiteral(L"false");
+            break;
+        case L'n':
+            SkipLiteral(L"null");
+            break;
+        default:
+            SkipNumber();
+            break;
+        }
+    }
+
+    void PlaylistParser::SkipLiteral(std::wstring_view literal)
+    {
+        if (json.substr(position, literal.size()) != literal)
+        {
+            Fail(L"invalid literal");
+        }
+        position += literal.size();
+    }
+
+    void PlaylistParser::SkipNumber()
+    {
+        size_t start{ position };
+        while (position < json.size())
+        {
+            wchar_t c{ json[position] };
+            if ((c >= L'0' && c <= L'9') || c == L'-' || c == L'+' || c == L'.' || c == L'e' || c == L'E')
+            {
+                position++;
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (position == start)
+        {
+            Fail(L"unexpected character");
+        }
+    }
+
+    void PlaylistParser::SkipWhitespace() noexcept
+    {
+        while (position < json.size() && IsWhitespace(json[position]))
+        {
+            position++;
+        }
+    }
+
+    /// <summary>
+    /// Skips whitespace and returns the next character without consuming it.
+    /// </summary>
+    wchar_t PlaylistParser::Peek()
+    {
+        SkipWhitespace();
+        if (position >= json.size())
+        {
+            Fail(L"unexpected end of document");
+        }
+        return json[position];
+    }
+
+    bool PlaylistParser::ConsumeIf(wchar_t c)
+    {
+        if (Peek() != c)
+        {
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    void PlaylistParser::Expect(wchar_t c)
+    {
+        if (Peek() != c)
+        {
+            Fail(L"unexpected character");
+        }
+        position++;
+    }
+
+    void PlaylistParser::Fail(wchar_t const* reason) const
+    {
+        std::wostringstream strStream{};
+        strStream << L"Invalid playlist JSON at offset " << position << L": " << reason;
+        throw hresult_error(WEB_E_INVALID_JSON_STRING, strStream.str().c_str());
+    }
+}
@@ -0,0 +1,69 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The fields of a single entry in a playlist's "Tracks" array.
+    /// </summary>
+    struct PlaylistTrackRecord
+    {
+        hstring id{};
+        hstring title{};
+        hstring artist{};
+        hstring image{};
+
+        // The fully-qualified URI of the audio file, if it is already known. When empty, it is
+        // resolved from the id with PlaylistDataFetcher::GetUriFromTrackId.
+        hstring src{};
+    };
+
+    /// <summary>
+    /// A forward-only parser for playlist JSON (see the playlistdata folder in the main project).
+    ///
+    /// Rather than building a JsonObject for the whole document and then looking fields up by name,
+    /// this walks the text once and hands each track to the caller as soon as its closing brace is
+    /// read. Nothing but the current track is held in memory, and strings without escape sequences
+    /// are copied straight out of the source text. Unknown fields are skipped.
+    /// </summary>
+    class PlaylistParser
+    {
+    public:
+        /// <summary>
+        /// Parses a playlist, calling onTrack once per track in document order.
+        /// Returns the playlist's "Next" field, the id of the page that continues it, or an empty
+        /// string if this is the last (or only) page.
+        /// Throws hresult_error(WEB_E_INVALID_JSON_STRING) if the text is not valid JSON, to match
+        /// the behavior of JsonObject::Parse.
+        /// </summary>
+        static hstring Parse(std::wstring_view json, std::function<void(PlaylistTrackRecord&&)> const& onTrack);
+
+    private:
+        explicit PlaylistParser(std::wstring_view json) noexcept : json{ json } {}
+
+        hstring ParseRoot(std::function<void(PlaylistTrackRecord&&)> const& onTrack);
+        void ParseTracks(std::function<void(PlaylistTrackRecord&&)> const& onTrack);
+        PlaylistTrackRecord ParseTrack();
+        std::wstring_view ParseString();
+        void SkipValue(uint32_t depth = 0);
+        void SkipLiteral(std::wstring_view literal);
+        void SkipNumber();
+        void SkipWhitespace() noexcept;
+        wchar_t Peek();
+        bool ConsumeIf(wchar_t c);
+        void Expect(wchar_t c);
+        [[noreturn]] void Fail(wchar_t const* reason) const;
+
+        std::wstring_view json;
+        size_t position{ 0 };
+
+        // Reused for strings that contain escape sequences and therefore cannot be returned
+        // as a view into the source text
+        std::wstring unescaped{};
+    };
+}
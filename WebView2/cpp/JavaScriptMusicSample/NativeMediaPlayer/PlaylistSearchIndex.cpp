@@ -0,0 +1,414 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaylistSearchIndex.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+    // What a character folds to when it is not kept as a letter or digit
+    constexpr wchar_t Separator{ L' ' };
+    constexpr wchar_t Dropped{ L'\0' };
+
+    // Scores for a term matching a word exactly, the start of a word, or the middle of one. Title
+    // matches count double, and a title that starts with the whole query gets a bonus on top.
+    constexpr uint32_t WordScore{ 4 };
+    constexpr uint32_t PrefixScore{ 3 };
+    constexpr uint32_t SubstringScore{ 1 };
+    constexpr uint32_t TitleWeight{ 2 };
+    constexpr uint32_t TitleStartBonus{ 4 };
+
+    WORD GetCharType(DWORD infoType, wchar_t c)
+    {
+        WORD type{ 0 };
+        GetStringTypeW(infoType, &c, 1, &type);
+        return type;
+    }
+
+    bool IsNonSpacingMark(wchar_t c)
+    {
+        return (GetCharType(CT_CTYPE3, c) & C3_NONSPACING) != 0;
+    }
+
+    wchar_t FoldCharacter(wchar_t c)
+    {
+        if (IsNonSpacingMark(c))
+        {
+            return Dropped;
+        }
+
+        // A letter with accents decomposes into the letter followed by the accents as combining
+        // marks. Anything that decomposes into more than that, such as a Hangul syllable or a
+        // ligature, is kept whole.
+        wchar_t base{ c };
+        wchar_t decomposed[8]{};
+        int length{ NormalizeString(NormalizationKD, &c, 1, decomposed, ARRAYSIZE(decomposed)) };
+        if (length == 1 || (length > 1 && std::all_of(decomposed + 1, decomposed + length, IsNonSpacingMark)))
+        {
+            base = decomposed[0];
+        }
+
+        if ((GetCharType(CT_CTYPE1, base) & (C1_ALPHA | C1_DIGIT)) == 0)
+        {
+            return Separator;
+        }
+
+        wchar_t lower{ base };
+        LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_LOWERCASE, &base, 1, &lower, 1, nullptr, nullptr, 0);
+        return lower;
+    }
+
+    /// <summary>
+    /// What each UTF-16 code unit folds to, so that folding a string is a table lookup per
+    /// character rather than several calls into the system. The table is filled in blocks of 256
+    /// as characters from them first turn up, since a playlist rarely uses more than a few blocks.
+    /// </summary>
+    class FoldTable
+    {
+    public:
+        static constexpr uint32_t BlockSize{ 256 };
+
+        static FoldTable& Instance()
+        {
+            static FoldTable instance{};
+            return instance;
+        }
+
+        wchar_t operator[](wchar_t c)
+        {
+            uint32_t code{ static_cast<uint16_t>(c) };
+            std::call_once(blocksFilled[code / BlockSize], [this, code]()
+            {
+                uint32_t first{ code - code % BlockSize };
+                for (uint32_t i = first; i < first + BlockSize; i++)
+                {
+                    table[i] = FoldCharacter(static_cast<wchar_t>(i));
+                }
+            });
+            return table[code];
+        }
+
+    private:
+        std::array<wchar_t, 0x10000> table{};
+        std::array<std::once_flag, 0x10000 / BlockSize> blocksFilled{};
+    };
+
+    /// <summary>
+    /// Calls onWord with each run of characters in folded text that are not separators.
+    /// </summary>
+    template <typename OnWord>
+    void ForEachWord(std::wstring_view folded, OnWord&& onWord)
+    {
+        size_t start{ 0 };
+        while (start < folded.size())
+        {
+            start = folded.find_first_not_of(Separator, start);
+            if (start == std::wstring_view::npos)
+            {
+                break;
+            }
+            size_t end{ std::min(folded.find(Separator, start), folded.size()) };
+            onWord(folded.substr(start, end - start));
+            start = end;
+        }
+    }
+
+    bool StartsWith(std::wstring_view text, std::wstring_view prefix) noexcept
+    {
+        return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    void PlaylistSearchIndex::Clear()
+    {
+        words.clear();
+        wordIds.clear();
+        sortedWords.clear();
+        trigramPostings.clear();
+        foldedTitles.clear();
+        titleOffsets.clear();
+    }
+
+    void PlaylistSearchIndex::AddTrack(std::wstring_view title, std::wstring_view artist)
+    {
+        uint32_t track{ TrackCount() };
+        std::wstring foldedTitle{ Fold(title) };
+        std::wstring foldedArtist{ Fold(artist) };
+
+        titleOffsets.push_back(static_cast<uint32_t>(foldedTitles.size()));
+        foldedTitles.append(foldedTitle);
+
+        AddWords(foldedTitle, track, false);
+        AddWords(foldedArtist, track, true);
+    }
+
+    std::vector<PlaylistSearchIndex::Result> PlaylistSearchIndex::Search(std::wstring_view query, uint32_t maxResults)
+    {
+        auto started{ std::chrono::steady_clock::now() };
+        SortNewWords();
+
+        uint32_t trackCount{ TrackCount() };
+        if (termStamps.size() < trackCount)
+        {
+            termStamps.resize(trackCount, 0);
+            termScores.resize(trackCount, 0);
+            totalScores.resize(trackCount, 0);
+        }
+
+        // Tracks that have matched every term so far
+        std::vector<uint32_t> candidates{};
+        std::wstring folded{ Fold(query) };
+        bool firstTerm{ true };
+        ForEachWord(folded, [&](std::wstring_view term)
+        {
+            if (!firstTerm && candidates.empty())
+            {
+                return;
+            }
+
+            if (++currentStamp == 0)
+            {
+                std::fill(termStamps.begin(), termStamps.end(), 0);
+                currentStamp = 1;
+            }
+            termMatches.clear();
+            MatchPrefix(term);
+            if (term.size() >= 3)
+            {
+                MatchSubstring(term);
+            }
+
+            if (firstTerm)
+            {
+                candidates = termMatches;
+                for (uint32_t track : candidates)
+                {
+                    totalScores[track] = termScores[track];
+                }
+                firstTerm = false;
+                return;
+            }
+
+            auto kept{ std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t track) { return termStamps[track] != currentStamp; }) };
+            candidates.erase(kept, candidates.end());
+            for (uint32_t track : candidates)
+            {
+                totalScores[track] += termScores[track];
+            }
+        });
+
+        // Typing the start of a title is the most common search of all
+        size_t queryStart{ folded.find_first_not_of(Separator) };
+        if (queryStart != std::wstring::npos)
+        {
+            std::wstring_view trimmed{ std::wstring_view{ folded }.substr(queryStart) };
+            trimmed = trimmed.substr(0, trimmed.find_last_not_of(Separator) + 1);
+            for (uint32_t track : candidates)
+            {
+                if (StartsWith(TitleOf(track), trimmed))
+                {
+                    totalScores[track] += TitleStartBonus;
+                }
+            }
+        }
+
+        auto ranksAbove = [&](uint32_t a, uint32_t b)
+        {
+            return totalScores[a] != totalScores[b] ? totalScores[a] > totalScores[b] : a < b;
+        };
+        size_t resultCount{ std::min<size_t>(maxResults, candidates.size()) };
+        std::partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end(), ranksAbove);
+
+        std::vector<Result> results{};
+        results.reserve(resultCount);
+        for (size_t i = 0; i < resultCount; i++)
+        {
+            results.push_back(Result{ candidates[i], totalScores[candidates[i]] });
+        }
+
+        uint64_t elapsed{ static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count()) };
+        stats.totalSearchMicroseconds += elapsed;
+        uint64_t maxElapsed{ stats.maxSearchMicroseconds };
+        while (elapsed > maxElapsed && !stats.maxSearchMicroseconds.compare_exchange_weak(maxElapsed, elapsed))
+        {
+        }
+        if (++stats.searches % StatisticsInterval == 0)
+        {
+            LogStatistics();
+        }
+        return results;
+    }
+
+    std::wstring PlaylistSearchIndex::Fold(std::wstring_view text)
+    {
+        FoldTable& table{ FoldTable::Instance() };
+        std::wstring folded{};
+        folded.reserve(text.size());
+        for (wchar_t c : text)
+        {
+            wchar_t f{ table[c] };
+            if (f != Dropped)
+            {
+                folded.push_back(f);
+            }
+        }
+        return folded;
+    }
+
+    void PlaylistSearchIndex::LogStatistics() const
+    {
+        uint64_t searches{ stats.searches };
+
+        std::wostringstream strStream{};
+        strStream << L"[PlaylistSearchIndex: "
+            << L"Tracks=" << TrackCount() << L", "
+            << L"Words=" << words.size() << L", "
+            << L"Trigrams=" << trigramPostings.size() << L", "
+            << L"Searches=" << searches << L", "
+            << L"AverageSearchUs=" << (searches > 0 ? stats.totalSearchMicroseconds / searches : 0) << L", "
+            << L"MaxSearchUs=" << stats.maxSearchMicroseconds
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    void PlaylistSearchIndex::AddWords(std::wstring_view folded, uint32_t track, bool isArtist)
+    {
+        uint32_t posting{ (track << 1) | (isArtist ? 1u : 0u) };
+        ForEachWord(folded, [&](std::wstring_view text)
+        {
+            auto [it, added] { wordIds.try_emplace(std::wstring{ text }, static_cast<uint32_t>(words.size())) };
+            uint32_t wordId{ it->second };
+            if (added)
+            {
+                words.push_back(Word{ it->first, {} });
+                for (size_t i = 0; i + 3 <= text.size(); i++)
+                {
+                    std::vector<uint32_t>& wordsWithTrigram{ trigramPostings[Trigram(text.data() + i)] };
+                    if (wordsWithTrigram.empty() || wordsWithTrigram.back() != wordId)
+                    {
+                        wordsWithTrigram.push_back(wordId);
+                    }
+                }
+            }
+
+            std::vector<uint32_t>& postings{ words[wordId].postings };
+            if (postings.empty() || postings.back() != posting)
+            {
+                postings.push_back(posting);
+            }
+        });
+    }
+
+    /// <summary>
+    /// Merges words added since the last search into the sorted list.
+    /// </summary>
+    void PlaylistSearchIndex::SortNewWords()
+    {
+        size_t sortedCount{ sortedWords.size() };
+        if (sortedCount == words.size())
+        {
+            return;
+        }
+
+        auto byText = [this](uint32_t a, uint32_t b) { return words[a].text < words[b].text; };
+        for (size_t id = sortedCount; id < words.size(); id++)
+        {
+            sortedWords.push_back(static_cast<uint32_t>(id));
+        }
+        std::sort(sortedWords.begin() + sortedCount, sortedWords.end(), byText);
+        std::inplace_merge(sortedWords.begin(), sortedWords.begin() + sortedCount, sortedWords.end(), byText);
+    }
+
+    std::wstring_view PlaylistSearchIndex::TitleOf(uint32_t track) const noexcept
+    {
+        uint32_t end{ track + 1 < titleOffsets.size() ? titleOffsets[track + 1] : static_cast<uint32_t>(foldedTitles.size()) };
+        return std::wstring_view{ foldedTitles }.substr(titleOffsets[track], end - titleOffsets[track]);
+    }
+
+    /// <summary>
+    /// Scores every track with a word that is term or starts with it. Those words are adjacent in
+    /// the sorted list, so they are found with a binary search and a scan.
+    /// </summary>
+    void PlaylistSearchIndex::MatchPrefix(std::wstring_view term)
+    {
+        auto first{ std::lower_bound(sortedWords.begin(), sortedWords.end(), term, [this](uint32_t id, std::wstring_view value) { return words[id].text < value; }) };
+        for (auto it{ first }; it != sortedWords.end() && StartsWith(words[*it].text, term); it++)
+        {
+            Word const& word{ words[*it] };
+            uint32_t score{ word.text.size() == term.size() ? WordScore : PrefixScore };
+            for (uint32_t posting : word.postings)
+            {
+                RecordTermMatch(posting >> 1, (posting & 1) ? score : score * TitleWeight);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Scores every track with a word that contains term part way through. Only words that have
+    /// every three-character sequence of term can contain it, so the shortest of those lists is
+    /// checked against the others, and what survives is confirmed against the word itself.
+    /// </summary>
+    void PlaylistSearchIndex::MatchSubstring(std::wstring_view term)
+    {
+        std::vector<std::vector<uint32_t> const*> lists{};
+        for (size_t i = 0; i + 3 <= term.size(); i++)
+        {
+            auto it{ trigramPostings.find(Trigram(term.data() + i)) };
+            if (it == trigramPostings.end())
+            {
+                return;
+            }
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+        for (uint32_t wordId : *lists.front())
+        {
+            bool inAll{ std::all_of(lists.begin() + 1, lists.end(), [wordId](auto list) { return std::binary_search(list->begin(), list->end(), wordId); }) };
+            Word const& word{ words[wordId] };
+
+            // Words that start with term were scored higher by MatchPrefix
+            if (!inAll || word.text.find(term, 1) == std::wstring::npos)
+            {
+                continue;
+            }
+
+            for (uint32_t posting : word.postings)
+            {
+                RecordTermMatch(posting >> 1, (posting & 1) ? SubstringScore : SubstringScore * TitleWeight);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Notes that track matches the current term with score, keeping the best score if it matches
+    /// more than one way.
+    /// </summary>
+    void PlaylistSearchIndex::RecordTermMatch(uint32_t track, uint32_t score)
+    {
+        if (termStamps[track] != currentStamp)
+        {
+            termStamps[track] = currentStamp;
+            termScores[track] = score;
+            termMatches.push_back(track);
+        }
+        else if (score > termScores[track])
+        {
+            termScores[track] = score;
+        }
+    }
+
+    uint64_t PlaylistSearchIndex::Trigram(wchar_t const* text) noexcept
+    {
+        return (static_cast<uint64_t>(static_cast<uint16_t>(text[0])) << 32) |
+            (static_cast<uint64_t>(static_cast<uint16_t>(text[1])) << 16) |
+            static_cast<uint64_t>(static_cast<uint16_t>(text[2]));
+    }
+}
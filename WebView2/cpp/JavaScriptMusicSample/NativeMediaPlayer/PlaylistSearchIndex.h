@@ -0,0 +1,108 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Finds tracks of the current playlist by title and artist, fast enough to search again on
+    /// every keystroke.
+    ///
+    /// Text is folded before it is indexed or searched for: accents are dropped, case is ignored,
+    /// and anything other than letters and digits separates words. Each word maps to the tracks it
+    /// appears in, and the words are kept sorted, so every word that starts with a search term is a
+    /// single range of them. For terms of three or more characters, every three-character sequence
+    /// also maps to the words it appears in, which finds terms in the middle of words.
+    ///
+    /// Tracks are identified by their index in the playlist and are added in order, as they load.
+    /// </summary>
+    class PlaylistSearchIndex
+    {
+    public:
+        struct Result
+        {
+            uint32_t track{ 0 };
+            uint32_t score{ 0 };
+        };
+
+        /// <summary>
+        /// Counters for checking that searches stay well within a frame.
+        /// </summary>
+        struct Statistics
+        {
+            std::atomic<uint64_t> searches{ 0 };
+            std::atomic<uint64_t> totalSearchMicroseconds{ 0 };
+            std::atomic<uint64_t> maxSearchMicroseconds{ 0 };
+        };
+
+        void Clear();
+
+        /// <summary>
+        /// Indexes the next track of the playlist, whose index is TrackCount() before the call.
+        /// </summary>
+        void AddTrack(std::wstring_view title, std::wstring_view artist);
+        uint32_t TrackCount() const noexcept { return static_cast<uint32_t>(titleOffsets.size()); }
+
+        /// <summary>
+        /// Returns up to maxResults tracks that match every term of query, best match first. A term
+        /// matches a track if a word of its title or artist is the term, starts with it, or, for
+        /// terms of three or more characters, contains it; in that order of preference, with title
+        /// matches ranked above artist matches. Ties go to the track that comes first.
+        /// </summary>
+        std::vector<Result> Search(std::wstring_view query, uint32_t maxResults);
+
+        /// <summary>
+        /// Folds text the way the index does: lowercased, without accents, with every character that
+        /// is not a letter or digit turned into a space.
+        /// </summary>
+        static std::wstring Fold(std::wstring_view text);
+
+        Statistics const& Stats() const noexcept { return stats; }
+        void LogStatistics() const;
+
+    private:
+        struct Word
+        {
+            std::wstring text{};
+
+            // Track index shifted left by one, with the low bit set for an artist match
+            std::vector<uint32_t> postings{};
+        };
+
+        void AddWords(std::wstring_view folded, uint32_t track, bool isArtist);
+        void SortNewWords();
+        std::wstring_view TitleOf(uint32_t track) const noexcept;
+        void MatchPrefix(std::wstring_view term);
+        void MatchSubstring(std::wstring_view term);
+        void RecordTermMatch(uint32_t track, uint32_t score);
+        static uint64_t Trigram(wchar_t const* text) noexcept;
+
+        std::vector<Word> words{};
+        std::unordered_map<std::wstring, uint32_t> wordIds{};
+        std::vector<uint32_t> sortedWords{};
+        std::unordered_map<uint64_t, std::vector<uint32_t>> trigramPostings{};
+
+        // The folded title of every track, back to back, for ranking titles that start with the query
+        std::wstring foldedTitles{};
+        std::vector<uint32_t> titleOffsets{};
+
+        // Per track scratch space for Search, so that nothing has to be cleared between terms.
+        // A track's term score only counts if its stamp is the current term's.
+        std::vector<uint32_t> termStamps{};
+        std::vector<uint32_t> termScores{};
+        std::vector<uint32_t> termMatches{};
+        std::vector<uint32_t> totalScores{};
+        uint32_t currentStamp{ 0 };
+
+        Statistics stats{};
+
+        // How many searches go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 100 };
+    };
+}
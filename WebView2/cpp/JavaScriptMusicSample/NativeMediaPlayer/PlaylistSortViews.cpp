@@ -0,0 +1,159 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "PlaylistSortViews.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+    // How titles and artists collate: in the user's locale, ignoring case, with "Track 10" after "Track 9"
+    constexpr DWORD SortKeyFlags{ LCMAP_SORTKEY | LINGUISTIC_IGNORECASE | SORT_DIGITSASNUMBERS };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    void PlaylistSortViews::Clear()
+    {
+        keyIds.clear();
+        keyBytes.clear();
+        keyOffsets.assign(1, 0);
+        titleKeys.clear();
+        artistKeys.clear();
+        keyRanks.clear();
+        byTitle.clear();
+        byArtist.clear();
+    }
+
+    void PlaylistSortViews::AddTrack(std::wstring_view title, std::wstring_view artist)
+    {
+        titleKeys.push_back(KeyOf(title));
+        artistKeys.push_back(KeyOf(artist));
+
+        // The views no longer cover every track
+        keyRanks.clear();
+        byTitle.clear();
+        byArtist.clear();
+    }
+
+    uint32_t PlaylistSortViews::TrackAt(PlaylistSortOrder order, uint32_t position)
+    {
+        if (order == PlaylistSortOrder::Original)
+        {
+            return position;
+        }
+        return View(order)[position];
+    }
+
+    void PlaylistSortViews::LogStatistics() const
+    {
+        std::wostringstream strStream{};
+        strStream << L"[PlaylistSortViews: "
+            << L"Tracks=" << TrackCount() << L", "
+            << L"Keys=" << keyIds.size() << L", "
+            << L"KeyBytes=" << keyBytes.size() << L", "
+            << L"Builds=" << builds << L", "
+            << L"LastBuildUs=" << lastBuildMicroseconds
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// The id of text's sort key, computing it the first time text turns up.
+    /// </summary>
+    uint32_t PlaylistSortViews::KeyOf(std::wstring_view text)
+    {
+        auto [it, added] { keyIds.try_emplace(std::wstring{ text }, static_cast<uint32_t>(keyOffsets.size() - 1)) };
+        if (!added)
+        {
+            return it->second;
+        }
+
+        // LCMapStringEx rejects an empty string, whose key is empty anyway. The key is written as
+        // bytes; its length includes a terminating zero, which is left off.
+        if (!text.empty())
+        {
+            int length{ LCMapStringEx(LOCALE_NAME_USER_DEFAULT, SortKeyFlags, text.data(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr, 0) };
+            if (length > 1)
+            {
+                size_t start{ keyBytes.size() };
+                keyBytes.resize(start + length);
+                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, SortKeyFlags, text.data(), static_cast<int>(text.size()),
+                    reinterpret_cast<LPWSTR>(keyBytes.data() + start), length, nullptr, nullptr, 0);
+                keyBytes.pop_back();
+            }
+        }
+        keyOffsets.push_back(static_cast<uint32_t>(keyBytes.size()));
+        return it->second;
+    }
+
+    /// <summary>
+    /// Sorts the distinct keys once, so that tracks can be sorted by comparing integers rather than
+    /// keys. Keys that compare equal get the same rank.
+    /// </summary>
+    void PlaylistSortViews::RankKeys()
+    {
+        uint32_t keyCount{ static_cast<uint32_t>(keyOffsets.size() - 1) };
+        auto keyBegin = [&](uint32_t key) { return keyBytes.begin() + keyOffsets[key]; };
+        auto keyEnd = [&](uint32_t key) { return keyBytes.begin() + keyOffsets[key + 1]; };
+        auto keyLess = [&](uint32_t a, uint32_t b)
+        {
+            return std::lexicographical_compare(keyBegin(a), keyEnd(a), keyBegin(b), keyEnd(b));
+        };
+
+        std::vector<uint32_t> sortedKeys(keyCount);
+        std::iota(sortedKeys.begin(), sortedKeys.end(), 0);
+        std::sort(sortedKeys.begin(), sortedKeys.end(), keyLess);
+
+        keyRanks.assign(keyCount, 0);
+        uint32_t rank{ 0 };
+        for (uint32_t i = 0; i < keyCount; i++)
+        {
+            if (i > 0 && keyLess(sortedKeys[i - 1], sortedKeys[i]))
+            {
+                rank++;
+            }
+            keyRanks[sortedKeys[i]] = rank;
+        }
+    }
+
+    std::vector<uint32_t> const& PlaylistSortViews::View(PlaylistSortOrder order)
+    {
+        bool byTitleOrder{ order == PlaylistSortOrder::Title };
+        std::vector<uint32_t>& view{ byTitleOrder ? byTitle : byArtist };
+        if (view.size() == TrackCount())
+        {
+            return view;
+        }
+
+        auto started{ std::chrono::steady_clock::now() };
+        if (keyRanks.empty())
+        {
+            RankKeys();
+        }
+
+        std::vector<uint32_t> const& primary{ byTitleOrder ? titleKeys : artistKeys };
+        std::vector<uint32_t> const& secondary{ byTitleOrder ? artistKeys : titleKeys };
+        view.resize(TrackCount());
+        std::iota(view.begin(), view.end(), 0);
+        std::sort(view.begin(), view.end(), [&](uint32_t a, uint32_t b)
+        {
+            uint32_t primaryA{ keyRanks[primary[a]] };
+            uint32_t primaryB{ keyRanks[primary[b]] };
+            if (primaryA != primaryB)
+            {
+                return primaryA < primaryB;
+            }
+            uint32_t secondaryA{ keyRanks[secondary[a]] };
+            uint32_t secondaryB{ keyRanks[secondary[b]] };
+            return secondaryA != secondaryB ? secondaryA < secondaryB : a < b;
+        });
+
+        builds++;
+        lastBuildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+        return view;
+    }
+}
@@ -0,0 +1,69 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "winrt/NativeMediaPlayer.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The tracks of the current playlist in each PlaylistSortOrder, for showing the playlist sorted
+    /// without changing the order it plays in.
+    ///
+    /// As tracks are added, their titles and artists are mapped to collation keys, each distinct
+    /// string once, so an artist shared by many tracks is only keyed a single time. The first time a
+    /// sorted order is asked for, the keys are ranked and the tracks sorted by rank into a permutation,
+    /// which is kept until a track is added or the views are cleared. After that, reading a track in
+    /// any order, or switching between orders, is an array lookup. Adding a track throws the sorted
+    /// orders away, so a caller that adds tracks in batches should not ask for one between batches:
+    /// each would cost a full sort.
+    ///
+    /// Tracks are identified by their index in the playlist and are added in order, as they load.
+    /// </summary>
+    class PlaylistSortViews
+    {
+    public:
+        void Clear();
+
+        /// <summary>
+        /// Adds the next track of the playlist, whose index is TrackCount() before the call.
+        /// </summary>
+        void AddTrack(std::wstring_view title, std::wstring_view artist);
+        uint32_t TrackCount() const noexcept { return static_cast<uint32_t>(titleKeys.size()); }
+
+        /// <summary>
+        /// The index of the track at position in order. Titles sort by title and then artist, artists
+        /// by artist and then title, both ignoring case and with digits compared as numbers. Tracks
+        /// that tie keep their playlist order.
+        /// </summary>
+        uint32_t TrackAt(winrt::NativeMediaPlayer::PlaylistSortOrder order, uint32_t position);
+
+        void LogStatistics() const;
+
+    private:
+        uint32_t KeyOf(std::wstring_view text);
+        void RankKeys();
+        std::vector<uint32_t> const& View(winrt::NativeMediaPlayer::PlaylistSortOrder order);
+
+        // Key n is keyBytes[keyOffsets[n], keyOffsets[n + 1]), a sort key that compares bytewise
+        std::unordered_map<std::wstring, uint32_t> keyIds{};
+        std::vector<uint8_t> keyBytes{};
+        std::vector<uint32_t> keyOffsets{ 0 };
+
+        // The key of every track's title and artist, and once ranked, where each key sorts
+        std::vector<uint32_t> titleKeys{};
+        std::vector<uint32_t> artistKeys{};
+        std::vector<uint32_t> keyRanks{};
+
+        // Permutations of track indices, built on first use; empty until then
+        std::vector<uint32_t> byTitle{};
+        std::vector<uint32_t> byArtist{};
+
+        uint64_t builds{ 0 };
+        uint64_t lastBuildMicroseconds{ 0 };
+    };
+}
@@ -0,0 +1,118 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "SessionSnapshot.h"
+#include "PlaylistDataFetcher.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <winrt/Windows.Storage.h>
+
+using namespace winrt::Windows::Storage;
+
+namespace
+{
+    constexpr char Magic[4]{ 'M', 'P', 'S', 'S' };
+    constexpr wchar_t StateFileName[]{ L"Session.mpss" };
+    constexpr wchar_t TracksFileName[]{ L"Session.mplb" };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    void SessionSnapshot::Write() const
+    {
+        Header header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = FormatVersion;
+        header.playlistIdLength = static_cast<uint16_t>(std::min<size_t>(playlistId.size(), UINT16_MAX));
+        header.trackCount = trackCount;
+        header.currentTrackIndex = currentTrackIndex;
+        header.position = position.count();
+        header.volume = volume;
+        header.muted = muted ? 1 : 0;
+
+        // The state file is small enough to go out in a single write
+        std::vector<uint8_t> contents(sizeof(Header) + header.playlistIdLength * sizeof(wchar_t));
+        std::memcpy(contents.data(), &header, sizeof(Header));
+        std::memcpy(contents.data() + sizeof(Header), playlistId.c_str(), header.playlistIdLength * sizeof(wchar_t));
+
+        winrt::file_handle file{ CreateFile2(StatePath().c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr) };
+        if (!file)
+        {
+            winrt::throw_last_error();
+        }
+
+        DWORD written{ 0 };
+        if (!WriteFile(file.get(), contents.data(), static_cast<DWORD>(contents.size()), &written, nullptr) || written != contents.size())
+        {
+            winrt::throw_last_error();
+        }
+    }
+
+    void SessionSnapshot::WriteTracks(std::vector<PlaylistTrackRecord> const& tracks)
+    {
+        DeleteFile(StatePath().c_str());
+        BinaryPlaylist::Write(TracksPath(), tracks, &PlaylistDataFetcher::GetUriFromTrackId);
+    }
+
+    std::optional<SessionSnapshot> SessionSnapshot::TryRead(std::shared_ptr<BinaryPlaylist>& tracks)
+    {
+        winrt::file_handle file{ CreateFile2(StatePath().c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr) };
+        if (!file)
+        {
+            return std::nullopt;
+        }
+
+        Header header{};
+        DWORD read{ 0 };
+        if (!ReadFile(file.get(), &header, sizeof(Header), &read, nullptr) || read != sizeof(Header) ||
+            std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+            header.version != FormatVersion)
+        {
+            OutputDebugString(L"Ignoring saved session with an unrecognized header or version.\n");
+            return std::nullopt;
+        }
+
+        std::wstring playlistId(header.playlistIdLength, L'\0');
+        DWORD playlistIdBytes{ static_cast<DWORD>(playlistId.size() * sizeof(wchar_t)) };
+        if (!ReadFile(file.get(), playlistId.data(), playlistIdBytes, &read, nullptr) || read != playlistIdBytes)
+        {
+            OutputDebugString(L"Ignoring truncated saved session.\n");
+            return std::nullopt;
+        }
+
+        tracks = BinaryPlaylist::TryOpen(TracksPath());
+        if (!tracks || tracks->Size() != header.trackCount || header.currentTrackIndex >= header.trackCount)
+        {
+            OutputDebugString(L"Ignoring saved session whose tracks do not match its state.\n");
+            tracks = nullptr;
+            return std::nullopt;
+        }
+
+        SessionSnapshot snapshot{};
+        snapshot.playlistId = playlistId;
+        snapshot.trackCount = header.trackCount;
+        snapshot.currentTrackIndex = header.currentTrackIndex;
+        snapshot.position = winrt::Windows::Foundation::TimeSpan{ header.position };
+        snapshot.volume = header.volume;
+        snapshot.muted = header.muted != 0;
+        return snapshot;
+    }
+
+    void SessionSnapshot::Delete()
+    {
+        DeleteFile(StatePath().c_str());
+        DeleteFile(TracksPath().c_str());
+    }
+
+    hstring SessionSnapshot::StatePath()
+    {
+        return ApplicationData::Current().LocalFolder().Path() + L"\\" + StateFileName;
+    }
+
+    hstring SessionSnapshot::TracksPath()
+    {
+        return ApplicationData::Current().LocalFolder().Path() + L"\\" + TracksFileName;
+    }
+}
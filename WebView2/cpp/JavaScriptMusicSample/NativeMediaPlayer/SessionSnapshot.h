@@ -0,0 +1,84 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "BinaryPlaylist.h"
+#include <memory>
+#include <optional>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The playback session saved when the app is suspended, so that it can pick up where it left off
+    /// if it is terminated in the background.
+    ///
+    /// A session is two files in the app's LocalFolder. The state file is a fixed-size header followed
+    /// by the playlist id:
+    ///
+    ///     Header       magic "MPSS", format version, the length of the playlist id, the track count,
+    ///                  the current track index, the position in 100ns ticks, the volume and muted
+    ///     Playlist id  UTF-16, without a terminator
+    ///
+    /// The tracks themselves are a BinaryPlaylist, with every src already resolved, so restoring
+    /// the session maps that file rather than fetching and parsing the playlist again. The state file
+    /// is written last and records the track count, so a session whose track file was left half
+    /// written is rejected rather than restored.
+    ///
+    /// All integers are little-endian. Readers must reject versions they do not understand; new
+    /// fields should be added by bumping FormatVersion.
+    /// </summary>
+    class SessionSnapshot
+    {
+    public:
+        static constexpr uint16_t FormatVersion{ 1 };
+
+        hstring playlistId{};
+        uint32_t trackCount{ 0 };
+        uint32_t currentTrackIndex{ 0 };
+        winrt::Windows::Foundation::TimeSpan position{};
+        double volume{ 0 };
+        bool muted{ false };
+
+        /// <summary>
+        /// Writes the state file. The track file must already hold trackCount tracks.
+        /// </summary>
+        void Write() const;
+
+        /// <summary>
+        /// Writes tracks to the track file. Removes the state file first, since until it is
+        /// rewritten it describes a different track file.
+        /// </summary>
+        static void WriteTracks(std::vector<PlaylistTrackRecord> const& tracks);
+
+        /// <summary>
+        /// Reads the saved session and maps its tracks. Returns nothing if there is no session, or
+        /// if it is not one this code understands.
+        /// </summary>
+        static std::optional<SessionSnapshot> TryRead(std::shared_ptr<BinaryPlaylist>& tracks);
+
+        /// <summary>
+        /// Removes the saved session, so that it is not restored again.
+        /// </summary>
+        static void Delete();
+
+    private:
+#pragma pack(push, 1)
+        struct Header
+        {
+            char magic[4];
+            uint16_t version;
+            uint16_t playlistIdLength;      // in characters
+            uint32_t trackCount;
+            uint32_t currentTrackIndex;
+            int64_t position;               // in 100ns ticks
+            double volume;
+            uint8_t muted;
+            uint8_t reserved[7];
+        };
+#pragma pack(pop)
+        static_assert(sizeof(Header) == 40, "The header layout is part of the file format");
+
+        static hstring StatePath();
+        static hstring TracksPath();
+    };
+}
@@ -0,0 +1,24 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "SharedHttpClient.h"
+#include <winrt/Windows.Web.Http.Filters.h>
+
+using namespace winrt::Windows::Web::Http;
+using namespace winrt::Windows::Web::Http::Filters;
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    HttpClient const& GetSharedHttpClient()
+    {
+        static const HttpClient httpClient{ []()
+        {
+            HttpBaseProtocolFilter filter{};
+            filter.CacheControl().ReadBehavior(HttpCacheReadBehavior::NoCache);
+            filter.CacheControl().WriteBehavior(HttpCacheWriteBehavior::NoCache);
+            return HttpClient{ filter };
+        }() };
+        return httpClient;
+    }
+}
@@ -0,0 +1,18 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The HttpClient that playlists, track heads and artwork are all fetched with.
+    ///
+    /// It is best to avoid re-creating an HttpClient every time a new request is made, for performance,
+    /// and sharing one lets the three reuse each other's connections to the same server. Each of them
+    /// keeps its own cache of what it fetches, so the client bypasses the system HTTP cache, which
+    /// would only hold second copies. It would also answer PlaylistCache's conditional requests
+    /// itself, so that it never saw a 304 from the server.
+    /// </summary>
+    winrt::Windows::Web::Http::HttpClient const& GetSharedHttpClient();
+}
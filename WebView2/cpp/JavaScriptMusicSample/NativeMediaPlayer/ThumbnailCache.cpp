@@ -0,0 +1,490 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "ThumbnailCache.h"
+#include "SharedHttpClient.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <winrt/Windows.Graphics.Imaging.h>
+#include <winrt/Windows.Storage.FileProperties.h>
+#include <winrt/Windows.Storage.Search.h>
+#include <winrt/Windows.System.h>
+
+using namespace winrt;
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Graphics::Imaging;
+using namespace winrt::Windows::Storage;
+using namespace winrt::Windows::Storage::FileProperties;
+using namespace winrt::Windows::Storage::Search;
+using namespace winrt::Windows::Storage::Streams;
+using namespace winrt::Windows::System;
+using namespace winrt::Windows::Web::Http;
+
+namespace
+{
+    // Keys are the 16 hex digits of a hash of the image URL. File names add the size of the full
+    // image, so that the bytes a thumbnail saves are still known in later sessions, and the extension.
+    constexpr size_t KeyLength{ 16 };
+
+    /// <summary>
+    /// The extension to store an image decoded by codecId under, or nullptr if thumbnails are not
+    /// kept in that format.
+    /// </summary>
+    wchar_t const* GetExtension(guid const& codecId)
+    {
+        if (codecId == BitmapDecoder::JpegDecoderId())
+        {
+            return L".jpg";
+        }
+        if (codecId == BitmapDecoder::PngDecoderId())
+        {
+            return L".png";
+        }
+        if (codecId == BitmapDecoder::GifDecoderId())
+        {
+            return L".gif";
+        }
+        if (codecId == BitmapDecoder::BmpDecoderId())
+        {
+            return L".bmp";
+        }
+        return nullptr;
+    }
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    ThumbnailCache& ThumbnailCache::Instance()
+    {
+        static ThumbnailCache instance{};
+        return instance;
+    }
+
+    ThumbnailCache::ThumbnailCache() :
+        diskIndexLoaded{ check_pointer(CreateEvent(nullptr, TRUE, FALSE, nullptr)) },
+        fetchSlots{ check_pointer(CreateSemaphore(nullptr, MaxConcurrentFetches, MaxConcurrentFetches, nullptr)) }
+    {
+        // The memory budget shrinks as the app gets closer to its memory limit
+        MemoryManager::AppMemoryUsageIncreased([this](auto&&, auto&&)
+        {
+            TrimToMemoryLevel();
+        });
+
+        LoadDiskIndexAsync();
+    }
+
+    RandomAccessStreamReference ThumbnailCache::TryGetThumbnail(hstring const& uri)
+    {
+        std::wstring key{ GetKey(uri) };
+        std::lock_guard lock{ mutex };
+        auto diskIt{ diskEntries.find(key) };
+        if (diskIt == diskEntries.end())
+        {
+            stats.misses++;
+            return nullptr;
+        }
+        RecordHit(diskIt->second);
+
+        auto memoryIt{ memoryEntries.find(key) };
+        if (memoryIt != memoryEntries.end())
+        {
+            stats.memoryHits++;
+            memoryLru.splice(memoryLru.begin(), memoryLru, memoryIt->second.lruPosition);
+
+            // Each reader gets its own position over the shared bytes
+            return RandomAccessStreamReference::CreateFromStream(memoryIt->second.stream.CloneStream());
+        }
+
+        stats.diskHits++;
+        return RandomAccessStreamReference::CreateFromUri(Uri{ hstring{ L"ms-appdata:///localcache/" } + FolderName + L"/" + diskIt->second.fileName });
+    }
+
+    hstring ThumbnailCache::TryGetPageUri(hstring const& uri)
+    {
+        std::wstring key{ GetKey(uri) };
+        std::lock_guard lock{ mutex };
+        auto it{ diskEntries.find(key) };
+        if (it == diskEntries.end())
+        {
+            return {};
+        }
+
+        // The page asks for this with every snapshot it takes, so it only counts towards recency;
+        // what the page saves is counted when the thumbnail is first served to the controls
+        diskLru.splice(diskLru.begin(), diskLru, it->second.lruPosition);
+        return hstring{ L"https://" } + PageHostName + L"/" + it->second.fileName;
+    }
+
+    IAsyncOperation<bool> ThumbnailCache::CacheAsync(hstring uri)
+    {
+        std::wstring key{ GetKey(uri) };
+
+        // Until the index is loaded, a thumbnail from an earlier session would look like a miss
+        co_await resume_on_signal(diskIndexLoaded.get());
+
+        std::shared_ptr<PendingFetch> fetch{};
+        {
+            std::lock_guard lock{ mutex };
+            if (diskEntries.count(key) > 0)
+            {
+                co_return true;
+            }
+
+            auto it{ pendingFetches.find(key) };
+            if (it != pendingFetches.end())
+            {
+                stats.coalescedFetches++;
+                fetch = it->second;
+            }
+            else
+            {
+                pendingFetches.emplace(key, std::make_shared<PendingFetch>(PendingFetch{ handle{ check_pointer(CreateEvent(nullptr, TRUE, FALSE, nullptr)) } }));
+            }
+        }
+
+        if (fetch)
+        {
+            co_await resume_on_signal(fetch->done.get());
+            co_return fetch->succeeded;
+        }
+
+        co_await resume_on_signal(fetchSlots.get());
+        bool succeeded{ false };
+        try
+        {
+            succeeded = co_await FetchAndStoreAsync(uri, key);
+        }
+        catch (hresult_error const& ex)
+        {
+            hstring errStr = L"Failed to cache thumbnail: " + uri + L" " + ex.message() + L"\n";
+            OutputDebugString(errStr.c_str());
+        }
+        ReleaseSemaphore(fetchSlots.get(), 1, nullptr);
+
+        {
+            std::lock_guard lock{ mutex };
+            auto it{ pendingFetches.find(key) };
+            fetch = it->second;
+            pendingFetches.erase(it);
+        }
+        if (succeeded)
+        {
+            stats.fetches++;
+        }
+        else
+        {
+            stats.fetchFailures++;
+        }
+        fetch->succeeded = succeeded;
+        SetEvent(fetch->done.get());
+
+        if ((stats.fetches + stats.fetchFailures) % StatisticsInterval == 0)
+        {
+            LogStatistics();
+        }
+        co_return succeeded;
+    }
+
+    void ThumbnailCache::TrimToMemoryLevel()
+    {
+        std::lock_guard lock{ mutex };
+        EvictMemoryToBudget(GetMemoryBudget());
+    }
+
+    void ThumbnailCache::LogStatistics() const
+    {
+        uint64_t decodes{ stats.decodes.load() };
+
+        std::wostringstream strStream{};
+        strStream << L"[ThumbnailCache: "
+            << L"Fetches=" << stats.fetches.load() << L", "
+            << L"FetchFailures=" << stats.fetchFailures.load() << L", "
+            << L"CoalescedFetches=" << stats.coalescedFetches.load() << L", "
+            << L"MemoryHits=" << stats.memoryHits.load() << L", "
+            << L"DiskHits=" << stats.diskHits.load() << L", "
+            << L"Misses=" << stats.misses.load() << L", "
+            << L"Evictions=" << stats.evictions.load() << L", "
+            << L"BytesDownloaded=" << stats.bytesDownloaded.load() << L", "
+            << L"BytesStored=" << stats.bytesStored.load() << L", "
+            << L"BytesSaved=" << stats.bytesSaved.load() << L", "
+            << L"Decodes=" << decodes << L", "
+            << L"AverageDecodeUs=" << (decodes > 0 ? stats.decodeMicroseconds.load() / decodes : 0)
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Indexes the thumbnails stored by earlier sessions, most recently written first, and trims
+    /// them to the disk budget. Recency within a session is only tracked in memory, so the order
+    /// thumbnails were written in is the best guess at it across sessions.
+    /// </summary>
+    IAsyncAction ThumbnailCache::LoadDiskIndexAsync()
+    {
+        co_await resume_background();
+
+        std::vector<std::wstring> evicted{};
+        try
+        {
+            StorageFolder folder{ co_await GetFolderAsync() };
+            QueryOptions options{};
+            options.SetPropertyPrefetch(PropertyPrefetchOptions::BasicProperties, std::vector<hstring>{});
+            auto files{ co_await folder.CreateFileQueryWithOptions(options).GetFilesAsync() };
+
+            struct Found
+            {
+                DiskEntry entry{};
+                DateTime modified{};
+            };
+            std::vector<Found> found{};
+            for (StorageFile const& file : files)
+            {
+                std::wstring fileName{ file.Name() };
+                size_t separator{ fileName.find(L'_') };
+                if (separator != KeyLength)
+                {
+                    continue;
+                }
+
+                BasicProperties properties{ co_await file.GetBasicPropertiesAsync() };
+                found.push_back(Found{ DiskEntry{ fileName, properties.Size(), std::wcstoull(fileName.c_str() + separator + 1, nullptr, 10) }, properties.DateModified() });
+            }
+            std::sort(found.begin(), found.end(), [](Found const& a, Found const& b) { return a.modified > b.modified; });
+
+            std::lock_guard lock{ mutex };
+            for (Found& file : found)
+            {
+                std::wstring key{ file.entry.fileName.substr(0, KeyLength) };
+                if (diskEntries.count(key) > 0)
+                {
+                    continue;
+                }
+                diskLru.push_back(key);
+                file.entry.lruPosition = std::prev(diskLru.end());
+                diskBytes += file.entry.size;
+                diskEntries.emplace(key, std::move(file.entry));
+            }
+            evicted = EvictDiskToBudget();
+        }
+        catch (hresult_error const& ex)
+        {
+            hstring errStr = L"Failed to index cached thumbnails: " + ex.message() + L"\n";
+            OutputDebugString(errStr.c_str());
+        }
+        SetEvent(diskIndexLoaded.get());
+
+        for (std::wstring const& fileName : evicted)
+        {
+            try
+            {
+                StorageFolder folder{ co_await GetFolderAsync() };
+                co_await (co_await folder.GetFileAsync(fileName)).DeleteAsync();
+            }
+            catch (hresult_error const&)
+            {
+                // Already gone
+            }
+        }
+    }
+
+    /// <summary>
+    /// Downloads the image at uri, scales it down to ThumbnailSize if it is larger, and stores the
+    /// result on disk and in memory under key. Runs on a background thread.
+    /// </summary>
+    IAsyncOperation<bool> ThumbnailCache::FetchAndStoreAsync(hstring uri, std::wstring key)
+    {
+        IBuffer original{ co_await ReadImageAsync(Uri{ uri }) };
+        stats.bytesDownloaded += original.Length();
+
+        InMemoryRandomAccessStream source{};
+        co_await source.WriteAsync(original);
+        source.Seek(0);
+
+        auto decodeStarted{ std::chrono::steady_clock::now() };
+        BitmapDecoder decoder{ co_await BitmapDecoder::CreateAsync(source) };
+        wchar_t const* extension{ GetExtension(decoder.DecoderInformation().CodecId()) };
+        if (!extension)
+        {
+            co_return false;
+        }
+
+        // The artwork fills a square, so the shorter side is the one that has to cover it
+        uint32_t width{ decoder.PixelWidth() };
+        uint32_t height{ decoder.PixelHeight() };
+        double scale{ std::max(static_cast<double>(ThumbnailSize) / width, static_cast<double>(ThumbnailSize) / height) };
+
+        InMemoryRandomAccessStream thumbnail{};
+        if (scale < 1.0)
+        {
+            // Transcoding keeps the format and metadata, including the EXIF orientation, of the original
+            BitmapEncoder encoder{ co_await BitmapEncoder::CreateForTranscodingAsync(thumbnail, decoder) };
+            encoder.BitmapTransform().ScaledWidth(std::max(1u, static_cast<uint32_t>(std::lround(width * scale))));
+            encoder.BitmapTransform().ScaledHeight(std::max(1u, static_cast<uint32_t>(std::lround(height * scale))));
+            encoder.BitmapTransform().InterpolationMode(BitmapInterpolationMode::Fant);
+            co_await encoder.FlushAsync();
+        }
+        else
+        {
+            // Already small enough to use as it is
+            co_await thumbnail.WriteAsync(original);
+        }
+
+        auto decodeTime{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - decodeStarted) };
+        stats.decodes++;
+        stats.decodeMicroseconds += decodeTime.count();
+
+        uint32_t size{ static_cast<uint32_t>(thumbnail.Size()) };
+        Buffer bytes{ size };
+        co_await thumbnail.GetInputStreamAt(0).ReadAsync(bytes, size, InputStreamOptions::None);
+
+        std::wostringstream fileName{};
+        fileName << key << L"_" << original.Length() << extension;
+        StorageFolder folder{ co_await GetFolderAsync() };
+        StorageFile file{ co_await folder.CreateFileAsync(fileName.str(), CreationCollisionOption::ReplaceExisting) };
+        co_await FileIO::WriteBufferAsync(file, bytes);
+        stats.bytesStored += size;
+        stats.bytesSaved += original.Length() > size ? original.Length() - size : 0;
+
+        std::vector<std::wstring> evicted{};
+        {
+            std::lock_guard lock{ mutex };
+            diskLru.push_front(key);
+            diskBytes += size;
+            diskEntries[key] = DiskEntry{ fileName.str(), size, original.Length(), diskLru.begin() };
+
+            size_t memoryBudget{ GetMemoryBudget() };
+            if (size <= memoryBudget)
+            {
+                memoryLru.push_front(key);
+                memoryBytes += size;
+                memoryEntries[key] = MemoryEntry{ thumbnail, memoryLru.begin() };
+                EvictMemoryToBudget(memoryBudget);
+            }
+            evicted = EvictDiskToBudget();
+        }
+
+        for (std::wstring const& evictedName : evicted)
+        {
+            try
+            {
+                co_await (co_await folder.GetFileAsync(evictedName)).DeleteAsync();
+            }
+            catch (hresult_error const&)
+            {
+                // Already gone
+            }
+        }
+        co_return true;
+    }
+
+    IAsyncOperation<IBuffer> ThumbnailCache::ReadImageAsync(Uri uri)
+    {
+        if (uri.SchemeName() == L"http" || uri.SchemeName() == L"https")
+        {
+            co_return co_await GetSharedHttpClient().GetBufferAsync(uri);
+        }
+
+        StorageFile file{ co_await StorageFile::GetFileFromApplicationUriAsync(uri) };
+        co_return co_await FileIO::ReadBufferAsync(file);
+    }
+
+    IAsyncOperation<StorageFolder> ThumbnailCache::GetFolderAsync()
+    {
+        co_return co_await ApplicationData::Current().LocalCacheFolder().CreateFolderAsync(FolderName, CreationCollisionOption::OpenIfExists);
+    }
+
+    /// <summary>
+    /// How many bytes of thumbnails may be kept in memory at the app's current memory usage level.
+    /// </summary>
+    size_t ThumbnailCache::GetMemoryBudget()
+    {
+        switch (MemoryManager::AppMemoryUsageLevel())
+        {
+        case AppMemoryUsageLevel::Low:
+            return 2 * 1024 * 1024;
+        case AppMemoryUsageLevel::Medium:
+            return 512 * 1024;
+        default:
+            return 0;
+        }
+    }
+
+    /// <summary>
+    /// Image URLs can be long and contain characters that are not allowed in file names, so they
+    /// are hashed into something that is.
+    /// </summary>
+    std::wstring ThumbnailCache::GetKey(hstring const& uri)
+    {
+        // 64-bit FNV-1a
+        uint64_t hash{ 14695981039346656037ull };
+        for (wchar_t c : uri)
+        {
+            hash = (hash ^ static_cast<uint64_t>(c)) * 1099511628211ull;
+        }
+
+        std::wostringstream strStream{};
+        strStream << std::hex << std::setw(KeyLength) << std::setfill(L'0') << hash;
+        return strStream.str();
+    }
+
+    /// <summary>
+    /// Marks a thumbnail as just used and counts what serving it instead of the full image saved.
+    /// The caller must hold mutex.
+    /// </summary>
+    void ThumbnailCache::RecordHit(DiskEntry const& entry)
+    {
+        diskLru.splice(diskLru.begin(), diskLru, entry.lruPosition);
+        if (entry.originalSize > entry.size)
+        {
+            stats.bytesSaved += entry.originalSize - entry.size;
+        }
+    }
+
+    /// <summary>
+    /// Drops least recently used thumbnails from memory until they fit in budget. They stay on
+    /// disk. The caller must hold mutex.
+    /// </summary>
+    void ThumbnailCache::EvictMemoryToBudget(size_t budget)
+    {
+        while (memoryBytes > budget && !memoryLru.empty())
+        {
+            auto it{ memoryEntries.find(memoryLru.back()) };
+            memoryBytes -= static_cast<size_t>(it->second.stream.Size());
+            memoryEntries.erase(it);
+            memoryLru.pop_back();
+        }
+    }
+
+    /// <summary>
+    /// Drops least recently used thumbnails from the index, and from memory, until the ones on disk
+    /// fit in DiskBudgetBytes. Returns the names of the files to delete, which the caller does once
+    /// it has released mutex. The caller must hold mutex.
+    /// </summary>
+    std::vector<std::wstring> ThumbnailCache::EvictDiskToBudget()
+    {
+        std::vector<std::wstring> evicted{};
+        while (diskBytes > DiskBudgetBytes && !diskLru.empty())
+        {
+            std::wstring key{ diskLru.back() };
+            auto it{ diskEntries.find(key) };
+            diskBytes -= it->second.size;
+            evicted.push_back(it->second.fileName);
+            diskEntries.erase(it);
+            diskLru.pop_back();
+
+            auto memoryIt{ memoryEntries.find(key) };
+            if (memoryIt != memoryEntries.end())
+            {
+                memoryBytes -= static_cast<size_t>(memoryIt->second.stream.Size());
+                memoryLru.erase(memoryIt->second.lruPosition);
+                memoryEntries.erase(memoryIt);
+            }
+            stats.evictions++;
+        }
+        return evicted;
+    }
+}
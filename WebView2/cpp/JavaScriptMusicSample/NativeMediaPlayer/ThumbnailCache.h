@@ -0,0 +1,138 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <winrt/Windows.Storage.h>
+#include <winrt/Windows.Storage.Streams.h>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Downloads track artwork once, shrinks it to the size it is displayed at, and serves it to both
+    /// the system media transport controls and the page.
+    ///
+    /// Each image URL is fetched at most once at a time, and only MaxConcurrentFetches fetches run at
+    /// once. Images larger than ThumbnailSize are scaled down in their own format before they are
+    /// stored. Stored thumbnails live in the Thumbnails folder of the local cache, which is kept
+    /// under DiskBudgetBytes by dropping the least recently used ones, and the most recently used
+    /// are also kept in memory within a budget that follows the app's memory usage level.
+    ///
+    /// The page loads thumbnails from the folder through the PageHostName virtual host, which the
+    /// app maps to it when it sets up the WebView.
+    /// </summary>
+    class ThumbnailCache
+    {
+    public:
+        /// <summary>
+        /// Counters describing how much the cache has saved since the app started.
+        /// </summary>
+        struct Statistics
+        {
+            std::atomic<uint64_t> fetches{ 0 };
+            std::atomic<uint64_t> fetchFailures{ 0 };
+            std::atomic<uint64_t> coalescedFetches{ 0 };   // requests that waited on a fetch already in flight
+            std::atomic<uint64_t> memoryHits{ 0 };
+            std::atomic<uint64_t> diskHits{ 0 };
+            std::atomic<uint64_t> misses{ 0 };
+            std::atomic<uint64_t> evictions{ 0 };
+            std::atomic<uint64_t> bytesDownloaded{ 0 };
+            std::atomic<uint64_t> bytesStored{ 0 };
+            std::atomic<uint64_t> bytesSaved{ 0 };         // full size minus thumbnail size, for every image served
+            std::atomic<uint64_t> decodes{ 0 };
+            std::atomic<uint64_t> decodeMicroseconds{ 0 };
+        };
+
+        /// <summary>
+        /// The length of the shorter side of a thumbnail, in pixels. This is the size of the artwork
+        /// on the page, which fills a square of that size; the transport controls show it smaller.
+        /// </summary>
+        static constexpr uint32_t ThumbnailSize{ 300 };
+        static constexpr uint32_t MaxConcurrentFetches{ 3 };
+        static constexpr uint64_t DiskBudgetBytes{ 16 * 1024 * 1024 };
+        static constexpr wchar_t FolderName[]{ L"Thumbnails" };
+        static constexpr wchar_t PageHostName[]{ L"local.thumbnails" };
+
+        static ThumbnailCache& Instance();
+
+        /// <summary>
+        /// Returns the thumbnail for the image at uri if it is cached, or nullptr if it is not.
+        /// </summary>
+        winrt::Windows::Storage::Streams::RandomAccessStreamReference TryGetThumbnail(hstring const& uri);
+
+        /// <summary>
+        /// Returns the URL the page can load the thumbnail for the image at uri from, or an empty
+        /// string if it is not cached.
+        /// </summary>
+        hstring TryGetPageUri(hstring const& uri);
+
+        /// <summary>
+        /// Fetches the image at uri and caches its thumbnail, unless that has already been done.
+        /// Completes with whether the thumbnail is now cached; failures are logged and otherwise
+        /// ignored, so that the caller can fall back to the full size image.
+        /// </summary>
+        winrt::Windows::Foundation::IAsyncOperation<bool> CacheAsync(hstring uri);
+
+        void TrimToMemoryLevel();
+        Statistics const& Stats() const noexcept { return stats; }
+        void LogStatistics() const;
+
+    private:
+        struct DiskEntry
+        {
+            std::wstring fileName{};
+            uint64_t size{ 0 };
+            uint64_t originalSize{ 0 };
+            std::list<std::wstring>::iterator lruPosition{};
+        };
+
+        struct MemoryEntry
+        {
+            winrt::Windows::Storage::Streams::InMemoryRandomAccessStream stream{ nullptr };
+            std::list<std::wstring>::iterator lruPosition{};
+        };
+
+        struct PendingFetch
+        {
+            winrt::handle done{};
+            bool succeeded{ false };
+        };
+
+        ThumbnailCache();
+
+        winrt::Windows::Foundation::IAsyncAction LoadDiskIndexAsync();
+        winrt::Windows::Foundation::IAsyncOperation<bool> FetchAndStoreAsync(hstring uri, std::wstring key);
+        static winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Storage::Streams::IBuffer> ReadImageAsync(winrt::Windows::Foundation::Uri uri);
+        static winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Storage::StorageFolder> GetFolderAsync();
+        static size_t GetMemoryBudget();
+        static std::wstring GetKey(hstring const& uri);
+        void RecordHit(DiskEntry const& entry);
+        void EvictMemoryToBudget(size_t budget);
+        std::vector<std::wstring> EvictDiskToBudget();
+
+        // Both LRU lists hold keys; every thumbnail in memory is also on disk
+        std::mutex mutex{};
+        std::list<std::wstring> diskLru{};
+        std::unordered_map<std::wstring, DiskEntry> diskEntries{};
+        uint64_t diskBytes{ 0 };
+        std::list<std::wstring> memoryLru{};
+        std::unordered_map<std::wstring, MemoryEntry> memoryEntries{};
+        size_t memoryBytes{ 0 };
+        std::unordered_map<std::wstring, std::shared_ptr<PendingFetch>> pendingFetches{};
+
+        // Signalled once the thumbnails left by earlier sessions have been indexed
+        winrt::handle diskIndexLoaded{};
+        // A semaphore with one count per fetch that may run
+        winrt::handle fetchSlots{};
+        Statistics stats{};
+
+        // How many fetches, successful or not, go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 20 };
+    };
+}
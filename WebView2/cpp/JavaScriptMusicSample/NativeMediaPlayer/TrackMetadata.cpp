@@ -17,36 +17,51 @@ namespace winrt::NativeMediaPlayer::implementation
         artist {artist},
         thumbnailSrc {thumbnailSrc}
     { }
+    TrackMetadata::TrackMetadata(std::shared_ptr<TrackMetadataStore> store, uint32_t row) noexcept :
+        store {std::move(store)},
+        row {row}
+    { }
     hstring TrackMetadata::Src()
     {
-        return src;
+        return store ? store->Get(row, TrackMetadataStore::Field::Src) : src;
     }
     void TrackMetadata::Src(hstring const& value)
     {
+        CheckWritable();
         src = value;
     }
     hstring TrackMetadata::Title()
     {
-        return title;
+        return store ? store->Get(row, TrackMetadataStore::Field::Title) : title;
     }
     void TrackMetadata::Title(hstring const& value)
     {
+        CheckWritable();
         title = value;
     }
     hstring TrackMetadata::Artist()
     {
-        return artist;
+        return store ? store->Get(row, TrackMetadataStore::Field::Artist) : artist;
     }
     void TrackMetadata::Artist(hstring const& value)
     {
+        CheckWritable();
         artist = value;
     }
     hstring TrackMetadata::ThumbnailSrc()
     {
-        return thumbnailSrc;
+        return store ? store->Get(row, TrackMetadataStore::Field::ThumbnailSrc) : thumbnailSrc;
     }
     void TrackMetadata::ThumbnailSrc(hstring const& value)
     {
+        CheckWritable();
         thumbnailSrc = value;
     }
+    void TrackMetadata::CheckWritable() const
+    {
+        if (store)
+        {
+            throw hresult_illegal_method_call(L"Tracks read from a playlist are read-only");
+        }
+    }
 }
@@ -3,14 +3,23 @@
 
 #pragma once
 #include "TrackMetadata.g.h"
+#include "TrackMetadataStore.h"
+#include <memory>
 
 namespace winrt::NativeMediaPlayer::implementation
 {
+    /// <summary>
+    /// A TrackMetadata constructed from JavaScript or elsewhere holds its own fields. One read out of
+    /// the controller's playlist is instead a read-only view of one row of the playlist's
+    /// TrackMetadataStore, which the controller creates on demand; the controller's search index,
+    /// sort views and track ids are all built from that row, so it cannot be changed through a view.
+    /// </summary>
     struct TrackMetadata : TrackMetadataT<TrackMetadata>
     {
         TrackMetadata() = default;
 
         TrackMetadata(hstring const& src, hstring const& title, hstring const& artist, hstring const& thumbnailSrc);
+        TrackMetadata(std::shared_ptr<TrackMetadataStore> store, uint32_t row) noexcept;
         hstring Src();
         void Src(hstring const& value);
         hstring Title();
@@ -20,11 +29,23 @@ namespace winrt::NativeMediaPlayer::implementation
         hstring ThumbnailSrc();
         void ThumbnailSrc(hstring const& value);
 
+        /// <summary>
+        /// The store and row a view reads from. Store is null for a TrackMetadata that holds its own fields.
+        /// </summary>
+        std::shared_ptr<TrackMetadataStore> const& Store() const noexcept { return store; }
+        uint32_t Row() const noexcept { return row; }
+
     private:
+        void CheckWritable() const;
+
         hstring src{ L"" };
         hstring title{ L"" };
         hstring artist{ L"" };
         hstring thumbnailSrc{ L"" };
+
+        // Only set for a view, whose own fields above stay empty
+        std::shared_ptr<TrackMetadataStore> store{};
+        uint32_t row{ 0 };
     };
 }
 namespace winrt::NativeMediaPlayer::factory_implementation
@@ -0,0 +1,242 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TrackMetadataList.h"
+#include "TrackMetadata.h"
+#include <algorithm>
+
+using namespace winrt;
+using namespace winrt::Windows::Foundation::Collections;
+
+namespace
+{
+    using TrackMetadataView = winrt::NativeMediaPlayer::implementation::TrackMetadata;
+
+    /// <summary>
+    /// Walks a TrackMetadataList, creating each view as it gets to it.
+    /// </summary>
+    struct TrackMetadataIterator : implements<TrackMetadataIterator, IIterator<winrt::NativeMediaPlayer::TrackMetadata>>
+    {
+        explicit TrackMetadataIterator(com_ptr<winrt::NativeMediaPlayer::implementation::TrackMetadataList> list) noexcept : list{ std::move(list) } {}
+
+        winrt::NativeMediaPlayer::TrackMetadata Current() const
+        {
+            if (!HasCurrent())
+            {
+                throw hresult_out_of_bounds();
+            }
+            return list->GetAt(index);
+        }
+
+        bool HasCurrent() const noexcept
+        {
+            return index < list->Size();
+        }
+
+        bool MoveNext() noexcept
+        {
+            if (HasCurrent())
+            {
+                index++;
+            }
+            return HasCurrent();
+        }
+
+        uint32_t GetMany(array_view<winrt::NativeMediaPlayer::TrackMetadata> items)
+        {
+            uint32_t count{ list->GetMany(index, items) };
+            index += count;
+            return count;
+        }
+
+    private:
+        com_ptr<winrt::NativeMediaPlayer::implementation::TrackMetadataList> list;
+        uint32_t index{ 0 };
+    };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    TrackMetadataList::TrackMetadataList() :
+        store{ std::make_shared<TrackMetadataStore>() }
+    {
+    }
+
+    TrackMetadataList::TrackMetadataList(std::shared_ptr<TrackMetadataStore> store, std::vector<uint32_t> rows, bool readOnly) :
+        store{ std::move(store) }, rows{ std::move(rows) }, readOnly{ readOnly }
+    {
+    }
+
+    NativeMediaPlayer::TrackMetadata TrackMetadataList::GetAt(uint32_t index) const
+    {
+        CheckIndex(index, Size());
+        return make<TrackMetadataView>(store, rows[index]);
+    }
+
+    IVectorView<NativeMediaPlayer::TrackMetadata> TrackMetadataList::GetView() const
+    {
+        return make<TrackMetadataList>(store, rows, true);
+    }
+
+    bool TrackMetadataList::IndexOf(NativeMediaPlayer::TrackMetadata const& value, uint32_t& index) const
+    {
+        // Two views are the same track if they view the same row
+        TrackMetadataView const* view{ value ? get_self<TrackMetadataView>(value) : nullptr };
+        if (view && view->Store() == store)
+        {
+            auto it{ std::find(rows.begin(), rows.end(), view->Row()) };
+            if (it != rows.end())
+            {
+                index = static_cast<uint32_t>(it - rows.begin());
+                return true;
+            }
+        }
+        index = 0;
+        return false;
+    }
+
+    uint32_t TrackMetadataList::GetMany(uint32_t startIndex, array_view<NativeMediaPlayer::TrackMetadata> items) const
+    {
+        if (startIndex >= Size())
+        {
+            return 0;
+        }
+
+        uint32_t count{ std::min(items.size(), Size() - startIndex) };
+        for (uint32_t i = 0; i < count; i++)
+        {
+            items[i] = make<TrackMetadataView>(store, rows[startIndex + i]);
+        }
+        return count;
+    }
+
+    void TrackMetadataList::SetAt(uint32_t index, NativeMediaPlayer::TrackMetadata const& value)
+    {
+        CheckWritable();
+        CheckIndex(index, Size());
+        rows[index] = RowOf(value);
+    }
+
+    void TrackMetadataList::InsertAt(uint32_t index, NativeMediaPlayer::TrackMetadata const& value)
+    {
+        CheckWritable();
+        CheckIndex(index, Size() + 1);
+        rows.insert(rows.begin() + index, RowOf(value));
+    }
+
+    void TrackMetadataList::RemoveAt(uint32_t index)
+    {
+        CheckWritable();
+        CheckIndex(index, Size());
+        rows.erase(rows.begin() + index);
+    }
+
+    void TrackMetadataList::Append(NativeMediaPlayer::TrackMetadata const& value)
+    {
+        CheckWritable();
+        rows.push_back(RowOf(value));
+    }
+
+    void TrackMetadataList::RemoveAtEnd()
+    {
+        CheckWritable();
+        CheckIndex(0, Size());
+        rows.pop_back();
+    }
+
+    void TrackMetadataList::Clear()
+    {
+        CheckWritable();
+        rows.clear();
+        store = std::make_shared<TrackMetadataStore>();
+    }
+
+    void TrackMetadataList::ReplaceAll(array_view<NativeMediaPlayer::TrackMetadata const> items)
+    {
+        CheckWritable();
+
+        // Read the rows before clearing, since some of the items may view the current store
+        std::vector<uint32_t> newRows{};
+        newRows.reserve(items.size());
+        for (NativeMediaPlayer::TrackMetadata const& item : items)
+        {
+            newRows.push_back(RowOf(item));
+        }
+        rows = std::move(newRows);
+    }
+
+    IIterator<NativeMediaPlayer::TrackMetadata> TrackMetadataList::First()
+    {
+        return make<TrackMetadataIterator>(get_strong());
+    }
+
+    NativeMediaPlayer::TrackMetadata TrackMetadataList::CreateTrack(hstring const& src, hstring const& title, hstring const& artist, hstring const& thumbnailSrc)
+    {
+        return make<TrackMetadataView>(store, store->Append(src, title, artist, thumbnailSrc));
+    }
+
+    void TrackMetadataList::AppendTrack(hstring const& src, hstring const& title, hstring const& artist, hstring const& thumbnailSrc)
+    {
+        CheckWritable();
+        rows.push_back(store->Append(src, title, artist, thumbnailSrc));
+    }
+
+    hstring TrackMetadataList::GetField(uint32_t index, TrackMetadataStore::Field field) const
+    {
+        CheckIndex(index, Size());
+        return store->Get(rows[index], field);
+    }
+
+    void TrackMetadataList::Reserve(uint32_t trackCount)
+    {
+        rows.reserve(trackCount);
+        store->Reserve(trackCount);
+    }
+
+    void TrackMetadataList::LogStatistics() const
+    {
+        store->LogStatistics();
+    }
+
+    void TrackMetadataList::Assign(std::shared_ptr<TrackMetadataStore> newStore, std::vector<uint32_t> newRows)
+    {
+        CheckWritable();
+        store = std::move(newStore);
+        rows = std::move(newRows);
+    }
+
+    /// <summary>
+    /// The row that value views in this list's store, copying it into a new row if it views another.
+    /// </summary>
+    uint32_t TrackMetadataList::RowOf(NativeMediaPlayer::TrackMetadata const& value)
+    {
+        if (!value)
+        {
+            throw hresult_invalid_argument();
+        }
+
+        TrackMetadataView const* view{ get_self<TrackMetadataView>(value) };
+        if (view->Store() == store)
+        {
+            return view->Row();
+        }
+        return store->Append(value.Src(), value.Title(), value.Artist(), value.ThumbnailSrc());
+    }
+
+    void TrackMetadataList::CheckWritable() const
+    {
+        if (readOnly)
+        {
+            throw hresult_illegal_method_call();
+        }
+    }
+
+    void TrackMetadataList::CheckIndex(uint32_t index, uint32_t size) const
+    {
+        if (index >= size)
+        {
+            throw hresult_out_of_bounds();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "winrt/NativeMediaPlayer.h"
+#include "TrackMetadataStore.h"
+#include <memory>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// The controller's playlist, as a vector of TrackMetadata whose elements are only created when
+    /// they are read. Each element is a row number in a TrackMetadataStore; GetAt wraps the row in a
+    /// TrackMetadata view. TrackMetadata put into the list that already views one of its rows are
+    /// stored as that row, and any others are copied into a new row.
+    ///
+    /// Clear starts a new store, so that rows left behind by removed tracks are freed along with the
+    /// playlist they belonged to. Views handed out earlier keep the old store alive.
+    ///
+    /// Like single_threaded_vector, which it replaces, it must only be used from one thread at a time.
+    /// </summary>
+    struct TrackMetadataList : implements<TrackMetadataList,
+        winrt::Windows::Foundation::Collections::IVector<winrt::NativeMediaPlayer::TrackMetadata>,
+        winrt::Windows::Foundation::Collections::IVectorView<winrt::NativeMediaPlayer::TrackMetadata>,
+        winrt::Windows::Foundation::Collections::IIterable<winrt::NativeMediaPlayer::TrackMetadata>>
+    {
+        TrackMetadataList();
+        TrackMetadataList(std::shared_ptr<TrackMetadataStore> store, std::vector<uint32_t> rows, bool readOnly);
+
+        winrt::NativeMediaPlayer::TrackMetadata GetAt(uint32_t index) const;
+        uint32_t Size() const noexcept { return static_cast<uint32_t>(rows.size()); }
+        winrt::Windows::Foundation::Collections::IVectorView<winrt::NativeMediaPlayer::TrackMetadata> GetView() const;
+        bool IndexOf(winrt::NativeMediaPlayer::TrackMetadata const& value, uint32_t& index) const;
+        uint32_t GetMany(uint32_t startIndex, array_view<winrt::NativeMediaPlayer::TrackMetadata> items) const;
+        void SetAt(uint32_t index, winrt::NativeMediaPlayer::TrackMetadata const& value);
+        void InsertAt(uint32_t index, winrt::NativeMediaPlayer::TrackMetadata const& value);
+        void RemoveAt(uint32_t index);
+        void Append(winrt::NativeMediaPlayer::TrackMetadata const& value);
+        void RemoveAtEnd();
+        void Clear();
+        void ReplaceAll(array_view<winrt::NativeMediaPlayer::TrackMetadata const> items);
+        winrt::Windows::Foundation::Collections::IIterator<winrt::NativeMediaPlayer::TrackMetadata> First();
+
+        /// <summary>
+        /// Adds a row to the store and returns a view of it, without adding it to the list.
+        /// </summary>
+        winrt::NativeMediaPlayer::TrackMetadata CreateTrack(hstring const& src, hstring const& title, hstring const& artist, hstring const& thumbnailSrc);
+
+        /// <summary>
+        /// Adds a track to the end of the list without creating a view of it.
+        /// </summary>
+        void AppendTrack(hstring const& src, hstring const& title, hstring const& artist, hstring const& thumbnailSrc);
+
+        /// <summary>
+        /// Reads one field of the track at index without creating a view of it.
+        /// </summary>
+        hstring GetField(uint32_t index, TrackMetadataStore::Field field) const;
+
+        void Reserve(uint32_t trackCount);
+        void LogStatistics() const;
+
+        /// <summary>
+        /// Replaces the list with rows of a store that was filled elsewhere, for instance on a
+        /// background thread. The store must not be used anywhere else afterwards.
+        /// </summary>
+        void Assign(std::shared_ptr<TrackMetadataStore> newStore, std::vector<uint32_t> newRows);
+
+    private:
+        uint32_t RowOf(winrt::NativeMediaPlayer::TrackMetadata const& value);
+        void CheckWritable() const;
+        void CheckIndex(uint32_t index, uint32_t size) const;
+
+        std::shared_ptr<TrackMetadataStore> store;
+        std::vector<uint32_t> rows{};
+        bool readOnly{ false };
+    };
+}
@@ -0,0 +1,270 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TrackMetadataStore.h"
+#include "BinaryPlaylist.h"
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+    // Rough sizes for estimating what a track took when it was an object of its own: the object,
+    // with its vtables, reference count and four hstring handles, plus its slot in the vector, and
+    // for each field an hstring header and the heap's bookkeeping for each allocation
+    constexpr size_t SeparateObjectSize{ 64 + sizeof(void*) };
+    constexpr size_t HStringHeaderSize{ 32 };
+    constexpr size_t HeapBlockOverhead{ 16 };
+
+    template <typename T>
+    size_t CapacityBytes(std::vector<T> const& vector) noexcept
+    {
+        return vector.capacity() * sizeof(T);
+    }
+
+    using Field = winrt::NativeMediaPlayer::implementation::TrackMetadataStore::Field;
+    using MappedField = winrt::NativeMediaPlayer::implementation::BinaryPlaylist::Field;
+
+    MappedField ToMappedField(Field field) noexcept
+    {
+        switch (field)
+        {
+        case Field::Src: return MappedField::Src;
+        case Field::Title: return MappedField::Title;
+        case Field::Artist: return MappedField::Artist;
+        case Field::ThumbnailSrc: return MappedField::Image;
+        }
+        return MappedField::Id;
+    }
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    TrackMetadataStore::TrackMetadataStore(std::shared_ptr<BinaryPlaylist const> mapped) :
+        mapped{ std::move(mapped) }, mappedRowCount{ this->mapped->Size() }
+    {
+    }
+
+    uint32_t TrackMetadataStore::Append(std::wstring_view src, std::wstring_view title, std::wstring_view artist, std::wstring_view thumbnailSrc)
+    {
+        uint32_t row{ RowCount() };
+        uint32_t column{ static_cast<uint32_t>(titles.size()) };
+        srcDirectories.push_back(0);
+        srcNames.push_back(0);
+        titles.push_back(0);
+        artists.push_back(0);
+        thumbnailDirectories.push_back(0);
+        thumbnailNames.push_back(0);
+
+        Set(column, Field::Src, src);
+        Set(column, Field::Title, title);
+        Set(column, Field::Artist, artist);
+        Set(column, Field::ThumbnailSrc, thumbnailSrc);
+        return row;
+    }
+
+    hstring TrackMetadataStore::Get(uint32_t row, Field field) const
+    {
+        if (row < mappedRowCount)
+        {
+            return hstring{ mapped->GetField(row, ToMappedField(field)) };
+        }
+
+        uint32_t column{ row - mappedRowCount };
+        switch (field)
+        {
+        case Field::Src:
+        case Field::ThumbnailSrc:
+        {
+            bool isSrc{ field == Field::Src };
+            std::wstring_view directory{ View((isSrc ? srcDirectories : thumbnailDirectories)[column]) };
+            std::wstring_view name{ View((isSrc ? srcNames : thumbnailNames)[column]) };
+            if (directory.empty())
+            {
+                return hstring{ name };
+            }
+
+            std::wstring url{};
+            url.reserve(directory.size() + name.size());
+            url.append(directory).append(name);
+            return hstring{ url };
+        }
+        case Field::Title:
+            return hstring{ View(titles[column]) };
+        case Field::Artist:
+            return hstring{ View(artists[column]) };
+        }
+        return {};
+    }
+
+    void TrackMetadataStore::Set(uint32_t column, Field field, std::wstring_view value)
+    {
+        switch (field)
+        {
+        case Field::Src:
+        case Field::ThumbnailSrc:
+        {
+            bool isSrc{ field == Field::Src };
+            size_t split{ SplitPoint(value) };
+            (isSrc ? srcDirectories : thumbnailDirectories)[column] = Intern(value.substr(0, split));
+            (isSrc ? srcNames : thumbnailNames)[column] = Intern(value.substr(split));
+            break;
+        }
+        case Field::Title:
+            titles[column] = Intern(value);
+            break;
+        case Field::Artist:
+            artists[column] = Intern(value);
+            break;
+        }
+    }
+
+    size_t TrackMetadataStore::FieldLength(uint32_t row, Field field) const
+    {
+        if (row < mappedRowCount)
+        {
+            return mapped->GetField(row, ToMappedField(field)).size();
+        }
+
+        uint32_t column{ row - mappedRowCount };
+        switch (field)
+        {
+        case Field::Src:
+            return View(srcDirectories[column]).size() + View(srcNames[column]).size();
+        case Field::Title:
+            return View(titles[column]).size();
+        case Field::Artist:
+            return View(artists[column]).size();
+        case Field::ThumbnailSrc:
+            return View(thumbnailDirectories[column]).size() + View(thumbnailNames[column]).size();
+        }
+        return 0;
+    }
+
+    void TrackMetadataStore::Reserve(uint32_t rowCount)
+    {
+        srcDirectories.reserve(rowCount);
+        srcNames.reserve(rowCount);
+        titles.reserve(rowCount);
+        artists.reserve(rowCount);
+        thumbnailDirectories.reserve(rowCount);
+        thumbnailNames.reserve(rowCount);
+    }
+
+    size_t TrackMetadataStore::MemoryBytes() const noexcept
+    {
+        return sizeof(*this) + CapacityBytes(characters) + CapacityBytes(offsets) + CapacityBytes(index) +
+            CapacityBytes(srcDirectories) + CapacityBytes(srcNames) + CapacityBytes(titles) +
+            CapacityBytes(artists) + CapacityBytes(thumbnailDirectories) + CapacityBytes(thumbnailNames);
+    }
+
+    size_t TrackMetadataStore::SeparateObjectBytes() const
+    {
+        auto stringBytes = [](size_t length)
+        {
+            return length == 0 ? 0 : HStringHeaderSize + length * sizeof(wchar_t) + HeapBlockOverhead;
+        };
+
+        size_t total{ 0 };
+        for (uint32_t row = 0; row < RowCount(); row++)
+        {
+            total += SeparateObjectSize + HeapBlockOverhead;
+            total += stringBytes(FieldLength(row, Field::Src));
+            total += stringBytes(FieldLength(row, Field::Title));
+            total += stringBytes(FieldLength(row, Field::Artist));
+            total += stringBytes(FieldLength(row, Field::ThumbnailSrc));
+        }
+        return total;
+    }
+
+    void TrackMetadataStore::LogStatistics() const
+    {
+        uint32_t rows{ RowCount() };
+        size_t memoryBytes{ MemoryBytes() };
+        size_t separateBytes{ SeparateObjectBytes() };
+
+        std::wostringstream strStream{};
+        strStream << L"[TrackMetadataStore: "
+            << L"Tracks=" << rows << L", "
+            << L"MappedTracks=" << mappedRowCount << L", "
+            << L"DistinctStrings=" << offsets.size() - 1 << L", "
+            << L"PoolCharacters=" << characters.size() << L", "
+            << L"MemoryBytes=" << memoryBytes << L", "
+            << L"BytesPerTrack=" << (rows > 0 ? memoryBytes / rows : 0) << L", "
+            << L"SeparateObjectBytesPerTrack=" << (rows > 0 ? separateBytes / rows : 0)
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    std::wstring_view TrackMetadataStore::View(uint32_t id) const noexcept
+    {
+        return std::wstring_view{ characters.data() + offsets[id], offsets[id + 1] - offsets[id] };
+    }
+
+    /// <summary>
+    /// Returns the id of value in the pool, adding it if it is not there yet.
+    /// </summary>
+    uint32_t TrackMetadataStore::Intern(std::wstring_view value)
+    {
+        // Keep the table at most half full, so that probes stay short
+        if ((offsets.size() + 1) * 2 > index.size())
+        {
+            GrowIndex();
+        }
+
+        size_t mask{ index.size() - 1 };
+        for (size_t slot = Hash(value) & mask;; slot = (slot + 1) & mask)
+        {
+            uint32_t id{ index[slot] };
+            if (id == EmptySlot)
+            {
+                id = static_cast<uint32_t>(offsets.size() - 1);
+                characters.insert(characters.end(), value.begin(), value.end());
+                offsets.push_back(static_cast<uint32_t>(characters.size()));
+                index[slot] = id;
+                return id;
+            }
+            if (View(id) == value)
+            {
+                return id;
+            }
+        }
+    }
+
+    void TrackMetadataStore::GrowIndex()
+    {
+        std::vector<uint32_t> grown(std::max<size_t>(index.size() * 2, 64), EmptySlot);
+        size_t mask{ grown.size() - 1 };
+        for (uint32_t id = 0; id + 1 < offsets.size(); id++)
+        {
+            size_t slot{ Hash(View(id)) & mask };
+            while (grown[slot] != EmptySlot)
+            {
+                slot = (slot + 1) & mask;
+            }
+            grown[slot] = id;
+        }
+        index = std::move(grown);
+    }
+
+    uint32_t TrackMetadataStore::Hash(std::wstring_view value) noexcept
+    {
+        // 32-bit FNV-1a
+        uint32_t hash{ 2166136261u };
+        for (wchar_t c : value)
+        {
+            hash = (hash ^ static_cast<uint32_t>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    /// <summary>
+    /// Where a URL divides into the directory that tracks share and the name that sets a track
+    /// apart: just after the last slash that comes before any query string.
+    /// </summary>
+    size_t TrackMetadataStore::SplitPoint(std::wstring_view url) noexcept
+    {
+        size_t slash{ url.substr(0, url.find(L'?')).rfind(L'/') };
+        return slash == std::wstring_view::npos ? 0 : slash + 1;
+    }
+}
@@ -0,0 +1,90 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    class BinaryPlaylist;
+
+    /// <summary>
+    /// The metadata of every track in a playlist, stored column by column with each distinct string
+    /// stored once.
+    ///
+    /// A track is a row: a handful of 32-bit ids into a shared string pool. URLs are split after their
+    /// last slash into a directory and a file name, which are interned separately, so the directory
+    /// that every track in a playlist shares is stored once however many tracks there are; so is an
+    /// artist's name. The pool is a single character buffer, and the intern table an open-addressed
+    /// array of ids, so the whole store is a few large allocations rather than several per track.
+    ///
+    /// A store can also stand in front of a BinaryPlaylist, whose tracks are then its first rows. Those
+    /// are read from the mapping as they are asked for, and nothing is copied out of it up front;
+    /// rows appended later go in the columns as usual.
+    ///
+    /// Rows are only ever added, and are not changed once they are. A row whose track has been
+    /// removed from the playlist stays until the playlist is replaced and the store with it. Like the
+    /// vector it stands behind, a store must only be used from one thread at a time.
+    /// </summary>
+    class TrackMetadataStore
+    {
+    public:
+        enum class Field : uint32_t
+        {
+            Src,
+            Title,
+            Artist,
+            ThumbnailSrc,
+        };
+
+        TrackMetadataStore() = default;
+        explicit TrackMetadataStore(std::shared_ptr<BinaryPlaylist const> mapped);
+
+        uint32_t Append(std::wstring_view src, std::wstring_view title, std::wstring_view artist, std::wstring_view thumbnailSrc);
+        hstring Get(uint32_t row, Field field) const;
+
+        uint32_t RowCount() const noexcept { return mappedRowCount + static_cast<uint32_t>(titles.size()); }
+        uint32_t MappedRowCount() const noexcept { return mappedRowCount; }
+        void Reserve(uint32_t rowCount);
+
+        /// <summary>
+        /// The bytes the store has allocated, and an estimate of what the same rows would take as
+        /// separate objects with a string allocation for each field. Mapped rows take no memory of
+        /// the store's own; the mapping is shared with the file cache.
+        /// </summary>
+        size_t MemoryBytes() const noexcept;
+        size_t SeparateObjectBytes() const;
+        void LogStatistics() const;
+
+    private:
+        static constexpr uint32_t EmptySlot{ UINT32_MAX };
+
+        void Set(uint32_t column, Field field, std::wstring_view value);
+        size_t FieldLength(uint32_t row, Field field) const;
+        std::wstring_view View(uint32_t id) const noexcept;
+        uint32_t Intern(std::wstring_view value);
+        void GrowIndex();
+        static uint32_t Hash(std::wstring_view value) noexcept;
+        static size_t SplitPoint(std::wstring_view url) noexcept;
+
+        std::shared_ptr<BinaryPlaylist const> mapped{};
+        uint32_t mappedRowCount{ 0 };
+
+        // String id n is characters[offsets[n], offsets[n + 1])
+        std::vector<wchar_t> characters{};
+        std::vector<uint32_t> offsets{ 0 };
+
+        // Open-addressed with linear probing; each slot is a string id or EmptySlot
+        std::vector<uint32_t> index{};
+
+        // One entry per row after the mapped ones
+        std::vector<uint32_t> srcDirectories{};
+        std::vector<uint32_t> srcNames{};
+        std::vector<uint32_t> titles{};
+        std::vector<uint32_t> artists{};
+        std::vector<uint32_t> thumbnailDirectories{};
+        std::vector<uint32_t> thumbnailNames{};
+    };
+}
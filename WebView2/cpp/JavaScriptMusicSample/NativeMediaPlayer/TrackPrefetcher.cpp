@@ -0,0 +1,400 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TrackPrefetcher.h"
+#include "SharedHttpClient.h"
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <winrt/Windows.Storage.h>
+#include <winrt/Windows.System.h>
+#include <winrt/Windows.Web.Http.Headers.h>
+
+using namespace winrt;
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Storage;
+using namespace winrt::Windows::Storage::Streams;
+using namespace winrt::Windows::System;
+using namespace winrt::Windows::Web::Http;
+
+namespace
+{
+    /// <summary>
+    /// The track's own stream, shared by a PrefetchedStream and all of its clones. It is opened by
+    /// the first read that goes past the prefetched bytes, and closed once the last of them is gone.
+    /// </summary>
+    struct SharedSource
+    {
+        explicit SharedSource(hstring uri) : uri{ uri }
+        {
+        }
+
+        ~SharedSource()
+        {
+            if (stream)
+            {
+                stream.Close();
+            }
+        }
+
+        hstring uri;
+        std::atomic<bool> opening{ false };
+        handle opened{ check_pointer(CreateEvent(nullptr, TRUE, FALSE, nullptr)) };
+
+        // Set once, before opened is signaled
+        IRandomAccessStream stream{ nullptr };
+        std::exception_ptr error{};
+    };
+
+    /// <summary>
+    /// Opens the source on the first call. Later calls, including ones made while it is still
+    /// opening, wait for that open and share its result.
+    /// </summary>
+    IAsyncOperation<IRandomAccessStream> OpenSourceAsync(std::shared_ptr<SharedSource> source)
+    {
+        if (!source->opening.exchange(true))
+        {
+            try
+            {
+                source->stream = co_await RandomAccessStreamReference::CreateFromUri(Uri{ source->uri }).OpenReadAsync();
+            }
+            catch (...)
+            {
+                source->error = std::current_exception();
+            }
+            SetEvent(source->opened.get());
+        }
+        else
+        {
+            co_await resume_on_signal(source->opened.get());
+        }
+
+        if (source->error)
+        {
+            std::rethrow_exception(source->error);
+        }
+        co_return source->stream;
+    }
+
+    /// <summary>
+    /// A read-only stream over a track whose first bytes are already in memory. Reads within those
+    /// bytes are answered immediately, without touching the track's own stream; that is only opened
+    /// when playback first reads past them, so a track that is skipped early costs no second open.
+    /// </summary>
+    struct PrefetchedStream : implements<PrefetchedStream, IRandomAccessStream>
+    {
+        PrefetchedStream(std::shared_ptr<SharedSource> source, std::shared_ptr<std::vector<uint8_t> const> head, uint64_t size, std::atomic<uint64_t>& bytesServed) :
+            source{ std::move(source) }, head{ std::move(head) }, size{ size }, bytesServed{ bytesServed }
+        {
+        }
+
+        uint64_t Size() const noexcept { return size; }
+        void Size(uint64_t) { throw hresult_not_implemented(); }
+        uint64_t Position() const noexcept { return position; }
+        void Seek(uint64_t value) noexcept { position = value; }
+        bool CanRead() const noexcept { return true; }
+        bool CanWrite() const noexcept { return false; }
+
+        IRandomAccessStream CloneStream()
+        {
+            return make<PrefetchedStream>(source, head, size, bytesServed);
+        }
+
+        IInputStream GetInputStreamAt(uint64_t value)
+        {
+            IRandomAccessStream clone{ CloneStream() };
+            clone.Seek(value);
+            return clone;
+        }
+
+        IOutputStream GetOutputStreamAt(uint64_t) { throw hresult_not_implemented(); }
+        IAsyncOperationWithProgress<uint32_t, uint32_t> WriteAsync(IBuffer) { throw hresult_not_implemented(); }
+        IAsyncOperation<bool> FlushAsync() { throw hresult_not_implemented(); }
+
+        void Close()
+        {
+            // The source is closed when the last clone lets go of it
+            source = nullptr;
+        }
+
+        IAsyncOperationWithProgress<IBuffer, uint32_t> ReadAsync(IBuffer buffer, uint32_t count, InputStreamOptions options)
+        {
+            auto strongThis{ get_strong() };
+            std::shared_ptr<SharedSource> sharedSource{ source };
+            if (!sharedSource)
+            {
+                throw hresult_error(RO_E_CLOSED);
+            }
+
+            uint64_t start{ position };
+            count = std::min(count, buffer.Capacity());
+
+            // Whatever falls within the prefetched bytes is copied straight out of memory
+            uint32_t fromHead{ 0 };
+            if (start < head->size())
+            {
+                fromHead = static_cast<uint32_t>(std::min<uint64_t>(count, head->size() - start));
+                std::copy_n(head->data() + start, fromHead, buffer.data());
+                bytesServed += fromHead;
+            }
+            buffer.Length(fromHead);
+
+            // Only go to the source for the rest if the caller cannot make do with a partial read
+            if (fromHead < count && (fromHead == 0 || options != InputStreamOptions::Partial))
+            {
+                // Clones read through their own input stream, as they share the source's position
+                IRandomAccessStream stream{ co_await OpenSourceAsync(sharedSource) };
+                Buffer rest{ count - fromHead };
+                IBuffer read{ co_await stream.GetInputStreamAt(start + fromHead).ReadAsync(rest, count - fromHead, options) };
+                std::copy_n(read.data(), read.Length(), buffer.data() + fromHead);
+                buffer.Length(fromHead + read.Length());
+            }
+
+            position = start + buffer.Length();
+            co_return buffer;
+        }
+
+    private:
+        std::shared_ptr<SharedSource> source;
+        std::shared_ptr<std::vector<uint8_t> const> head;
+        uint64_t size;
+        std::atomic<uint64_t>& bytesServed;
+        std::atomic<uint64_t> position{ 0 };
+    };
+}
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    TrackPrefetcher& TrackPrefetcher::Instance()
+    {
+        static TrackPrefetcher instance{ &GetMemoryBudget };
+
+        // The budget shrinks as the app gets closer to its memory limit
+        static event_token memoryUsageIncreased{ MemoryManager::AppMemoryUsageIncreased([](auto&&, auto&&)
+        {
+            instance.TrimToMemoryLevel();
+        }) };
+        return instance;
+    }
+
+    TrackPrefetcher::TrackPrefetcher(std::function<size_t()> memoryBudget) :
+        memoryBudget{ std::move(memoryBudget) }
+    {
+    }
+
+    IAsyncAction TrackPrefetcher::PrefetchAsync(hstring uri)
+    {
+        std::wstring key{ uri };
+        {
+            std::lock_guard lock{ mutex };
+            if (entries.count(key) > 0 || pendingFetches.count(key) > 0 || memoryBudget() == 0)
+            {
+                co_return;
+            }
+            pendingFetches.insert(key);
+        }
+
+        // Keep the file and network work off the UI thread
+        co_await resume_background();
+
+        auto head{ std::make_shared<Head>() };
+        bool fetched{ false };
+        try
+        {
+            Uri parsedUri{ uri };
+            if (parsedUri.SchemeName() == L"http" || parsedUri.SchemeName() == L"https")
+            {
+                co_await FetchRemoteHeadAsync(parsedUri, head);
+            }
+            else
+            {
+                co_await FetchLocalHeadAsync(parsedUri, head);
+            }
+            fetched = !head->bytes.empty() && head->totalSize >= head->bytes.size();
+        }
+        catch (hresult_error const& ex)
+        {
+            hstring errStr = L"Failed to prefetch track: " + uri + L" " + ex.message() + L"\n";
+            OutputDebugString(errStr.c_str());
+        }
+
+        std::lock_guard lock{ mutex };
+        pendingFetches.erase(key);
+        if (!fetched)
+        {
+            stats.prefetchFailures++;
+            co_return;
+        }
+
+        stats.prefetches++;
+        stats.bytesPrefetched += head->bytes.size();
+        lru.push_front(key);
+        memoryBytes += head->bytes.size();
+        entries[key] = Entry{ head, lru.begin() };
+        EvictToBudget(memoryBudget());
+    }
+
+    IRandomAccessStream TrackPrefetcher::TryOpenStream(hstring const& uri, hstring& contentType)
+    {
+        std::shared_ptr<Head const> head{};
+        uint64_t lookups{ 0 };
+        {
+            std::lock_guard lock{ mutex };
+            auto it{ entries.find(std::wstring{ uri }) };
+            if (it != entries.end())
+            {
+                stats.hits++;
+                head = it->second.head;
+                lru.splice(lru.begin(), lru, it->second.lruPosition);
+            }
+            else
+            {
+                stats.misses++;
+            }
+            lookups = stats.hits + stats.misses;
+        }
+
+        if (lookups % StatisticsInterval == 0)
+        {
+            LogStatistics();
+        }
+        if (!head)
+        {
+            return nullptr;
+        }
+
+        contentType = head->contentType;
+
+        // The stream shares the bytes, so evicting the entry while the track plays is harmless
+        std::shared_ptr<std::vector<uint8_t> const> bytes{ head, &head->bytes };
+        return make<PrefetchedStream>(std::make_shared<SharedSource>(uri), bytes, head->totalSize, stats.bytesServedFromCache);
+    }
+
+    void TrackPrefetcher::TrimToMemoryLevel()
+    {
+        std::lock_guard lock{ mutex };
+        EvictToBudget(memoryBudget());
+    }
+
+    void TrackPrefetcher::LogStatistics() const
+    {
+        uint64_t hits{ stats.hits.load() };
+        uint64_t lookups{ hits + stats.misses.load() };
+
+        std::wostringstream strStream{};
+        strStream << L"[TrackPrefetcher: "
+            << L"Prefetches=" << stats.prefetches.load() << L", "
+            << L"PrefetchFailures=" << stats.prefetchFailures.load() << L", "
+            << L"Hits=" << hits << L", "
+            << L"Misses=" << stats.misses.load() << L", "
+            << L"HitRatePercent=" << (lookups > 0 ? hits * 100 / lookups : 0) << L", "
+            << L"Evictions=" << stats.evictions.load() << L", "
+            << L"BytesPrefetched=" << stats.bytesPrefetched.load() << L", "
+            << L"BytesServedFromCache=" << stats.bytesServedFromCache.load()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    IAsyncAction TrackPrefetcher::FetchLocalHeadAsync(Uri uri, std::shared_ptr<Head> head)
+    {
+        StorageFile file{ co_await StorageFile::GetFileFromApplicationUriAsync(uri) };
+        IRandomAccessStreamWithContentType stream{ co_await file.OpenReadAsync() };
+        head->totalSize = stream.Size();
+        head->contentType = stream.ContentType();
+
+        uint32_t length{ static_cast<uint32_t>(std::min<uint64_t>(PrefetchBytes, head->totalSize)) };
+        head->bytes.resize(length);
+        uint32_t filled{ 0 };
+        while (filled < length)
+        {
+            Buffer buffer{ length - filled };
+            IBuffer read{ co_await stream.ReadAsync(buffer, length - filled, InputStreamOptions::None) };
+            if (read.Length() == 0)
+            {
+                break;
+            }
+            std::copy_n(read.data(), read.Length(), head->bytes.data() + filled);
+            filled += read.Length();
+        }
+        head->bytes.resize(filled);
+    }
+
+    IAsyncAction TrackPrefetcher::FetchRemoteHeadAsync(Uri uri, std::shared_ptr<Head> head)
+    {
+        HttpRequestMessage request{ HttpMethod::Get(), uri };
+        request.Headers().TryAppendWithoutValidation(L"Range", L"bytes=0-" + to_hstring(PrefetchBytes - 1));
+        HttpResponseMessage response{ co_await GetSharedHttpClient().SendRequestAsync(request, HttpCompletionOption::ResponseHeadersRead) };
+        response.EnsureSuccessStatusCode();
+
+        // A server that honors the range reports the full size in Content-Range; one that ignores it
+        // sends the whole track, of which only the start is read
+        auto contentHeaders{ response.Content().Headers() };
+        if (response.StatusCode() == HttpStatusCode::PartialContent && contentHeaders.ContentRange() && contentHeaders.ContentRange().Length())
+        {
+            head->totalSize = contentHeaders.ContentRange().Length().Value();
+        }
+        else if (response.StatusCode() == HttpStatusCode::Ok && contentHeaders.ContentLength())
+        {
+            head->totalSize = contentHeaders.ContentLength().Value();
+        }
+        else
+        {
+            // Without the total size the stream cannot be presented to the player
+            co_return;
+        }
+        if (contentHeaders.ContentType())
+        {
+            head->contentType = contentHeaders.ContentType().MediaType();
+        }
+
+        IInputStream stream{ co_await response.Content().ReadAsInputStreamAsync() };
+        uint32_t length{ static_cast<uint32_t>(std::min<uint64_t>(PrefetchBytes, head->totalSize)) };
+        head->bytes.resize(length);
+        uint32_t filled{ 0 };
+        while (filled < length)
+        {
+            Buffer buffer{ length - filled };
+            IBuffer read{ co_await stream.ReadAsync(buffer, length - filled, InputStreamOptions::Partial) };
+            if (read.Length() == 0)
+            {
+                break;
+            }
+            std::copy_n(read.data(), read.Length(), head->bytes.data() + filled);
+            filled += read.Length();
+        }
+        head->bytes.resize(filled);
+        response.Close();
+    }
+
+    /// <summary>
+    /// How many bytes of track data may be cached at the app's current memory usage level.
+    /// </summary>
+    size_t TrackPrefetcher::GetMemoryBudget()
+    {
+        switch (MemoryManager::AppMemoryUsageLevel())
+        {
+        case AppMemoryUsageLevel::Low:
+            return 8 * PrefetchBytes;
+        case AppMemoryUsageLevel::Medium:
+            return 2 * PrefetchBytes;
+        default:
+            return 0;
+        }
+    }
+
+    /// <summary>
+    /// Drops least recently used entries until the cache fits in budget. The caller must hold mutex.
+    /// </summary>
+    void TrackPrefetcher::EvictToBudget(size_t budget)
+    {
+        while (memoryBytes > budget && !lru.empty())
+        {
+            auto it{ entries.find(lru.back()) };
+            memoryBytes -= it->second.head->bytes.size();
+            entries.erase(it);
+            lru.pop_back();
+            stats.evictions++;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <winrt/Windows.Storage.Streams.h>
+
+namespace winrt::NativeMediaPlayer::implementation
+{
+    /// <summary>
+    /// Reads the start of upcoming tracks into memory before they are needed, so that the switch to
+    /// the next track does not wait on slow storage or the network.
+    ///
+    /// PrefetchAsync fetches the first PrefetchBytes of a track. When the player later opens that
+    /// track, TryOpenStream hands it a stream that serves those bytes from memory, and only opens
+    /// the real source once playback reads past them.
+    ///
+    /// Cached heads are kept in an LRU list whose budget follows the app's memory usage level: the
+    /// cache shrinks as the app gets close to its limit and is dropped entirely at High.
+    /// </summary>
+    class TrackPrefetcher
+    {
+    public:
+        /// <summary>
+        /// Counters describing how effective prefetching has been since the app started.
+        /// </summary>
+        struct Statistics
+        {
+            std::atomic<uint64_t> prefetches{ 0 };
+            std::atomic<uint64_t> prefetchFailures{ 0 };
+            std::atomic<uint64_t> hits{ 0 };
+            std::atomic<uint64_t> misses{ 0 };
+            std::atomic<uint64_t> evictions{ 0 };
+            std::atomic<uint64_t> bytesPrefetched{ 0 };
+            std::atomic<uint64_t> bytesServedFromCache{ 0 };
+        };
+
+        /// <summary>
+        /// How much of each track is fetched ahead of time. At typical MP3 bitrates this is 30 seconds
+        /// or more of audio, which is plenty of time for the rest of the track to start streaming.
+        /// </summary>
+        static constexpr uint32_t PrefetchBytes{ 1024 * 1024 };
+
+        static TrackPrefetcher& Instance();
+
+        /// <summary>
+        /// A prefetcher whose cache may hold as many bytes as memoryBudget returns each time it is
+        /// asked. Instance follows the app's memory usage level; tests use a budget of their own.
+        /// </summary>
+        explicit TrackPrefetcher(std::function<size_t()> memoryBudget);
+        TrackPrefetcher(TrackPrefetcher const&) = delete;
+        TrackPrefetcher& operator=(TrackPrefetcher const&) = delete;
+
+        /// <summary>
+        /// Fetches the start of the track at uri into the cache, unless it is already there or on its
+        /// way. Failures are logged and otherwise ignored; the track is then simply opened normally.
+        /// </summary>
+        winrt::Windows::Foundation::IAsyncAction PrefetchAsync(hstring uri);
+
+        /// <summary>
+        /// Returns a stream over the track at uri that starts out reading from the cache, or nullptr if
+        /// its start has not been prefetched.
+        /// </summary>
+        winrt::Windows::Storage::Streams::IRandomAccessStream TryOpenStream(hstring const& uri, hstring& contentType);
+
+        void TrimToMemoryLevel();
+        Statistics const& Stats() const noexcept { return stats; }
+        void LogStatistics() const;
+
+    private:
+        struct Head
+        {
+            std::vector<uint8_t> bytes{};
+            uint64_t totalSize{ 0 };
+            hstring contentType{};
+        };
+
+        struct Entry
+        {
+            std::shared_ptr<Head const> head{};
+            std::list<std::wstring>::iterator lruPosition{};
+        };
+
+        static winrt::Windows::Foundation::IAsyncAction FetchLocalHeadAsync(winrt::Windows::Foundation::Uri uri, std::shared_ptr<Head> head);
+        static winrt::Windows::Foundation::IAsyncAction FetchRemoteHeadAsync(winrt::Windows::Foundation::Uri uri, std::shared_ptr<Head> head);
+        static size_t GetMemoryBudget();
+        void EvictToBudget(size_t budget);
+
+        std::function<size_t()> memoryBudget;
+        std::mutex mutex{};
+        std::list<std::wstring> lru{};
+        std::unordered_map<std::wstring, Entry> entries{};
+        std::unordered_set<std::wstring> pendingFetches{};
+        size_t memoryBytes{ 0 };
+        Statistics stats{};
+
+        // How many lookups go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 20 };
+    };
+}
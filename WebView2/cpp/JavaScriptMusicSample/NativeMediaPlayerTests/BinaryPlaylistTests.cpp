@@ -0,0 +1,170 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "BinaryPlaylist.h"
+#include "TrackMetadataStore.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using Field = BinaryPlaylist::Field;
+
+namespace
+{
+    winrt::hstring ResolveSrc(winrt::hstring const& id)
+    {
+        return winrt::hstring{ L"https://example.com/tracks/" + std::wstring{ id } + L".mp3" };
+    }
+
+    /// <summary>
+    /// A playlist file in the temp folder, deleted again when the test is done with it.
+    /// </summary>
+    class TempPlaylistFile
+    {
+    public:
+        explicit TempPlaylistFile(wchar_t const* name) :
+            path{ std::filesystem::temp_directory_path() / (std::wstring{ L"NativeMediaPlayerTests." } + name + BinaryPlaylist::FileExtension) }
+        {
+            std::filesystem::remove(path);
+        }
+
+        ~TempPlaylistFile()
+        {
+            std::error_code error{};
+            std::filesystem::remove(path, error);
+        }
+
+        winrt::hstring Path() const { return winrt::hstring{ path.wstring() }; }
+        std::filesystem::path const& FilesystemPath() const { return path; }
+
+    private:
+        std::filesystem::path path;
+    };
+
+    std::vector<PlaylistTrackRecord> MakeTracks()
+    {
+        return std::vector<PlaylistTrackRecord>{
+            // src resolved from the id when the file is written
+            PlaylistTrackRecord{ L"101", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg", L"" },
+            // Every field empty but the src, which is already known
+            PlaylistTrackRecord{ L"", L"", L"", L"", L"https://example.com/get?track=102" },
+            // The artist and image repeat the first track's, and the title needs more than ASCII
+            PlaylistTrackRecord{ L"103", L"Caf\x00E9 \xD83C\xDFB5", L"Computoser", L"https://example.com/art/1.jpg", L"" },
+        };
+    }
+}
+
+TEST(BinaryPlaylistRoundTripsEveryField)
+{
+    TempPlaylistFile file{ L"RoundTrip" };
+    std::vector<PlaylistTrackRecord> tracks{ MakeTracks() };
+    BinaryPlaylist::Write(file.Path(), tracks, &ResolveSrc);
+
+    std::shared_ptr<BinaryPlaylist> playlist{ BinaryPlaylist::TryOpen(file.Path()) };
+    CHECK(playlist != nullptr);
+    CHECK(playlist->Size() == tracks.size());
+    for (uint32_t i = 0; i < tracks.size(); i++)
+    {
+        winrt::hstring expectedSrc{ tracks[i].src.empty() ? ResolveSrc(tracks[i].id) : tracks[i].src };
+        CHECK(playlist->GetField(i, Field::Id) == tracks[i].id);
+        CHECK(playlist->GetField(i, Field::Src) == expectedSrc);
+        CHECK(playlist->GetField(i, Field::Title) == tracks[i].title);
+        CHECK(playlist->GetField(i, Field::Artist) == tracks[i].artist);
+        CHECK(playlist->GetField(i, Field::Image) == tracks[i].image);
+
+        PlaylistTrackRecord track{ playlist->GetTrack(i) };
+        CHECK(track.id == tracks[i].id);
+        CHECK(track.src == expectedSrc);
+        CHECK(track.title == tracks[i].title);
+        CHECK(track.artist == tracks[i].artist);
+        CHECK(track.image == tracks[i].image);
+    }
+
+    // Repeated strings are stored once, so their fields point at the same characters
+    CHECK(playlist->GetField(0, Field::Artist).data() == playlist->GetField(2, Field::Artist).data());
+
+    bool threw{ false };
+    try
+    {
+        playlist->GetField(static_cast<uint32_t>(tracks.size()), Field::Title);
+    }
+    catch (winrt::hresult_out_of_bounds const&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(BinaryPlaylistWritesEmptyPlaylist)
+{
+    TempPlaylistFile file{ L"Empty" };
+    BinaryPlaylist::Write(file.Path(), {}, &ResolveSrc);
+    std::shared_ptr<BinaryPlaylist> playlist{ BinaryPlaylist::TryOpen(file.Path()) };
+    CHECK(playlist != nullptr);
+    CHECK(playlist->Size() == 0);
+}
+
+TEST(BinaryPlaylistRejectsDamagedFiles)
+{
+    TempPlaylistFile missing{ L"Missing" };
+    CHECK(BinaryPlaylist::TryOpen(missing.Path()) == nullptr);
+
+    TempPlaylistFile file{ L"Whole" };
+    BinaryPlaylist::Write(file.Path(), MakeTracks(), &ResolveSrc);
+    uintmax_t fileSize{ std::filesystem::file_size(file.FilesystemPath()) };
+
+    // Cut off in the header, in the track table and in the string table
+    TempPlaylistFile truncated{ L"Truncated" };
+    for (uintmax_t size : { uintmax_t{ 0 }, uintmax_t{ 10 }, uintmax_t{ 60 }, fileSize - 2 })
+    {
+        std::filesystem::copy_file(file.FilesystemPath(), truncated.FilesystemPath(), std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(truncated.FilesystemPath(), size);
+        CHECK(BinaryPlaylist::TryOpen(truncated.Path()) == nullptr);
+    }
+
+    // A version this code does not understand; the version follows the four-byte magic
+    TempPlaylistFile newerVersion{ L"NewerVersion" };
+    std::filesystem::copy_file(file.FilesystemPath(), newerVersion.FilesystemPath());
+    {
+        std::fstream stream{ newerVersion.FilesystemPath(), std::ios::in | std::ios::out | std::ios::binary };
+        uint16_t version{ BinaryPlaylist::FormatVersion + 1 };
+        stream.seekp(4);
+        stream.write(reinterpret_cast<char const*>(&version), sizeof(version));
+        CHECK(stream.good());
+    }
+    CHECK(BinaryPlaylist::TryOpen(newerVersion.Path()) == nullptr);
+}
+
+TEST(TrackMetadataStoreReadsMappedRows)
+{
+    TempPlaylistFile file{ L"Store" };
+    std::vector<PlaylistTrackRecord> tracks{ MakeTracks() };
+    BinaryPlaylist::Write(file.Path(), tracks, &ResolveSrc);
+
+    TrackMetadataStore store{ BinaryPlaylist::TryOpen(file.Path()) };
+    CHECK(store.MappedRowCount() == 3);
+    CHECK(store.RowCount() == 3);
+
+    // Mapped rows are read from the file, so the store has nothing of its own yet
+    CHECK(store.MemoryBytes() == TrackMetadataStore{}.MemoryBytes());
+
+    // Rows appended after the mapped ones go in the store's own columns
+    CHECK(store.Append(L"https://example.com/tracks/104.mp3", L"Appended", L"Computoser", L"") == 3);
+    CHECK(store.MappedRowCount() == 3);
+    CHECK(store.RowCount() == 4);
+
+    using StoreField = TrackMetadataStore::Field;
+    for (uint32_t i = 0; i < tracks.size(); i++)
+    {
+        CHECK(store.Get(i, StoreField::Src) == (tracks[i].src.empty() ? ResolveSrc(tracks[i].id) : tracks[i].src));
+        CHECK(store.Get(i, StoreField::Title) == tracks[i].title);
+        CHECK(store.Get(i, StoreField::Artist) == tracks[i].artist);
+        CHECK(store.Get(i, StoreField::ThumbnailSrc) == tracks[i].image);
+    }
+    CHECK(store.Get(3, StoreField::Src) == L"https://example.com/tracks/104.mp3");
+    CHECK(store.Get(3, StoreField::Title) == L"Appended");
+    CHECK(store.Get(3, StoreField::Artist) == L"Computoser");
+    CHECK(store.Get(3, StoreField::ThumbnailSrc) == L"");
+}
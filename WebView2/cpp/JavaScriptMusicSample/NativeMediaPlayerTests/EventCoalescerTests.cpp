@@ -0,0 +1,196 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "EventCoalescer.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+
+namespace
+{
+    enum Event : uint32_t
+    {
+        PositionChanged,
+        PlaybackStateChanged,
+    };
+
+    constexpr uint32_t PositionUpdates{ 500 };
+    constexpr std::chrono::microseconds PositionInterval{ 1000 };
+
+    // How long the UI thread takes over each delivery, longer than the gap between updates
+    constexpr std::chrono::milliseconds DeliveryWork{ 4 };
+
+    /// <summary>
+    /// Stands in for the CoreDispatcher: one thread running queued callbacks in order.
+    /// </summary>
+    class DispatcherThread
+    {
+    public:
+        DispatcherThread() : worker{ [this]() { Run(); } }
+        {
+        }
+
+        ~DispatcherThread()
+        {
+            {
+                std::lock_guard lock{ mutex };
+                stopping = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+
+        void RunAsync(std::function<void()> callback)
+        {
+            std::lock_guard lock{ mutex };
+            queue.push_back(std::move(callback));
+            maxQueued = std::max(maxQueued, queue.size());
+            callbacks++;
+            wake.notify_one();
+        }
+
+        void WaitUntilIdle()
+        {
+            std::unique_lock lock{ mutex };
+            idle.wait(lock, [&]() { return queue.empty() && !running; });
+        }
+
+        size_t MaxQueued()
+        {
+            std::lock_guard lock{ mutex };
+            return maxQueued;
+        }
+
+        uint64_t Callbacks()
+        {
+            std::lock_guard lock{ mutex };
+            return callbacks;
+        }
+
+    private:
+        void Run()
+        {
+            std::unique_lock lock{ mutex };
+            while (true)
+            {
+                wake.wait(lock, [&]() { return stopping || !queue.empty(); });
+                if (queue.empty())
+                {
+                    return;
+                }
+
+                std::function<void()> callback{ std::move(queue.front()) };
+                queue.pop_front();
+                running = true;
+                lock.unlock();
+                callback();
+                lock.lock();
+                running = false;
+                idle.notify_all();
+            }
+        }
+
+        std::mutex mutex{};
+        std::condition_variable wake{};
+        std::condition_variable idle{};
+        std::deque<std::function<void()>> queue{};
+        size_t maxQueued{ 0 };
+        uint64_t callbacks{ 0 };
+        bool running{ false };
+        bool stopping{ false };
+        std::thread worker;
+    };
+}
+
+TEST(EventCoalescerDeliversLatestValues)
+{
+    std::vector<std::function<void()>> scheduled{};
+    std::vector<std::pair<uint32_t, int64_t>> delivered{};
+    EventCoalescer coalescer{ [&](std::function<void()> callback) { scheduled.push_back(std::move(callback)); },
+        [&](EventCoalescer::PendingEvents const& events)
+        {
+            for (uint32_t kind : { PositionChanged, PlaybackStateChanged })
+            {
+                if (events.Contains(kind))
+                {
+                    delivered.emplace_back(kind, events.ValueOf(kind));
+                }
+            }
+        } };
+
+    coalescer.Raise(PositionChanged, 1);
+    coalescer.Raise(PositionChanged, 2);
+    coalescer.Raise(PlaybackStateChanged, 7);
+    coalescer.Raise(PositionChanged, 3);
+    CHECK(scheduled.size() == 1);
+    CHECK(delivered.empty());
+
+    scheduled[0]();
+    CHECK(delivered == (std::vector<std::pair<uint32_t, int64_t>>{ { PositionChanged, 3 }, { PlaybackStateChanged, 7 } }));
+
+    // Once a callback has run, the next raise schedules another
+    coalescer.Raise(PositionChanged, 4);
+    CHECK(scheduled.size() == 2);
+    scheduled[1]();
+    CHECK(delivered.back() == (std::pair<uint32_t, int64_t>{ PositionChanged, 4 }));
+
+    CHECK(coalescer.Stats().raised == 5);
+    CHECK(coalescer.Stats().delivered == 3);
+    CHECK(coalescer.Stats().dispatcherCallbacks == 2);
+}
+
+TEST(EventCoalescerBoundsDispatcherLoadAt1kHz)
+{
+    DispatcherThread dispatcher{};
+    std::atomic<int64_t> lastPosition{ -1 };
+    std::atomic<int64_t> lastState{ -1 };
+    EventCoalescer coalescer{ [&](std::function<void()> callback) { dispatcher.RunAsync(std::move(callback)); },
+        [&](EventCoalescer::PendingEvents const& events)
+        {
+            if (events.Contains(PositionChanged))
+            {
+                lastPosition = events.ValueOf(PositionChanged);
+            }
+            if (events.Contains(PlaybackStateChanged))
+            {
+                lastState = events.ValueOf(PlaybackStateChanged);
+            }
+            std::this_thread::sleep_for(DeliveryWork);
+        } };
+
+    // Raised from a thread of its own, as the media pipeline does, at 1 kHz. The deadline is spun
+    // on rather than slept until, since a sleep can take a whole timer tick.
+    std::thread mediaThread{ [&]()
+    {
+        auto deadline{ std::chrono::steady_clock::now() };
+        for (uint32_t i = 0; i < PositionUpdates; i++)
+        {
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            deadline += PositionInterval;
+
+            coalescer.Raise(PositionChanged, i);
+            if (i % 100 == 0)
+            {
+                coalescer.Raise(PlaybackStateChanged, i / 100);
+            }
+        }
+    } };
+    mediaThread.join();
+    dispatcher.WaitUntilIdle();
+
+    // Never more than one callback waiting, far fewer callbacks than updates, and nothing lost
+    CHECK(dispatcher.MaxQueued() == 1);
+    CHECK(dispatcher.Callbacks() == coalescer.Stats().dispatcherCallbacks);
+    CHECK(coalescer.Stats().raised == PositionUpdates + PositionUpdates / 100);
+    CHECK(coalescer.Stats().dispatcherCallbacks <= PositionUpdates / 2);
+    CHECK(lastPosition == PositionUpdates - 1);
+    CHECK(lastState == (PositionUpdates - 1) / 100);
+}
@@ -0,0 +1,192 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "LocalHttpServer.h"
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <cctype>
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace
+{
+    [[noreturn]] void ThrowLastSocketError()
+    {
+        winrt::throw_hresult(HRESULT_FROM_WIN32(WSAGetLastError()));
+    }
+
+    char const* ReasonPhrase(int status)
+    {
+        switch (status)
+        {
+        case 200:
+            return "OK";
+        case 206:
+            return "Partial Content";
+        case 304:
+            return "Not Modified";
+        case 404:
+            return "Not Found";
+        case 500:
+            return "Internal Server Error";
+        }
+        return "Unknown";
+    }
+
+    std::string ToLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::string Trim(std::string const& text)
+    {
+        size_t first{ text.find_first_not_of(" \t") };
+        size_t last{ text.find_last_not_of(" \t") };
+        return first == std::string::npos ? std::string{} : text.substr(first, last - first + 1);
+    }
+}
+
+namespace NativeMediaPlayerTests
+{
+    std::string LocalHttpServer::Request::Header(std::string const& name) const
+    {
+        for (auto const& [headerName, value] : headers)
+        {
+            if (headerName == name)
+            {
+                return value;
+            }
+        }
+        return {};
+    }
+
+    LocalHttpServer::LocalHttpServer(Handler handler) :
+        handler{ std::move(handler) }
+    {
+        WSADATA data{};
+        if (int error{ WSAStartup(MAKEWORD(2, 2), &data) }; error != 0)
+        {
+            winrt::throw_hresult(HRESULT_FROM_WIN32(error));
+        }
+
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == INVALID_SOCKET)
+        {
+            ThrowLastSocketError();
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        int addressLength{ sizeof(address) };
+        if (bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 ||
+            getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0 ||
+            listen(listener, SOMAXCONN) != 0)
+        {
+            ThrowLastSocketError();
+        }
+        port = ntohs(address.sin_port);
+
+        worker = std::thread{ [this]() { Run(); } };
+    }
+
+    LocalHttpServer::~LocalHttpServer()
+    {
+        // Closing the socket fails the accept the worker is waiting in
+        closesocket(listener);
+        worker.join();
+        WSACleanup();
+    }
+
+    winrt::Windows::Foundation::Uri LocalHttpServer::Uri(std::wstring const& path) const
+    {
+        return winrt::Windows::Foundation::Uri{ L"http://127.0.0.1:" + std::to_wstring(port) + path };
+    }
+
+    std::vector<LocalHttpServer::Request> LocalHttpServer::Requests() const
+    {
+        std::lock_guard lock{ mutex };
+        return requests;
+    }
+
+    void LocalHttpServer::Run()
+    {
+        while (true)
+        {
+            SOCKET connection{ accept(listener, nullptr, nullptr) };
+            if (connection == INVALID_SOCKET)
+            {
+                return;
+            }
+            Serve(connection);
+            closesocket(connection);
+        }
+    }
+
+    void LocalHttpServer::Serve(SOCKET connection)
+    {
+        // Only GET requests are expected, so the request ends with its headers
+        std::string received{};
+        size_t headersEnd{ std::string::npos };
+        while (headersEnd == std::string::npos)
+        {
+            char buffer[4096];
+            int length{ recv(connection, buffer, sizeof(buffer), 0) };
+            if (length <= 0)
+            {
+                return;
+            }
+            received.append(buffer, length);
+            headersEnd = received.find("\r\n\r\n");
+        }
+
+        Request request{};
+        size_t lineStart{ 0 };
+        for (size_t lineEnd{ received.find("\r\n") }; lineEnd <= headersEnd; lineStart = lineEnd + 2, lineEnd = received.find("\r\n", lineStart))
+        {
+            std::string line{ received.substr(lineStart, lineEnd - lineStart) };
+            if (lineStart == 0)
+            {
+                size_t methodEnd{ line.find(' ') };
+                size_t pathEnd{ line.find(' ', methodEnd + 1) };
+                request.method = line.substr(0, methodEnd);
+                request.path = line.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+            }
+            else if (size_t colon{ line.find(':') }; colon != std::string::npos)
+            {
+                request.headers.emplace_back(ToLower(line.substr(0, colon)), Trim(line.substr(colon + 1)));
+            }
+        }
+
+        {
+            std::lock_guard lock{ mutex };
+            requests.push_back(request);
+        }
+
+        Response response{ handler(request) };
+        std::string sent{ "HTTP/1.1 " + std::to_string(response.status) + " " + ReasonPhrase(response.status) + "\r\n" };
+        for (auto const& [name, value] : response.headers)
+        {
+            sent += name + ": " + value + "\r\n";
+        }
+        if (response.status != 304)
+        {
+            sent += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+        }
+        sent += "Connection: close\r\n\r\n" + response.body;
+
+        for (size_t offset{ 0 }; offset < sent.size();)
+        {
+            int length{ send(connection, sent.data() + offset, static_cast<int>(sent.size() - offset), 0) };
+            if (length <= 0)
+            {
+                return;
+            }
+            offset += length;
+        }
+        shutdown(connection, SD_SEND);
+    }
+}
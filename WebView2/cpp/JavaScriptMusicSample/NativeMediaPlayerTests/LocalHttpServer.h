@@ -0,0 +1,74 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <winsock2.h>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace NativeMediaPlayerTests
+{
+    /// <summary>
+    /// An HTTP server on the loopback interface, so that code which fetches from the web can be
+    /// tested without it. It answers one request per connection, in the order they arrive, with
+    /// whatever the handler returns, and keeps every request it was sent so that tests can check
+    /// what the client asked for.
+    /// </summary>
+    class LocalHttpServer
+    {
+    public:
+        struct Request
+        {
+            std::string method{};
+            std::string path{};
+
+            // Names are lowercase, since HTTP header names are not case sensitive
+            std::vector<std::pair<std::string, std::string>> headers{};
+
+            /// <summary>
+            /// The value of the header with the given lowercase name, or an empty string.
+            /// </summary>
+            std::string Header(std::string const& name) const;
+        };
+
+        struct Response
+        {
+            int status{ 200 };
+            std::vector<std::pair<std::string, std::string>> headers{};
+            std::string body{};
+        };
+
+        using Handler = std::function<Response(Request const&)>;
+
+        /// <summary>
+        /// Starts listening on a port the system picks.
+        /// </summary>
+        explicit LocalHttpServer(Handler handler);
+        ~LocalHttpServer();
+        LocalHttpServer(LocalHttpServer const&) = delete;
+        LocalHttpServer& operator=(LocalHttpServer const&) = delete;
+
+        /// <summary>
+        /// The address of path on this server, which must start with a slash.
+        /// </summary>
+        winrt::Windows::Foundation::Uri Uri(std::wstring const& path) const;
+
+        std::vector<Request> Requests() const;
+
+    private:
+        void Run();
+        void Serve(SOCKET connection);
+
+        Handler handler;
+        SOCKET listener{ INVALID_SOCKET };
+        uint16_t port{ 0 };
+
+        mutable std::mutex mutex{};
+        std::vector<Request> requests{};
+        std::thread worker{};
+    };
+}
@@ -0,0 +1,185 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "PlayQueue.h"
+#include <set>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using winrt::NativeMediaPlayer::PlaybackRepeatMode;
+
+namespace
+{
+    constexpr uint32_t BenchmarkTrackCount{ 100000 };
+    constexpr uint32_t BenchmarkOperations{ 1000000 };
+}
+
+TEST(PlayQueueShufflePlaysEveryTrackOnce)
+{
+    for (uint32_t trackCount : { 1u, 2u, 3u, 7u, 100u, 1000u, 4097u })
+    {
+        PlayQueue queue{};
+        queue.SetShuffle(true, 42);
+        queue.Reset(trackCount, trackCount / 2);
+
+        std::vector<uint32_t> ahead{ queue.PeekAhead(trackCount) };
+        CHECK(ahead.size() == trackCount - 1);
+
+        std::set<uint32_t> played{ *queue.Current() };
+        for (uint32_t i = 1; i < trackCount; i++)
+        {
+            std::optional<uint32_t> track{ queue.Advance(false) };
+            CHECK(track && *track == ahead[i - 1]);
+            CHECK(played.insert(*track).second);
+        }
+        CHECK(!queue.Advance(false));
+
+        // History retraces the whole pass
+        for (uint32_t i = 1; i < trackCount; i++)
+        {
+            CHECK(queue.Retreat());
+        }
+        CHECK(*queue.Current() == trackCount / 2);
+        CHECK(!queue.Retreat());
+    }
+}
+
+TEST(PlayQueueShuffleIsReproducible)
+{
+    PlayQueue first{};
+    PlayQueue second{};
+    first.SetShuffle(true, 7);
+    second.SetShuffle(true, 7);
+    first.Reset(50, 0);
+    second.Reset(50, 0);
+    CHECK(first.PeekAhead(49) == second.PeekAhead(49));
+}
+
+TEST(PlayQueuePlayNextAndRepeat)
+{
+    PlayQueue queue{};
+    queue.Reset(10, 5);
+
+    // Without history, going back walks the playlist order
+    CHECK(*queue.Retreat() == 4);
+    CHECK(*queue.Retreat() == 3);
+    CHECK(*queue.Advance(true) == 4);
+
+    // A queued track plays next, and the base order carries on after it
+    queue.PlayNext(9);
+    CHECK(*queue.Advance(true) == 9);
+    CHECK(*queue.Advance(true) == 5);
+    CHECK(*queue.Retreat() == 9);
+    CHECK(*queue.Advance(true) == 5);
+    CHECK(*queue.Advance(true) == 6);
+
+    // Repeat-one only holds a track that finishes by itself
+    queue.RepeatMode(PlaybackRepeatMode::One);
+    CHECK(*queue.Advance(false) == 6);
+    CHECK(*queue.Advance(true) == 7);
+
+    queue.RepeatMode(PlaybackRepeatMode::All);
+    CHECK(*queue.Advance(true) == 8);
+    CHECK(*queue.Advance(true) == 9);
+    CHECK(*queue.Advance(false) == 0);
+
+    std::vector<uint32_t> behind{ queue.PeekBehind(3) };
+    CHECK(behind == (std::vector<uint32_t>{ 9, 8, 7 }));
+}
+
+TEST(PlayQueueRemapKeepsQueuedTracks)
+{
+    PlayQueue queue{};
+    queue.Reset(10, 3);
+    queue.Advance(true);
+    queue.PlayNext(8);
+
+    // Odd tracks are removed and the rest move down to half their index
+    queue.Remap(5, [](uint32_t track) { return track % 2 ? std::nullopt : std::optional<uint32_t>{ track / 2 }; });
+    CHECK(*queue.Current() == 2);
+
+    std::vector<uint32_t> ahead{ queue.PeekAhead(2) };
+    CHECK(ahead.size() == 2 && ahead[0] == 4 && ahead[1] == 3);
+}
+
+BENCHMARK(PlayQueueThroughput)
+{
+    auto report = [](char const* measurement, double seconds)
+    {
+        NativeMediaPlayerTests::Report(measurement, BenchmarkOperations / seconds / 1e6, "M ops/s");
+    };
+
+    PlayQueue queue{};
+    queue.RepeatMode(PlaybackRepeatMode::All);
+    double shuffleSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        queue.SetShuffle(true, 1);
+        queue.Reset(BenchmarkTrackCount, 0);
+    }) };
+    NativeMediaPlayerTests::Report("Shuffle 100k tracks", shuffleSeconds * 1e6, "us");
+
+    report("Skip next, shuffled", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            queue.Advance(true);
+        }
+    }));
+
+    report("Skip previous, shuffled", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            if (!queue.Retreat())
+            {
+                queue.Advance(true);
+            }
+        }
+    }));
+
+    report("Play next insert", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            queue.PlayNext(i % BenchmarkTrackCount);
+        }
+    }));
+
+    report("Skip next through inserted", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            queue.Advance(true);
+        }
+    }));
+
+    report("Insert and skip, interleaved", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            if (i % 10 == 0)
+            {
+                queue.PlayNext(i % BenchmarkTrackCount);
+            }
+            queue.Advance(true);
+        }
+    }));
+
+    report("Jump to track", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            queue.JumpTo((i * 7919u) % BenchmarkTrackCount);
+        }
+    }));
+
+    report("Peek 2 ahead and 2 behind", NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkOperations; i++)
+        {
+            CHECK(queue.PeekAhead(2).size() == 2);
+            CHECK(queue.PeekBehind(2).size() == 2);
+        }
+    }));
+}
@@ -0,0 +1,204 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "PlaybackStateSnapshot.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using namespace winrt::Windows::Data::Json;
+using winrt::NativeMediaPlayer::PlaybackRepeatMode;
+
+namespace
+{
+    constexpr uint32_t BenchmarkRefreshes{ 20000 };
+
+    PlaybackStateSnapshot MakeSnapshot()
+    {
+        PlaybackStateSnapshot snapshot{};
+        snapshot.version = 12;
+        snapshot.paused = false;
+        snapshot.ended = false;
+        snapshot.muted = true;
+        snapshot.volume = 0.5;
+        snapshot.currentTime = 42.25;
+        snapshot.duration = 180;
+        snapshot.currentTrackIndex = 3;
+        snapshot.playlistLength = 10;
+        snapshot.shuffleEnabled = true;
+        snapshot.repeatMode = PlaybackRepeatMode::All;
+        snapshot.currentTrack = PlaybackStateSnapshot::Track{
+            L"ms-appx-web:///tracks/104.mp3",
+            L"Silence \"With\" Nothing",
+            L"Computoser",
+            L"https://raw.githubusercontent.com/microsoft/Windows-universal-samples/main/SharedContent/media/Samples/LandscapeImage4.jpg",
+            L"" };
+        return snapshot;
+    }
+
+    /// <summary>
+    /// Stands in for the WinRTAdapter's synchronous proxy. Every call is handed to another thread,
+    /// which runs it and hands the result back while the caller waits, the way each property the
+    /// page reads blocks on a round trip to the app.
+    /// </summary>
+    class DispatchLayer
+    {
+    public:
+        DispatchLayer() : worker{ [this]() { Run(); } }
+        {
+        }
+
+        ~DispatchLayer()
+        {
+            {
+                std::lock_guard lock{ mutex };
+                stopping = true;
+            }
+            requested.notify_one();
+            worker.join();
+        }
+
+        template <typename Function>
+        auto Call(Function&& function)
+        {
+            decltype(function()) result{};
+            std::unique_lock lock{ mutex };
+            request = [&]() { result = function(); };
+            requested.notify_one();
+            completed.wait(lock, [&]() { return !request; });
+            roundTrips++;
+            return result;
+        }
+
+        uint64_t RoundTrips() const noexcept { return roundTrips; }
+
+    private:
+        void Run()
+        {
+            std::unique_lock lock{ mutex };
+            while (true)
+            {
+                requested.wait(lock, [&]() { return request || stopping; });
+                if (stopping)
+                {
+                    return;
+                }
+                request();
+                request = nullptr;
+                completed.notify_one();
+            }
+        }
+
+        std::mutex mutex{};
+        std::condition_variable requested{};
+        std::condition_variable completed{};
+        std::function<void()> request{};
+        bool stopping{ false };
+        uint64_t roundTrips{ 0 };
+        std::thread worker;
+    };
+}
+
+TEST(PlaybackStateSnapshotHasEveryField)
+{
+    JsonObject snapshot{ JsonObject::Parse(MakeSnapshot().Stringify()) };
+    CHECK(snapshot.GetNamedNumber(L"version") == 12);
+    CHECK(!snapshot.GetNamedBoolean(L"paused"));
+    CHECK(!snapshot.GetNamedBoolean(L"ended"));
+    CHECK(snapshot.GetNamedBoolean(L"muted"));
+    CHECK(snapshot.GetNamedNumber(L"volume") == 0.5);
+    CHECK(snapshot.GetNamedNumber(L"currentTime") == 42.25);
+    CHECK(snapshot.GetNamedNumber(L"duration") == 180);
+    CHECK(snapshot.GetNamedNumber(L"currentTrackIndex") == 3);
+    CHECK(snapshot.GetNamedNumber(L"playlistLength") == 10);
+    CHECK(snapshot.GetNamedBoolean(L"shuffleEnabled"));
+    CHECK(snapshot.GetNamedNumber(L"repeatMode") == static_cast<double>(PlaybackRepeatMode::All));
+
+    JsonObject track{ snapshot.GetNamedObject(L"currentTrack") };
+    CHECK(track.GetNamedString(L"src") == L"ms-appx-web:///tracks/104.mp3");
+    CHECK(track.GetNamedString(L"title") == L"Silence \"With\" Nothing");
+    CHECK(track.GetNamedString(L"artist") == L"Computoser");
+    CHECK(track.GetNamedString(L"thumbnailSrc").size() > 0);
+    CHECK(track.GetNamedString(L"cachedThumbnailSrc").empty());
+}
+
+TEST(PlaybackStateSnapshotWithoutTrack)
+{
+    PlaybackStateSnapshot snapshot{ MakeSnapshot() };
+    snapshot.currentTrack.reset();
+    JsonObject parsed{ JsonObject::Parse(snapshot.Stringify()) };
+    CHECK(parsed.GetNamedValue(L"currentTrack").ValueType() == JsonValueType::Null);
+}
+
+BENCHMARK(PlaybackStateSnapshotRefresh)
+{
+    PlaybackStateSnapshot state{ MakeSnapshot() };
+    DispatchLayer dispatch{};
+
+    auto report = [&](char const* measurement, double seconds, uint64_t roundTrips)
+    {
+        NativeMediaPlayerTests::Report(measurement, seconds / BenchmarkRefreshes * 1e6, "us/refresh");
+        NativeMediaPlayerTests::Report(measurement, static_cast<double>(roundTrips) / BenchmarkRefreshes, "calls/refresh");
+    };
+
+    // Every field the page shows, read one property at a time
+    uint64_t roundTrips{ dispatch.RoundTrips() };
+    double propertySeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkRefreshes; i++)
+        {
+            state.currentTime += 0.25;
+            CHECK(!dispatch.Call([&]() { return state.paused; }));
+            dispatch.Call([&]() { return state.ended; });
+            dispatch.Call([&]() { return state.muted; });
+            dispatch.Call([&]() { return state.volume; });
+            dispatch.Call([&]() { return state.currentTime; });
+            dispatch.Call([&]() { return state.duration; });
+            dispatch.Call([&]() { return state.currentTrackIndex; });
+            dispatch.Call([&]() { return state.playlistLength; });
+            dispatch.Call([&]() { return state.shuffleEnabled; });
+            dispatch.Call([&]() { return state.repeatMode; });
+            dispatch.Call([&]() { return state.currentTrack->src; });
+            dispatch.Call([&]() { return state.currentTrack->title; });
+            dispatch.Call([&]() { return state.currentTrack->artist; });
+            dispatch.Call([&]() { return state.currentTrack->thumbnailSrc; });
+        }
+    }) };
+    report("Property reads", propertySeconds, dispatch.RoundTrips() - roundTrips);
+
+    // As the page does it, reading StateVersion first and then the snapshot, which has changed
+    roundTrips = dispatch.RoundTrips();
+    uint64_t lastVersion{ state.version };
+    double snapshotSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkRefreshes; i++)
+        {
+            state.currentTime += 0.25;
+            state.version++;
+            CHECK(dispatch.Call([&]() { return state.version; }) != lastVersion);
+            CHECK(!dispatch.Call([&]() { return state.Stringify(); }).empty());
+            lastVersion = state.version;
+        }
+    }) };
+    report("Snapshot", snapshotSeconds, dispatch.RoundTrips() - roundTrips);
+
+    // When nothing but the position has changed, the page skips the snapshot
+    roundTrips = dispatch.RoundTrips();
+    double unchangedSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkRefreshes; i++)
+        {
+            if (dispatch.Call([&]() { return state.version; }) != lastVersion)
+            {
+                dispatch.Call([&]() { return state.Stringify(); });
+            }
+        }
+    }) };
+    report("Snapshot, version unchanged", unchangedSeconds, dispatch.RoundTrips() - roundTrips);
+
+    NativeMediaPlayerTests::Report("Property reads / snapshot", propertySeconds / snapshotSeconds, "x");
+}
@@ -0,0 +1,249 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "LocalHttpServer.h"
+#include "PlaylistCache.h"
+#include <filesystem>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using namespace winrt::Windows::Foundation::Collections;
+using namespace winrt::Windows::Storage;
+using NativeMediaPlayerTests::LocalHttpServer;
+
+namespace
+{
+    constexpr char LastModified[]{ "Wed, 21 Oct 2015 07:28:00 GMT" };
+
+    std::string MakePlaylist(std::string const& name, uint32_t trackCount)
+    {
+        std::string text{ "{\"Title\":\"" + name + "\",\"Tracks\":[" };
+        for (uint32_t i = 0; i < trackCount; i++)
+        {
+            text += (i == 0 ? "" : ",") + std::string{ "{\"Id\":\"" } + std::to_string(100 + i) + "\",\"Title\":\"Track " + std::to_string(i) + "\",\"Artist\":\"Computoser\"}";
+        }
+        return text + "]}";
+    }
+
+    /// <summary>
+    /// Waits for something the cache does in the background, such as writing its disk tier.
+    /// Returns false if it has not happened within a few seconds.
+    /// </summary>
+    bool WaitUntil(std::function<bool()> const& condition)
+    {
+        auto deadline{ std::chrono::steady_clock::now() + std::chrono::seconds(10) };
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Makes every disk entry look as though it was last validated long ago, as it would after the
+    /// app had been closed for a while.
+    /// </summary>
+    void MakeDiskEntriesStale(IPropertySet const& validators)
+    {
+        std::vector<winrt::hstring> fileNames{};
+        for (auto const& pair : validators)
+        {
+            fileNames.push_back(pair.Key());
+        }
+        for (winrt::hstring const& fileName : fileNames)
+        {
+            ApplicationDataCompositeValue composite{ validators.Lookup(fileName).as<ApplicationDataCompositeValue>() };
+            composite.Insert(L"ValidatedAt", winrt::box_value(int64_t{ 0 }));
+            validators.Insert(fileName, composite);
+        }
+    }
+
+    /// <summary>
+    /// A folder of its own in the temp folder for the disk tier, deleted again when the test is
+    /// done with it.
+    /// </summary>
+    class TempFolder
+    {
+    public:
+        explicit TempFolder(wchar_t const* name)
+        {
+            StorageFolder tempFolder{ StorageFolder::GetFolderFromPathAsync(std::filesystem::temp_directory_path().wstring()).get() };
+            folder = tempFolder.CreateFolderAsync(std::wstring{ L"NativeMediaPlayerTests." } + name, CreationCollisionOption::ReplaceExisting).get();
+        }
+
+        ~TempFolder()
+        {
+            try
+            {
+                folder.DeleteAsync(StorageDeleteOption::PermanentDelete).get();
+            }
+            catch (winrt::hresult_error const&)
+            {
+            }
+        }
+
+        StorageFolder const& Folder() const { return folder; }
+
+        /// <summary>
+        /// How many entries the disk tier has files for, leaving out any partly written one.
+        /// </summary>
+        uint32_t CachedFileCount() const
+        {
+            uint32_t count{ 0 };
+            for (StorageFile const& file : folder.GetFolderAsync(L"PlaylistCache").get().GetFilesAsync().get())
+            {
+                if (file.FileType() == L".json")
+                {
+                    count++;
+                }
+            }
+            return count;
+        }
+
+    private:
+        StorageFolder folder{ nullptr };
+    };
+}
+
+TEST(PlaylistCacheServesAndRevalidatesFromLocalServer)
+{
+    std::mutex serverMutex{};
+    std::string playlist{ MakePlaylist("First", 10) };
+    std::string eTag{ "\"v1\"" };
+    int status{ 200 };
+    LocalHttpServer server{ [&](LocalHttpServer::Request const& request)
+    {
+        std::lock_guard lock{ serverMutex };
+        if (status == 200 && request.Header("if-none-match") == eTag)
+        {
+            return LocalHttpServer::Response{ 304, { { "ETag", eTag } } };
+        }
+        return LocalHttpServer::Response{ status,
+            { { "Content-Type", "application/json; charset=utf-8" }, { "ETag", eTag }, { "Last-Modified", LastModified } },
+            status == 200 ? playlist : std::string{} };
+    } };
+
+    TempFolder folder{ L"PlaylistCache" };
+    PropertySet validators{};
+    PlaylistCache cache{ folder.Folder(), validators };
+    winrt::Windows::Foundation::Uri uri{ server.Uri(L"/playlists/first.json") };
+
+    // Fetched, then written to disk in the background
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(server.Requests().size() == 1);
+    CHECK(cache.Stats().misses == 1);
+    CHECK(WaitUntil([&]() { return validators.Size() == 1; }));
+    CHECK(folder.CachedFileCount() == 1);
+
+    // Fresh in memory, then fresh on disk, so the server is not asked again
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(cache.Stats().memoryHits == 1);
+    cache.TrimMemory();
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(cache.Stats().diskHits == 1);
+    CHECK(server.Requests().size() == 1);
+
+    // Stale, and unchanged on the server, which says so with a 304
+    cache.TrimMemory();
+    MakeDiskEntriesStale(validators);
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(server.Requests().size() == 2);
+    CHECK(server.Requests()[1].Header("if-none-match") == "\"v1\"");
+    CHECK(server.Requests()[1].Header("if-modified-since") == LastModified);
+    CHECK(cache.Stats().revalidatedHits == 1);
+
+    // Stale, and changed on the server; the new text replaces the disk entry
+    {
+        std::lock_guard lock{ serverMutex };
+        playlist = MakePlaylist("First, updated", 12);
+        eTag = "\"v2\"";
+    }
+    cache.TrimMemory();
+    MakeDiskEntriesStale(validators);
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(cache.Stats().misses == 2);
+    CHECK(WaitUntil([&]()
+    {
+        for (auto const& pair : validators)
+        {
+            auto composite{ pair.Value().try_as<ApplicationDataCompositeValue>() };
+            return composite && winrt::unbox_value_or<winrt::hstring>(composite.TryLookup(L"ETag"), L"") == L"\"v2\"";
+        }
+        return false;
+    }));
+    CHECK(folder.CachedFileCount() == 1);
+    cache.TrimMemory();
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(playlist));
+    CHECK(cache.Stats().diskHits == 2);
+
+    // Stale, and the server is failing; the copy on disk is still served
+    {
+        std::lock_guard lock{ serverMutex };
+        status = 500;
+    }
+    cache.TrimMemory();
+    MakeDiskEntriesStale(validators);
+    CHECK(cache.GetAsync(L"first", uri).get() == winrt::to_hstring(MakePlaylist("First, updated", 12)));
+    CHECK(server.Requests().size() == 4);
+}
+
+TEST(PlaylistCacheSharesConcurrentFetches)
+{
+    std::string playlist{ MakePlaylist("Shared", 10) };
+    LocalHttpServer server{ [&](LocalHttpServer::Request const&)
+    {
+        // Slow enough that the second request arrives while the first is still being fetched
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return LocalHttpServer::Response{ 200, { { "Content-Type", "application/json; charset=utf-8" } }, playlist };
+    } };
+
+    TempFolder folder{ L"PlaylistCacheShared" };
+    PropertySet validators{};
+    PlaylistCache cache{ folder.Folder(), validators };
+    winrt::Windows::Foundation::Uri uri{ server.Uri(L"/playlists/shared.json") };
+
+    auto first{ cache.GetAsync(L"shared", uri) };
+    auto second{ cache.GetAsync(L"shared", uri) };
+    CHECK(first.get() == winrt::to_hstring(playlist));
+    CHECK(second.get() == winrt::to_hstring(playlist));
+    CHECK(server.Requests().size() == 1);
+    CHECK(cache.Stats().sharedFetches == 1);
+    CHECK(WaitUntil([&]() { return validators.Size() == 1; }));
+}
+
+TEST(PlaylistCacheKeepsDiskTierInBudget)
+{
+    LocalHttpServer server{ [&](LocalHttpServer::Request const& request)
+    {
+        return LocalHttpServer::Response{ 200, { { "Content-Type", "application/json; charset=utf-8" } }, MakePlaylist(request.path, 20) };
+    } };
+
+    // Room for two of the playlists but not three
+    uint64_t playlistBytes{ MakePlaylist("/a", 20).size() };
+    TempFolder folder{ L"PlaylistCacheBudget" };
+    PropertySet validators{};
+    PlaylistCache cache{ folder.Folder(), validators, playlistBytes * 5 / 2 };
+
+    cache.GetAsync(L"a", server.Uri(L"/a")).get();
+    CHECK(WaitUntil([&]() { return validators.Size() == 1; }));
+    cache.GetAsync(L"b", server.Uri(L"/b")).get();
+    CHECK(WaitUntil([&]() { return validators.Size() == 2; }));
+
+    // The playlist validated longest ago makes room for the last one
+    cache.GetAsync(L"c", server.Uri(L"/c")).get();
+    CHECK(WaitUntil([&]() { return cache.Stats().diskEvictions == 1 && validators.Size() == 2; }));
+    CHECK(WaitUntil([&]() { return folder.CachedFileCount() == 2; }));
+
+    cache.TrimMemory();
+    cache.GetAsync(L"c", server.Uri(L"/c")).get();
+    CHECK(cache.Stats().diskHits == 1);
+    CHECK(server.Requests().size() == 3);
+    cache.GetAsync(L"a", server.Uri(L"/a")).get();
+    CHECK(server.Requests().size() == 4);
+    CHECK(WaitUntil([&]() { return cache.Stats().diskEvictions == 2 && validators.Size() == 2; }));
+}
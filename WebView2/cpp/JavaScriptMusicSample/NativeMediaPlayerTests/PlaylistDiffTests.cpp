@@ -0,0 +1,226 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "PlaylistDiff.h"
+#include "PlayQueue.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Foundation::Collections;
+using winrt::NativeMediaPlayer::PlaybackRepeatMode;
+
+namespace
+{
+    constexpr uint32_t BenchmarkSkips{ 10000 };
+
+    IVector<IInspectable> MakeItems(std::vector<uint32_t> const& ids)
+    {
+        IVector<IInspectable> items{ winrt::single_threaded_vector<IInspectable>() };
+        for (uint32_t id : ids)
+        {
+            items.Append(winrt::box_value(id));
+        }
+        return items;
+    }
+
+    std::vector<uint32_t> ItemIds(IVector<IInspectable> const& items)
+    {
+        std::vector<uint32_t> ids{};
+        for (IInspectable const& item : items)
+        {
+            ids.push_back(winrt::unbox_value<uint32_t>(item));
+        }
+        return ids;
+    }
+
+    /// <summary>
+    /// Stands in for the MediaPlaybackList of MediaPlaybackController::SyncWindow: the items around
+    /// the queue's current track, kept in line with PlaylistDiff. Each item is a boxed URI string,
+    /// so the memory measured is the window's own bookkeeping rather than what a MediaPlaybackItem
+    /// and its MediaSource cost on top of it.
+    /// </summary>
+    class PlaybackWindow
+    {
+    public:
+        PlaybackWindow(PlayQueue const& queue, uint32_t trackCount, uint32_t windowSize) :
+            queue{ queue }, trackCount{ trackCount }, windowSize{ windowSize }
+        {
+        }
+
+        uint32_t Sync()
+        {
+            uint32_t reach{ windowSize == 0 ? trackCount - 1 : windowSize };
+            std::vector<uint32_t> behind{ queue.PeekBehind(reach) };
+            std::vector<uint32_t> ahead{ queue.PeekAhead(reach) };
+            std::vector<uint32_t> desired(behind.rbegin(), behind.rend());
+            desired.push_back(*queue.Current());
+            desired.insert(desired.end(), ahead.begin(), ahead.end());
+
+            std::optional<uint32_t> playingPosition{};
+            if (!tracks.empty())
+            {
+                playingPosition = current;
+            }
+
+            PlaylistDiff diff{ PlaylistDiff::Compute(tracks, desired, playingPosition) };
+            diff.Apply(items, [&](uint32_t newIndex)
+            {
+                return winrt::box_value(winrt::hstring{ L"https://example.com/tracks/" + std::to_wstring(desired[newIndex]) + L".mp3" });
+            });
+            tracks = std::move(desired);
+            current = static_cast<uint32_t>(behind.size());
+            return diff.Insertions();
+        }
+
+        uint32_t Size() const { return items.Size(); }
+
+    private:
+        PlayQueue const& queue;
+        uint32_t trackCount;
+        uint32_t windowSize;
+        IVector<IInspectable> items{ winrt::single_threaded_vector<IInspectable>() };
+        std::vector<uint32_t> tracks{};
+        uint32_t current{ 0 };
+    };
+}
+
+TEST(PlaylistDiffUnchangedListHasNoEdits)
+{
+    std::vector<uint32_t> ids{ 1, 2, 3, 4 };
+    PlaylistDiff diff{ PlaylistDiff::Compute(ids, ids) };
+    CHECK(diff.Insertions() == 0 && diff.Removals() == 0 && diff.Moves() == 0);
+    for (uint32_t i = 0; i < ids.size(); i++)
+    {
+        CHECK(diff.NewIndexOf(i) == i);
+        CHECK(diff.OldIndexOf(i) == i);
+    }
+    CHECK(!diff.NewIndexOf(4));
+}
+
+TEST(PlaylistDiffCountsEdits)
+{
+    // 2 is removed, 9 is inserted and 4 moves to the front
+    PlaylistDiff diff{ PlaylistDiff::Compute(std::vector<uint32_t>{ 1, 2, 3, 4 }, std::vector<uint32_t>{ 4, 1, 3, 9 }) };
+    CHECK(diff.Removals() == 1);
+    CHECK(diff.Insertions() == 1);
+    CHECK(diff.Moves() == 1);
+    CHECK(!diff.NewIndexOf(1));
+    CHECK(diff.NewIndexOf(3) == 0u);
+    CHECK(diff.OldIndexOf(0) == 3u);
+    CHECK(!diff.OldIndexOf(3));
+}
+
+TEST(PlaylistDiffMatchesIdsByString)
+{
+    std::vector<winrt::hstring> oldIds{ L"a", L"b", L"a" };
+    std::vector<winrt::hstring> newIds{ L"a", L"a", L"c" };
+    PlaylistDiff diff{ PlaylistDiff::Compute(oldIds, newIds) };
+
+    // Repeated Ids pair up in order
+    CHECK(diff.OldIndexOf(0) == 0u);
+    CHECK(diff.OldIndexOf(1) == 2u);
+    CHECK(!diff.OldIndexOf(2));
+    CHECK(diff.Removals() == 1 && diff.Insertions() == 1 && diff.Moves() == 0);
+}
+
+TEST(PlaylistDiffKeepsPinnedEntryInPlace)
+{
+    std::vector<uint32_t> oldIds{ 0, 1, 2, 3, 4 };
+    std::vector<uint32_t> newIds{ 1, 2, 3, 4, 0 };
+
+    // Unpinned, moving 0 alone is cheapest; pinned, everything else has to move around it
+    CHECK(PlaylistDiff::Compute(oldIds, newIds).Moves() == 1);
+    CHECK(PlaylistDiff::Compute(oldIds, newIds, 0).Moves() == 4);
+
+    // A pinned entry that is removed does not hold anything else back
+    CHECK(PlaylistDiff::Compute(oldIds, std::vector<uint32_t>{ 1, 2, 3, 4 }, 0).Moves() == 0);
+}
+
+TEST(PlaylistDiffApplyProducesNewList)
+{
+    std::mt19937 random{ 42 };
+    for (uint32_t round = 0; round < 200; round++)
+    {
+        std::vector<uint32_t> oldIds(random() % 20);
+        std::iota(oldIds.begin(), oldIds.end(), 0);
+        std::vector<uint32_t> newIds{ oldIds };
+        std::shuffle(newIds.begin(), newIds.end(), random);
+        newIds.resize(newIds.size() * (random() % 4) / 3);
+        for (uint32_t i = 0; i < round % 5; i++)
+        {
+            newIds.insert(newIds.begin() + random() % (newIds.size() + 1), 100 + i);
+        }
+
+        std::optional<uint32_t> pinned{};
+        if (!oldIds.empty() && round % 2)
+        {
+            pinned = static_cast<uint32_t>(random() % oldIds.size());
+        }
+
+        IVector<IInspectable> items{ MakeItems(oldIds) };
+        std::vector<IInspectable> oldItems{ items.begin(), items.end() };
+        PlaylistDiff diff{ PlaylistDiff::Compute(oldIds, newIds, pinned) };
+        uint32_t created{ 0 };
+        diff.Apply(items, [&](uint32_t newIndex)
+        {
+            created++;
+            return winrt::box_value(newIds[newIndex]);
+        });
+
+        CHECK(ItemIds(items) == newIds);
+        CHECK(created == diff.Insertions());
+        CHECK(diff.Removals() + diff.Moves() <= oldIds.size());
+
+        // Entries that survive are the same items, not copies
+        for (uint32_t newIndex = 0; newIndex < newIds.size(); newIndex++)
+        {
+            if (std::optional<uint32_t> oldIndex{ diff.OldIndexOf(newIndex) })
+            {
+                CHECK(items.GetAt(newIndex) == oldItems[*oldIndex]);
+            }
+        }
+    }
+}
+
+BENCHMARK(PlaybackWindowSliding)
+{
+    // Windowed lists run first, since the peak working set only ever grows and loading every
+    // track takes far more memory
+    for (uint32_t windowSize : { 5u, 0u })
+    {
+        for (uint32_t trackCount : { 100u, 1000u, 10000u, 100000u })
+        {
+            PlayQueue queue{};
+            queue.RepeatMode(PlaybackRepeatMode::All);
+            queue.Reset(trackCount, 0);
+            PlaybackWindow window{ queue, trackCount, windowSize };
+
+            // Every item in the window is created before the first track can start playing
+            double firstSyncSeconds{ NativeMediaPlayerTests::SecondsToRun([&]() { window.Sync(); }) };
+
+            uint32_t skips{ windowSize == 0 ? std::min(BenchmarkSkips, 1000000 / trackCount) : BenchmarkSkips };
+            uint32_t created{ 0 };
+            double skipSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+            {
+                for (uint32_t i = 0; i < skips; i++)
+                {
+                    queue.Advance(true);
+                    created += window.Sync();
+                }
+            }) };
+
+            char measurement[64]{};
+            sprintf_s(measurement, "%s, %u tracks", windowSize == 0 ? "Every track" : "Window of 5", trackCount);
+            NativeMediaPlayerTests::Report(measurement, firstSyncSeconds * 1e3, "ms to fill the list");
+            NativeMediaPlayerTests::Report(measurement, skipSeconds / skips * 1e6, "us/skip");
+            NativeMediaPlayerTests::Report(measurement, static_cast<double>(created) / skips, "items created/skip");
+            NativeMediaPlayerTests::Report(measurement, window.Size(), "items loaded");
+            NativeMediaPlayerTests::Report(measurement, NativeMediaPlayerTests::PeakWorkingSetBytes() / 1048576.0, "MB peak working set");
+        }
+    }
+}
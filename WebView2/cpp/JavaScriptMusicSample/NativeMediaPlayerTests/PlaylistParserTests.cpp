@@ -0,0 +1,196 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "PlaylistParser.h"
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using namespace winrt::Windows::Data::Json;
+
+namespace
+{
+    // Every size parses about this many tracks in total, so that small playlists are timed over
+    // enough runs to be measurable
+    constexpr uint32_t BenchmarkTracksPerSize{ 1000000 };
+
+    std::vector<PlaylistTrackRecord> ParseAll(std::wstring_view json, winrt::hstring& next)
+    {
+        std::vector<PlaylistTrackRecord> tracks{};
+        next = PlaylistParser::Parse(json, [&](PlaylistTrackRecord&& track) { tracks.push_back(std::move(track)); });
+        return tracks;
+    }
+
+    bool Throws(std::wstring_view json)
+    {
+        try
+        {
+            PlaylistParser::Parse(json, [](PlaylistTrackRecord&&) {});
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            return e.code() == WEB_E_INVALID_JSON_STRING;
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// A playlist shaped like the ones in the playlistdata folder, with trackCount tracks.
+    /// </summary>
+    std::wstring MakePlaylist(uint32_t trackCount)
+    {
+        std::wstring json{ L"{\"Tracks\":[" };
+        for (uint32_t i = 0; i < trackCount; i++)
+        {
+            if (i > 0)
+            {
+                json += L',';
+            }
+            json += L"{\"Title\":\"Track " + std::to_wstring(i) + L"\",\"Artist\":\"Computoser\",\"Id\":\"" +
+                std::to_wstring(100 + i) + L"\",\"Image\":\"https://raw.githubusercontent.com/microsoft/" +
+                L"Windows-universal-samples/main/SharedContent/media/Samples/LandscapeImage" +
+                std::to_wstring(i % 8 + 1) + L".jpg\"}";
+        }
+        json += L"],\"Next\":\"page2\"}";
+        return json;
+    }
+
+    /// <summary>
+    /// Reads a playlist the way PlayTrackInternalAsync did before PlaylistParser: a JsonObject for
+    /// the whole document, then GetNamedString for each field of each track.
+    /// </summary>
+    size_t ParseWithJsonObject(std::wstring const& json)
+    {
+        JsonObject root{ JsonObject::Parse(json) };
+        JsonArray tracks{ root.GetNamedArray(L"Tracks") };
+        size_t fieldLength{ 0 };
+        for (uint32_t i = 0; i < tracks.Size(); i++)
+        {
+            JsonObject track{ tracks.GetObjectAt(i) };
+            PlaylistTrackRecord record{
+                track.GetNamedString(L"Id", L""),
+                track.GetNamedString(L"Title", L""),
+                track.GetNamedString(L"Artist", L""),
+                track.GetNamedString(L"Image", L"") };
+            fieldLength += record.id.size();
+        }
+        return fieldLength;
+    }
+
+    size_t ParseWithPlaylistParser(std::wstring const& json)
+    {
+        size_t fieldLength{ 0 };
+        PlaylistParser::Parse(json, [&](PlaylistTrackRecord&& record) { fieldLength += record.id.size(); });
+        return fieldLength;
+    }
+}
+
+TEST(PlaylistParserReadsTracksInOrder)
+{
+    winrt::hstring next{};
+    std::vector<PlaylistTrackRecord> tracks{ ParseAll(
+        L"\xFEFF{ \"Tracks\": [\n"
+        L"  { \"Title\": \"Run Early\", \"Artist\": \"Computoser\", \"Id\": \"102\", \"Image\": \"a.jpg\" },\n"
+        L"  { \"Id\": \"103\" }\n"
+        L"], \"Next\": \"page2\" }", next) };
+
+    CHECK(tracks.size() == 2);
+    CHECK(tracks[0].id == L"102");
+    CHECK(tracks[0].title == L"Run Early");
+    CHECK(tracks[0].artist == L"Computoser");
+    CHECK(tracks[0].image == L"a.jpg");
+    CHECK(tracks[0].src.empty());
+
+    // Missing fields are empty, as GetNamedString(name, L"") returns
+    CHECK(tracks[1].id == L"103");
+    CHECK(tracks[1].title.empty() && tracks[1].artist.empty() && tracks[1].image.empty());
+    CHECK(next == L"page2");
+}
+
+TEST(PlaylistParserUnescapesStrings)
+{
+    winrt::hstring next{};
+    std::vector<PlaylistTrackRecord> tracks{ ParseAll(
+        LR"({"Tracks":[{"Title":"Say \"Hi\"\\\/\n","Artist":"Caf\u00e9 \ud83c\udfb5","Id":"1"}]})", next) };
+
+    CHECK(tracks.size() == 1);
+    CHECK(tracks[0].title == L"Say \"Hi\"\\/\n");
+    CHECK(tracks[0].artist == L"Caf\x00E9 \xD83C\xDFB5");
+    CHECK(tracks[0].id == L"1");
+}
+
+TEST(PlaylistParserSkipsUnknownFields)
+{
+    winrt::hstring next{};
+    std::vector<PlaylistTrackRecord> tracks{ ParseAll(
+        LR"({"Version":2,"Tracks":[{"Id":"1","Duration":-1.5e3,"Tags":["a",{"b":[true,false,null]}],"Title":null}],"Owner":{"Name":"x"}})", next) };
+
+    CHECK(tracks.size() == 1);
+    CHECK(tracks[0].id == L"1");
+    CHECK(tracks[0].title.empty());
+    CHECK(next.empty());
+}
+
+TEST(PlaylistParserReadsNext)
+{
+    winrt::hstring next{ L"stale" };
+    CHECK(ParseAll(LR"({"Next":null,"Tracks":[]})", next).empty());
+    CHECK(next.empty());
+
+    ParseAll(LR"({"Tracks":[],"Next":"after \"this\""})", next);
+    CHECK(next == L"after \"this\"");
+}
+
+TEST(PlaylistParserRejectsInvalidJson)
+{
+    CHECK(Throws(L""));
+    CHECK(Throws(L"{"));
+    CHECK(Throws(LR"({"error":"nope"})"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":"1"}])"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":"1}]})"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":"\x"}]})"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":"\u12"}]})"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":tru}]})"));
+    CHECK(Throws(LR"({"Tracks":[]} trailing)"));
+    CHECK(Throws(LR"({"Tracks":[{"Id":"1",}]})"));
+
+    std::wstring deep(100, L'[');
+    CHECK(Throws(L"{\"Tracks\":[],\"Deep\":" + deep + std::wstring(100, L']') + L"}"));
+}
+
+BENCHMARK(PlaylistParserThroughput)
+{
+    for (uint32_t trackCount : { 10u, 1000u, 100000u })
+    {
+        std::wstring json{ MakePlaylist(trackCount) };
+        uint32_t runs{ BenchmarkTracksPerSize / trackCount };
+        CHECK(ParseWithPlaylistParser(json) == ParseWithJsonObject(json));
+
+        // The peak working set only ever grows, so at each size the parser is measured before the
+        // DOM path, and the sizes go from smallest to largest
+        auto report = [&](char const* parser, double seconds)
+        {
+            char measurement[64]{};
+            sprintf_s(measurement, "%s, %u tracks", parser, trackCount);
+            NativeMediaPlayerTests::Report(measurement, seconds / runs * 1e6, "us/parse");
+            NativeMediaPlayerTests::Report(measurement, static_cast<double>(trackCount) * runs / seconds / 1e6, "M tracks/s");
+            NativeMediaPlayerTests::Report(measurement, NativeMediaPlayerTests::PeakWorkingSetBytes() / 1048576.0, "MB peak working set");
+        };
+
+        report("PlaylistParser", NativeMediaPlayerTests::SecondsToRun([&]()
+        {
+            for (uint32_t i = 0; i < runs; i++)
+            {
+                ParseWithPlaylistParser(json);
+            }
+        }));
+
+        report("JsonObject", NativeMediaPlayerTests::SecondsToRun([&]()
+        {
+            for (uint32_t i = 0; i < runs; i++)
+            {
+                ParseWithJsonObject(json);
+            }
+        }));
+    }
+}
@@ -0,0 +1,183 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "PlaylistSearchIndex.h"
+#include <algorithm>
+#include <random>
+
+// PlaylistSearchIndex folds text with NormalizeString, which the app gets from WindowsApp.lib
+#pragma comment(lib, "normaliz.lib")
+
+using namespace winrt::NativeMediaPlayer::implementation;
+
+namespace
+{
+    constexpr uint32_t BenchmarkTrackCount{ 100000 };
+    constexpr uint32_t BenchmarkArtistCount{ 500 };
+    constexpr uint32_t BenchmarkMaxResults{ 50 };
+    constexpr double FrameMilliseconds{ 1000.0 / 60 };
+
+    std::vector<uint32_t> Tracks(std::vector<PlaylistSearchIndex::Result> const& results)
+    {
+        std::vector<uint32_t> tracks{};
+        for (PlaylistSearchIndex::Result const& result : results)
+        {
+            tracks.push_back(result.track);
+        }
+        return tracks;
+    }
+
+    /// <summary>
+    /// A made-up word of two to four syllables, so that words share prefixes and trigrams the way
+    /// real titles do.
+    /// </summary>
+    std::wstring MakeWord(std::mt19937& random)
+    {
+        static constexpr wchar_t const* Syllables[]{
+            L"ka", L"lo", L"mi", L"ne", L"ru", L"sa", L"to", L"vi", L"den", L"mar", L"son", L"tel",
+            L"bri", L"cor", L"fal", L"gen", L"hol", L"jas", L"lin", L"pol", L"ques", L"ran", L"sum", L"wes" };
+        std::wstring word{};
+        for (uint32_t i = 0, count = 2 + random() % 3; i < count; i++)
+        {
+            word += Syllables[random() % std::size(Syllables)];
+        }
+        return word;
+    }
+}
+
+TEST(PlaylistSearchIndexFoldsText)
+{
+    CHECK(PlaylistSearchIndex::Fold(L"Run Early") == L"run early");
+    CHECK(PlaylistSearchIndex::Fold(L"Caf\x00E9 del Mar!") == L"cafe del mar ");
+    CHECK(PlaylistSearchIndex::Fold(L"\x00C9T\x00C9, 2024") == L"ete  2024");
+
+    // Combining marks are dropped rather than turned into separators
+    CHECK(PlaylistSearchIndex::Fold(L"Cafe\x0301") == L"cafe");
+}
+
+TEST(PlaylistSearchIndexRanksMatches)
+{
+    PlaylistSearchIndex index{};
+    index.AddTrack(L"Run Early", L"Computoser");
+    index.AddTrack(L"Early Run", L"Computoser");
+    index.AddTrack(L"Nightrun", L"Someone");
+    index.AddTrack(L"Something", L"Runners");
+    index.AddTrack(L"Unrelated", L"Nobody");
+    CHECK(index.TrackCount() == 5);
+
+    // A whole word of a title that starts with the query, a whole word of a title, the start of
+    // an artist's word, then the middle of a title's word
+    CHECK(Tracks(index.Search(L"run", 10)) == (std::vector<uint32_t>{ 0, 1, 3, 2 }));
+    CHECK(Tracks(index.Search(L"RUN", 2)) == (std::vector<uint32_t>{ 0, 1 }));
+
+    // Every term has to match
+    CHECK(Tracks(index.Search(L"run ear", 10)) == (std::vector<uint32_t>{ 0, 1 }));
+    CHECK(Tracks(index.Search(L"comp some", 10)).empty());
+    CHECK(index.Search(L"", 10).empty());
+    CHECK(index.Search(L"  !! ", 10).empty());
+}
+
+TEST(PlaylistSearchIndexIgnoresAccents)
+{
+    PlaylistSearchIndex index{};
+    index.AddTrack(L"Caf\x00E9 Society", L"Beyonc\x00E9");
+    CHECK(Tracks(index.Search(L"cafe", 10)) == std::vector<uint32_t>{ 0 });
+    CHECK(Tracks(index.Search(L"CAF\x00C9", 10)) == std::vector<uint32_t>{ 0 });
+    CHECK(Tracks(index.Search(L"beyonce", 10)) == std::vector<uint32_t>{ 0 });
+    CHECK(Tracks(index.Search(L"ciet", 10)) == std::vector<uint32_t>{ 0 });
+}
+
+TEST(PlaylistSearchIndexGrowsBetweenSearches)
+{
+    PlaylistSearchIndex index{};
+    index.AddTrack(L"First", L"A");
+    CHECK(Tracks(index.Search(L"second", 10)).empty());
+
+    index.AddTrack(L"Second", L"B");
+    CHECK(Tracks(index.Search(L"second", 10)) == std::vector<uint32_t>{ 1 });
+    CHECK(Tracks(index.Search(L"first", 10)) == std::vector<uint32_t>{ 0 });
+
+    index.Clear();
+    CHECK(index.TrackCount() == 0);
+    CHECK(index.Search(L"first", 10).empty());
+    index.AddTrack(L"Third", L"C");
+    CHECK(Tracks(index.Search(L"third", 10)) == std::vector<uint32_t>{ 0 });
+}
+
+BENCHMARK(PlaylistSearchIndexKeystrokeLatency)
+{
+    std::mt19937 random{ 1 };
+    std::vector<std::wstring> artists{};
+    for (uint32_t i = 0; i < BenchmarkArtistCount; i++)
+    {
+        artists.push_back(MakeWord(random) + L" " + MakeWord(random));
+    }
+    std::vector<std::wstring> titles{};
+    for (uint32_t i = 0; i < BenchmarkTrackCount; i++)
+    {
+        std::wstring title{ MakeWord(random) };
+        for (uint32_t words = 1 + random() % 4; words > 1; words--)
+        {
+            title += L" " + MakeWord(random);
+        }
+        titles.push_back(std::move(title));
+    }
+
+    PlaylistSearchIndex index{};
+    double buildSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkTrackCount; i++)
+        {
+            index.AddTrack(titles[i], artists[i % BenchmarkArtistCount]);
+        }
+
+        // The first search sorts the words that were added
+        index.Search(L"a", 1);
+    }) };
+    NativeMediaPlayerTests::Report("Build, 100k tracks", buildSeconds * 1e3, "ms");
+
+    // Type out the start of some titles and artists a character at a time, as a user on the
+    // on-screen keyboard would, and time the search that follows each keystroke
+    std::vector<std::wstring> queries{ L"sum", L"ka", L"wesmar", L"den ran", L"lotel", L"q", L"x" };
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        std::wstring const& title{ titles[random() % BenchmarkTrackCount] };
+        queries.push_back(title.substr(0, std::min<size_t>(title.size(), 12)));
+        queries.push_back(artists[random() % BenchmarkArtistCount]);
+    }
+
+    std::vector<double> keystrokeSeconds{};
+    size_t resultCount{ 0 };
+    for (std::wstring const& query : queries)
+    {
+        for (size_t length = 1; length <= query.size(); length++)
+        {
+            keystrokeSeconds.push_back(NativeMediaPlayerTests::SecondsToRun([&]()
+            {
+                resultCount += index.Search(std::wstring_view{ query }.substr(0, length), BenchmarkMaxResults).size();
+            }));
+        }
+    }
+    CHECK(resultCount > 0);
+
+    std::sort(keystrokeSeconds.begin(), keystrokeSeconds.end());
+    double totalSeconds{ 0 };
+    for (double seconds : keystrokeSeconds)
+    {
+        totalSeconds += seconds;
+    }
+    double medianMilliseconds{ keystrokeSeconds[keystrokeSeconds.size() / 2] * 1e3 };
+    double p99Milliseconds{ keystrokeSeconds[keystrokeSeconds.size() * 99 / 100] * 1e3 };
+    double maxMilliseconds{ keystrokeSeconds.back() * 1e3 };
+    NativeMediaPlayerTests::Report("Keystrokes", static_cast<double>(keystrokeSeconds.size()), "searches");
+    NativeMediaPlayerTests::Report("Search, mean", totalSeconds / keystrokeSeconds.size() * 1e3, "ms");
+    NativeMediaPlayerTests::Report("Search, median", medianMilliseconds, "ms");
+    NativeMediaPlayerTests::Report("Search, 99th percentile", p99Milliseconds, "ms");
+    NativeMediaPlayerTests::Report("Search, slowest", maxMilliseconds, "ms");
+    NativeMediaPlayerTests::Report("Frame at 60 Hz", FrameMilliseconds, "ms");
+
+    // The point of the index: every keystroke's results are ready within the frame it was typed in
+    CHECK(maxMilliseconds < FrameMilliseconds);
+}
@@ -0,0 +1,40 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include <cstdio>
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+namespace NativeMediaPlayerTests
+{
+    std::vector<TestCase>& Registry()
+    {
+        // A function-local static, since tests register themselves during static initialization
+        static std::vector<TestCase> registry{};
+        return registry;
+    }
+
+    void Fail(char const* file, int line, char const* expression)
+    {
+        throw CheckFailure{ std::string{ file } + "(" + std::to_string(line) + "): CHECK(" + expression + ") failed" };
+    }
+
+    void Report(char const* measurement, double value, char const* unit)
+    {
+        std::printf("    %-40s %14.2f %s\n", measurement, value, unit);
+    }
+
+    size_t PeakWorkingSetBytes()
+    {
+        PROCESS_MEMORY_COUNTERS counters{};
+        counters.cb = sizeof(counters);
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+    }
+}
@@ -0,0 +1,82 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace NativeMediaPlayerTests
+{
+    /// <summary>
+    /// Just enough of a test runner to check NativeMediaPlayer's building blocks without the app.
+    ///
+    /// TEST registers a function that runs every time; CHECK fails it, and any exception that
+    /// escapes it does too. BENCHMARK registers one that only runs with --benchmark, since it takes
+    /// seconds rather than milliseconds. A benchmark passes or fails like a test, but its point is
+    /// the numbers it reports with Report, one line per measurement, so that runs can be compared.
+    /// </summary>
+    struct TestCase
+    {
+        char const* name{ nullptr };
+        void (*run)() { nullptr };
+        bool isBenchmark{ false };
+    };
+
+    std::vector<TestCase>& Registry();
+
+    struct Registration
+    {
+        Registration(char const* name, void (*run)(), bool isBenchmark)
+        {
+            Registry().push_back(TestCase{ name, run, isBenchmark });
+        }
+    };
+
+    /// <summary>
+    /// Thrown by CHECK, and caught by the runner, which reports where the check was.
+    /// </summary>
+    struct CheckFailure
+    {
+        std::string message{};
+    };
+
+    [[noreturn]] void Fail(char const* file, int line, char const* expression);
+
+    /// <summary>
+    /// Prints one measurement of the benchmark that is running.
+    /// </summary>
+    void Report(char const* measurement, double value, char const* unit);
+
+    /// <summary>
+    /// The most memory the process has had in its working set since it started.
+    /// </summary>
+    size_t PeakWorkingSetBytes();
+
+    template <typename Function>
+    double SecondsToRun(Function&& function)
+    {
+        auto started{ std::chrono::steady_clock::now() };
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    }
+}
+
+#define TEST(name) \
+    static void name(); \
+    static ::NativeMediaPlayerTests::Registration name##Registration{ #name, &name, false }; \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static ::NativeMediaPlayerTests::Registration name##Registration{ #name, &name, true }; \
+    static void name()
+
+#define CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) \
+        { \
+            ::NativeMediaPlayerTests::Fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (false)
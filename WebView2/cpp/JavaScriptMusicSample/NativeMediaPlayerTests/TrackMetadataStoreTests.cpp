@@ -0,0 +1,107 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "TrackMetadataStore.h"
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using Field = TrackMetadataStore::Field;
+
+namespace
+{
+    constexpr uint32_t BenchmarkTrackCount{ 100000 };
+
+    // The playlists in the playlistdata folder have a few dozen artists and a handful of images,
+    // and every src is in the same directory
+    constexpr uint32_t BenchmarkArtistCount{ 50 };
+    constexpr uint32_t BenchmarkImageCount{ 8 };
+
+    void CheckRow(TrackMetadataStore const& store, uint32_t row, std::wstring_view src, std::wstring_view title, std::wstring_view artist, std::wstring_view thumbnailSrc)
+    {
+        CHECK(store.Get(row, Field::Src) == src);
+        CHECK(store.Get(row, Field::Title) == title);
+        CHECK(store.Get(row, Field::Artist) == artist);
+        CHECK(store.Get(row, Field::ThumbnailSrc) == thumbnailSrc);
+    }
+}
+
+TEST(TrackMetadataStoreReturnsWhatWasAppended)
+{
+    TrackMetadataStore store{};
+    CHECK(store.Append(L"https://example.com/tracks/101.mp3", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg") == 0);
+    CHECK(store.Append(L"https://example.com/tracks/102.mp3", L"", L"Computoser", L"") == 1);
+
+    // URLs are split before the query string, and some have no directory at all
+    CHECK(store.Append(L"https://example.com/get?path=/tracks/103.mp3", L"Joy", L"", L"art.jpg") == 2);
+    CHECK(store.Append(L"https://example.com/tracks/", L"Slash", L"Other", L"/") == 3);
+
+    CHECK(store.RowCount() == 4);
+    CHECK(store.MappedRowCount() == 0);
+    CheckRow(store, 0, L"https://example.com/tracks/101.mp3", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg");
+    CheckRow(store, 1, L"https://example.com/tracks/102.mp3", L"", L"Computoser", L"");
+    CheckRow(store, 2, L"https://example.com/get?path=/tracks/103.mp3", L"Joy", L"", L"art.jpg");
+    CheckRow(store, 3, L"https://example.com/tracks/", L"Slash", L"Other", L"/");
+}
+
+TEST(TrackMetadataStoreStoresRepeatedStringsOnce)
+{
+    TrackMetadataStore store{};
+    store.Reserve(4);
+    store.Append(L"https://example.com/tracks/101.mp3", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg");
+    size_t memoryBytes{ store.MemoryBytes() };
+
+    // Nothing new to intern, and the columns have room, so nothing is allocated
+    store.Append(L"https://example.com/tracks/101.mp3", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg");
+    CHECK(store.MemoryBytes() == memoryBytes);
+    CheckRow(store, 1, L"https://example.com/tracks/101.mp3", L"Run Early", L"Computoser", L"https://example.com/art/1.jpg");
+}
+
+BENCHMARK(TrackMetadataStoreFootprint)
+{
+    std::vector<std::wstring> srcs{};
+    std::vector<std::wstring> titles{};
+    for (uint32_t i = 0; i < BenchmarkTrackCount; i++)
+    {
+        srcs.push_back(L"https://raw.githubusercontent.com/microsoft/Windows-universal-samples/main/SharedContent/media/tracks/" + std::to_wstring(100 + i) + L".mp3");
+        titles.push_back(L"Track number " + std::to_wstring(i));
+    }
+    std::vector<std::wstring> artists{};
+    for (uint32_t i = 0; i < BenchmarkArtistCount; i++)
+    {
+        artists.push_back(L"Artist " + std::to_wstring(i));
+    }
+    std::vector<std::wstring> images{};
+    for (uint32_t i = 0; i < BenchmarkImageCount; i++)
+    {
+        images.push_back(L"https://raw.githubusercontent.com/microsoft/Windows-universal-samples/main/SharedContent/media/Samples/LandscapeImage" + std::to_wstring(i + 1) + L".jpg");
+    }
+
+    TrackMetadataStore store{};
+    double appendSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkTrackCount; i++)
+        {
+            store.Append(srcs[i], titles[i], artists[i % BenchmarkArtistCount], images[i % BenchmarkImageCount]);
+        }
+    }) };
+
+    size_t readLength{ 0 };
+    double getSeconds{ NativeMediaPlayerTests::SecondsToRun([&]()
+    {
+        for (uint32_t i = 0; i < BenchmarkTrackCount; i++)
+        {
+            readLength += store.Get(i, Field::Src).size() + store.Get(i, Field::Title).size() +
+                store.Get(i, Field::Artist).size() + store.Get(i, Field::ThumbnailSrc).size();
+        }
+    }) };
+    CHECK(readLength > 0);
+
+    double memoryBytesPerTrack{ static_cast<double>(store.MemoryBytes()) / BenchmarkTrackCount };
+    double separateBytesPerTrack{ static_cast<double>(store.SeparateObjectBytes()) / BenchmarkTrackCount };
+    NativeMediaPlayerTests::Report("Store, 100k tracks", memoryBytesPerTrack, "bytes/track");
+    NativeMediaPlayerTests::Report("Separate objects (estimate), 100k tracks", separateBytesPerTrack, "bytes/track");
+    NativeMediaPlayerTests::Report("Separate objects / store", separateBytesPerTrack / memoryBytesPerTrack, "x");
+    NativeMediaPlayerTests::Report("Append", BenchmarkTrackCount / appendSeconds / 1e6, "M tracks/s");
+    NativeMediaPlayerTests::Report("Get, all four fields", BenchmarkTrackCount / getSeconds / 1e6, "M tracks/s");
+}
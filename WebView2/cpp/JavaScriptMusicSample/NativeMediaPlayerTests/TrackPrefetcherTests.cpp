@@ -0,0 +1,185 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include "LocalHttpServer.h"
+#include "TrackPrefetcher.h"
+
+using namespace winrt::NativeMediaPlayer::implementation;
+using namespace winrt::Windows::Storage::Streams;
+using NativeMediaPlayerTests::LocalHttpServer;
+
+namespace
+{
+    constexpr size_t PrefetchBytes{ TrackPrefetcher::PrefetchBytes };
+
+    // About what a decoder reads before the first sample can play
+    constexpr uint32_t FirstReadBytes{ 64 * 1024 };
+
+    constexpr uint32_t BenchmarkTrackChanges{ 10 };
+
+    std::string MakeTrack(size_t size, uint32_t seed)
+    {
+        std::string track(size, '\0');
+        for (size_t i = 0; i < size; i++)
+        {
+            track[i] = static_cast<char>((i * 7 + i / 251 + seed) & 0xFF);
+        }
+        return track;
+    }
+
+    /// <summary>
+    /// Answers a request for track the way a file server does, honoring a single byte range.
+    /// </summary>
+    LocalHttpServer::Response ServeTrack(LocalHttpServer::Request const& request, std::string const& track)
+    {
+        std::string range{ request.Header("range") };
+        if (range.rfind("bytes=", 0) != 0)
+        {
+            return LocalHttpServer::Response{ 200, { { "Content-Type", "audio/mpeg" } }, track };
+        }
+
+        size_t dash{ range.find('-') };
+        uint64_t first{ std::stoull(range.substr(6, dash - 6)) };
+        uint64_t last{ track.size() - 1 };
+        if (dash + 1 < range.size())
+        {
+            last = std::min<uint64_t>(last, std::stoull(range.substr(dash + 1)));
+        }
+        return LocalHttpServer::Response{ 206,
+            { { "Content-Type", "audio/mpeg" }, { "Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(track.size()) } },
+            track.substr(first, last - first + 1) };
+    }
+
+    std::string Read(IRandomAccessStream const& stream, uint32_t count)
+    {
+        Buffer buffer{ count };
+        IBuffer read{ stream.ReadAsync(buffer, count, InputStreamOptions::None).get() };
+        return std::string{ reinterpret_cast<char const*>(read.data()), read.Length() };
+    }
+}
+
+TEST(TrackPrefetcherServesHeadBeforeOpeningSource)
+{
+    std::string track{ MakeTrack(PrefetchBytes * 3 / 2, 1) };
+    LocalHttpServer server{ [&](LocalHttpServer::Request const& request) { return ServeTrack(request, track); } };
+    TrackPrefetcher prefetcher{ []() { return 8 * PrefetchBytes; } };
+    winrt::hstring uri{ server.Uri(L"/tracks/1.mp3").ToString() };
+
+    prefetcher.PrefetchAsync(uri).get();
+    CHECK(prefetcher.Stats().prefetches == 1);
+    CHECK(prefetcher.Stats().bytesPrefetched == PrefetchBytes);
+    CHECK(server.Requests().size() == 1);
+    CHECK(server.Requests()[0].Header("range") == "bytes=0-" + std::to_string(PrefetchBytes - 1));
+
+    // Already cached, so nothing is fetched again
+    prefetcher.PrefetchAsync(uri).get();
+    CHECK(server.Requests().size() == 1);
+
+    winrt::hstring contentType{};
+    IRandomAccessStream stream{ prefetcher.TryOpenStream(uri, contentType) };
+    CHECK(stream);
+    CHECK(contentType == L"audio/mpeg");
+    CHECK(stream.Size() == track.size());
+    CHECK(prefetcher.Stats().hits == 1);
+
+    // The start of the track comes from memory without a request of its own
+    CHECK(Read(stream, FirstReadBytes) == track.substr(0, FirstReadBytes));
+    CHECK(server.Requests().size() == 1);
+
+    // Reads that run past the prefetched bytes, and those after them, come from the track itself
+    std::string rest{};
+    for (std::string read{ Read(stream, 100000) }; !read.empty(); read = Read(stream, 100000))
+    {
+        rest += read;
+    }
+    CHECK(rest == track.substr(FirstReadBytes));
+    CHECK(server.Requests().size() > 1);
+    CHECK(prefetcher.Stats().bytesServedFromCache == PrefetchBytes);
+
+    CHECK(!prefetcher.TryOpenStream(server.Uri(L"/tracks/2.mp3").ToString(), contentType));
+    CHECK(prefetcher.Stats().misses == 1);
+}
+
+TEST(TrackPrefetcherKeepsToMemoryBudget)
+{
+    std::string track{ MakeTrack(PrefetchBytes * 2, 2) };
+    LocalHttpServer server{ [&](LocalHttpServer::Request const& request) { return ServeTrack(request, track); } };
+    std::atomic<size_t> budget{ 2 * PrefetchBytes };
+    TrackPrefetcher prefetcher{ [&]() { return budget.load(); } };
+
+    // Room for two heads, so the least recently used of three goes
+    for (wchar_t const* path : { L"/tracks/1.mp3", L"/tracks/2.mp3", L"/tracks/3.mp3" })
+    {
+        prefetcher.PrefetchAsync(server.Uri(path).ToString()).get();
+    }
+    CHECK(prefetcher.Stats().prefetches == 3);
+    CHECK(prefetcher.Stats().evictions == 1);
+
+    winrt::hstring contentType{};
+    CHECK(!prefetcher.TryOpenStream(server.Uri(L"/tracks/1.mp3").ToString(), contentType));
+    CHECK(prefetcher.TryOpenStream(server.Uri(L"/tracks/3.mp3").ToString(), contentType));
+
+    // With no budget left the cache is emptied, and nothing more is fetched
+    budget = 0;
+    prefetcher.TrimToMemoryLevel();
+    CHECK(prefetcher.Stats().evictions == 3);
+    size_t requests{ server.Requests().size() };
+    prefetcher.PrefetchAsync(server.Uri(L"/tracks/4.mp3").ToString()).get();
+    CHECK(server.Requests().size() == requests);
+}
+
+BENCHMARK(TrackPrefetcherGapAtTrackChange)
+{
+    // Each response from the server is held back by the latency being measured, as a slow disk
+    // or a distant server would
+    std::atomic<uint32_t> latencyMilliseconds{ 0 };
+    std::string track{ MakeTrack(PrefetchBytes * 4, 3) };
+    LocalHttpServer server{ [&](LocalHttpServer::Request const& request)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latencyMilliseconds.load()));
+        return ServeTrack(request, track);
+    } };
+    TrackPrefetcher prefetcher{ []() { return 64 * PrefetchBytes; } };
+
+    for (uint32_t latency : { 0u, 20u, 100u, 250u, 500u })
+    {
+        latencyMilliseconds = latency;
+        double openedSeconds{ 0 };
+        double prefetchedSeconds{ 0 };
+        for (uint32_t i = 0; i < BenchmarkTrackChanges; i++)
+        {
+            // Every track has a URI of its own, so nothing along the way can have cached it
+            std::wstring path{ L"/tracks/" + std::to_wstring(latency) + L"/" + std::to_wstring(i) };
+
+            // Without a prefetched head, the next track is opened when it is needed, as the
+            // PrefetchedStream's own source and the player's are
+            winrt::Windows::Foundation::Uri openedUri{ server.Uri(path + L".mp3") };
+            openedSeconds += NativeMediaPlayerTests::SecondsToRun([&]()
+            {
+                IRandomAccessStream stream{ RandomAccessStreamReference::CreateFromUri(openedUri).OpenReadAsync().get() };
+                CHECK(Read(stream, FirstReadBytes).size() == FirstReadBytes);
+            });
+
+            // With one, the head was fetched while the previous track played
+            winrt::hstring prefetchedUri{ server.Uri(path + L"-prefetched.mp3").ToString() };
+            prefetcher.PrefetchAsync(prefetchedUri).get();
+            prefetchedSeconds += NativeMediaPlayerTests::SecondsToRun([&]()
+            {
+                winrt::hstring contentType{};
+                IRandomAccessStream stream{ prefetcher.TryOpenStream(prefetchedUri, contentType) };
+                CHECK(stream);
+                CHECK(Read(stream, FirstReadBytes).size() == FirstReadBytes);
+            });
+        }
+
+        char measurement[64]{};
+        sprintf_s(measurement, "Opened at the change, %u ms latency", latency);
+        NativeMediaPlayerTests::Report(measurement, openedSeconds / BenchmarkTrackChanges * 1e3, "ms gap");
+        sprintf_s(measurement, "Prefetched, %u ms latency", latency);
+        NativeMediaPlayerTests::Report(measurement, prefetchedSeconds / BenchmarkTrackChanges * 1e3, "ms gap");
+    }
+
+    NativeMediaPlayerTests::Report("Hit rate", 100.0 * prefetcher.Stats().hits / (prefetcher.Stats().hits + prefetcher.Stats().misses), "%");
+}
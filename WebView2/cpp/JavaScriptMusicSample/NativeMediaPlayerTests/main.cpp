@@ -0,0 +1,68 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "TestHarness.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+using namespace NativeMediaPlayerTests;
+
+/// <summary>
+/// Runs the tests, or with --benchmark the benchmarks instead. Any other argument only runs the
+/// tests or benchmarks whose name contains it. Returns the number that failed.
+/// </summary>
+int main(int argc, char* argv[])
+{
+    winrt::init_apartment();
+
+    bool runBenchmarks{ false };
+    char const* filter{ nullptr };
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--benchmark") == 0)
+        {
+            runBenchmarks = true;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    int run{ 0 };
+    int failed{ 0 };
+    for (TestCase const& testCase : Registry())
+    {
+        if (testCase.isBenchmark != runBenchmarks || (filter && !std::strstr(testCase.name, filter)))
+        {
+            continue;
+        }
+
+        std::printf("%s\n", testCase.name);
+        std::fflush(stdout);
+        run++;
+        try
+        {
+            testCase.run();
+            continue;
+        }
+        catch (CheckFailure const& failure)
+        {
+            std::printf("    FAILED: %s\n", failure.message.c_str());
+        }
+        catch (winrt::hresult_error const& error)
+        {
+            std::printf("    FAILED: 0x%08X %ls\n", static_cast<uint32_t>(error.code()), error.message().c_str());
+        }
+        catch (std::exception const& error)
+        {
+            std::printf("    FAILED: %s\n", error.what());
+        }
+        failed++;
+    }
+
+    std::printf("%d of %d %s passed\n", run - failed, run, runBenchmarks ? "benchmarks" : "tests");
+    return failed;
+}
@@ -5,6 +5,7 @@
 #include "MainPage.h"
 #include "MainPage.g.cpp"
 #include "winrt/WinRTAdapter.h"
+#include "winrt/WindowsAPIProxies.h"
 #include <winrt/Microsoft.Web.WebView2.Core.h>
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Media.h>
@@ -17,7 +18,6 @@
 
 using namespace winrt::Microsoft::UI::Xaml::Controls;
 using namespace winrt::Microsoft::Web::WebView2::Core;
-using namespace winrt::Windows::Data::Json;
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Graphics::Display::Core;
 using namespace winrt::Windows::Media;
@@ -52,6 +52,11 @@ namespace winrt::JavaScriptVideoSample::implementation
         smtc.IsNextEnabled(true);
         smtc.IsPreviousEnabled(true);
         smtc.ButtonPressed({ this, &MainPage::OnSMTCButtonPressed });
+        smtcUpdates = std::make_unique<SmtcUpdateScheduler>(smtc);
+        remoteCommands = std::make_unique<RemoteCommandChannel>([this](hstring const& json)
+        {
+            webView.CoreWebView2().PostWebMessageAsJson(json);
+        });
 
         // Hook up an event so that we can inform the JavaScript code when the HDMI display mode chages.
         auto hdmiInfo{ Windows::Graphics::Display::Core::HdmiDisplayInformation::GetForCurrentView() };
@@ -60,6 +65,7 @@ namespace winrt::JavaScriptVideoSample::implementation
             hdmiInfo.DisplayModesChanged({ this, &MainPage::OnDisplayModeChanged });
         }
 
+        RegisterWebMessageHandlers();
         InitializeWebView();
     }
 
@@ -139,6 +145,7 @@ namespace winrt::JavaScriptVideoSample::implementation
                     L"chrome.webview.hostObjects.options.ignoreMemberNotFoundError = true;"
                     L"window.Windows = chrome.webview.hostObjects.sync.Windows;"
                     L"window.WindowsProxies = chrome.webview.hostObjects.sync.WindowsAPIProxies;"
+                    L"window.nativeWrapperAcceptsBatches = true;"
                 L"}"
             L"})();");
 
@@ -177,6 +184,9 @@ namespace winrt::JavaScriptVideoSample::implementation
     void MainPage::OnNavigationStarting(WebView2 const&, CoreWebView2NavigationStartingEventArgs const&)
     {
         isNavigatedToPage = false;
+
+        // The new page has to say again that it takes remote commands
+        remoteCommands->SetReady(false);
     }
 
     /// <summary>
@@ -210,15 +220,10 @@ namespace winrt::JavaScriptVideoSample::implementation
     /// passed to window.chrome.webview.postMessage()</param>
     void MainPage::OnWebMessageReceived(WebView2 const&, CoreWebView2WebMessageReceivedEventArgs const& args)
     {
-        // If the message contains valid JSON data, handle it as an event notification.
+        // If the message contains valid JSON data, handle it as one or more event notifications.
         // Otherwise, simply log the message as-is to the debug console.
         hstring jsonMessage{ args.TryGetWebMessageAsString() };
-        JsonObject argsJson{};
-        if (JsonObject::TryParse(jsonMessage, argsJson))
-        {
-            HandleJsonNotification(argsJson);
-        }
-        else
+        if (!webMessages.Dispatch(jsonMessage))
         {
             OutputDebugString(L"Could not parse JSON message recieved:");
             OutputDebugString(jsonMessage.c_str());
@@ -231,7 +236,9 @@ namespace winrt::JavaScriptVideoSample::implementation
     /// <param name="args">Details about which button was pressed.</param>
     void MainPage::OnSMTCButtonPressed(SystemMediaTransportControls const&, SystemMediaTransportControlsButtonPressedEventArgs const& args)
     {
-        HandleSMTCButtonPressed(args.Button());
+        // Take the time of the press before anything else, so that its latency includes the hop to
+        // the UI thread
+        HandleSMTCButtonPressed(args.Button(), std::chrono::steady_clock::now());
     }
 
     /// <summary>
@@ -240,14 +247,15 @@ namespace winrt::JavaScriptVideoSample::implementation
     /// </summary>
     void MainPage::OnDisplayModeChanged(HdmiDisplayInformation const&, IInspectable const&)
     {
+        // The modes the page picks from may be different now
+        winrt::WindowsAPIProxies::DisplayModeSelector::Invalidate();
         UpdateDisplayMode();
     }
 
     /// <summary>
-    /// A helper function to handle JSON messages sent from the JavaScript code.
+    /// Sets up the handler for each JSON message the JavaScript code sends.
     /// </summary>
-    /// <param name="json">The JSON object that was sent.</param>
-    void MainPage::HandleJsonNotification(JsonObject const& json)
+    void MainPage::RegisterWebMessageHandlers()
     {
         // The JavaScript code is capable of sending any arbitrary JSON message that the native code is
         // prepared to handle. For the purposes of this sample we expect it to have the form:
@@ -259,130 +267,102 @@ namespace winrt::JavaScriptVideoSample::implementation
         //         ...
         //     }
         // }
+        //
+        // or to be an array of them, when several events occurred within a single animation frame.
+        // Messages nobody registered for are logged and ignored; see WebMessageProtocol.
 
-        hstring message{ json.GetNamedString(L"Message") };
-        JsonObject args{ json.GetNamedObject(L"Args") };
-
-        if (message == L"PlaybackStarted")
+        webMessages.Register(L"PlaybackStarted", [this]()
         {
             // Inform the system that playback has started
-            smtc.PlaybackStatus(MediaPlaybackStatus::Playing);
-        }
-        else if (message == L"PlaybackPaused")
+            smtcUpdates->UpdateStatus(MediaPlaybackStatus::Playing);
+        });
+        webMessages.Register(L"PlaybackPaused", [this]()
         {
             // Inform the system that playback has paused
-            smtc.PlaybackStatus(MediaPlaybackStatus::Paused);
-        }
-        else if (message == L"PlaybackEnded")
+            smtcUpdates->UpdateStatus(MediaPlaybackStatus::Paused);
+        });
+        webMessages.Register(L"PlaybackEnded", [this]()
         {
             // Inform the system that playback stopped
-            smtc.PlaybackStatus(MediaPlaybackStatus::Stopped);
-        }
-        else if (message == L"TimeUpdate" && args)
+            smtcUpdates->UpdateStatus(MediaPlaybackStatus::Stopped);
+        });
+        webMessages.Register<TimeUpdateArgs>(L"TimeUpdate", [this](TimeUpdateArgs const& args)
         {
-            // This message is sent at regular intervals when playback is occurring.
-            // Ensure that the expected arguments are included.
-            if (args.HasKey(L"CurrentTime") && args.HasKey(L"Duration"))
-            {
-                double currentTime = args.GetNamedNumber(L"CurrentTime");
-                double duration = args.GetNamedNumber(L"Duration");
-
-                // Keep the system up to date on our current playback position
-                UpdatePlaybackProgress(currentTime, duration);
-            }
-            else
-            {
-                OutputDebugString(L"Missing CurrentTime or Duration argument with TimeUpdate message.\n");
-            }
-        }
-        else if (message == L"VideoUpdate" && args)
+            // Keep the system up to date on our current playback position. This message arrives
+            // several times a second, far more often than the system needs to hear about it.
+            smtcUpdates->UpdateTimeline(args.currentTime, args.duration);
+        });
+        webMessages.Register<VideoUpdateArgs>(L"VideoUpdate", [this](VideoUpdateArgs const& args)
         {
-            // This message is passed when the selected video changes.
-            hstring newTitle{ L"" };
-            hstring newSubtitle{ L"" };
-
-            // Treat arguments to this message as optional, but log if the title is missing.
-            if (args.HasKey(L"Title"))
-            {
-                newTitle = args.GetNamedString(L"Title");
-            }
-            else
-            {
-                OutputDebugString(L"Missing Title with VideoUpdate message.\n");
-            }
-            if (args.HasKey(L"Subtitle"))
-            {
-                newSubtitle = args.GetNamedString(L"Subtitle");
-            }
-
-            UpdateVideoMetadata(newTitle, newSubtitle);
-        }
-        else
+            smtcUpdates->UpdateMetadata(args.title, args.subtitle);
+        });
+        webMessages.Register(L"CommandChannelReady", [this]()
         {
-            std::wostringstream strStream{};
-            strStream << L"Unexpected JSON message:\n" << message.c_str() << std::endl;
-            OutputDebugString(strStream.str().c_str());
-        }
+            // From now on remote button presses are posted to the page rather than run as scripts
+            remoteCommands->SetReady(true);
+        });
+        webMessages.Register<CommandsHandledArgs>(L"CommandsHandled", [this](CommandsHandledArgs const& args)
+        {
+            remoteCommands->Handled(args.sequence);
+        });
     }
 
     /// <summary>
-    /// Keep the system in-sync with the current playback status as it changes. It is recommended
-    /// to call this function at least every 5 seconds to ensure that the system and the
-    /// application don't get out of sync.
-    /// 
-    /// In this sample, it is called more often because it is hooked up to the ontimeupdate event
-    /// on the video element.
+    /// Both arguments are required.
     /// </summary>
-    /// <param name="currentTime">The current spot the playhead is at in the video.</param>
-    /// <param name="duration">The total length of the video.</param>
-    void MainPage::UpdatePlaybackProgress(double currentTime, double duration)
+    std::optional<MainPage::TimeUpdateArgs> MainPage::TimeUpdateArgs::Decode(WebMessageArgs const& args)
     {
-        TimeSpan currentTimeSpan{ std::chrono::duration_cast<TimeSpan>(std::chrono::duration<double>(currentTime)) };
-        TimeSpan durationSpan{ std::chrono::duration_cast<TimeSpan>(std::chrono::duration<double>(duration)) };
-
-        SystemMediaTransportControlsTimelineProperties timelineProps{};
-        timelineProps.StartTime(TimeSpan::zero());
-        timelineProps.MinSeekTime(TimeSpan::zero());
-        timelineProps.Position(currentTimeSpan);
-        timelineProps.MaxSeekTime(durationSpan);
-        timelineProps.EndTime(durationSpan);
-
-        smtc.UpdateTimelineProperties(timelineProps);
+        std::optional<double> currentTime{ args.GetNumber(L"CurrentTime") };
+        std::optional<double> duration{ args.GetNumber(L"Duration") };
+        if (!currentTime || !duration)
+        {
+            return std::nullopt;
+        }
+        return TimeUpdateArgs{ *currentTime, *duration };
     }
 
     /// <summary>
-    /// Keep the system informed of the currently-playing content. The most important part of
-    /// this function is that it informs the system that the currently playing content is a 
-    /// video. Additionally it passes along some metadata. As of 01/2023 this metadata is not
-    /// presently shown for videos anywhere in the Xbox UI, but it is plumbed here in case that
-    /// changes in the future.
+    /// Both arguments are optional, but a missing title is logged.
     /// </summary>
-    /// <param name="title">The title of the video being played.</param>
-    /// <param name="subtitle">The subtitle of the video being played.</param>
-    void MainPage::UpdateVideoMetadata(hstring const& title, hstring const& subtitle)
+    std::optional<MainPage::VideoUpdateArgs> MainPage::VideoUpdateArgs::Decode(WebMessageArgs const& args)
     {
-        SystemMediaTransportControlsDisplayUpdater updater{ smtc.DisplayUpdater() };
-        updater.Type(MediaPlaybackType::Video);
-        updater.VideoProperties().Title(title);
-        updater.VideoProperties().Subtitle(subtitle);
-
-        // There are a few other properties that can be set on the VideoProperties object in
-        // addition to title and subtitle. You may plumb them if you wish.
+        std::optional<std::wstring_view> title{ args.GetString(L"Title") };
+        if (!title)
+        {
+            OutputDebugString(L"Missing Title with VideoUpdate message.\n");
+        }
+        return VideoUpdateArgs{ hstring{ title.value_or(L"") }, hstring{ args.GetString(L"Subtitle").value_or(L"") } };
+    }
 
-        updater.Update();
+    std::optional<MainPage::CommandsHandledArgs> MainPage::CommandsHandledArgs::Decode(WebMessageArgs const& args)
+    {
+        std::optional<double> sequence{ args.GetNumber(L"Sequence") };
+        if (!sequence || *sequence < 0)
+        {
+            return std::nullopt;
+        }
+        return CommandsHandledArgs{ static_cast<uint64_t>(*sequence) };
     }
 
     /// <summary>
-    /// Calls the appropriate JavaScript function to perform the action that matches the button the
-    /// user pressed on the media remote.
+    /// Passes the button the user pressed on the media remote to the page, as a command if it takes
+    /// them, or else by calling the appropriate JavaScript function.
     /// </summary>
     /// <param name="button">The button the user pressed.</param>
-    fire_and_forget MainPage::HandleSMTCButtonPressed(SystemMediaTransportControlsButton const button)
+    /// <param name="pressedAt">When the button was pressed.</param>
+    fire_and_forget MainPage::HandleSMTCButtonPressed(SystemMediaTransportControlsButton const button, std::chrono::steady_clock::time_point pressedAt)
     {
         // This callback can occur on a background thread. We need to interact with the WebView,
         // so this call marshalls the handler back to the UI thread.
         co_await webView.Dispatcher();
 
+        // Commands are cheaper than scripts, which each have to be compiled and run in turn, and a
+        // burst of presses is coalesced into one command while the page is busy
+        if (remoteCommands->IsReady() && remoteCommands->Press(button, pressedAt))
+        {
+            co_return;
+        }
+
         // Only handle button presses if we're fully navigated to a page in the WebView.
         if (isNavigatedToPage)
         {
@@ -425,7 +405,7 @@ namespace winrt::JavaScriptVideoSample::implementation
         // When the display changes (eg. the HDMI cable is plugged into a new device) ensure
         // the new device is in the correct mode for the current content.
         OutputDebugString(L"Display mode has changed.\n");
-        co_await webView.ExecuteScriptAsync(L"updateDisplayModeAsync();");
+        co_await webView.ExecuteScriptAsync(L"onDisplayChangedAsync();");
     }
 
     /// <summary>
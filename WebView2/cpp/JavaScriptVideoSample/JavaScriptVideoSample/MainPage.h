@@ -4,6 +4,10 @@
 #pragma once
 
 #include "MainPage.g.h"
+#include "RemoteCommandChannel.h"
+#include "SmtcUpdateScheduler.h"
+#include "WebMessageProtocol.h"
+#include <memory>
 
 namespace winrt::JavaScriptVideoSample::implementation
 {
@@ -28,6 +32,18 @@ namespace winrt::JavaScriptVideoSample::implementation
         /// </summary>
         Windows::Media::SystemMediaTransportControls smtc = nullptr;
 
+        /// <summary>
+        /// Everything the page reports about playback reaches the SystemMediaTransportControls through
+        /// this, which only passes on what the system needs to know.
+        /// </summary>
+        std::unique_ptr<SmtcUpdateScheduler> smtcUpdates{};
+
+        /// <summary>
+        /// Delivers media remote button presses to the page once it has said it can take them.
+        /// Until then, presses run a script in the page instead.
+        /// </summary>
+        std::unique_ptr<RemoteCommandChannel> remoteCommands{};
+
         /// <summary>
         /// This is the URI that will be loaded when the app launches.
         /// For the purposes of this sample, we're using HTML/JavaScript embedded within the app itself, but
@@ -40,6 +56,45 @@ namespace winrt::JavaScriptVideoSample::implementation
         /// </summary>
         bool isNavigatedToPage = false;
 
+        /// <summary>
+        /// Routes the messages the JavaScript code posts to the handlers registered in
+        /// RegisterWebMessageHandlers().
+        /// </summary>
+        WebMessageProtocol webMessages{};
+
+        /// <summary>
+        /// The arguments of the TimeUpdate message, sent at regular intervals while playback is occurring.
+        /// </summary>
+        struct TimeUpdateArgs
+        {
+            double currentTime{ 0 };
+            double duration{ 0 };
+
+            static std::optional<TimeUpdateArgs> Decode(WebMessageArgs const& args);
+        };
+
+        /// <summary>
+        /// The arguments of the VideoUpdate message, sent when the selected video changes.
+        /// </summary>
+        struct VideoUpdateArgs
+        {
+            hstring title{};
+            hstring subtitle{};
+
+            static std::optional<VideoUpdateArgs> Decode(WebMessageArgs const& args);
+        };
+
+        /// <summary>
+        /// The arguments of the CommandsHandled message, sent when the page has finished with a batch
+        /// of remote commands.
+        /// </summary>
+        struct CommandsHandledArgs
+        {
+            uint64_t sequence{ 0 };
+
+            static std::optional<CommandsHandledArgs> Decode(WebMessageArgs const& args);
+        };
+
         fire_and_forget InitializeWebView();
         void OnNavigationStarting(Microsoft::UI::Xaml::Controls::WebView2 const&, Microsoft::Web::WebView2::Core::CoreWebView2NavigationStartingEventArgs const&);
         void OnNavigationCompleted(Microsoft::UI::Xaml::Controls::WebView2 const&, Microsoft::Web::WebView2::Core::CoreWebView2NavigationCompletedEventArgs const&);
@@ -49,10 +104,8 @@ namespace winrt::JavaScriptVideoSample::implementation
         fire_and_forget OnLaunchingExternalUriScheme(winrt::Microsoft::Web::WebView2::Core::CoreWebView2 const&, Microsoft::Web::WebView2::Core::CoreWebView2LaunchingExternalUriSchemeEventArgs const&);
         void OnWebViewProcessFailed(winrt::Microsoft::Web::WebView2::Core::CoreWebView2 const&, Microsoft::Web::WebView2::Core::CoreWebView2ProcessFailedEventArgs const&);
 
-        void HandleJsonNotification(Windows::Data::Json::JsonObject const& json);
-        void UpdatePlaybackProgress(double currentTime, double duration);
-        void UpdateVideoMetadata(hstring const& title, hstring const& subtitle);
-        fire_and_forget HandleSMTCButtonPressed(Windows::Media::SystemMediaTransportControlsButton const button);
+        void RegisterWebMessageHandlers();
+        fire_and_forget HandleSMTCButtonPressed(Windows::Media::SystemMediaTransportControlsButton const button, std::chrono::steady_clock::time_point pressedAt);
         fire_and_forget UpdateDisplayMode();
     };
 }
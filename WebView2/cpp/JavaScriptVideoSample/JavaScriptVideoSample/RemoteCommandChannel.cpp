@@ -0,0 +1,209 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "RemoteCommandChannel.h"
+#include <sstream>
+
+using namespace winrt::Windows::Data::Json;
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Media;
+
+namespace
+{
+    constexpr wchar_t const* ButtonKindNames[]{ L"Play", L"Pause", L"Stop", L"Next", L"Previous" };
+}
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    RemoteCommandChannel::RemoteCommandChannel(std::function<void(hstring const&)> postJson) :
+        postJson{ std::move(postJson) }
+    {
+        ackTimer.Interval(AckTimeout);
+        ackTimer.Tick({ this, &RemoteCommandChannel::OnAckTimeout });
+    }
+
+    RemoteCommandChannel::~RemoteCommandChannel()
+    {
+        // A running timer is kept alive by the dispatcher, and would otherwise call back into this
+        ackTimer.Stop();
+    }
+
+    /// <summary>
+    /// Anything queued for a page that is going away is dropped rather than sent to the next one.
+    /// </summary>
+    void RemoteCommandChannel::SetReady(bool value)
+    {
+        ready = value;
+        pending = Batch{};
+        inFlight.reset();
+        ackTimer.Stop();
+    }
+
+    bool RemoteCommandChannel::Press(SystemMediaTransportControlsButton button, Clock::time_point pressedAt)
+    {
+        ButtonKind kind{};
+        switch (button)
+        {
+        case SystemMediaTransportControlsButton::Play:
+            kind = ButtonKind::Play;
+            break;
+        case SystemMediaTransportControlsButton::Pause:
+            kind = ButtonKind::Pause;
+            break;
+        case SystemMediaTransportControlsButton::Stop:
+            kind = ButtonKind::Stop;
+            break;
+        case SystemMediaTransportControlsButton::Next:
+            kind = ButtonKind::Next;
+            break;
+        case SystemMediaTransportControlsButton::Previous:
+            kind = ButtonKind::Previous;
+            break;
+        default:
+            return false;
+        }
+
+        stats.presses++;
+        if (!pending.presses.empty())
+        {
+            stats.coalesced++;
+        }
+        pending.presses.emplace_back(kind, pressedAt);
+        if (kind == ButtonKind::Next)
+        {
+            pending.skip++;
+        }
+        else if (kind == ButtonKind::Previous)
+        {
+            pending.skip--;
+        }
+        else
+        {
+            pending.transport = kind;
+        }
+
+        // While the page is busy with the last batch, this one keeps collecting presses
+        if (!inFlight)
+        {
+            SendPending();
+        }
+        return true;
+    }
+
+    void RemoteCommandChannel::Handled(uint64_t handledSequence)
+    {
+        if (!inFlight || handledSequence != sequence)
+        {
+            return;
+        }
+
+        auto now{ Clock::now() };
+        for (auto const& [kind, pressedAt] : inFlight->presses)
+        {
+            auto milliseconds{ std::chrono::duration_cast<std::chrono::milliseconds>(now - pressedAt).count() };
+            size_t bucket{ 0 };
+            while (bucket < LatencyBucketCount - 1 && milliseconds >= (1ll << bucket))
+            {
+                bucket++;
+            }
+            stats.latencies[kind][bucket]++;
+        }
+
+        uint64_t handledBefore{ stats.handled };
+        stats.handled += inFlight->presses.size();
+        if (handledBefore / StatisticsInterval != stats.handled / StatisticsInterval)
+        {
+            LogStatistics();
+        }
+
+        inFlight.reset();
+        ackTimer.Stop();
+        SendPending();
+    }
+
+    void RemoteCommandChannel::LogStatistics() const
+    {
+        std::wostringstream strStream{};
+        strStream << L"[RemoteCommandChannel: "
+            << L"Presses=" << stats.presses << L", "
+            << L"Coalesced=" << stats.coalesced << L", "
+            << L"Batches=" << stats.batches << L", "
+            << L"Handled=" << stats.handled << L", "
+            << L"TimedOut=" << stats.timedOut
+            << L"]" << std::endl;
+
+        // One line per button that has been pressed, with a count per latency bucket: <1ms, <2ms, <4ms...
+        for (size_t kind = 0; kind < ButtonKindCount; kind++)
+        {
+            LatencyHistogram const& histogram{ stats.latencies[kind] };
+            uint64_t total{ 0 };
+            for (uint64_t count : histogram)
+            {
+                total += count;
+            }
+            if (total == 0)
+            {
+                continue;
+            }
+
+            strStream << L"[RemoteCommandChannel: Button=" << ButtonKindNames[kind] << L", LatencyMs=";
+            for (size_t bucket = 0; bucket + 1 < LatencyBucketCount; bucket++)
+            {
+                strStream << L"<" << (1ll << bucket) << L":" << histogram[bucket] << L" ";
+            }
+            strStream << L">=" << (1ll << (LatencyBucketCount - 2)) << L":" << histogram[LatencyBucketCount - 1];
+            strStream << L"]" << std::endl;
+        }
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    void RemoteCommandChannel::SendPending()
+    {
+        if (pending.presses.empty())
+        {
+            return;
+        }
+
+        JsonArray commands{};
+        if (pending.skip != 0)
+        {
+            JsonObject skip{};
+            skip.SetNamedValue(L"Command", JsonValue::CreateStringValue(L"Skip"));
+            skip.SetNamedValue(L"Count", JsonValue::CreateNumberValue(pending.skip));
+            commands.Append(skip);
+        }
+        if (pending.transport)
+        {
+            JsonObject transport{};
+            transport.SetNamedValue(L"Command", JsonValue::CreateStringValue(ButtonKindNames[*pending.transport]));
+            commands.Append(transport);
+        }
+
+        // Presses that cancel out, such as Next then Previous, still need answering so that their
+        // latency is recorded, so the batch is sent even if it has no commands
+        JsonObject batch{};
+        batch.SetNamedValue(L"Sequence", JsonValue::CreateNumberValue(static_cast<double>(++sequence)));
+        batch.SetNamedValue(L"Commands", commands);
+
+        inFlight = std::move(pending);
+        pending = Batch{};
+        stats.batches++;
+        ackTimer.Start();
+        postJson(batch.Stringify());
+    }
+
+    void RemoteCommandChannel::OnAckTimeout(IInspectable const&, IInspectable const&)
+    {
+        ackTimer.Stop();
+        if (!inFlight)
+        {
+            return;
+        }
+
+        stats.timedOut++;
+        OutputDebugString(L"The page did not answer a batch of remote commands in time.\n");
+        inFlight.reset();
+        SendPending();
+    }
+}
@@ -0,0 +1,111 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <winrt/Windows.Media.h>
+#include <winrt/Windows.UI.Xaml.h>
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    /// <summary>
+    /// Passes media remote button presses to the page as JSON commands, rather than running a script
+    /// for each one.
+    ///
+    /// Only one batch of commands is with the page at a time. Presses that arrive while the page is
+    /// still handling the last batch are coalesced into the next one: Next and Previous add up to a
+    /// single skip, and of Play, Pause and Stop only the last counts. A batch is posted as
+    ///
+    ///     { "Sequence": n, "Commands": [ { "Command": "Skip", "Count": -2 }, { "Command": "Pause" } ] }
+    ///
+    /// with the skip always first, and the page answers it with a CommandsHandled message carrying the
+    /// same Sequence. A batch the page never answers is given up on after AckTimeout, and whatever
+    /// was pressed in the meantime is posted instead.
+    ///
+    /// The time from each press to the page answering for it is kept in a histogram per button.
+    /// All calls are expected on the UI thread.
+    /// </summary>
+    class RemoteCommandChannel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit RemoteCommandChannel(std::function<void(hstring const&)> postJson);
+        ~RemoteCommandChannel();
+
+        /// <summary>
+        /// True once the page has said it handles commands, until it navigates away. Until then,
+        /// presses should be passed on some other way.
+        /// </summary>
+        bool IsReady() const noexcept { return ready; }
+        void SetReady(bool value);
+
+        /// <summary>
+        /// Queues a button press, and posts it straight away unless the page is still busy.
+        /// Returns false, without queuing it, for buttons that have no command.
+        /// </summary>
+        bool Press(winrt::Windows::Media::SystemMediaTransportControlsButton button, Clock::time_point pressedAt);
+
+        /// <summary>
+        /// Called when the page has finished with the batch numbered sequence.
+        /// </summary>
+        void Handled(uint64_t sequence);
+
+        void LogStatistics() const;
+
+    private:
+        // Latencies are bucketed by powers of two milliseconds: under 1ms, under 2ms, and so on,
+        // with the last bucket taking everything longer
+        static constexpr size_t LatencyBucketCount{ 12 };
+        using LatencyHistogram = std::array<uint64_t, LatencyBucketCount>;
+
+        // The buttons there are commands for, and so histograms
+        enum ButtonKind : size_t
+        {
+            Play,
+            Pause,
+            Stop,
+            Next,
+            Previous,
+            ButtonKindCount,
+        };
+
+        struct Batch
+        {
+            int32_t skip{ 0 };
+            std::optional<ButtonKind> transport{};
+            std::vector<std::pair<ButtonKind, Clock::time_point>> presses{};
+        };
+
+        static constexpr std::chrono::seconds AckTimeout{ 2 };
+
+        // Handled presses between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 20 };
+
+        void SendPending();
+        void OnAckTimeout(winrt::Windows::Foundation::IInspectable const&, winrt::Windows::Foundation::IInspectable const&);
+
+        std::function<void(hstring const&)> postJson{};
+        bool ready{ false };
+        Batch pending{};
+        std::optional<Batch> inFlight{};
+        uint64_t sequence{ 0 };
+        winrt::Windows::UI::Xaml::DispatcherTimer ackTimer{};
+
+        struct Statistics
+        {
+            uint64_t presses{ 0 };
+            uint64_t coalesced{ 0 };        // presses that went out in the same batch as an earlier one
+            uint64_t batches{ 0 };
+            uint64_t handled{ 0 };          // presses the page answered for
+            uint64_t timedOut{ 0 };         // batches the page never answered
+            std::array<LatencyHistogram, ButtonKindCount> latencies{};
+        };
+        Statistics stats{};
+    };
+}
@@ -0,0 +1,144 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "SmtcUpdateScheduler.h"
+#include <cmath>
+#include <sstream>
+
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Media;
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    SmtcUpdateScheduler::SmtcUpdateScheduler(SystemMediaTransportControls const& smtc) :
+        smtc{ smtc }
+    {
+    }
+
+    /// <summary>
+    /// Pausing, resuming or stopping moves the timeline off the course the system would otherwise
+    /// extrapolate, so the latest position goes out along with the new status.
+    /// </summary>
+    void SmtcUpdateScheduler::UpdateStatus(MediaPlaybackStatus status)
+    {
+        if (sentStatus == status)
+        {
+            stats.statusesSuppressed++;
+            return;
+        }
+
+        smtc.PlaybackStatus(status);
+        sentStatus = status;
+        stats.statusesSent++;
+
+        if (reportedDuration > 0)
+        {
+            stats.discontinuities++;
+            SendTimeline(reportedPosition, reportedDuration);
+        }
+        LogStatistics();
+    }
+
+    void SmtcUpdateScheduler::UpdateTimeline(double currentTime, double duration)
+    {
+        reportedPosition = currentTime;
+        reportedDuration = duration;
+
+        auto now{ std::chrono::steady_clock::now() };
+        bool discontinuous{ duration != sentDuration };
+        if (!discontinuous)
+        {
+            // While playing, the position should have moved on by the time since it was last sent
+            double predicted{ sentPosition };
+            if (sentStatus == MediaPlaybackStatus::Playing)
+            {
+                predicted += std::chrono::duration<double>(now - sentTimelineAt).count();
+            }
+            discontinuous = std::abs(currentTime - predicted) > SeekTolerance;
+        }
+
+        if (discontinuous)
+        {
+            stats.discontinuities++;
+        }
+        else if (now - sentTimelineAt < heartbeatInterval)
+        {
+            stats.timelinesSuppressed++;
+            return;
+        }
+        SendTimeline(currentTime, duration);
+    }
+
+    /// <summary>
+    /// Keep the system informed of the currently-playing content. The most important part of
+    /// this function is that it informs the system that the currently playing content is a
+    /// video. Additionally it passes along some metadata. As of 01/2023 this metadata is not
+    /// presently shown for videos anywhere in the Xbox UI, but it is plumbed here in case that
+    /// changes in the future.
+    /// </summary>
+    /// <param name="title">The title of the video being played.</param>
+    /// <param name="subtitle">The subtitle of the video being played.</param>
+    void SmtcUpdateScheduler::UpdateMetadata(hstring const& title, hstring const& subtitle)
+    {
+        if (sentTitle == title && sentSubtitle == subtitle)
+        {
+            stats.metadataSuppressed++;
+            return;
+        }
+
+        SystemMediaTransportControlsDisplayUpdater updater{ smtc.DisplayUpdater() };
+        updater.Type(MediaPlaybackType::Video);
+        updater.VideoProperties().Title(title);
+        updater.VideoProperties().Subtitle(subtitle);
+
+        // There are a few other properties that can be set on the VideoProperties object in
+        // addition to title and subtitle. You may plumb them if you wish.
+
+        updater.Update();
+        sentTitle = title;
+        sentSubtitle = subtitle;
+        stats.metadataSent++;
+    }
+
+    void SmtcUpdateScheduler::LogStatistics() const
+    {
+        std::wostringstream strStream{};
+        strStream << L"[SmtcUpdateScheduler: "
+            << L"TimelinesSent=" << stats.timelinesSent << L", "
+            << L"TimelinesSuppressed=" << stats.timelinesSuppressed << L", "
+            << L"Discontinuities=" << stats.discontinuities << L", "
+            << L"StatusesSent=" << stats.statusesSent << L", "
+            << L"StatusesSuppressed=" << stats.statusesSuppressed << L", "
+            << L"MetadataSent=" << stats.metadataSent << L", "
+            << L"MetadataSuppressed=" << stats.metadataSuppressed
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    /// <summary>
+    /// Keep the system in-sync with the current playback status as it changes. It is recommended
+    /// to do this at least every 5 seconds to ensure that the system and the application don't
+    /// get out of sync.
+    /// </summary>
+    /// <param name="currentTime">The current spot the playhead is at in the video.</param>
+    /// <param name="duration">The total length of the video.</param>
+    void SmtcUpdateScheduler::SendTimeline(double currentTime, double duration)
+    {
+        TimeSpan currentTimeSpan{ std::chrono::duration_cast<TimeSpan>(std::chrono::duration<double>(currentTime)) };
+        TimeSpan durationSpan{ std::chrono::duration_cast<TimeSpan>(std::chrono::duration<double>(duration)) };
+
+        SystemMediaTransportControlsTimelineProperties timelineProps{};
+        timelineProps.StartTime(TimeSpan::zero());
+        timelineProps.MinSeekTime(TimeSpan::zero());
+        timelineProps.Position(currentTimeSpan);
+        timelineProps.MaxSeekTime(durationSpan);
+        timelineProps.EndTime(durationSpan);
+
+        smtc.UpdateTimelineProperties(timelineProps);
+        sentPosition = currentTime;
+        sentDuration = duration;
+        sentTimelineAt = std::chrono::steady_clock::now();
+        stats.timelinesSent++;
+    }
+}
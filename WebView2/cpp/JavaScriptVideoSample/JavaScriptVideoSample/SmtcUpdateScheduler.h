@@ -0,0 +1,72 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <chrono>
+#include <optional>
+#include <winrt/Windows.Media.h>
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    /// <summary>
+    /// Decides which of the page's playback reports are passed on to the SystemMediaTransportControls.
+    ///
+    /// The page reports its position several times a second, but the system only needs to hear about
+    /// it every few seconds to stay in sync, plus whenever the position stops following on from the
+    /// last one it was told: a seek, a pause or resume, or a change of duration. Those are sent at
+    /// once; otherwise the timeline is sent when HeartbeatInterval has passed since it last was.
+    /// Status and metadata are only sent when they differ from what was last sent.
+    ///
+    /// The heartbeat is driven by the reports themselves, so nothing is sent while the page is quiet.
+    /// All calls are expected on the UI thread.
+    /// </summary>
+    class SmtcUpdateScheduler
+    {
+    public:
+        static constexpr std::chrono::seconds DefaultHeartbeatInterval{ 5 };
+
+        explicit SmtcUpdateScheduler(winrt::Windows::Media::SystemMediaTransportControls const& smtc);
+
+        std::chrono::steady_clock::duration HeartbeatInterval() const noexcept { return heartbeatInterval; }
+        void HeartbeatInterval(std::chrono::steady_clock::duration value) noexcept { heartbeatInterval = value; }
+
+        void UpdateStatus(winrt::Windows::Media::MediaPlaybackStatus status);
+        void UpdateTimeline(double currentTime, double duration);
+        void UpdateMetadata(hstring const& title, hstring const& subtitle);
+
+        void LogStatistics() const;
+
+    private:
+        void SendTimeline(double currentTime, double duration);
+
+        winrt::Windows::Media::SystemMediaTransportControls smtc{ nullptr };
+        std::chrono::steady_clock::duration heartbeatInterval{ DefaultHeartbeatInterval };
+
+        // A position further than this from where the last one sent predicts is treated as a seek
+        static constexpr double SeekTolerance{ 1.0 };
+
+        // What the system was last told
+        std::optional<winrt::Windows::Media::MediaPlaybackStatus> sentStatus{};
+        std::optional<hstring> sentTitle{};
+        hstring sentSubtitle{};
+        double sentPosition{ 0 };
+        double sentDuration{ -1 };
+        std::chrono::steady_clock::time_point sentTimelineAt{};
+
+        // The latest position the page reported, which may not have been sent
+        double reportedPosition{ 0 };
+        double reportedDuration{ -1 };
+
+        struct Statistics
+        {
+            uint64_t timelinesSent{ 0 };
+            uint64_t timelinesSuppressed{ 0 };
+            uint64_t discontinuities{ 0 };      // timelines sent early because of a seek, status or duration change
+            uint64_t statusesSent{ 0 };
+            uint64_t statusesSuppressed{ 0 };
+            uint64_t metadataSent{ 0 };
+            uint64_t metadataSuppressed{ 0 };
+        };
+        Statistics stats{};
+    };
+}
@@ -0,0 +1,491 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "WebMessageProtocol.h"
+#include <algorithm>
+#include <cwchar>
+#include <sstream>
+
+namespace
+{
+    // Unknown values nested deeper than this are rejected rather than risk exhausting the stack
+    constexpr uint32_t MaxNestingDepth{ 64 };
+
+    // Longer numbers than this are not valid message arguments
+    constexpr size_t MaxNumberLength{ 63 };
+
+    bool IsWhitespace(wchar_t c) noexcept
+    {
+        return c == L' ' || c == L'\t' || c == L'\n' || c == L'\r';
+    }
+
+    int HexValue(wchar_t c) noexcept
+    {
+        if (c >= L'0' && c <= L'9') return c - L'0';
+        if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+        if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+        return -1;
+    }
+}
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    bool WebMessageArgs::HasKey(std::wstring_view name) const noexcept
+    {
+        return Find(name) != nullptr;
+    }
+
+    std::optional<double> WebMessageArgs::GetNumber(std::wstring_view name) const noexcept
+    {
+        Field const* field{ Find(name) };
+        return field ? field->number : std::nullopt;
+    }
+
+    std::optional<std::wstring_view> WebMessageArgs::GetString(std::wstring_view name) const noexcept
+    {
+        Field const* field{ Find(name) };
+        return field ? field->text : std::nullopt;
+    }
+
+    WebMessageArgs::Field const* WebMessageArgs::Find(std::wstring_view name) const noexcept
+    {
+        for (size_t i = 0; i < fieldCount; i++)
+        {
+            if (fields[i].name == name)
+            {
+                return &fields[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void WebMessageProtocol::Register(std::wstring_view message, std::function<void()> handler)
+    {
+        AddRoute(message, [handler{ std::move(handler) }](WebMessageArgs const&)
+        {
+            handler();
+            return true;
+        });
+    }
+
+    bool WebMessageProtocol::Dispatch(std::wstring_view text)
+    {
+        auto started{ std::chrono::steady_clock::now() };
+        uint64_t messagesBefore{ stats.messages };
+        stats.posts++;
+
+        json = text;
+        position = 0;
+        bool valid{ true };
+        try
+        {
+            if (Peek() == L'[')
+            {
+                stats.batches++;
+                position++;
+                if (Peek() != L']')
+                {
+                    do
+                    {
+                        ParseMessage();
+                        HandleMessage();
+                    } while (ConsumeIf(L','));
+                }
+                Expect(L']');
+            }
+            else
+            {
+                ParseMessage();
+                HandleMessage();
+            }
+
+            SkipWhitespace();
+            if (position != json.size())
+            {
+                Fail(L"unexpected data after the end of the message");
+            }
+        }
+        catch (hresult_error const& ex)
+        {
+            stats.invalid++;
+            OutputDebugString((ex.message() + L"\n").c_str());
+            valid = false;
+        }
+
+        stats.dispatchTime += std::chrono::steady_clock::now() - started;
+        if (messagesBefore / StatisticsInterval != stats.messages / StatisticsInterval)
+        {
+            LogStatistics();
+        }
+        return valid;
+    }
+
+    void WebMessageProtocol::LogStatistics() const
+    {
+        auto dispatchMicroseconds{ std::chrono::duration_cast<std::chrono::microseconds>(stats.dispatchTime).count() };
+
+        std::wostringstream strStream{};
+        strStream << L"[WebMessageProtocol: "
+            << L"Posts=" << stats.posts << L", "
+            << L"Batches=" << stats.batches << L", "
+            << L"Messages=" << stats.messages << L", "
+            << L"Unknown=" << stats.unknown << L", "
+            << L"Rejected=" << stats.rejected << L", "
+            << L"Invalid=" << stats.invalid << L", "
+            << L"DispatchUs=" << dispatchMicroseconds << L", "
+            << L"UsPerMessage=" << (stats.messages > 0 ? static_cast<double>(dispatchMicroseconds) / stats.messages : 0.0)
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    void WebMessageProtocol::AddRoute(std::wstring_view message, std::function<bool(WebMessageArgs const&)> handle)
+    {
+        Route route{ MessageIdOf(message), std::wstring{ message }, std::move(handle) };
+        auto it{ std::lower_bound(routes.begin(), routes.end(), route.id, [](Route const& existing, uint32_t id) { return existing.id < id; }) };
+        routes.insert(it, std::move(route));
+    }
+
+    WebMessageProtocol::Route const* WebMessageProtocol::FindRoute(uint32_t id, std::wstring_view name) const noexcept
+    {
+        // Different names can share a hash, so the name still has to be compared, but only against
+        // the routes that share it
+        auto it{ std::lower_bound(routes.begin(), routes.end(), id, [](Route const& existing, uint32_t id) { return existing.id < id; }) };
+        for (; it != routes.end() && it->id == id; ++it)
+        {
+            if (it->name == name)
+            {
+                return &*it;
+            }
+        }
+        return nullptr;
+    }
+
+    /// <summary>
+    /// { "Message": "...", "Args": { ... }, ... }
+    /// </summary>
+    void WebMessageProtocol::ParseMessage()
+    {
+        message.reset();
+        args.fieldCount = 0;
+
+        Expect(L'{');
+        if (Peek() != L'}')
+        {
+            do
+            {
+                std::wstring_view key{ ParseString(skipBuffer) };
+                bool isMessage{ key == L"Message" };
+                bool isArgs{ key == L"Args" };
+                Expect(L':');
+                if (isMessage && Peek() == L'"')
+                {
+                    message = ParseString(messageBuffer);
+                }
+                else if (isArgs && Peek() == L'{')
+                {
+                    ParseArgs();
+                }
+                else
+                {
+                    SkipValue();
+                }
+            } while (ConsumeIf(L','));
+        }
+        Expect(L'}');
+    }
+
+    void WebMessageProtocol::ParseArgs()
+    {
+        Expect(L'{');
+        if (Peek() != L'}')
+        {
+            do
+            {
+                if (args.fieldCount == WebMessageArgs::MaxFields)
+                {
+                    ParseString(skipBuffer);
+                    Expect(L':');
+                    SkipValue();
+                    continue;
+                }
+
+                WebMessageArgs::Field& field{ args.fields[args.fieldCount] };
+                field.name = ParseString(field.nameBuffer);
+                field.number.reset();
+                field.text.reset();
+                Expect(L':');
+
+                wchar_t next{ Peek() };
+                if (next == L'"')
+                {
+                    field.text = ParseString(field.textBuffer);
+                }
+                else if (next == L'-' || (next >= L'0' && next <= L'9'))
+                {
+                    field.number = ParseNumber();
+                }
+                else
+                {
+                    SkipValue();
+                    continue;
+                }
+                args.fieldCount++;
+            } while (ConsumeIf(L','));
+        }
+        Expect(L'}');
+    }
+
+    void WebMessageProtocol::HandleMessage()
+    {
+        stats.messages++;
+        if (!message)
+        {
+            stats.unknown++;
+            OutputDebugString(L"Web message has no Message name.\n");
+            return;
+        }
+
+        Route const* route{ FindRoute(MessageIdOf(*message), *message) };
+        if (!route)
+        {
+            stats.unknown++;
+            std::wostringstream strStream{};
+            strStream << L"Unexpected JSON message:\n" << *message << std::endl;
+            OutputDebugString(strStream.str().c_str());
+            return;
+        }
+
+        if (!route->handle(args))
+        {
+            stats.rejected++;
+            std::wostringstream strStream{};
+            strStream << L"Missing or invalid Args with " << *message << L" message." << std::endl;
+            OutputDebugString(strStream.str().c_str());
+        }
+    }
+
+    /// <summary>
+    /// Reads a string literal. The returned view points into the message text when the literal has
+    /// no escape sequences, and into buffer otherwise.
+    /// </summary>
+    std::wstring_view WebMessageProtocol::ParseString(std::wstring& buffer)
+    {
+        Expect(L'"');
+
+        size_t start{ position };
+        while (position < json.size() && json[position] != L'"' && json[position] != L'\\')
+        {
+            position++;
+        }
+        if (position >= json.size())
+        {
+            Fail(L"unterminated string");
+        }
+        if (json[position] == L'"')
+        {
+            return json.substr(start, position++ - start);
+        }
+
+        // Slow path: the string contains escape sequences
+        buffer.assign(json.substr(start, position - start));
+        while (position < json.size())
+        {
+            wchar_t c{ json[position++] };
+            if (c == L'"')
+            {
+                return buffer;
+            }
+            if (c != L'\\')
+            {
+                buffer.push_back(c);
+                continue;
+            }
+            if (position >= json.size())
+            {
+                break;
+            }
+
+            switch (wchar_t escaped{ json[position++] })
+            {
+            case L'"':
+            case L'\\':
+            case L'/':
+                buffer.push_back(escaped);
+                break;
+            case L'b': buffer.push_back(L'\b'); break;
+            case L'f': buffer.push_back(L'\f'); break;
+            case L'n': buffer.push_back(L'\n'); break;
+            case L'r': buffer.push_back(L'\r'); break;
+            case L't': buffer.push_back(L'\t'); break;
+            case L'u':
+            {
+                if (position + 4 > json.size())
+                {
+                    Fail(L"truncated \\u escape");
+                }
+                int value{ 0 };
+                for (size_t i = 0; i < 4; i++)
+                {
+                    int digit{ HexValue(json[position++]) };
+                    if (digit < 0)
+                    {
+                        Fail(L"invalid \\u escape");
+                    }
+                    value = (value << 4) | digit;
+                }
+                buffer.push_back(static_cast<wchar_t>(value));
+                break;
+            }
+            default:
+                Fail(L"invalid escape sequence");
+            }
+        }
+
+        Fail(L"unterminated string");
+    }
+
+    /// <summary>
+    /// Reads a number. It is copied out to be converted, since the message text is not terminated
+    /// where the number ends.
+    /// </summary>
+    double WebMessageProtocol::ParseNumber()
+    {
+        size_t start{ position };
+        while (position < json.size())
+        {
+            wchar_t c{ json[position] };
+            if ((c >= L'0' && c <= L'9') || c == L'-' || c == L'+' || c == L'.' || c == L'e' || c == L'E')
+            {
+                position++;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        size_t length{ position - start };
+        if (length == 0 || length > MaxNumberLength)
+        {
+            Fail(L"invalid number");
+        }
+
+        wchar_t digits[MaxNumberLength + 1]{};
+        json.copy(digits, length, start);
+        wchar_t* end{ nullptr };
+        double value{ std::wcstod(digits, &end) };
+        if (end != digits + length)
+        {
+            Fail(L"invalid number");
+        }
+        return value;
+    }
+
+    void WebMessageProtocol::SkipValue(uint32_t depth)
+    {
+        if (depth > MaxNestingDepth)
+        {
+            Fail(L"nesting too deep");
+        }
+
+        switch (Peek())
+        {
+        case L'"':
+            ParseString(skipBuffer);
+            break;
+        case L'{':
+            position++;
+            if (Peek() != L'}')
+            {
+                do
+                {
+                    ParseString(skipBuffer);
+                    Expect(L':');
+                    SkipValue(depth + 1);
+                } while (ConsumeIf(L','));
+            }
+            Expect(L'}');
+            break;
+        case L'[':
+            position++;
+            if (Peek() != L']')
+            {
+                do
+                {
+                    SkipValue(depth + 1);
+                } while (ConsumeIf(L','));
+            }
+            Expect(L']');
+            break;
+        case L't':
+            SkipLiteral(L"true");
+            break;
+        case L'f':
+            SkipLiteral(L"false");
+            break;
+        case L'n':
+            SkipLiteral(L"null");
+            break;
+        default:
+            ParseNumber();
+            break;
+        }
+    }
+
+    void WebMessageProtocol::SkipLiteral(std::wstring_view literal)
+    {
+        if (json.substr(position, literal.size()) != literal)
+        {
+            Fail(L"invalid literal");
+        }
+        position += literal.size();
+    }
+
+    void WebMessageProtocol::SkipWhitespace() noexcept
+    {
+        while (position < json.size() && IsWhitespace(json[position]))
+        {
+            position++;
+        }
+    }
+
+    /// <summary>
+    /// Skips whitespace and returns the next character without consuming it.
+    /// </summary>
+    wchar_t WebMessageProtocol::Peek()
+    {
+        SkipWhitespace();
+        if (position >= json.size())
+        {
+            Fail(L"unexpected end of message");
+        }
+        return json[position];
+    }
+
+    bool WebMessageProtocol::ConsumeIf(wchar_t c)
+    {
+        if (Peek() != c)
+        {
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    void WebMessageProtocol::Expect(wchar_t c)
+    {
+        if (Peek() != c)
+        {
+            Fail(L"unexpected character");
+        }
+        position++;
+    }
+
+    void WebMessageProtocol::Fail(wchar_t const* reason) const
+    {
+        std::wostringstream strStream{};
+        strStream << L"Invalid JSON message at offset " << position << L": " << reason;
+        throw hresult_error(WEB_E_INVALID_JSON_STRING, strStream.str().c_str());
+    }
+}
@@ -0,0 +1,167 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace winrt::JavaScriptVideoSample::implementation
+{
+    /// <summary>
+    /// The "Args" of a single web message. Only numbers and strings are kept; fields of any other
+    /// type are skipped, as are any beyond MaxFields. Names and strings view the message text, or
+    /// buffers owned by the WebMessageProtocol, so they are only valid for the duration of the
+    /// handler they are passed to.
+    /// </summary>
+    class WebMessageArgs
+    {
+    public:
+        static constexpr size_t MaxFields{ 8 };
+
+        bool HasKey(std::wstring_view name) const noexcept;
+        std::optional<double> GetNumber(std::wstring_view name) const noexcept;
+        std::optional<std::wstring_view> GetString(std::wstring_view name) const noexcept;
+
+    private:
+        friend class WebMessageProtocol;
+
+        struct Field
+        {
+            std::wstring_view name{};
+            std::optional<double> number{};
+            std::optional<std::wstring_view> text{};
+
+            // Hold the name and value when they contain escape sequences, and so cannot view the
+            // message text. Reused from message to message.
+            std::wstring nameBuffer{};
+            std::wstring textBuffer{};
+        };
+
+        Field const* Find(std::wstring_view name) const noexcept;
+
+        std::array<Field, MaxFields> fields{};
+        size_t fieldCount{ 0 };
+    };
+
+    /// <summary>
+    /// Decodes the messages that the page sends with window.chrome.webview.postMessage and routes
+    /// them to the handler registered for each. A message is a JSON object of the form
+    ///
+    ///     { "Message": "<name>", "Args": { "<argument name>": <argument value>, ... } }
+    ///
+    /// and a batch is a JSON array of messages, which lets the page collect what it has to say and
+    /// post it once per animation frame.
+    ///
+    /// Rather than building a JsonObject for every message and comparing its name against each one
+    /// in turn, the text is read in a single pass into reused buffers, the name is hashed as it goes
+    /// by, and the handler is found in a table keyed by the hashes computed when it was registered.
+    /// Handlers registered with an argument type get their arguments decoded into it; a message
+    /// whose arguments do not decode is logged and dropped.
+    ///
+    /// Handlers must not call Dispatch themselves.
+    /// </summary>
+    class WebMessageProtocol
+    {
+    public:
+        /// <summary>
+        /// The id a message name is routed by: its 32-bit FNV-1a hash.
+        /// </summary>
+        static constexpr uint32_t MessageIdOf(std::wstring_view name) noexcept
+        {
+            uint32_t hash{ 2166136261u };
+            for (wchar_t c : name)
+            {
+                hash = (hash ^ static_cast<uint32_t>(c)) * 16777619u;
+            }
+            return hash;
+        }
+
+        /// <summary>
+        /// Routes message to handler. TArgs must have a static
+        /// std::optional&lt;TArgs&gt; Decode(WebMessageArgs const&amp;).
+        /// </summary>
+        template <typename TArgs>
+        void Register(std::wstring_view message, std::function<void(TArgs const&)> handler)
+        {
+            AddRoute(message, [handler{ std::move(handler) }](WebMessageArgs const& args)
+            {
+                std::optional<TArgs> decoded{ TArgs::Decode(args) };
+                if (!decoded)
+                {
+                    return false;
+                }
+                handler(*decoded);
+                return true;
+            });
+        }
+
+        /// <summary>
+        /// Routes a message that has no arguments to handler.
+        /// </summary>
+        void Register(std::wstring_view message, std::function<void()> handler);
+
+        /// <summary>
+        /// Handles a single message or a batch of them. Returns false if text is not valid JSON, or
+        /// is neither a message nor a batch; messages in a batch before the point where it stopped
+        /// being valid have still been handled.
+        /// </summary>
+        bool Dispatch(std::wstring_view text);
+
+        void LogStatistics() const;
+
+    private:
+        struct Route
+        {
+            uint32_t id{ 0 };
+            std::wstring name{};
+            std::function<bool(WebMessageArgs const&)> handle{};
+        };
+
+        void AddRoute(std::wstring_view message, std::function<bool(WebMessageArgs const&)> handle);
+        Route const* FindRoute(uint32_t id, std::wstring_view name) const noexcept;
+
+        void ParseMessage();
+        void ParseArgs();
+        void HandleMessage();
+        std::wstring_view ParseString(std::wstring& buffer);
+        double ParseNumber();
+        void SkipValue(uint32_t depth = 0);
+        void SkipLiteral(std::wstring_view literal);
+        void SkipWhitespace() noexcept;
+        wchar_t Peek();
+        bool ConsumeIf(wchar_t c);
+        void Expect(wchar_t c);
+        [[noreturn]] void Fail(wchar_t const* reason) const;
+
+        // Sorted by id
+        std::vector<Route> routes{};
+
+        // The state of the message being read
+        std::wstring_view json{};
+        size_t position{ 0 };
+        std::optional<std::wstring_view> message{};
+        std::wstring messageBuffer{};
+        std::wstring skipBuffer{};
+        WebMessageArgs args{};
+
+        struct Statistics
+        {
+            uint64_t posts{ 0 };
+            uint64_t batches{ 0 };              // posts holding an array of messages
+            uint64_t messages{ 0 };
+            uint64_t unknown{ 0 };              // messages with no handler
+            uint64_t rejected{ 0 };             // messages whose arguments did not decode
+            uint64_t invalid{ 0 };              // posts that were not valid JSON
+            std::chrono::steady_clock::duration dispatchTime{};    // reading and handling, all posts
+        };
+        Statistics stats{};
+
+        // How many messages go by between logging the statistics
+        static constexpr uint64_t StatisticsInterval{ 1000 };
+    };
+}
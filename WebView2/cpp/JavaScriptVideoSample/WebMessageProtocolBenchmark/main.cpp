@@ -0,0 +1,347 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "WebMessageProtocol.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+using namespace winrt;
+using namespace winrt::Windows::Data::Json;
+using namespace winrt::JavaScriptVideoSample::implementation;
+
+namespace
+{
+    // How many times each trace is replayed, after one replay to warm up
+    constexpr uint32_t Replays{ 200 };
+
+    // Counted by the replacements for operator new below
+    std::atomic<uint64_t> allocations{ 0 };
+
+    /// <summary>
+    /// What the handlers were told, in place of the system media transport controls that the app's
+    /// handlers update, so that the two ways of handling messages can be checked against each other.
+    /// </summary>
+    struct Sink
+    {
+        uint64_t messages{ 0 };
+        uint64_t statusChanges{ 0 };
+        uint64_t timeUpdates{ 0 };
+        uint64_t videoUpdates{ 0 };
+        uint64_t commandsHandled{ 0 };
+        double currentTime{ 0 };
+        double duration{ 0 };
+        hstring title{};
+        hstring subtitle{};
+        uint64_t sequence{ 0 };
+    };
+
+    /// <summary>
+    /// Reads a trace from the Traces folder next to the executable: one post per line, with lines
+    /// that start with # left out. The posts are converted to hstrings here, since that is how
+    /// CoreWebView2 hands them over, and so that the conversion is not part of what is measured.
+    /// </summary>
+    std::vector<hstring> ReadTrace(wchar_t const* name)
+    {
+        wchar_t modulePath[MAX_PATH]{};
+        GetModuleFileNameW(nullptr, modulePath, MAX_PATH);
+        std::filesystem::path path{ std::filesystem::path{ modulePath }.parent_path() / L"Traces" / name };
+
+        std::vector<hstring> posts{};
+        std::ifstream file{ path };
+        for (std::string line{}; std::getline(file, line);)
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                posts.push_back(to_hstring(line));
+            }
+        }
+        if (posts.empty())
+        {
+            throw hresult_error(E_FAIL, L"Could not read the trace " + path.wstring());
+        }
+        return posts;
+    }
+
+    /// <summary>
+    /// The way MainPage handled a post before WebMessageProtocol: parsed into a JsonObject, with its
+    /// name compared against each message in turn. Only takes single messages, as it did then.
+    /// </summary>
+    void HandleWithJsonObject(hstring const& post, Sink& sink)
+    {
+        JsonObject json{};
+        if (!JsonObject::TryParse(post, json))
+        {
+            return;
+        }
+
+        hstring message{ json.GetNamedString(L"Message") };
+        JsonObject args{ json.GetNamedObject(L"Args") };
+        sink.messages++;
+
+        if (message == L"PlaybackStarted" || message == L"PlaybackPaused" || message == L"PlaybackEnded")
+        {
+            sink.statusChanges++;
+        }
+        else if (message == L"TimeUpdate" && args)
+        {
+            if (args.HasKey(L"CurrentTime") && args.HasKey(L"Duration"))
+            {
+                sink.currentTime = args.GetNamedNumber(L"CurrentTime");
+                sink.duration = args.GetNamedNumber(L"Duration");
+                sink.timeUpdates++;
+            }
+        }
+        else if (message == L"VideoUpdate" && args)
+        {
+            hstring newTitle{ L"" };
+            hstring newSubtitle{ L"" };
+            if (args.HasKey(L"Title"))
+            {
+                newTitle = args.GetNamedString(L"Title");
+            }
+            if (args.HasKey(L"Subtitle"))
+            {
+                newSubtitle = args.GetNamedString(L"Subtitle");
+            }
+            sink.title = newTitle;
+            sink.subtitle = newSubtitle;
+            sink.videoUpdates++;
+        }
+        else if (message == L"CommandChannelReady")
+        {
+        }
+        else if (message == L"CommandsHandled" && args)
+        {
+            if (args.HasKey(L"Sequence"))
+            {
+                sink.sequence = static_cast<uint64_t>(args.GetNamedNumber(L"Sequence"));
+                sink.commandsHandled++;
+            }
+        }
+    }
+
+    // The argument types of MainPage, decoded the same way
+
+    struct TimeUpdateArgs
+    {
+        double currentTime{ 0 };
+        double duration{ 0 };
+
+        static std::optional<TimeUpdateArgs> Decode(WebMessageArgs const& args)
+        {
+            std::optional<double> currentTime{ args.GetNumber(L"CurrentTime") };
+            std::optional<double> duration{ args.GetNumber(L"Duration") };
+            if (!currentTime || !duration)
+            {
+                return std::nullopt;
+            }
+            return TimeUpdateArgs{ *currentTime, *duration };
+        }
+    };
+
+    struct VideoUpdateArgs
+    {
+        hstring title{};
+        hstring subtitle{};
+
+        static std::optional<VideoUpdateArgs> Decode(WebMessageArgs const& args)
+        {
+            return VideoUpdateArgs{ hstring{ args.GetString(L"Title").value_or(L"") }, hstring{ args.GetString(L"Subtitle").value_or(L"") } };
+        }
+    };
+
+    struct CommandsHandledArgs
+    {
+        uint64_t sequence{ 0 };
+
+        static std::optional<CommandsHandledArgs> Decode(WebMessageArgs const& args)
+        {
+            std::optional<double> sequence{ args.GetNumber(L"Sequence") };
+            if (!sequence || *sequence < 0)
+            {
+                return std::nullopt;
+            }
+            return CommandsHandledArgs{ static_cast<uint64_t>(*sequence) };
+        }
+    };
+
+    /// <summary>
+    /// Registers the messages MainPage::RegisterWebMessageHandlers does, with handlers that update
+    /// whichever sink is set instead of the system.
+    /// </summary>
+    void RegisterHandlers(WebMessageProtocol& protocol, Sink* const& sink)
+    {
+        for (wchar_t const* status : { L"PlaybackStarted", L"PlaybackPaused", L"PlaybackEnded" })
+        {
+            protocol.Register(status, [&sink]()
+            {
+                sink->messages++;
+                sink->statusChanges++;
+            });
+        }
+        protocol.Register<TimeUpdateArgs>(L"TimeUpdate", [&sink](TimeUpdateArgs const& args)
+        {
+            sink->messages++;
+            sink->currentTime = args.currentTime;
+            sink->duration = args.duration;
+            sink->timeUpdates++;
+        });
+        protocol.Register<VideoUpdateArgs>(L"VideoUpdate", [&sink](VideoUpdateArgs const& args)
+        {
+            sink->messages++;
+            sink->title = args.title;
+            sink->subtitle = args.subtitle;
+            sink->videoUpdates++;
+        });
+        protocol.Register(L"CommandChannelReady", [&sink]()
+        {
+            sink->messages++;
+        });
+        protocol.Register<CommandsHandledArgs>(L"CommandsHandled", [&sink](CommandsHandledArgs const& args)
+        {
+            sink->messages++;
+            sink->sequence = args.sequence;
+            sink->commandsHandled++;
+        });
+    }
+
+    struct Measurement
+    {
+        double seconds{ 0 };
+        uint64_t allocations{ 0 };
+        Sink sink{};
+    };
+
+    /// <summary>
+    /// Replays every post of trace through handle, once to warm up and then Replays times, and
+    /// returns how long the replays took and how many allocations they made. The sink counts the
+    /// last replay only.
+    /// </summary>
+    template <typename Handle>
+    Measurement Replay(std::vector<hstring> const& trace, Handle&& handle)
+    {
+        Measurement measurement{};
+        for (hstring const& post : trace)
+        {
+            handle(post, measurement.sink);
+        }
+
+        uint64_t allocationsBefore{ allocations.load() };
+        auto started{ std::chrono::steady_clock::now() };
+        for (uint32_t i = 0; i < Replays; i++)
+        {
+            measurement.sink = Sink{};
+            for (hstring const& post : trace)
+            {
+                handle(post, measurement.sink);
+            }
+        }
+        measurement.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        measurement.allocations = allocations.load() - allocationsBefore;
+        return measurement;
+    }
+
+    void Report(char const* name, std::vector<hstring> const& trace, Measurement const& measurement)
+    {
+        double posts{ static_cast<double>(trace.size()) * Replays };
+        double messages{ static_cast<double>(measurement.sink.messages) * Replays };
+        std::printf("%s\n", name);
+        std::printf("    %-40s %14.0f\n", "Posts/sec", posts / measurement.seconds);
+        std::printf("    %-40s %14.0f\n", "Messages/sec", messages / measurement.seconds);
+        std::printf("    %-40s %14.3f\n", "Microseconds/message", measurement.seconds * 1e6 / messages);
+        std::printf("    %-40s %14.3f\n", "Allocations/message", measurement.allocations / messages);
+    }
+
+    bool SameResults(Sink const& expected, Sink const& actual)
+    {
+        return expected.messages == actual.messages &&
+            expected.statusChanges == actual.statusChanges &&
+            expected.timeUpdates == actual.timeUpdates &&
+            expected.videoUpdates == actual.videoUpdates &&
+            expected.commandsHandled == actual.commandsHandled &&
+            expected.currentTime == actual.currentTime &&
+            expected.duration == actual.duration &&
+            expected.title == actual.title &&
+            expected.subtitle == actual.subtitle &&
+            expected.sequence == actual.sequence;
+    }
+}
+
+// Replaced so that allocations can be counted. This only sees what is allocated with operator new in
+// this executable, which includes WebMessageProtocol and std::function, but not what
+// Windows.Data.Json allocates for its JsonObjects, nor the buffers of hstrings. The JsonObject path
+// allocates more than it reports, so its count is a lower bound.
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory{ std::malloc(size == 0 ? 1 : size) })
+    {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+/// <summary>
+/// Replays the recorded traces in the Traces folder through the JsonObject parsing that MainPage
+/// used to do and through WebMessageProtocol, and prints the messages per second and allocations
+/// per message of each. Returns 1 if the two did not handle the messages the same way.
+/// </summary>
+int main()
+{
+    init_apartment();
+
+    try
+    {
+        std::vector<hstring> unbatched{ ReadTrace(L"playback-unbatched.txt") };
+        std::vector<hstring> batched{ ReadTrace(L"playback-batched.txt") };
+
+        Measurement jsonObject{ Replay(unbatched, &HandleWithJsonObject) };
+        Report("JsonObject, one message per post", unbatched, jsonObject);
+
+        // One protocol for all of a trace's replays, as the page has one for its lifetime
+        auto replayProtocol = [](std::vector<hstring> const& trace)
+        {
+            WebMessageProtocol protocol{};
+            Sink* sink{ nullptr };
+            RegisterHandlers(protocol, sink);
+            return Replay(trace, [&](hstring const& post, Sink& replaySink)
+            {
+                sink = &replaySink;
+                protocol.Dispatch(post);
+            });
+        };
+
+        Measurement protocolUnbatched{ replayProtocol(unbatched) };
+        Report("WebMessageProtocol, one message per post", unbatched, protocolUnbatched);
+        Measurement protocolBatched{ replayProtocol(batched) };
+        Report("WebMessageProtocol, batched posts", batched, protocolBatched);
+
+        if (!SameResults(jsonObject.sink, protocolUnbatched.sink) || !SameResults(jsonObject.sink, protocolBatched.sink))
+        {
+            std::printf("FAILED: the two ways of handling the traces did not agree\n");
+            return 1;
+        }
+    }
+    catch (hresult_error const& error)
+    {
+        std::printf("FAILED: 0x%08X %ls\n", static_cast<uint32_t>(error.code()), error.message().c_str());
+        return 1;
+    }
+    return 0;
+}
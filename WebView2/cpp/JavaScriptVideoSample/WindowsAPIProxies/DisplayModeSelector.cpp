@@ -0,0 +1,281 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "DisplayModeSelector.h"
+#include "DisplayModeSelector.g.cpp"
+#include <winrt/Windows.Graphics.Display.h>
+#include <array>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Graphics::Display;
+using namespace winrt::Windows::Graphics::Display::Core;
+using winrt::WindowsAPIProxies::DisplayModeKind;
+
+namespace
+{
+    constexpr size_t DisplayModeKindCount{ 4 };
+
+    enum class RefreshBand
+    {
+        Other,
+        Hz50,
+        Hz60,
+    };
+
+    // The modes the display supports, enumerated once and sorted into the ones suitable for each
+    // kind, in the order the display listed them
+    struct ModeIndex
+    {
+        size_t modeCount{ 0 };
+        std::array<std::vector<HdmiDisplayMode>, DisplayModeKindCount> candidates{};
+    };
+
+    struct SelectorState
+    {
+        std::mutex lock{};
+        std::optional<ModeIndex> index{};
+
+        // The last mode successfully requested, and the HDR option it was requested with
+        HdmiDisplayMode appliedMode{ nullptr };
+        std::optional<HdmiDisplayHdrOption> appliedHdrOption{};
+
+        struct Statistics
+        {
+            uint64_t builds{ 0 };           // times the supported modes were enumerated
+            uint64_t lookups{ 0 };
+            uint64_t requests{ 0 };
+            uint64_t skipped{ 0 };          // requests for the mode the display was already in
+            uint64_t failed{ 0 };
+        };
+        Statistics stats{};
+    };
+
+    SelectorState& State()
+    {
+        static SelectorState state{};
+        return state;
+    }
+
+    // Some TVs report a refresh rate a few decimals lower than 50, 60 or 120. Add a small delta to
+    // bump it over the threshold.
+    RefreshBand RefreshBandOf(double refreshRate)
+    {
+        double rate{ refreshRate + 0.5 };
+        if (rate >= 50 && rate < 60)
+        {
+            return RefreshBand::Hz50;
+        }
+        if (rate >= 60 && rate < 120)
+        {
+            return RefreshBand::Hz60;
+        }
+        return RefreshBand::Other;
+    }
+
+    HdmiDisplayHdrOption HdrOptionFor(DisplayModeKind kind)
+    {
+        switch (kind)
+        {
+        case DisplayModeKind::DolbyVision4K:
+            return HdmiDisplayHdrOption::DolbyVisionLowLatency;
+        case DisplayModeKind::Hdr4K:
+            return HdmiDisplayHdrOption::Eotf2084;
+        case DisplayModeKind::Sdr4K:
+            return HdmiDisplayHdrOption::EotfSdr;
+        default:
+            return HdmiDisplayHdrOption::None;
+        }
+    }
+
+    ModeIndex BuildIndex(HdmiDisplayInformation const& hdmiInfo)
+    {
+        ModeIndex index{};
+        for (HdmiDisplayMode const& mode : hdmiInfo.GetSupportedDisplayModes())
+        {
+            index.modeCount++;
+            RefreshBand band{ RefreshBandOf(mode.RefreshRate()) };
+            if (band == RefreshBand::Hz50)
+            {
+                // If your content has other display needs (such as 4K, or HDR) you should modify
+                // this to check for those as well
+                index.candidates[static_cast<size_t>(DisplayModeKind::Refresh50Hz)].push_back(mode);
+            }
+            else if (band == RefreshBand::Hz60 && mode.ResolutionWidthInRawPixels() >= 3840)
+            {
+                if (mode.IsDolbyVisionLowLatencySupported())
+                {
+                    index.candidates[static_cast<size_t>(DisplayModeKind::DolbyVision4K)].push_back(mode);
+                }
+                if (mode.IsSmpte2084Supported())
+                {
+                    index.candidates[static_cast<size_t>(DisplayModeKind::Hdr4K)].push_back(mode);
+                }
+                if (mode.IsSdrLuminanceSupported())
+                {
+                    index.candidates[static_cast<size_t>(DisplayModeKind::Sdr4K)].push_back(mode);
+                }
+            }
+        }
+        return index;
+    }
+
+    // The display reports whether it is showing HDR, though not which kind, so the HDR option last
+    // requested is only trusted while the display agrees with it
+    bool IsShowingHdr()
+    {
+        AdvancedColorInfo colorInfo{ DisplayInformation::GetForCurrentView().GetAdvancedColorInfo() };
+        return colorInfo.CurrentAdvancedColorKind() == AdvancedColorKind::HighDynamicRange;
+    }
+
+    void LogStatistics(SelectorState const& state)
+    {
+        std::wostringstream strStream{};
+        strStream << L"[DisplayModeSelector: "
+            << L"Builds=" << state.stats.builds << L", "
+            << L"Modes=" << (state.index ? state.index->modeCount : 0) << L", "
+            << L"Lookups=" << state.stats.lookups << L", "
+            << L"Requests=" << state.stats.requests << L", "
+            << L"Skipped=" << state.stats.skipped << L", "
+            << L"Failed=" << state.stats.failed
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+}
+
+namespace winrt::WindowsAPIProxies::implementation
+{
+    /// <summary>
+    /// The supported modes are enumerated on the first call after the cache is invalidated. Of the
+    /// modes suitable for the kind, the one the display is already in is preferred, then one with
+    /// the same resolution, then the first the display lists. Returns null if none is suitable.
+    /// </summary>
+    HdmiDisplayMode DisplayModeSelector::FindBestMode(DisplayModeKind kind)
+    {
+        if (static_cast<size_t>(kind) >= DisplayModeKindCount)
+        {
+            throw hresult_invalid_argument{};
+        }
+
+        HdmiDisplayInformation hdmiInfo{ HdmiDisplayInformation::GetForCurrentView() };
+        if (!hdmiInfo)
+        {
+            return nullptr;
+        }
+
+        SelectorState& state{ State() };
+        std::lock_guard guard{ state.lock };
+        state.stats.lookups++;
+        if (!state.index)
+        {
+            state.index = BuildIndex(hdmiInfo);
+            state.stats.builds++;
+            LogStatistics(state);
+        }
+
+        std::vector<HdmiDisplayMode> const& candidates{ state.index->candidates[static_cast<size_t>(kind)] };
+        if (candidates.empty())
+        {
+            return nullptr;
+        }
+
+        HdmiDisplayMode current{ hdmiInfo.GetCurrentDisplayMode() };
+        if (current)
+        {
+            for (HdmiDisplayMode const& mode : candidates)
+            {
+                if (mode.IsEqual(current))
+                {
+                    return mode;
+                }
+            }
+            for (HdmiDisplayMode const& mode : candidates)
+            {
+                if (mode.ResolutionWidthInRawPixels() == current.ResolutionWidthInRawPixels() &&
+                    mode.ResolutionHeightInRawPixels() == current.ResolutionHeightInRawPixels())
+                {
+                    return mode;
+                }
+            }
+        }
+        return candidates.front();
+    }
+
+    IAsyncOperation<bool> DisplayModeSelector::RequestSetBestModeAsync(DisplayModeKind kind)
+    {
+        HdmiDisplayMode mode{ FindBestMode(kind) };
+        if (!mode)
+        {
+            co_return false;
+        }
+        co_return co_await RequestSetModeAsync(mode, HdrOptionFor(kind));
+    }
+
+    /// <summary>
+    /// Drops the enumerated modes, so that the next lookup enumerates them again. Call this when
+    /// the display's modes change, such as when a different TV is plugged in.
+    /// </summary>
+    void DisplayModeSelector::Invalidate()
+    {
+        SelectorState& state{ State() };
+        std::lock_guard guard{ state.lock };
+        state.index.reset();
+    }
+
+    /// <summary>
+    /// Changing mode makes the TV resync, which blanks the screen for a few seconds, so a request
+    /// for the mode and HDR option the display is already in succeeds without being made. The
+    /// display reports its mode and whether it is showing HDR, but not which HDR option it was set
+    /// with, so an HDR request is only skipped if this selector made it. An SDR request is skipped
+    /// whenever the display is in the mode and not showing HDR, however it got there.
+    /// </summary>
+    IAsyncOperation<bool> DisplayModeSelector::RequestSetModeAsync(HdmiDisplayMode mode, HdmiDisplayHdrOption hdrOption)
+    {
+        HdmiDisplayInformation hdmiInfo{ HdmiDisplayInformation::GetForCurrentView() };
+        SelectorState& state{ State() };
+
+        bool alreadySet{ false };
+        {
+            std::lock_guard guard{ state.lock };
+            state.stats.requests++;
+
+            HdmiDisplayMode current{ hdmiInfo.GetCurrentDisplayMode() };
+            bool wantsHdr{ hdrOption == HdmiDisplayHdrOption::Eotf2084 || hdrOption == HdmiDisplayHdrOption::DolbyVisionLowLatency };
+            if (current && current.IsEqual(mode) && wantsHdr == IsShowingHdr())
+            {
+                alreadySet = !wantsHdr ||
+                    (state.appliedMode && state.appliedMode.IsEqual(mode) && state.appliedHdrOption == hdrOption);
+            }
+            if (alreadySet)
+            {
+                state.stats.skipped++;
+                LogStatistics(state);
+            }
+        }
+        if (alreadySet)
+        {
+            co_return true;
+        }
+
+        bool success = co_await hdmiInfo.RequestSetCurrentDisplayModeAsync(mode, hdrOption);
+
+        std::lock_guard guard{ state.lock };
+        if (success)
+        {
+            state.appliedMode = mode;
+            state.appliedHdrOption = hdrOption;
+        }
+        else
+        {
+            state.appliedMode = nullptr;
+            state.appliedHdrOption.reset();
+            state.stats.failed++;
+        }
+        LogStatistics(state);
+        co_return success;
+    }
+}
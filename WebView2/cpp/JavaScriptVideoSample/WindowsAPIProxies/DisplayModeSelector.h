@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "DisplayModeSelector.g.h"
+
+namespace winrt::WindowsAPIProxies::implementation
+{
+    struct DisplayModeSelector : DisplayModeSelectorT<DisplayModeSelector>
+    {
+        DisplayModeSelector() = default;
+
+        static winrt::Windows::Graphics::Display::Core::HdmiDisplayMode FindBestMode(winrt::WindowsAPIProxies::DisplayModeKind kind);
+        static winrt::Windows::Foundation::IAsyncOperation<bool> RequestSetBestModeAsync(winrt::WindowsAPIProxies::DisplayModeKind kind);
+        static void Invalidate();
+
+        // Not part of the runtime class. GraphicsDisplayProxies sets modes through this too, so that
+        // every mode change is known about when deciding whether a request can be skipped.
+        static winrt::Windows::Foundation::IAsyncOperation<bool> RequestSetModeAsync(winrt::Windows::Graphics::Display::Core::HdmiDisplayMode mode, winrt::Windows::Graphics::Display::Core::HdmiDisplayHdrOption hdrOption);
+    };
+}
+namespace winrt::WindowsAPIProxies::factory_implementation
+{
+    struct DisplayModeSelector : DisplayModeSelectorT<DisplayModeSelector, implementation::DisplayModeSelector>
+    {
+    };
+}
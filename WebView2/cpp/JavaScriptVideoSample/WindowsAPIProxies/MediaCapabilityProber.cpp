@@ -0,0 +1,319 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#include "pch.h"
+#include "MediaCapabilityProber.h"
+#include "MediaCapabilityProber.g.cpp"
+#include <winrt/Windows.Media.Protection.h>
+#include <winrt/Windows.Security.ExchangeActiveSyncProvisioning.h>
+#include <winrt/Windows.Storage.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Foundation::Collections;
+using namespace winrt::Windows::Graphics::Display::Core;
+using namespace winrt::Windows::Media::Protection;
+using namespace winrt::Windows::Security::ExchangeActiveSyncProvisioning;
+using namespace winrt::Windows::Storage;
+using winrt::hstring;
+
+namespace
+{
+    constexpr wchar_t const* ContainerName{ L"MediaCapabilities" };
+
+    // A profile holding more answers than this is started afresh, so that an app changing the types
+    // it asks about can't grow it without bound
+    constexpr uint32_t MaxAnswersPerProfile{ 256 };
+
+    // IsTypeSupported stops answering Maybe within 10 seconds. It is asked again quickly at first,
+    // as most types are decided in a few milliseconds, backing off to every 100ms.
+    constexpr std::chrono::seconds ProbeDeadline{ 12 };
+    constexpr std::chrono::milliseconds FirstPollInterval{ 10 };
+    constexpr std::chrono::milliseconds MaxPollInterval{ 100 };
+
+    struct Statistics
+    {
+        std::atomic<uint64_t> probes{ 0 };          // calls to ProbeAsync
+        std::atomic<uint64_t> cached{ 0 };          // types answered from a previous launch
+        std::atomic<uint64_t> probed{ 0 };          // types asked of IsTypeSupported
+        std::atomic<uint64_t> polls{ 0 };           // calls to IsTypeSupported
+        std::atomic<uint64_t> undecided{ 0 };       // types still Maybe at the deadline
+        std::atomic<uint64_t> changed{ 0 };         // cached answers a background probe overturned
+    };
+
+    Statistics& Stats()
+    {
+        static Statistics stats{};
+        return stats;
+    }
+
+    // Only one background probe runs at a time; the others would only repeat its work
+    std::atomic<bool> reprobing{ false };
+
+    // Saving is a read, merge and write of the profile, which is done by the UI thread and
+    // background probes alike
+    std::mutex storeLock{};
+
+    uint64_t Fnv1a(uint64_t hash, void const* data, size_t size)
+    {
+        uint8_t const* bytes{ static_cast<uint8_t const*>(data) };
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t Fnv1a(uint64_t hash, hstring const& value)
+    {
+        return Fnv1a(hash, value.c_str(), value.size() * sizeof(wchar_t));
+    }
+
+    constexpr uint64_t Fnv1aBasis{ 14695981039346656037ull };
+
+    hstring ToHex(uint64_t value)
+    {
+        std::wostringstream strStream{};
+        strStream << std::hex << value;
+        return hstring{ strStream.str() };
+    }
+
+    /// <summary>
+    /// Identifies the console model and the display attached to it, which between them decide what
+    /// can be played. The display is identified by the modes it supports, as HDMI gives no name.
+    /// Must be called on the UI thread.
+    /// </summary>
+    hstring CurrentProfileKey()
+    {
+        uint64_t hash{ Fnv1a(Fnv1aBasis, EasClientDeviceInformation{}.SystemProductName()) };
+
+        HdmiDisplayInformation hdmiInfo{ HdmiDisplayInformation::GetForCurrentView() };
+        if (hdmiInfo)
+        {
+            for (HdmiDisplayMode const& mode : hdmiInfo.GetSupportedDisplayModes())
+            {
+                uint32_t const fields[]
+                {
+                    mode.ResolutionWidthInRawPixels(),
+                    mode.ResolutionHeightInRawPixels(),
+                    static_cast<uint32_t>(std::lround(mode.RefreshRate() * 100)),
+                    (mode.IsSdrLuminanceSupported() ? 1u : 0u) |
+                        (mode.IsSmpte2084Supported() ? 2u : 0u) |
+                        (mode.IsDolbyVisionLowLatencySupported() ? 4u : 0u),
+                };
+                hash = Fnv1a(hash, fields, sizeof(fields));
+            }
+        }
+        return ToHex(hash);
+    }
+
+    hstring TypeKey(hstring const& type, hstring const& keySystem)
+    {
+        // Types are usually too long to be setting names themselves
+        return ToHex(Fnv1a(Fnv1a(Fnv1aBasis, keySystem), type));
+    }
+
+    ApplicationDataCompositeValue LoadProfile(hstring const& profileKey)
+    {
+        IPropertySet values{ ApplicationData::Current().LocalSettings().CreateContainer(ContainerName, ApplicationDataCreateDisposition::Always).Values() };
+        if (auto stored{ values.TryLookup(profileKey).try_as<ApplicationDataCompositeValue>() })
+        {
+            return stored;
+        }
+        return {};
+    }
+
+    void SaveAnswers(hstring const& profileKey, std::vector<std::pair<hstring, bool>> const& answers)
+    {
+        if (answers.empty())
+        {
+            return;
+        }
+
+        std::lock_guard guard{ storeLock };
+        ApplicationDataCompositeValue profile{ LoadProfile(profileKey) };
+        if (profile.Size() + answers.size() > MaxAnswersPerProfile)
+        {
+            profile.Clear();
+        }
+        for (auto const& [typeKey, supported] : answers)
+        {
+            profile.Insert(typeKey, box_value(supported));
+        }
+        ApplicationData::Current().LocalSettings().CreateContainer(ContainerName, ApplicationDataCreateDisposition::Always).Values().Insert(profileKey, profile);
+    }
+
+    IAsyncOperation<ProtectionCapabilityResult> ProbeTypeAsync(hstring type, hstring keySystem)
+    {
+        co_await winrt::resume_background();
+
+        ProtectionCapabilities capabilities{};
+        auto deadline{ std::chrono::steady_clock::now() + ProbeDeadline };
+        std::chrono::milliseconds interval{ FirstPollInterval };
+
+        ProtectionCapabilityResult result{ capabilities.IsTypeSupported(type, keySystem) };
+        Stats().polls++;
+        while (result == ProtectionCapabilityResult::Maybe && std::chrono::steady_clock::now() < deadline)
+        {
+            co_await winrt::resume_after(interval);
+            interval = std::min(interval * 2, MaxPollInterval);
+            result = capabilities.IsTypeSupported(type, keySystem);
+            Stats().polls++;
+        }
+        if (result == ProtectionCapabilityResult::Maybe)
+        {
+            Stats().undecided++;
+        }
+        co_return result;
+    }
+
+    void LogStatistics(std::chrono::steady_clock::time_point startedAt)
+    {
+        Statistics const& stats{ Stats() };
+        std::wostringstream strStream{};
+        strStream << L"[MediaCapabilityProber: "
+            << L"Probes=" << stats.probes << L", "
+            << L"Cached=" << stats.cached << L", "
+            << L"Probed=" << stats.probed << L", "
+            << L"Polls=" << stats.polls << L", "
+            << L"Undecided=" << stats.undecided << L", "
+            << L"Changed=" << stats.changed << L", "
+            << L"ElapsedMs=" << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startedAt).count()
+            << L"]" << std::endl;
+        OutputDebugString(strStream.str().c_str());
+    }
+
+    struct CachedType
+    {
+        hstring type;
+        hstring typeKey;
+        bool supported;
+    };
+
+    /// <summary>
+    /// Asks again about types that were answered from a previous launch, so that a system update
+    /// that changes what is supported is picked up by the next launch.
+    /// </summary>
+    winrt::fire_and_forget ReprobeAsync(hstring profileKey, std::vector<CachedType> cachedTypes, hstring keySystem)
+    {
+        if (reprobing.exchange(true))
+        {
+            co_return;
+        }
+
+        auto startedAt{ std::chrono::steady_clock::now() };
+        try
+        {
+            co_await winrt::resume_background();
+
+            std::vector<IAsyncOperation<ProtectionCapabilityResult>> probes{};
+            for (CachedType const& cachedType : cachedTypes)
+            {
+                probes.push_back(ProbeTypeAsync(cachedType.type, keySystem));
+            }
+
+            std::vector<std::pair<hstring, bool>> answers{};
+            for (size_t i = 0; i < probes.size(); i++)
+            {
+                ProtectionCapabilityResult result{ co_await probes[i] };
+                if (result == ProtectionCapabilityResult::Maybe)
+                {
+                    continue;
+                }
+
+                bool supported{ result != ProtectionCapabilityResult::NotSupported };
+                if (supported != cachedTypes[i].supported)
+                {
+                    Stats().changed++;
+                }
+                answers.emplace_back(cachedTypes[i].typeKey, supported);
+            }
+            SaveAnswers(profileKey, answers);
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            std::wostringstream strStream{};
+            strStream << L"Background media capability probe failed: " << ex.message().c_str() << std::endl;
+            OutputDebugString(strStream.str().c_str());
+        }
+
+        reprobing = false;
+        LogStatistics(startedAt);
+    }
+}
+
+namespace winrt::WindowsAPIProxies::implementation
+{
+    /// <summary>
+    /// Types that were answered on a previous launch with the same console and display are answered
+    /// from settings straight away, then probed again in the background. The rest are all probed at
+    /// once, and their answers saved. A type still undecided at the deadline is reported as
+    /// supported, as IsTypeSupported's Maybe would be, but isn't saved.
+    /// </summary>
+    IAsyncOperation<IVectorView<bool>> MediaCapabilityProber::ProbeAsync(array_view<hstring const> types, hstring keySystem)
+    {
+        // The view is only valid until the first suspension
+        std::vector<hstring> requested{ types.begin(), types.end() };
+        auto startedAt{ std::chrono::steady_clock::now() };
+        Stats().probes++;
+
+        hstring profileKey{ CurrentProfileKey() };
+        ApplicationDataCompositeValue profile{ LoadProfile(profileKey) };
+
+        std::vector<std::optional<bool>> answers(requested.size());
+        std::vector<hstring> typeKeys{};
+        std::vector<CachedType> cachedTypes{};
+        std::vector<size_t> unanswered{};
+        std::vector<IAsyncOperation<ProtectionCapabilityResult>> probes{};
+        for (size_t i = 0; i < requested.size(); i++)
+        {
+            typeKeys.push_back(TypeKey(requested[i], keySystem));
+            if (auto stored{ profile.TryLookup(typeKeys[i]) })
+            {
+                answers[i] = unbox_value<bool>(stored);
+                cachedTypes.push_back({ requested[i], typeKeys[i], *answers[i] });
+            }
+            else
+            {
+                unanswered.push_back(i);
+                probes.push_back(ProbeTypeAsync(requested[i], keySystem));
+            }
+        }
+        Stats().cached += cachedTypes.size();
+        Stats().probed += probes.size();
+
+        std::vector<std::pair<hstring, bool>> probedAnswers{};
+        for (size_t k = 0; k < probes.size(); k++)
+        {
+            size_t i{ unanswered[k] };
+            ProtectionCapabilityResult result{ co_await probes[k] };
+            answers[i] = (result != ProtectionCapabilityResult::NotSupported);
+            if (result != ProtectionCapabilityResult::Maybe)
+            {
+                probedAnswers.emplace_back(typeKeys[i], *answers[i]);
+            }
+        }
+        SaveAnswers(profileKey, probedAnswers);
+
+        if (!cachedTypes.empty())
+        {
+            ReprobeAsync(profileKey, std::move(cachedTypes), keySystem);
+        }
+        LogStatistics(startedAt);
+
+        IVector<bool> results{ single_threaded_vector<bool>() };
+        for (std::optional<bool> const& answer : answers)
+        {
+            results.Append(*answer);
+        }
+        co_return results.GetView();
+    }
+}
@@ -0,0 +1,21 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+#include "MediaCapabilityProber.g.h"
+
+namespace winrt::WindowsAPIProxies::implementation
+{
+    struct MediaCapabilityProber : MediaCapabilityProberT<MediaCapabilityProber>
+    {
+        MediaCapabilityProber() = default;
+
+        static winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Foundation::Collections::IVectorView<bool>> ProbeAsync(array_view<hstring const> types, hstring keySystem);
+    };
+}
+namespace winrt::WindowsAPIProxies::factory_implementation
+{
+    struct MediaCapabilityProber : MediaCapabilityProberT<MediaCapabilityProber, implementation::MediaCapabilityProber>
+    {
+    };
+}